@@ -1,5 +1,6 @@
 #include "DebugDraw.h"
 #include "OpenGL.h"
+#include <stdio.h>
 
 namespace roxlu {
 namespace bullet {
@@ -10,12 +11,14 @@ DebugDraw::DebugDraw()
 }
 
 void DebugDraw::drawLine(const btVector3& from,const btVector3& to,const btVector3& fromColor, const btVector3& toColor) {
+#if defined(ROXLU_WITH_OPENGL)
 	glBegin(GL_LINES);
 		glColor3f(fromColor.x(), fromColor.y(), fromColor.z());
 		glVertex3d(from.x(), from.y(), from.z());
 		glColor3f(toColor.x(), toColor.y(), toColor.z());
 		glVertex3d(to.x(), to.y(), to.z());
 	glEnd();
+#endif
 }
 
 void DebugDraw::drawLine(const btVector3& from,const btVector3& to,const btVector3& color) {
@@ -23,7 +26,7 @@ void DebugDraw::drawLine(const btVector3& from,const btVector3& to,const btVecto
 }
 
 void DebugDraw::drawSphere(const btVector3& p, btScalar radius, const btVector3& color) {
-
+#if defined(ROXLU_WITH_OPENGL)
 	glColor4f(color.x(), color.y(), color.z(), btScalar(1.0f));
 	glPushMatrix();
 		glTranslatef(p.x(), p.y(), p.z());
@@ -55,6 +58,7 @@ void DebugDraw::drawSphere(const btVector3& p, btScalar radius, const btVector3&
 			glEnd();
 		}
 	glPopMatrix();
+#endif
 }
 
 void DebugDraw::drawBox(
@@ -86,6 +90,7 @@ void DebugDraw::drawTriangle(
 			,btScalar alpha
 )
 {
+#if defined(ROXLU_WITH_OPENGL)
 	const btVector3	n = btCross(b-a,c-a).normalized();
 	glBegin(GL_TRIANGLES);		
 		glColor4f(color.x(), color.y(), color.z(),alpha);
@@ -94,6 +99,7 @@ void DebugDraw::drawTriangle(
 		glVertex3d(b.x(),b.y(),b.z());
 		glVertex3d(c.x(),c.y(),c.z());
 	glEnd();
+#endif
 }
 
 void DebugDraw::setDebugMode(int mode) {
@@ -116,6 +122,7 @@ void  DebugDraw::drawContactPoint(
 			,const btVector3& color
 )
 {
+#if defined(ROXLU_WITH_OPENGL)
 	btVector3 to = pointOnB + normalOnB * 1; //distance;
 	const btVector3&from = pointOnB;
 	glColor4f(color.x(), color.y(), color.z(),1.f);
@@ -123,6 +130,7 @@ void  DebugDraw::drawContactPoint(
 		glVertex3d(from.x(), from.y(), from.z());
 		glVertex3d(to.x(), to.y(), to.z());
 	glEnd();
+#endif
 }
 
 
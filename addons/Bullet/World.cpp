@@ -1,12 +1,27 @@
 #include "World.h"
 #include "Vec3.h"
 #include "Constants.h"
+#include <algorithm>
+#include <string.h>
 
 namespace roxlu {
 namespace bullet {
 
 namespace rb = roxlu::bullet;
 
+void world_physics_thread_function(void* user) {
+	World* w = static_cast<World*>(user);
+	w->runPhysics();
+}
+
+WorldSettings::WorldSettings()
+	:use_physics_thread(false)
+	,fixed_time_step(1/60.0f)
+	,max_sub_steps(10)
+	,max_persistent_manifolds(4096)
+{
+}
+
 World::World() 
 	:broadphase(NULL)
 	,config(NULL)
@@ -14,12 +29,33 @@ World::World()
 	,solver(NULL)
 	,world(NULL)
 	,debug_drawer(NULL)
+	,back_dx(0)
+	,shared_dx(1)
+	,front_dx(2)
+	,has_new_transforms(false)
+	,must_stop(false)
+	,is_thread_running(false)
 {
+	uv_mutex_init(&world_mutex);
+	uv_mutex_init(&buffer_mutex);
 }
 
-void World::create() {
+World::~World() {
+	shutdown();
+	uv_mutex_destroy(&world_mutex);
+	uv_mutex_destroy(&buffer_mutex);
+}
+
+void World::create(const WorldSettings& ws) {
+	shutdown();
+	settings = ws;
+
+	btDefaultCollisionConstructionInfo cci;
+	cci.m_defaultMaxPersistentManifoldPoolSize = settings.max_persistent_manifolds;
+
 	broadphase = new btDbvtBroadphase();
-	config = new btDefaultCollisionConfiguration();
+	config = new btDefaultCollisionConfiguration(cci);
+
 	dispatcher = new btCollisionDispatcher(config);
 	solver = new btSequentialImpulseConstraintSolver;
 	world = new btDiscreteDynamicsWorld(dispatcher, broadphase, solver, config);
@@ -27,14 +63,135 @@ void World::create() {
 	debug_drawer = new roxlu::bullet::DebugDraw();
 	debug_drawer->setDebugMode(btIDebugDraw::DBG_DrawWireframe /*| btIDebugDraw::DBG_DrawAabb*/);
 	world->setDebugDrawer(debug_drawer);
+
+	if(settings.use_physics_thread) {
+		must_stop = false;
+		is_thread_running = true;
+		uv_thread_create(&thread, world_physics_thread_function, this);
+	}
+}
+
+void World::shutdown() {
+	if(is_thread_running) {
+		uv_mutex_lock(&buffer_mutex);
+		must_stop = true;
+		uv_mutex_unlock(&buffer_mutex);
+		uv_thread_join(&thread);
+		is_thread_running = false;
+	}
+
+	for(std::vector<rbb::Body*>::iterator it = bodies.begin(); it != bodies.end(); ++it) {
+		(*it)->world = NULL;
+	}
+	bodies.clear();
+
+	for(int i = 0; i < 3; ++i) {
+		transforms[i].clear();
+	}
+	has_new_transforms = false;
+
+	// the world uses the solver and dispatcher
+	delete world;
+	delete solver;
+	delete dispatcher;
+	delete config;
+	delete broadphase;
+	delete debug_drawer;
+	world = NULL;
+	solver = NULL;
+	dispatcher = NULL;
+	config = NULL;
+	broadphase = NULL;
+	debug_drawer = NULL;
 }
 
 void World::setGravity(float x, float y, float z) {
+	lock();
 	world->setGravity(btVector3(x,y,z));	
+	unlock();
 }
 
 void World::update() {
-	world->stepSimulation(1/60.0f, 10);
+	if(!world) {
+		RX_ERROR(BULLET_ERR_NOT_CREATED);
+		return;
+	}
+
+	if(!is_thread_running) {
+		world->stepSimulation(settings.fixed_time_step, settings.max_sub_steps, settings.fixed_time_step);
+		return;
+	}
+
+	uv_mutex_lock(&buffer_mutex);
+	if(has_new_transforms) {
+		std::swap(front_dx, shared_dx);
+		has_new_transforms = false;
+	}
+	uv_mutex_unlock(&buffer_mutex);
+}
+
+// Physics thread
+// -----------------------------------------------------------------------------
+void World::runPhysics() {
+	uint64_t step_ns = uint64_t(settings.fixed_time_step * 1e9);
+	uint64_t last_time = uv_hrtime();
+
+	while(true) {
+		uv_mutex_lock(&buffer_mutex);
+		bool stop = must_stop;
+		uv_mutex_unlock(&buffer_mutex);
+		if(stop) {
+			break;
+		}
+
+		uint64_t now = uv_hrtime();
+		step(double(now - last_time) / 1e9);
+		last_time = now;
+
+		uv_mutex_lock(&buffer_mutex);
+		std::swap(back_dx, shared_dx);
+		has_new_transforms = true;
+		uv_mutex_unlock(&buffer_mutex);
+
+		uint64_t took = uv_hrtime() - now;
+		if(took < step_ns) {
+			rx_sleep_millis((step_ns - took) / 1000000);
+		}
+	}
+}
+
+void World::step(float dt) {
+	lock();
+
+	world->stepSimulation(dt, settings.max_sub_steps, settings.fixed_time_step);
+
+	std::vector<float>& back = transforms[back_dx];
+	back.resize(bodies.size() * 16);
+	btTransform trans;
+	for(size_t i = 0; i < bodies.size(); ++i) {
+		bodies[i]->motion_state->getWorldTransform(trans);
+		trans.getOpenGLMatrix(&back[i * 16]);
+	}
+
+	unlock();
+}
+
+bool World::copyMatrix(size_t transformDx, Mat4& m) {
+	std::vector<float>& front = transforms[front_dx];
+	if((transformDx + 1) * 16 > front.size()) {
+		return false;
+	}
+	memcpy(m.m, &front[transformDx * 16], sizeof(float) * 16);
+	return true;
+}
+
+void World::addBody(rbb::Body* body) {
+	lock();
+	body->world = this;
+	body->transform_dx = bodies.size();
+	bodies.push_back(body);
+	world->addRigidBody(body->rigid_body);
+	unlock();
 }
 
 
@@ -48,7 +205,7 @@ btSphereShape* World::sphereCreateShape(float radius) {
 rbb::Sphere* World::sphereCreateBody(btSphereShape* sphereShape, const Vec3& position, const float mass ) {
 	rbb::Sphere* sphere = new rbb::Sphere();
 	World::setupBody(sphere, sphereShape, World::createTransform(position), mass);
-	world->addRigidBody(sphere->rigid_body);
+	addBody(sphere);
 	return sphere;
 }
 
@@ -64,13 +221,15 @@ btStaticPlaneShape* World::createStaticPlaneShape(const Vec3& planeNormal, float
 rbb::StaticPlane* World::createStaticPlaneBody(btStaticPlaneShape* planeShape, const Vec3& position) {
 	rbb::StaticPlane* plane = new rbb::StaticPlane();	
 	World::setupBody(plane, planeShape, World::createTransform(position),0);
-	world->addRigidBody(plane->rigid_body);
+	addBody(plane);
 	return plane;
 }
 
 
 void World::debugDraw() {
+	lock();
 	world->debugDrawWorld();
+	unlock();
 }
 
 // Box
@@ -83,7 +242,7 @@ btBoxShape* World::createBoxShape(float sizeX, float sizeY, float sizeZ) {
 rbb::Box* World::createBoxBody(btBoxShape* boxShape, const Vec3& position, const float mass) {
 	rbb::Box* box = new rbb::Box();
 	World::setupBody(box, boxShape, World::createTransform(position), mass);
-	world->addRigidBody(box->rigid_body);
+	addBody(box);
 	return box;
 }
 
@@ -11,6 +11,45 @@
 #include "Roxlu.h"
 #include "Constants.h"
 #include "DebugDraw.h"
+#include <uv.h>
+#include <vector>
+
+/*
+
+  World
+  -----
+  By default the world steps on the thread that calls update(). Pass a
+  WorldSettings to create() to step on a separate physics thread, so the
+  render thread never waits for a step. Bullet itself still runs the
+  sequential collision dispatcher and constraint solver.
+
+  When `use_physics_thread` is true, update() never steps the simulation. The
+  physics thread steps at `fixed_time_step` and writes the matrices of all
+  bodies into a back buffer which it swaps with a shared buffer. update()
+  swaps the shared buffer with the one that the render thread reads from, so
+  Body::copyMatrix() always returns the transforms of one complete step and
+  never waits for the physics thread.
+
+  Everything that changes the bullet world (creating bodies, setGravity(),
+  Body::applyCentralForce(), debugDraw()) locks the world; this waits until
+  the current step has finished.
+
+  Examples
+  --------
+
+      rb::WorldSettings settings;
+      settings.use_physics_thread = true;
+
+      rb::World world;
+      world.create(settings);
+
+      // each frame
+      world.update();
+      box->copyMatrix(mat);
+
+*/
+
+#define BULLET_ERR_NOT_CREATED "Call World::create() first"
 
 namespace roxlu {
 namespace bullet {
@@ -18,17 +57,30 @@ namespace bullet {
 namespace rb = roxlu::bullet;
 namespace rbb = roxlu::bullet::body;
 
+struct WorldSettings {
+	WorldSettings();
+	bool use_physics_thread;                                   // step the simulation on a separate thread
+	float fixed_time_step;                                     // the internal time step of bullet
+	int max_sub_steps;                                         // maximum number of internal steps per stepSimulation() call
+	int max_persistent_manifolds;                              // size of the contact manifold pool, increase when you have many bodies touching each other
+};
+
+void world_physics_thread_function(void* user);               // calls World::runPhysics()
+
 class World {
 public:
 	World();
-	void create();
+	~World();
+	void create(const WorldSettings& settings = WorldSettings());
 	void setGravity(float x, float y, float z);
-	void update();
+	void update();                                             // steps the world or, with a physics thread, picks up the latest transforms
 	void debugDraw();
-	
+	void lock();                                               // lock the bullet world when you change it directly while the physics thread runs
+	void unlock();
+
 	btBoxShape* createBoxShape(float sizeX, float sizeY, float sizeZ);
 	rbb::Box* createBoxBody(btBoxShape* boxShape, const Vec3& position, const float mass);
-	
+
 	btStaticPlaneShape* createStaticPlaneShape(const Vec3& planeNormal, float planeConstant);
 	rbb::StaticPlane* createStaticPlaneBody(btStaticPlaneShape* planeShape, const Vec3& position);
 	btSphereShape* sphereCreateShape(float radius);
@@ -38,20 +90,53 @@ public:
 	static btTransform createTransform(const Vec3& position);
 	static void setupBody(rbb::Body* body, btCollisionShape* collisionShape, const btTransform& transform, const float mass);
 	btDiscreteDynamicsWorld* getBulletWorld();
+	bool isThreaded();
+	bool copyMatrix(size_t transformDx, Mat4& m);              // copies the matrix of the body from the buffer of the render thread, returns false when the body isn't stepped yet
+	void runPhysics();                                         // the physics thread; don't call this yourself
+
 private:
-	
-	btBroadphaseInterface* broadphase;		
+	void addBody(rbb::Body* body);                             // adds the rigid body to the world and gives the body a slot in the transform buffers
+	void step(float dt);                                       // steps the simulation and fills the back buffer with the new transforms
+	void shutdown();
+
+	WorldSettings settings;
+	btBroadphaseInterface* broadphase;
 	btDefaultCollisionConfiguration* config;
 	btCollisionDispatcher* dispatcher;
 	btSequentialImpulseConstraintSolver* solver;
 	btDiscreteDynamicsWorld* world;
-	rb::DebugDraw* debug_drawer; 
+	rb::DebugDraw* debug_drawer;
+
+	/* physics thread */
+	std::vector<rbb::Body*> bodies;                            // all bodies, index is Body::transform_dx
+	std::vector<float> transforms[3];                          // 16 floats per body: back buffer (physics thread), shared buffer and front buffer (render thread)
+	int back_dx;                                               // index into transforms of the buffer the physics thread writes
+	int shared_dx;                                             // index of the newest complete buffer
+	int front_dx;                                              // index of the buffer the render thread reads
+	bool has_new_transforms;                                   // true when the shared buffer is newer than the front buffer
+	bool must_stop;
+	bool is_thread_running;
+	uv_thread_t thread;
+	uv_mutex_t world_mutex;                                    // held while stepping; protects the bullet world
+	uv_mutex_t buffer_mutex;                                   // protects shared_dx and has_new_transforms
 };
 
 inline btDiscreteDynamicsWorld* World::getBulletWorld() {
 	return world;
 }
 
+inline bool World::isThreaded() {
+	return is_thread_running;
+}
+
+inline void World::lock() {
+	uv_mutex_lock(&world_mutex);
+}
+
+inline void World::unlock() {
+	uv_mutex_unlock(&world_mutex);
+}
+
 }} // roxlu::bullet
 
-#endif
\ No newline at end of file
+#endif
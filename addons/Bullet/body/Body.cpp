@@ -1,18 +1,46 @@
 #include "Body.h"
+#include "../World.h"
 
 namespace roxlu {
 namespace bullet {
 namespace body {
 
-Body::Body() {
+Body::Body()
+	:rigid_body(NULL)
+	,collision_shape(NULL)
+	,motion_state(NULL)
+	,world(NULL)
+	,transform_dx(0)
+{
 }
 
 Body::~Body() {
 }
 
+void Body::applyCentralForce(float x, float y, float z) {
+	if(world) {
+		world->lock();
+	}
+	rigid_body->applyCentralForce(btVector3(x,y,z));
+	if(world) {
+		world->unlock();
+	}
+}
+
+// When the world steps on a physics thread we read the matrix of the last complete step.
 void Body::copyMatrix(Mat4& mat) const {
+	if(world && world->isThreaded() && world->copyMatrix(transform_dx, mat)) {
+		return;
+	}
+
 	btTransform trans;
+	if(world) {
+		world->lock();
+	}
 	motion_state->getWorldTransform(trans);
+	if(world) {
+		world->unlock();
+	}
 	trans.getOpenGLMatrix(mat.m);
 }
 
@@ -3,26 +3,28 @@
 
 #include "bullet/btBulletDynamicsCommon.h"
 #include "Mat4.h"
+#include <stddef.h>
+
 namespace roxlu {
 namespace bullet {
+
+class World;
+
 namespace body {
 
 class Body {
 public:
 	Body();
-	~Body();
+	virtual ~Body();
 	void applyCentralForce(float x, float y, float z);
 	virtual void copyMatrix(Mat4& m) const;
 	
 	btRigidBody* rigid_body;
 	btCollisionShape* collision_shape;
 	btDefaultMotionState* motion_state;
-;
+	World* world;                     // the world this body was added to
+	size_t transform_dx;              // slot in the transform buffers of the world
 };
 
-inline void Body::applyCentralForce(float x, float y, float z) {
-	rigid_body->applyCentralForce(btVector3(x,y,z));
-}
-
 }}} // roxlu::bullet::shape
 #endif
\ No newline at end of file
@@ -36,7 +36,7 @@ namespace buttons {
     void onMouseDown(int x, int y);                                           
                                                                               
     void sendCommand(CommandData cmd);                                            /* Send a command to the gui server */ 
-    void write(char* data, size_t nbytes);                                        /* Send data over socket */
+    void write(char* data, size_t nbytes);                                        /* Send data over socket; the data is copied */
     void parseBuffer();                                                           /* Parses the incoming bitstream */ 
     void handleCommand(CommandData& cmd);                                         /* Handles the commands we find in parseBuffer() */
     void getScheme();                                                             /* Ask the remove server for the gui scheme */
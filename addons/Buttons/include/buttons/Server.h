@@ -18,6 +18,7 @@ extern "C" {
 #include <vector>
 #include <deque>
 #include <roxlu/core/Log.h>
+#include <roxlu/core/Utils.h>
 
 #define BUTTONS_UV_ERR(r, okval, msg, ret)      \
   if(r != okval) { \
@@ -26,6 +27,9 @@ extern "C" {
     return ret; \
   }
 
+#define BUTTONS_DEFAULT_SEND_RATE 30                   /* default number of value updates per second we send to the clients */
+#define BUTTONS_DEFAULT_MAX_PENDING_BYTES (64 * 1024)  /* when a client has more bytes queued for writing we hold back its value updates */
+
 namespace buttons {
 
   void buttons_server_on_new_connection(uv_stream_t* sock, int status);
@@ -50,6 +54,7 @@ namespace buttons {
     ,BDATA_VECTOR           // vector (float 2) data
     ,BDATA_PADF             // float pad value (2 floats, x/y percentage)
     ,BDATA_PADI             // int pad value (2 floats, x/y percentage)
+    ,BDATA_BATCH            // batch of value changes: UI16 count, then for each change an UI16 size + the same data as BDATA_CHANGED
   };
 
 
@@ -109,6 +114,10 @@ namespace buttons {
     bool deserialize(ButtonsBuffer& buffer, 
                      CommandData& data, 
                      std::map<unsigned int, std::map<unsigned int, Element*> >& elements);
+
+    bool deserializeValue(ButtonsBuffer& buffer,       /* Deserializes the buttons id, element id and value of a BDATA_CHANGED command or of one entry in a BDATA_BATCH */
+                          CommandData& data, 
+                          std::map<unsigned int, std::map<unsigned int, Element*> >& elements);
   };
 
 
@@ -128,10 +137,15 @@ namespace buttons {
     void parseBuffer();                                /* Parse incoming bitstreamd and decode commands */
     void handleCommand(CommandData& cmd);              /* When parsing of the buffer returns a command we perform the correct action in here */
     void sendCommand(ServerCommand& cmd);
-    void write(char* buf, size_t nbytes);              /* Writes data on the sockets */
+    void sendChanges();                                /* Sends all dirty values in one BDATA_BATCH command, unless the client can't keep up */
+    void setDirty(size_t dx);                          /* Marks the value with the given index in Server::values as changed */
+    void write(char* buf, size_t nbytes);              /* Writes data on the sockets; the data is copied */
 
   public:
     ButtonsBuffer buffer;                              /* Holds all received data */
+    ButtonsBuffer batch;                               /* Used to create the BDATA_BATCH command */
+    std::vector<size_t> dirty;                         /* Indices into Server::values which changed since we last sent them */
+    std::vector<bool> is_dirty;                        /* Per value in Server::values, true when it's in `dirty` */
     ClientServerUtils util;                            /* Client server utilities, used to serialize/deserialize a bitstream */
     Server& server;
     uv_tcp_t sock;
@@ -147,11 +161,13 @@ namespace buttons {
     void removeConnection(Connection* c);              /* Remove a connection when it disconnects */
     void addButtons(Buttons& gui);                     /* Add a buttons object you want to share across the network */
     void sendScheme(Connection* con);                  /* Sends the GUI scheme to the client */
-    void onEvent(ButtonsEventType event,               /* When you change values on the server these are sent to all clients */
+    void onEvent(ButtonsEventType event,               /* When you change values on the server these are sent to all clients; button presses right away, other values coalesced at the send rate */
                  const Buttons& buttons, 
                  const Element* target, 
                  void* targetData);
     void sendToAll(ServerCommand& cmd);                /* Sends the given server command to all connected clients */
+    void setSendRate(int hz);                          /* Number of times per second we send the changed values to the clients; <= 0 sends them on every update() */
+    void sendChanges();                                /* Sends the changed values to all clients; update() calls this at the send rate */
 
   private:
     void createScheme();                               /* Creates a binary scheme of the guis which is used on the client to create the gui */
@@ -163,6 +179,11 @@ namespace buttons {
     std::map<unsigned int, std::map<unsigned int, buttons::Element*> > elements; /* Indexed by buttons-id with all elements */
     std::vector<Connection*> connections;              /* Collection of all the connected clients. */
     std::vector<Buttons*> buttons;                     /* Collection of buttons we share with all clients */
+    std::map<unsigned int, std::map<unsigned int, size_t> > value_indices; /* Indexed by buttons-id and element-id, index into values */
+    std::vector<ButtonsBuffer> values;                 /* The latest serialized value of every element that changed at least once; only the latest value is sent */
+    uint64_t send_interval;                            /* Minimum number of millis between two batches of changes */
+    uint64_t send_timeout;                             /* When rx_millis() is bigger we send the next batch */
+    size_t max_pending_bytes;                          /* When a client has more bytes in its write queue we don't send changes to it; they're coalesced and sent when it caught up */
     uv_tcp_t sock;
     uv_loop_t* loop;
     int port;
@@ -211,17 +211,24 @@ namespace buttons {
     return clean_name;
   }
 
-  // Super simple buffer used by client/server
+  // Super simple buffer used by client/server. The consume*() functions
+  // don't erase the bytes but move a read cursor; size(), getPtr() and the
+  // get*() functions work on the bytes after the cursor. When everything
+  // has been consumed the buffer is cleared, call compact() to remove the
+  // consumed bytes when some are left (e.g. a partially received command).
   struct ButtonsBuffer {
-    ButtonsBuffer(){
+    ButtonsBuffer()
+      :read_dx(0)
+    {
     }
 
     void clear() {	
       data.clear();
+      read_dx = 0;
     }
 
     size_t size() { 
-      return data.size();
+      return data.size() - read_dx;
     }
 
     size_t getNumBytes() { 
@@ -229,7 +236,7 @@ namespace buttons {
     }
 
     char* getPtr() { 
-      return &data[0]; 
+      return &data[read_dx]; 
     }
 
     void addByte(char b) { 
@@ -253,9 +260,7 @@ namespace buttons {
     }
 
     void addBytes(char* buffer, int num) { 
-      for(int i = 0; i < num; ++i) { 
-        data.push_back(buffer[i]);
-      } 
+      data.insert(data.end(), buffer, buffer + num);
     }
 
     void addString(std::string str) {
@@ -266,22 +271,19 @@ namespace buttons {
 
     void rewrite(int start, int num, char* buffer) { 
       for(int i = start, j = 0; i < (start+num); ++i, ++j) { 
-        data[i] = buffer[j]; 
+        data[read_dx + i] = buffer[j]; 
       } 
     }
 
     char consumeByte() {
-      char c = data[0];
+      char c = data[read_dx];
       flush(1);
       return c;
     }
 
     std::string consumeString() {
       unsigned short size = consumeUI16();
-      std::string str;
-      for(int i = 0; i < size; ++i) {
-        str.push_back((char)data[i]);
-      }
+      std::string str(getPtr(), size);
       flush(size);
       return str;
     }
@@ -312,39 +314,50 @@ namespace buttons {
 
     unsigned short int getUI16(int dx = 0) {
       unsigned short int v;
-      memcpy((char*)&v, (char*)&data[dx], sizeof(v));
+      memcpy((char*)&v, (char*)&data[read_dx + dx], sizeof(v));
       return v;
     } 
 
     unsigned int getUI32(int dx = 0) { 
       unsigned int v; 
-      memcpy((char*)&v, (char*)&data[dx], sizeof(v));
+      memcpy((char*)&v, (char*)&data[read_dx + dx], sizeof(v));
       return v;
     }
 
-    float getFloat() {
+    float getFloat(int dx = 0) {
       float f = 0.0f;
-      memcpy((char*)&f, (char*)&data[0], sizeof(float));
+      memcpy((char*)&f, (char*)&data[read_dx + dx], sizeof(float));
       return f;
     }
 
     int getI32(int dx = 0) {
       int v = 0;
-      memcpy((char*)&v, (char*)&data[dx], sizeof(int));
+      memcpy((char*)&v, (char*)&data[read_dx + dx], sizeof(int));
       return v;
     }
 
     void flush() {
-      flush(size());
+      clear();
     }
 
     void flush(int numBytes) {
-      data.erase(data.begin(), data.begin() + numBytes);
+      read_dx += numBytes;
+      if(read_dx >= data.size()) {
+        clear();
+      }
+    }
+
+    void compact() {
+      if(read_dx) {
+        data.erase(data.begin(), data.begin() + read_dx);
+        read_dx = 0;
+      }
     }
 
-    char& operator[](const unsigned int dx) { return data[dx]; } 
+    char& operator[](const unsigned int dx) { return data[read_dx + dx]; } 
 
     std::vector<char> data;
+    size_t read_dx;                /* read cursor, the consume*() functions move it forward */
   };
 
 } // namespace buttons
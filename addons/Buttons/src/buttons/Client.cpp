@@ -87,23 +87,59 @@ namespace buttons {
   }
 
   void Client::parseBuffer() {
-    do {
-      if(buffer.size() < 5) { // each command must contain an ID (1 bytes) + size (4 bytes)
-        return;
-      }
+    while(buffer.size() >= 5) { // each command must contain an ID (1 bytes) + size (4 bytes)
 
       unsigned int command_size = buffer.getUI32(1); // peek the command size
-      if(buffer.size() < command_size) {
-        RX_VERBOSE("buffer not complete - we need more bytes, received: %ld but need %d", buffer.size(), command_size);
-        return;
+      if(buffer.size() - 5 < command_size) { // don't add 5 to command_size, a corrupt size would wrap around
+        RX_VERBOSE("buffer not complete - we need more bytes, received: %ld but need %d", buffer.size(), command_size + 5);
+        break;
+      }
+
+      size_t remaining = (buffer.size() - 5) - command_size;
+      if(buffer[0] == BDATA_BATCH) {
+        buffer.flush(5);
+        unsigned short num_values = (command_size >= 2) ? buffer.consumeUI16() : 0;
+        for(unsigned short i = 0; i < num_values; ++i) {
+
+          // each value has a size (2 bytes) and must fit in this command; when not we drop the rest of the command
+          if(buffer.size() < remaining + 2) {
+            RX_ERROR("Batch command is truncated, dropping %u of %u values", num_values - i, num_values);
+            break;
+          }
+          unsigned short value_size = buffer.consumeUI16();
+          if(buffer.size() - remaining < value_size) {
+            RX_ERROR("Batch value size (%u) is larger than the rest of the command (%zu), dropping the command", value_size, buffer.size() - remaining);
+            break;
+          }
+
+          size_t next = buffer.size() - value_size;
+          CommandData deserialized;
+          if(util.deserializeValue(buffer, deserialized, elements)) {
+            handleCommand(deserialized);
+          }
+
+          // deserializeValue() read more than the value size; we can't trust the rest of the command
+          if(buffer.size() < next) {
+            RX_ERROR("Batch value read past its size, dropping the command");
+            break;
+          }
+          buffer.flush(buffer.size() - next);
+        }
+      }
+      else {
+        CommandData deserialized;
+        if(util.deserialize(buffer, deserialized, elements)) {
+          handleCommand(deserialized);
+        }
       }
 
-      CommandData deserialized;
-      if(util.deserialize(buffer, deserialized, elements)) {
-        handleCommand(deserialized);
+      // skip what we didn't parse (e.g. a value for an unknown element)
+      if(buffer.size() > remaining) {
+        buffer.flush(buffer.size() - remaining);
       }
+    }
 
-    } while (buffer.size() > 0);
+    buffer.compact();
   }
 
   void Client::onEvent(ButtonsEventType event,
@@ -382,13 +418,19 @@ namespace buttons {
   }
 
   void Client::write(char* data, size_t nbytes) {
-    uv_buf_t buf = uv_buf_init(data, nbytes);
+    // libuv uses the data until the write callback is called
+    char* copy = new char[nbytes];
+    memcpy(copy, data, nbytes);
+
+    uv_buf_t buf = uv_buf_init(copy, nbytes);
     uv_write_t* wreq = new uv_write_t();
-    wreq->data = this;
+    wreq->data = copy;
 
     int r = uv_write(wreq, (uv_stream_t*)&sock, &buf, 1, buttons_client_on_write);
     if(r) {
       RX_ERROR("uv_write() to server failed.");
+      delete[] copy;
+      delete wreq;
     }
   }
 
@@ -517,6 +559,8 @@ namespace buttons {
   }
 
   void buttons_client_on_write(uv_write_t* req, int status) {
+    char* data = static_cast<char*>(req->data);
+    delete[] data;
     delete req;
   }
 
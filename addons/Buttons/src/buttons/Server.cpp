@@ -10,7 +10,12 @@ namespace buttons {
   Server::Server(int port)
     :port(port)
     ,loop(NULL)
+    ,send_interval(0)
+    ,send_timeout(0)
+    ,max_pending_bytes(BUTTONS_DEFAULT_MAX_PENDING_BYTES)
   {
+    setSendRate(BUTTONS_DEFAULT_SEND_RATE);
+
     loop = uv_default_loop();
     if(!loop) {
       RX_ERROR("Cannot get default libuv loop for buttons server");
@@ -45,6 +50,22 @@ namespace buttons {
 
   void Server::update() {
     uv_run(loop, UV_RUN_NOWAIT);
+
+    uint64_t now = rx_millis();
+    if(now >= send_timeout) {
+      send_timeout = now + send_interval;
+      sendChanges();
+    }
+  }
+
+  void Server::setSendRate(int hz) {
+    send_interval = (hz > 0) ? (1000 / hz) : 0;
+  }
+
+  void Server::sendChanges() {
+    for(std::vector<Connection*>::iterator it = connections.begin(); it != connections.end(); ++it) {
+      (*it)->sendChanges();
+    }
   }
 
   void Server::removeConnection(Connection* c) {
@@ -122,11 +143,41 @@ namespace buttons {
   }
 
   void Server::onEvent(ButtonsEventType event, const Buttons& buttons, const Element* target, void* targetData) {
-    if(event == BEVENT_VALUE_CHANGED) {
+    if(event != BEVENT_VALUE_CHANGED) {
+      return;
+    }
+
+    // a button press is an event, not a value; coalescing would merge two clicks into one
+    if(target->type == BTYPE_BUTTON) {
       ServerCommand cmd(BDATA_CHANGED);
       if(util.serialize(buttons, target, cmd.buffer, targetData)) {
+        sendChanges(); // values changed before the press must arrive before it
         sendToAll(cmd);
       }
+      return;
+    }
+
+    // we only keep the latest value of each element; update() sends it at the send rate
+    size_t dx = 0;
+    std::map<unsigned int, size_t>& indices = value_indices[buttons.id];
+    std::map<unsigned int, size_t>::iterator it = indices.find(target->id);
+    if(it == indices.end()) {
+      dx = values.size();
+      values.push_back(ButtonsBuffer());
+      indices[target->id] = dx;
+    }
+    else {
+      dx = it->second;
+    }
+
+    ButtonsBuffer& value = values[dx];
+    value.clear();
+    if(!util.serialize(buttons, target, value, targetData)) {
+      return;
+    }
+
+    for(std::vector<Connection*>::iterator cit = connections.begin(); cit != connections.end(); ++cit) {
+      (*cit)->setDirty(dx);
     }
   }
 
@@ -168,27 +219,62 @@ namespace buttons {
   }
 
   void Connection::parseBuffer() {
-    do {
-      // check minimum size of a command.
-      if(buffer.size() < 5) { 
-        RX_VERBOSE("Buffer is too small, must be at least 5 bytes for a command");
-        return;
-      }
-      
+    // each command has a name (1 byte) + size (4 bytes)
+    while(buffer.size() >= 5) {
+
       // peek, and check if the buffer contains a complete command
       unsigned int command_size = buffer.getUI32(1); // peek
-      if(buffer.size() < command_size) {
-        RX_VERBOSE("Buffer has only %zu bytes, and the command consists of: %u bytes.\n", buffer.size(), command_size);
-        return;
+      if(buffer.size() - 5 < command_size) { // don't add 5 to command_size, a corrupt size would wrap around
+        RX_VERBOSE("Buffer has only %zu bytes, and the command consists of: %u bytes.\n", buffer.size(), command_size + 5);
+        break;
       }
 
       // when we arrive at this point we received a complete command
-      CommandData deserialized;
-      if(util.deserialize(buffer, deserialized, server.elements)) {
-        handleCommand(deserialized);
+      size_t remaining = (buffer.size() - 5) - command_size;
+      if(buffer[0] == BDATA_BATCH) {
+        buffer.flush(5);
+        unsigned short num_values = (command_size >= 2) ? buffer.consumeUI16() : 0;
+        for(unsigned short i = 0; i < num_values; ++i) {
+
+          // each value has a size (2 bytes) and must fit in this command; when not we drop the rest of the command
+          if(buffer.size() < remaining + 2) {
+            RX_ERROR("Batch command is truncated, dropping %u of %u values", num_values - i, num_values);
+            break;
+          }
+          unsigned short value_size = buffer.consumeUI16();
+          if(buffer.size() - remaining < value_size) {
+            RX_ERROR("Batch value size (%u) is larger than the rest of the command (%zu), dropping the command", value_size, buffer.size() - remaining);
+            break;
+          }
+
+          size_t next = buffer.size() - value_size;
+          CommandData deserialized;
+          if(util.deserializeValue(buffer, deserialized, server.elements)) {
+            handleCommand(deserialized);
+          }
+
+          // deserializeValue() read more than the value size; we can't trust the rest of the command
+          if(buffer.size() < next) {
+            RX_ERROR("Batch value read past its size, dropping the command");
+            break;
+          }
+          buffer.flush(buffer.size() - next);
+        }
       }
+      else {
+        CommandData deserialized;
+        if(util.deserialize(buffer, deserialized, server.elements)) {
+          handleCommand(deserialized);
+        }
+      }
+
+      // skip what we didn't parse (e.g. a value for an unknown element)
+      if(buffer.size() > remaining) {
+        buffer.flush(buffer.size() - remaining);
+      }
+    }
 
-    } while(buffer.size() > 0);
+    buffer.compact();
   }
 
   void Connection::handleCommand(CommandData& cmd) {
@@ -248,26 +334,78 @@ namespace buttons {
     unsigned int size = cmd.buffer.getNumBytes();
     assert(sizeof(size) == 4); // we assumed that a uint is 4 bytes...
 
-    write(&cmd.name, 1);
-    write((char*)&size, sizeof(size));
-    write(cmd.buffer.getPtr(), cmd.buffer.getNumBytes());
+    ButtonsBuffer out;
+    out.addByte(cmd.name);
+    out.addUI32(size);
+    if(size) {
+      out.addBytes(cmd.buffer.getPtr(), size);
+    }
+    write(out.getPtr(), out.getNumBytes());
+  }
+
+  void Connection::setDirty(size_t dx) {
+    if(is_dirty.size() <= dx) {
+      is_dirty.resize(dx + 1, false);
+    }
+    if(!is_dirty[dx]) {
+      is_dirty[dx] = true;
+      dirty.push_back(dx);
+    }
+  }
+
+  void Connection::sendChanges() {
+    if(!dirty.size()) {
+      return;
+    }
+
+    // a slow client; the changes stay dirty so it gets the latest values once it caught up
+    if(sock.write_queue_size > server.max_pending_bytes) {
+      return;
+    }
+
+    size_t num_values = std::min<size_t>(dirty.size(), 0xFFFF);
+
+    batch.clear();
+    batch.addByte(BDATA_BATCH);
+    batch.addUI32(0); // size, rewritten below
+    batch.addUI16(num_values);
+
+    for(size_t i = 0; i < num_values; ++i) {
+      ButtonsBuffer& value = server.values[dirty[i]];
+      batch.addUI16(value.getNumBytes());
+      batch.addBytes(value.getPtr(), value.getNumBytes());
+      is_dirty[dirty[i]] = false;
+    }
+
+    dirty.erase(dirty.begin(), dirty.begin() + num_values);
+
+    unsigned int size = batch.getNumBytes() - 5;
+    batch.rewrite(1, sizeof(size), (char*)&size);
+    write(batch.getPtr(), batch.getNumBytes());
   }
 
   void Connection::write(char* data, size_t nbytes) {
-     uv_buf_t buf = uv_buf_init(data, nbytes);
+    // libuv uses the data until the write callback is called
+    char* copy = new char[nbytes];
+    memcpy(copy, data, nbytes);
+
+    uv_buf_t buf = uv_buf_init(copy, nbytes);
     uv_write_t* wreq = new uv_write_t();
-    wreq->data = this;
+    wreq->data = copy;
 
     int r = uv_write(wreq, (uv_stream_t*) &sock, &buf, 1, buttons_connection_on_write);
     if(r) {
       RX_ERROR("cannot uv_write(): %s", uv_strerror(uv_last_error(sock.loop)));
+      delete[] copy;
+      delete wreq;
     }
   }
 
   // CONNECTION CALLBACKS
   // ++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
   void buttons_connection_on_write(uv_write_t* req, int status) {
-    Connection* c = static_cast<Connection*>(req->data);
+    char* data = static_cast<char*>(req->data);
+    delete[] data;
     delete req;
 
     if(status == -1) {
@@ -482,82 +620,8 @@ namespace buttons {
 
     switch(command_name) {
       case BDATA_CHANGED: {
-        unsigned int command_size = buffer.consumeUI32();
-        result.buttons_id = buffer.consumeUI32();
-        result.element_id = buffer.consumeUI32();
-        result.element = elements[result.buttons_id][result.element_id];
-
-        if(result.element == NULL) {
-          RX_ERROR("We received an event for an unknown element: %d, buttons: %d", result.element_id, result.buttons_id);
-          return false;
-        }
-
-        switch(result.element->type) {
-          case BTYPE_SLIDER: { 
-            Sliderf* sliderf = static_cast<Sliderf*>(result.element);
-            if(sliderf->value_type == Slider<float>::SLIDER_FLOAT) {
-              // float flider
-              result.sliderf = sliderf;
-              result.sliderf_value = buffer.consumeFloat();
-              result.name = BDATA_SLIDERF;
-              return true;
-            }
-            else {
-              // int slider
-              Slideri* slideri = static_cast<Slideri*>(result.element);
-              result.slideri = slideri;
-              result.slideri_value = buffer.consumeI32();
-              result.name = BDATA_SLIDERI;
-              return true;
-            }
-            break;
-          }
-          case BTYPE_TOGGLE: {
-            Toggle* toggle = static_cast<Toggle*>(result.element);
-            result.toggle = toggle;
-            result.toggle_value = (buffer.consumeByte() == 1);
-            result.name = BDATA_TOGGLE;
-            return true;
-          }
-          case BTYPE_BUTTON: {
-            result.button_value = buffer.consumeUI32();
-            result.name = BDATA_BUTTON;
-            return true;
-          }
-          case BTYPE_RADIO: {
-            result.radio_value = buffer.consumeUI32();
-            result.name = BDATA_RADIO;
-            return true;
-          }
-          case BTYPE_COLOR: {
-            result.name = BDATA_COLOR;
-            result.color_value[0] = buffer.consumeUI32();
-            result.color_value[1] = buffer.consumeUI32();
-            result.color_value[2] = buffer.consumeUI32();
-            result.color_value[3] = buffer.consumeUI32();
-            return true;
-          }
-          case BTYPE_VECTOR: {
-            result.name = BDATA_VECTOR;
-            result.vector_value[0] = buffer.consumeFloat();
-            result.vector_value[1] = buffer.consumeFloat();
-            return true;
-          }
-          case BTYPE_PAD: {
-            char type = buffer.consumeByte();
-            if(type == PAD_FLOAT) {
-              result.name = BDATA_PADF;
-            }
-            else {
-              result.name = BDATA_PADI;
-            }
-            result.pad_value[0] = buffer.consumeFloat();
-            result.pad_value[1] = buffer.consumeFloat();
-            return true;
-          }
-          default:break;
-        }
-        break;
+        buffer.consumeUI32(); // command size
+        return deserializeValue(buffer, result, elements);
       }
       case BDATA_GET_SCHEME: {
         result.name = BDATA_GET_SCHEME;
@@ -567,7 +631,7 @@ namespace buttons {
       case BDATA_SCHEME: {
         unsigned int command_size = buffer.consumeUI32();
         result.name = BDATA_SCHEME;
-        result.buffer.addBytes(buffer.getPtr(), buffer.getNumBytes());
+        result.buffer.addBytes(buffer.getPtr(), command_size);
         buffer.flush(command_size);
         return true;
       }
@@ -578,4 +642,95 @@ namespace buttons {
     return false;
   }
 
+  bool ClientServerUtils::deserializeValue(
+                                           ButtonsBuffer& buffer
+                                           ,CommandData& result
+                                           ,std::map<unsigned int, std::map<unsigned int, buttons::Element*> >& elements
+                                           )
+  {
+    result.buttons_id = buffer.consumeUI32();
+    result.element_id = buffer.consumeUI32();
+    result.element = NULL;
+
+    std::map<unsigned int, std::map<unsigned int, buttons::Element*> >::iterator bit = elements.find(result.buttons_id);
+    if(bit != elements.end()) {
+      std::map<unsigned int, buttons::Element*>::iterator eit = bit->second.find(result.element_id);
+      if(eit != bit->second.end()) {
+        result.element = eit->second;
+      }
+    }
+
+    if(result.element == NULL) {
+      RX_ERROR("We received an event for an unknown element: %d, buttons: %d", result.element_id, result.buttons_id);
+      return false;
+    }
+
+    switch(result.element->type) {
+      case BTYPE_SLIDER: { 
+        Sliderf* sliderf = static_cast<Sliderf*>(result.element);
+        if(sliderf->value_type == Slider<float>::SLIDER_FLOAT) {
+          // float flider
+          result.sliderf = sliderf;
+          result.sliderf_value = buffer.consumeFloat();
+          result.name = BDATA_SLIDERF;
+          return true;
+        }
+        else {
+          // int slider
+          Slideri* slideri = static_cast<Slideri*>(result.element);
+          result.slideri = slideri;
+          result.slideri_value = buffer.consumeI32();
+          result.name = BDATA_SLIDERI;
+          return true;
+        }
+        break;
+      }
+      case BTYPE_TOGGLE: {
+        Toggle* toggle = static_cast<Toggle*>(result.element);
+        result.toggle = toggle;
+        result.toggle_value = (buffer.consumeByte() == 1);
+        result.name = BDATA_TOGGLE;
+        return true;
+      }
+      case BTYPE_BUTTON: {
+        result.button_value = buffer.consumeUI32();
+        result.name = BDATA_BUTTON;
+        return true;
+      }
+      case BTYPE_RADIO: {
+        result.radio_value = buffer.consumeUI32();
+        result.name = BDATA_RADIO;
+        return true;
+      }
+      case BTYPE_COLOR: {
+        result.name = BDATA_COLOR;
+        result.color_value[0] = buffer.consumeUI32();
+        result.color_value[1] = buffer.consumeUI32();
+        result.color_value[2] = buffer.consumeUI32();
+        result.color_value[3] = buffer.consumeUI32();
+        return true;
+      }
+      case BTYPE_VECTOR: {
+        result.name = BDATA_VECTOR;
+        result.vector_value[0] = buffer.consumeFloat();
+        result.vector_value[1] = buffer.consumeFloat();
+        return true;
+      }
+      case BTYPE_PAD: {
+        char type = buffer.consumeByte();
+        if(type == PAD_FLOAT) {
+          result.name = BDATA_PADF;
+        }
+        else {
+          result.name = BDATA_PADI;
+        }
+        result.pad_value[0] = buffer.consumeFloat();
+        result.pad_value[1] = buffer.consumeFloat();
+        return true;
+      }
+      default:break;
+    }
+    return false;
+  }
+
 } // buttons
@@ -10,6 +10,21 @@
  // ++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
  av.waitForEncodingThreadToFinish();
 
+ Encoding is pipelined:
+
+  - addVideoFrame() / addAudioFrame() copy the data into a ring buffer
+    and add a packet to `packets`.
+  - `num_convert_threads` converter threads (see setNumConvertThreads())
+    take the packets in order and convert the video frames into x264 pictures,
+    each with its own SwsContext, so the colorspace conversion of the next
+    frames runs in parallel with encoding the current one.
+  - the encoder thread (run()) takes the converted packets in the order they
+    were added and feeds them to x264 / lame and the FLV muxer.
+
+ Use setupX264() to change the preset, tune and threading options of x264
+ (by default we use "ultrafast" + "zerolatency" with one thread) and
+ getStats() to get the achieved encoding speed and latency.
+
  */
 
 #ifndef ROXLU_AV_H
@@ -27,9 +42,18 @@ extern "C" {
 #include <roxlu/Roxlu.h>
 #include <stdio.h>
 #include <vector>
+#include <deque>
+#include <string>
 #include <flv/FLV.h>
 
 #define MP3_BUFFER_SIZE 8192
+#define AV_NUM_EXTRA_PICTURES 2                                   /* number of x264 pictures we allocate on top of one per converter thread */
+
+#define ERR_AV_X264_PRESET "No x264 preset given."
+#define ERR_AV_X264_THREADS "Invalid number of x264 threads: %d"
+#define ERR_AV_CONVERT_THREADS "Invalid number of convert threads: %d, we need at least one."
+#define ERR_AV_ALREADY_INITIALIZED "Cannot change the number of convert threads after calling initialize()."
+#define ERR_AV_AUDIO_PACKET_SIZE "Audio packet is too big (%ld bytes), skipping it."
 
 enum AVVideoFormat {
   AV_FMT_RGB24,
@@ -52,6 +76,37 @@ struct AVPacket {
   size_t write_index; 
   size_t num_bytes;
   int num_frames; // num audio frames, or always 1 for a video frame
+  x264_picture_t* pic; // the converted video frame, set by the converter thread (NULL when conversion failed)
+  bool is_ready; // set to true when the packet can be encoded (i.e. the video frame has been converted)
+};
+
+struct AVX264Settings {
+  AVX264Settings();
+  std::string preset;                                             /* x264 preset: "ultrafast", "superfast", "veryfast", "faster", "fast", "medium", etc.. */
+  std::string tune;                                               /* x264 tune, e.g. "zerolatency"; empty for none */
+  int threads;                                                    /* number of x264 encoder threads, 0 = auto */
+  int lookahead_threads;                                          /* number of x264 lookahead threads, 0 = auto, -1 = use the value of the preset/tune */
+  int sliced_threads;                                             /* 1 = slice based threading (low latency), 0 = frame based threading, -1 = use the value of the preset/tune */
+  int rc_lookahead;                                               /* number of frames for the rate control lookahead, -1 = use the value of the preset/tune */
+  int sync_lookahead;                                             /* size of the threaded lookahead buffer, -1 = use the value of the preset/tune */
+};
+
+struct AVStats {
+  AVStats();
+  int num_video_frames;                                           /* number of encoded video frames written to the FLV */
+  double fps;                                                     /* achieved encoding speed in video frames per second */
+  double avg_latency;                                             /* average millis between addVideoFrame() and writing the encoded frame */
+  rx_uint64 max_latency;                                          /* max millis between addVideoFrame() and writing the encoded frame */
+};
+
+class AV;
+
+struct AVConverter {
+  AVConverter();
+  AV* av;
+  uv_thread_t thread;
+  SwsContext* sws;                                                /* each converter uses its own context */
+  char* buffer;                                                   /* the input frame (or audio samples) we copy from the ring buffer */
 };
 
 struct AVPacketSorter {
@@ -61,6 +116,7 @@ struct AVPacketSorter {
 };
 
 void av_thread_function(void* av); // calls AV::run() in a separate thread
+void av_convert_thread_function(void* converter); // calls AV::convert() in a separate thread
 
 class AV {
  public: 
@@ -68,9 +124,11 @@ class AV {
   ~AV();
   bool setupVideo(int inWidth, int inHeight, int outWidth, int outHeight, double fps, AVVideoFormat videoFmt, FLV* flv);
   bool setupAudio(int numChannels, int sampleRate, int maxSamplesPerFrame, AVAudioFormat audioFmt);
+  bool setupX264(AVX264Settings settings); // set the x264 preset/tune/threading options, must be called before start()
+  bool setNumConvertThreads(int num); // number of threads that convert the video frames, must be called before initialize(), default 2
   bool initialize();
 
-  void start(); // start encoding thread, must be called after calling initialize()
+  void start(); // start the converter and encoding threads, must be called after calling initialize()
   void stop(); // stop encoding
 
   bool wantsNewVideoFrame();
@@ -82,10 +140,12 @@ class AV {
 
   void waitForEncodingThreadToFinish();
   void setVerticalFlip(bool flip);  // enable or disable vertical flip of video input, must be called before setupVideo()  (handy when recording downloaded pixels from opengl)
+  AVStats getStats(); // returns the encoding speed and latency of the current/last recording
 
   void reset(); // do not call yourself, use stop(): resets the encoders. is called for you when the thread stops. (call stop() to stop the thread)
   //  void run();  // do not call yourself, threaded function
   void run();
+  void convert(AVConverter* c); // do not call yourself, threaded function which converts video frames
  private:
   bool initializeVideo(); // initializes video codecs, called by initialize()
   bool initializeAudio(); // initializes audio codecs, called by initialize(), for now we do not need to ininitialize anything here; see start() which creates a lame instance when necessary
@@ -96,6 +156,8 @@ class AV {
   void printX264Params(x264_param_t* p);
   void printX264Headers(x264_nal_t* nal); // prints result of x264_encoder_headers
   void printAVPixelFormat(AVPixelFormat p);
+  bool encodeVideoPicture(x264_picture_t* pic); // encodes the given picture (or flushes a delayed frame when pic is NULL) and writes the result to the FLV
+  bool mustStop();
   FLVAudioSampleRate audioSampleRateToFLVSampleRate(int rate);
   AVPixelFormat videoFormatToAVPixelFormat(AVVideoFormat f);
   void shutdown(); // frees all memory, closes encoders.
@@ -132,29 +194,41 @@ class AV {
   rx_uint64 vid_time_started; // time when we started adding frames
   rx_uint64 vid_last_timestamp;  // used to detect errors in encodeVideoPacket
   bool vid_is_buffer_ready; // set to true when all buffers contain image data
-  char* vid_tmp_buffer; // buffer for at least one image
   x264_param_t vid_params;
   x264_t* vid_encoder;
-  x264_picture_t vid_pic_in; // we copy data from input into this structure and feed that to the x264 encoder
   x264_picture_t vid_pic_out; // result from x264_encoder_encode(), we don't have to free this; only when using x264_picture_alloc
-  SwsContext* vid_sws; 
+  std::vector<x264_picture_t*> vid_pics; // all allocated pictures; the converters write into these and we feed them to the x264 encoder
+  std::vector<x264_picture_t*> vid_free_pics; // pictures which can be used by a converter, protected by encode_mutex
+  std::deque<rx_uint64> vid_timestamps; // timestamps of the pictures given to x264 which haven't been written yet (x264 may delay frames)
   bool vid_vflip; // flip video input
+  AVX264Settings x264_settings; // preset/tune/threading options, see setupX264()
 
   /* muxer */
   bool is_initialized;
   FLV* flv;
 
-  std::vector<AVPacket*> packets;
+  std::deque<AVPacket*> packets; // packets added by addVideoFrame/addAudioFrame which aren't converted yet, protected by mutex
+  std::deque<AVPacket*> encode_packets; // packets in the order they were added, waiting to be encoded, protected by encode_mutex
   RingBuffer audio_ring_buffer;
   RingBuffer video_ring_buffer;
-  RingBuffer audio_work_buffer;
-  RingBuffer video_work_buffer;
+  RingBuffer audio_encode_buffer; // audio samples of the packets in encode_packets, protected by encode_mutex
+
+  /* stats */
+  AVStats stats; // protected by encode_mutex
+  rx_uint64 stats_total_latency;
+  rx_uint64 stats_time_started;
 
   /* thread */
   bool must_stop; // when called stop(), we stop our threaded function.
   uv_thread_t thread;
   uv_mutex_t mutex;
   uv_mutex_t stop_mutex;
+  uv_mutex_t encode_mutex;
+  uv_cond_t packets_cond; // signalled when a packet is added to packets
+  uv_cond_t encode_cond; // signalled when a packet has been converted, a picture is freed or a converter stopped
+  std::vector<AVConverter*> converters;
+  int num_convert_threads;
+  int num_running_converters; // protected by encode_mutex
 
   //Thread thread; // thread handle, see start(), stop
 };
@@ -179,6 +253,7 @@ inline void AV::addVideoFrame(const void* data) {
 
       video_ring_buffer.write((char*)data, p->num_bytes);
       packets.push_back(p);
+      uv_cond_signal(&packets_cond);
     }
     uv_mutex_unlock(&mutex);
   }
@@ -209,6 +284,7 @@ inline void AV::addAudioFrame(const void* data, int nframes) {
     p->num_frames = nframes;
     audio_ring_buffer.write((char*)data, p->num_bytes);
     packets.push_back(p);
+    uv_cond_signal(&packets_cond);
   }
   uv_mutex_unlock(&mutex);
 
@@ -234,30 +310,26 @@ inline void AV::setFLV(FLV* f) {
   flv = f;
 }
 
-inline void AV::start() {
-  if(!is_initialized) {
-    RX_ERROR("cannot start AV because we're not initialized.");
-    return;
-  }
-  if(!openX264()) {
-    RX_ERROR("ERROR: cannot open X264");
-    return;
-  }
-	if(!openLame()) {
-		RX_ERROR("cannot create lame mp3 encoder");
-		return;
-	}
-  if(!openFLV()) {
-    RX_ERROR("ERROR: cannot open FLV.");
-    return;
-  }
-  uv_thread_create(&thread, av_thread_function, (void*)this);
-}
-
 inline void AV::stop() {
   uv_mutex_lock(&stop_mutex);
   must_stop = true;
   uv_mutex_unlock(&stop_mutex);
+
+  // wake up the converters and encoder
+  uv_mutex_lock(&mutex);
+  uv_cond_broadcast(&packets_cond);
+  uv_mutex_unlock(&mutex);
+
+  uv_mutex_lock(&encode_mutex);
+  uv_cond_broadcast(&encode_cond);
+  uv_mutex_unlock(&encode_mutex);
+}
+
+inline bool AV::mustStop() {
+  uv_mutex_lock(&stop_mutex);
+  bool r = must_stop;
+  uv_mutex_unlock(&stop_mutex);
+  return r;
 }
 
 inline void AV::waitForEncodingThreadToFinish() {
@@ -273,7 +345,14 @@ inline AVPixelFormat AV::videoFormatToAVPixelFormat(AVVideoFormat f) {
 }
 
 inline void AV::setVerticalFlip(bool flip) {
-  vid_vflip = true;
+  vid_vflip = flip;
+}
+
+inline AVStats AV::getStats() {
+  uv_mutex_lock(&encode_mutex);
+  AVStats result = stats;
+  uv_mutex_unlock(&encode_mutex);
+  return result;
 }
 
 
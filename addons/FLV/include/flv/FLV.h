@@ -19,6 +19,24 @@
  * flv.writeVideoPacket(...)
  * flv.writeAudioPacket(...) 
  * -------------------------------
+ *
+ * Multiple outputs:
+ * -----------------
+ * Besides the callbacks set with setCallbacks() (which are called directly
+ * from the thread that writes the packets), you can add extra outputs with 
+ * addOutput(). The encoded data is shared between all outputs (we only
+ * encode once) and each output has its own thread and bounded queue, so a 
+ * slow sink (e.g. a socket) never stalls the others. When the queue of an
+ * output is full we drop packets until the next video keyframe.
+ *
+ * Outputs can be added while we're writing: they first receive the FLV
+ * header, meta data and AVC sequence header and then start at the next 
+ * video keyframe, with the timestamps starting at 0 again. All outputs are
+ * closed and deleted when the FLV is closed.
+ * 
+ * FLVFileWriter (flv_file_*) and FLVMemoryWriter (flv_memory_*) can be 
+ * used as outputs; for e.g. a socket pass your own callbacks.
+ * -----------------
  */
 
 #ifndef ROXLU_AV_FLV_H
@@ -27,12 +45,14 @@
 #include <inttypes.h>
 
 extern "C" { 
+#include <uv.h>
 #include <x264.h>
 }
 
 #include <roxlu/Roxlu.h>
 #include <algorithm>
 #include <vector>
+#include <deque>
 #include <string>
 #include <assert.h>
 
@@ -58,6 +78,14 @@ extern "C" {
 #define FLV_TAG_AUDIO 8
 #define FLV_TAG_VIDEO 9
 #define FLV_TAG_SCRIPT_DATA 18
+#define FLV_TAG_HEADER_SIZE 11                   /* tag type, data size, timestamp, timestamp extended, stream id */
+
+#define FLV_DEFAULT_MAX_QUEUED_TAGS 120          /* default number of tags an output can queue before we start dropping */
+
+#define ERR_FLV_OUTPUT_CALLBACK "Cannot add an output without a write callback."
+#define ERR_FLV_OUTPUT_NOT_FOUND "Cannot remove the output; not found."
+#define ERR_FLV_MEMORY_FULL "FLVMemoryWriter is full, dropping %ld bytes."
+#define VERBOSE_FLV_OUTPUT_DROPPED "FLV output dropped %ld tags because the queue was full or we were waiting for a keyframe."
 
 
 enum FLVSoundCodec {
@@ -113,6 +141,9 @@ void flv_file_rewrite(char* data,  size_t nbytes, size_t pos, void* user);
 void flv_file_flush(void * user);
 void flv_file_close(void* user);
 
+size_t flv_memory_write(char* data, size_t nbytes, void* user);
+void flv_memory_close(void* user);
+
 struct FLVFileWriter {
   FLVFileWriter();
   ~FLVFileWriter();
@@ -120,6 +151,19 @@ struct FLVFileWriter {
   FILE* fp;
 };
 
+// Keeps the flv data in memory so another thread can read() it (e.g. to send it to a client). 
+// Data which doesn't fit is dropped, so read often enough. Use with flv_memory_write/flv_memory_close.
+struct FLVMemoryWriter {
+  FLVMemoryWriter(size_t capacity);
+  ~FLVMemoryWriter();
+  size_t write(char* data, size_t nbytes); // returns 0 when the data does not fit
+  size_t read(char* data, size_t nbytes); // returns the number of bytes read
+  size_t size(); // number of bytes that can be read
+  RingBuffer buffer;
+  uv_mutex_t mutex;
+  bool is_closed; // set by flv_memory_close(); there will no more data.
+};
+
 struct FLVHeader {
   int has_audio; 
   int has_video;
@@ -155,6 +199,55 @@ struct FLVAvcSequenceHeader {
 struct FLVCloseParams {
 };
 
+class FLV;
+
+// The data of one or more flv tags which is shared between the outputs
+struct FLVTag {
+  FLVTag();
+  void reset();
+  std::vector<char> data;
+  rx_uint32 timestamp;
+  int type; // FLV_TAG_AUDIO, FLV_TAG_VIDEO or FLV_TAG_NONE for the header, meta data and avc sequence header
+  bool is_keyframe;
+  int refcount; // protected by FLV::tags_mutex; see FLV::retainTag() and FLV::releaseTag()
+};
+
+void flv_output_thread(void* user); // calls FLVOutput::run()
+
+// An extra output of a FLV, with its own thread and bounded queue. Created by FLV::addOutput().
+class FLVOutput {
+ public:
+  FLVOutput(FLV* flv, size_t maxQueuedTags);
+  ~FLVOutput();
+  bool push(FLVTag* tag); // adds the tag to the queue; returns false when we drop it (queue full, or waiting for a keyframe)
+  void run(); // do not call yourself, threaded function which writes the queued tags
+  void stop(); // writes everything that is queued, then stops the thread
+  void write(FLVTag* tag);
+
+ public:
+  flv_write_data_cb cb_write;
+  flv_rewrite_data_cb cb_rewrite;
+  flv_flush_data_cb cb_flush;
+  flv_close_cb cb_close;
+  void* cb_user;
+
+  FLV* flv;
+  std::deque<FLVTag*> tags; // protected by mutex
+  size_t max_queued_tags; // when the queue grows bigger we drop tags until the next keyframe
+  size_t num_dropped; // number of tags we dropped
+  bool is_waiting_for_keyframe; // true when we need to skip tags until we get a video keyframe
+  bool must_rebase; // when true, the timestamps are made relative to the first keyframe we write (for outputs added while streaming)
+  rx_uint32 timestamp_offset; // subtracted from the tag timestamps
+  rx_uint32 last_video_timestamp; // rebased timestamp of the last video tag; used to rewrite the meta data on close
+  rx_uint64 total_num_frames; // number of video tags written
+  size_t bytes_flushed; // total number of bytes we passed to cb_write
+  std::vector<char> rebased; // a copy of the tag with the rebased timestamp 
+  bool must_stop;
+  uv_thread_t thread;
+  uv_mutex_t mutex;
+  uv_cond_t cond;
+};
+
 class FLV {
  public:
   FLV();
@@ -201,7 +294,20 @@ class FLV {
     flv_close_cb closeCB, 
     void* user
   );
-  void flush();
+  FLVOutput* addOutput( // adds an output which gets the same data; rewriteCB, flushCB and closeCB may be NULL. Can be called while writing.
+    flv_write_data_cb writeCB, 
+    flv_rewrite_data_cb rewriteCB, 
+    flv_flush_data_cb flushCB, 
+    flv_close_cb closeCB, 
+    void* user,
+    size_t maxQueuedTags = FLV_DEFAULT_MAX_QUEUED_TAGS
+  );
+  bool removeOutput(FLVOutput* output); // writes the queued data, closes and deletes the output.
+  void flush(); // flushes the buffer as header data (flv header, meta data, avc sequence header)
+  void flushPacket(int type, rx_uint32 timestamp, bool isKeyframe); // flushes the buffer which contains one audio or video tag
+  void retainTag(FLVTag* tag);
+  void releaseTag(FLVTag* tag); // puts the tag back into the pool when nobody uses it anymore
+  void rewriteMetaData(flv_rewrite_data_cb cb, void* user, rx_uint64 lastVideoTimestamp, rx_uint64 numFrames, size_t bytesFlushed);
   size_t size();
   char* ptr();
 
@@ -214,6 +320,10 @@ class FLV {
  public:
   FLVHeader flv_header; // contains info about audio and video encoding
 
+ private:
+  FLVTag* acquireTag(); // returns a tag from the pool (or a new one) with a refcount of 1
+  void closeOutput(FLVOutput* output); // stops the output thread, rewrites the meta data, calls the close callback and deletes the output
+
  private:
   /* callbacks */
   flv_write_data_cb cb_write; // gets called when there is some data to be written
@@ -236,6 +346,14 @@ class FLV {
   rx_uint64 last_video_timestamp; // used to rewrite the duration field
   rx_uint64 total_num_frames; // total num frames added, used to recalc. framerate
   bool is_opened; // check to make sure we don't open twice; and nicely cleanup
+  bool has_packets; // set to true when we've written the first audio or video packet; outputs added after this need to start at a keyframe
+
+  /* outputs */
+  std::vector<FLVOutput*> outputs; // protected by outputs_mutex
+  std::vector<FLVTag*> header_tags; // the header data which we send to outputs that are added later, protected by outputs_mutex
+  std::vector<FLVTag*> free_tags; // pool with tags we can reuse, protected by tags_mutex
+  uv_mutex_t outputs_mutex;
+  uv_mutex_t tags_mutex;
 };
 
 inline void FLV::setCallbacks(
@@ -253,19 +371,6 @@ inline void FLV::setCallbacks(
   cb_user = user;
 }
 
-inline void FLV::flush() {
-  if(cb_write == NULL) {
-    printf("VERBOSE: FLV: cannot write data, write callback not yet set.\n");
-    return;
-  }
-  if(!is_opened) {
-    printf("VERBOSE: FLV: cannot write data, not yet opened.\n");
-    return;
-  }
-  bytes_flushed += cb_write(&buffer[0], buffer.size(), cb_user);
-  buffer.clear();
-}
-
 inline size_t FLV::size() {
   return buffer.size();
 }
@@ -7,6 +7,9 @@
 #include <roxlu/Roxlu.h>
 #include <string>
 
+// the screen recorder reads back the framebuffer, so it's only available when building with OpenGL
+#if defined(ROXLU_WITH_OPENGL)
+
 //#define SCREEN_RECORDER_USE_PBO
 #define SCREEN_RECORDER_NUM_PBOS 5
 
@@ -63,4 +66,5 @@ class FLVScreenRecorder {
   unsigned char* pixels;
 #endif
 };
+#endif /* ROXLU_WITH_OPENGL */
 #endif
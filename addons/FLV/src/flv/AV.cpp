@@ -1,5 +1,33 @@
 #include <flv/AV.h>
 
+AVX264Settings::AVX264Settings()
+  :preset("ultrafast")
+  ,tune("zerolatency")
+  ,threads(1)
+  ,lookahead_threads(-1)
+  ,sliced_threads(-1)
+  ,rc_lookahead(-1)
+  ,sync_lookahead(-1)
+{
+}
+
+AVStats::AVStats()
+  :num_video_frames(0)
+  ,fps(0.0)
+  ,avg_latency(0.0)
+  ,max_latency(0)
+{
+}
+
+AVConverter::AVConverter()
+  :av(NULL)
+  ,sws(NULL)
+  ,buffer(NULL)
+{
+}
+
+// -------------------------------------------------------------------------
+
 AV::AV() 
   :vid_in_w(640)
   ,vid_in_h(480)
@@ -12,8 +40,7 @@ AV::AV()
   ,vid_timeout(0)
   ,vid_is_buffer_ready(false)
   ,vid_encoder(NULL)
-  ,vid_sws(NULL)
-  ,vid_tmp_buffer(NULL)
+  ,vid_vflip(false)
   ,vid_total_frames(0)
   ,vid_time_started(0)
   ,vid_last_timestamp(0)
@@ -27,14 +54,20 @@ AV::AV()
   ,audio_lame_flags(NULL)
   ,flv(NULL)
   ,audio_ring_buffer(1024 * 1024 * 5) 
-  ,audio_work_buffer(1024 * 1024 * 5)
   ,video_ring_buffer(0)
-  ,video_work_buffer(0)
+  ,audio_encode_buffer(1024 * 1024 * 5)
+  ,stats_total_latency(0)
+  ,stats_time_started(0)
   ,is_initialized(false)
   ,must_stop(false)
+  ,num_convert_threads(2)
+  ,num_running_converters(0)
 {
   uv_mutex_init(&mutex);
   uv_mutex_init(&stop_mutex);
+  uv_mutex_init(&encode_mutex);
+  uv_cond_init(&packets_cond);
+  uv_cond_init(&encode_cond);
 }
 
 AV::~AV() {
@@ -62,11 +95,7 @@ bool AV::setupVideo(int inw,
   vid_bytes_per_frame = vid_in_w * vid_in_h * vid_num_channels;
   flv = f;
 
-  vid_tmp_buffer = new char[vid_bytes_per_frame];
-  memset(vid_tmp_buffer, 0x00, vid_bytes_per_frame);
-
   video_ring_buffer.resize(vid_bytes_per_frame * 5);
-  video_work_buffer.resize(vid_bytes_per_frame * 5);
   return true;
 }
 
@@ -100,6 +129,36 @@ bool AV::setupAudio(int numChannels,
   return true;
 }
 
+bool AV::setupX264(AVX264Settings settings) {
+  if(!settings.preset.size()) {
+    RX_ERROR(ERR_AV_X264_PRESET);
+    return false;
+  }
+
+  if(settings.threads < 0) {
+    RX_ERROR(ERR_AV_X264_THREADS, settings.threads);
+    return false;
+  }
+
+  x264_settings = settings;
+  return true;
+}
+
+bool AV::setNumConvertThreads(int num) {
+  if(num < 1) {
+    RX_ERROR(ERR_AV_CONVERT_THREADS, num);
+    return false;
+  }
+
+  if(is_initialized) {
+    RX_ERROR(ERR_AV_ALREADY_INITIALIZED);
+    return false;
+  }
+
+  num_convert_threads = num;
+  return true;
+}
+
 bool AV::initialize() {
   if(!initializeVideo()) {
     RX_ERROR(("cannot initialize video."));
@@ -116,24 +175,42 @@ bool AV::initialize() {
 }
 
 bool AV::initializeVideo() {
+
+  // one picture per converter + some extra so the converters can work ahead of the encoder
   unsigned int csp = (vid_vflip) ? X264_CSP_I420 | X264_CSP_VFLIP : X264_CSP_I420;
-  int r = x264_picture_alloc(&vid_pic_in, csp, vid_out_w, vid_out_h);
-  if(r != 0) {
-    RX_ERROR(("cannot allocate picture that holds the encoded data."));
-    return false;
+  for(int i = 0; i < num_convert_threads + AV_NUM_EXTRA_PICTURES; ++i) {
+    x264_picture_t* pic = new x264_picture_t();
+    int r = x264_picture_alloc(pic, csp, vid_out_w, vid_out_h);
+    if(r != 0) {
+      RX_ERROR(("cannot allocate picture that holds the encoded data."));
+      delete pic;
+      return false;
+    }
+    vid_pics.push_back(pic);
   }
+  vid_free_pics = vid_pics;
 
   AVPixelFormat av_fmt = videoFormatToAVPixelFormat(vid_fmt);
-  vid_sws = sws_getContext(vid_in_w, vid_in_h, av_fmt,
-                           vid_out_w, vid_out_h, PIX_FMT_YUV420P, 
-                           SWS_FAST_BILINEAR, NULL, NULL, NULL);
-
   printAVPixelFormat(av_fmt);
-  
-  if(!vid_sws) {
-    RX_ERROR(("cannot setup sws."));
-    return false;
+
+  // the converter buffer is also used for audio packets, see convert() 
+  size_t buffer_size = std::max<size_t>(vid_bytes_per_frame, sizeof(audio_tmp_in_buffer));
+
+  for(int i = 0; i < num_convert_threads; ++i) {
+    AVConverter* c = new AVConverter();
+    c->av = this;
+    c->buffer = new char[buffer_size];
+    converters.push_back(c);
+
+    c->sws = sws_getContext(vid_in_w, vid_in_h, av_fmt,
+                            vid_out_w, vid_out_h, PIX_FMT_YUV420P, 
+                            SWS_FAST_BILINEAR, NULL, NULL, NULL);
+    if(!c->sws) {
+      RX_ERROR(("cannot setup sws."));
+      return false;
+    }
   }
+
   return true;
 }
 
@@ -204,13 +281,16 @@ bool AV::openFLV() {
 bool AV::openX264() {
   int r = 0;
   x264_param_t* p = &vid_params;
+  const char* tune = (x264_settings.tune.size()) ? x264_settings.tune.c_str() : NULL;
 
-  r = x264_param_default_preset(p, "ultrafast", "zerolatency"); // ultrafast, zerolatency
+  r = x264_param_default_preset(p, x264_settings.preset.c_str(), tune); 
   if(r != 0) {
-    RX_ERROR(("cannot set x264 preset."));
+    RX_ERROR("cannot set x264 preset: %s / %s.", x264_settings.preset.c_str(), x264_settings.tune.c_str());
     return false;
   }
 
+  // baseline has no b-frames; we rely on this because FLV::writeVideoPacket() has no composition time and 
+  // encodeVideoPicture() expects the frames in the order we added them.
   r = x264_param_apply_profile(p, "baseline");
   if(r != 0) {
     RX_ERROR(("cannot apply profile."));
@@ -219,7 +299,19 @@ bool AV::openX264() {
 #if defined(NDEBUG)
   p->i_log_level = X264_LOG_DEBUG;
 #endif
-  p->i_threads = 1;
+  p->i_threads = x264_settings.threads;
+  if(x264_settings.lookahead_threads >= 0) {
+    p->i_lookahead_threads = x264_settings.lookahead_threads;
+  }
+  if(x264_settings.sliced_threads >= 0) {
+    p->b_sliced_threads = x264_settings.sliced_threads;
+  }
+  if(x264_settings.rc_lookahead >= 0) {
+    p->rc.i_lookahead = x264_settings.rc_lookahead;
+  }
+  if(x264_settings.sync_lookahead >= 0) {
+    p->i_sync_lookahead = x264_settings.sync_lookahead;
+  }
   p->i_width = vid_out_w;
   p->i_height = vid_out_h;
   p->i_fps_num = vid_fps;
@@ -239,126 +331,220 @@ bool AV::openX264() {
   return true;
 }
 
-#define AV_CHECK_MUST_STOP \
-  {                                             \
-    uv_mutex_lock(&stop_mutex);                 \
-    if(must_stop) {                             \
-       uv_mutex_unlock(&stop_mutex);            \
-      break;                                    \
-    }                                           \
-    uv_mutex_unlock(&stop_mutex);               \
-  }                                            
+void AV::start() {
+  if(!is_initialized) {
+    RX_ERROR("cannot start AV because we're not initialized.");
+    return;
+  }
+  if(!openX264()) {
+    RX_ERROR("ERROR: cannot open X264");
+    return;
+  }
+	if(!openLame()) {
+		RX_ERROR("cannot create lame mp3 encoder");
+		return;
+	}
+  if(!openFLV()) {
+    RX_ERROR("ERROR: cannot open FLV.");
+    return;
+  }
+
+  uv_mutex_lock(&encode_mutex);
+  {
+    stats = AVStats();
+    stats_total_latency = 0;
+    stats_time_started = 0;
+    num_running_converters = converters.size();
+  }
+  uv_mutex_unlock(&encode_mutex);
 
+  for(std::vector<AVConverter*>::iterator it = converters.begin(); it != converters.end(); ++it) {
+    uv_thread_create(&(*it)->thread, av_convert_thread_function, (void*)*it);
+  }
 
+  uv_thread_create(&thread, av_thread_function, (void*)this);
+}
 
 void av_thread_function(void* user) {
   AV* av_ptr = static_cast<AV*>(user);
   av_ptr->run();
 }
 
-void AV::run() {
+void av_convert_thread_function(void* user) {
+  AVConverter* c = static_cast<AVConverter*>(user);
+  c->av->convert(c);
+}
 
-  // audio + video 
-  if(vid_in_w != 0 && audio_num_channels != 0) {
-    std::vector<AVPacket*> work_packets;
-    while(true) {
+// Converter stage: takes the packets in the order they were added, copies the
+// data out of the ring buffers and converts video frames into a free x264 picture. 
+// Because we move a packet from `packets` into `encode_packets` while holding 
+// `mutex`, the encoder gets the packets in order even with multiple converters.
+void AV::convert(AVConverter* c) {
+  x264_picture_t* pic = NULL;
+  int vid_in_stride = vid_in_w * vid_num_channels;
 
-      if(!is_initialized) {
-        rx_sleep_millis(vid_millis_per_frame);
-        AV_CHECK_MUST_STOP;
-        continue;
-      }
+  while(!mustStop()) {
 
-      if(!vid_is_buffer_ready || !audio_is_buffer_ready) {
-        rx_sleep_millis(vid_millis_per_frame);
-        AV_CHECK_MUST_STOP;
-        continue;
+    // wait until we receive both audio and video, so they start at the same time
+    if(!is_initialized || !vid_is_buffer_ready || (audio_num_channels != 0 && !audio_is_buffer_ready)) {
+      rx_sleep_millis(vid_millis_per_frame);
+      continue;
+    }
+
+    // make sure we have a picture before we take a packet, so we never block with a packet taken
+    if(!pic) {
+      uv_mutex_lock(&encode_mutex);
+      {
+        while(vid_free_pics.empty() && !mustStop()) {
+          uv_cond_wait(&encode_cond, &encode_mutex);
+        }
+        if(!vid_free_pics.empty()) {
+          pic = vid_free_pics.back();
+          vid_free_pics.pop_back();
+        }
       }
+      uv_mutex_unlock(&encode_mutex);
 
-      size_t num_packets = packets.size();
-      if(num_packets == 0) {
-        AV_CHECK_MUST_STOP;
+      if(!pic) {
         continue;
       }
+    }
 
-      uv_mutex_lock(&mutex);
-      {
-        std::copy(packets.begin(), packets.end(), std::back_inserter(work_packets));
-        audio_work_buffer.write(audio_ring_buffer.getReadPtr(), audio_ring_buffer.size());
-        video_work_buffer.write(video_ring_buffer.getReadPtr(), video_ring_buffer.size());
-        audio_ring_buffer.reset();
-        video_ring_buffer.reset();
-        packets.clear();
+    AVPacket* p = NULL;
+    uv_mutex_lock(&mutex);
+    {
+      while(packets.empty() && !mustStop()) {
+        uv_cond_wait(&packets_cond, &mutex);
       }
-      uv_mutex_unlock(&mutex);
 
-      for(std::vector<AVPacket*>::iterator it = work_packets.begin(); it != work_packets.end(); ++it) {
-        AVPacket* p = *it;
+      if(!packets.empty()) {
+        p = packets.front();
+        packets.pop_front();
+
         if(p->type == AV_VIDEO) {
-          encodeVideoPacket(p);
+          video_ring_buffer.read(c->buffer, p->num_bytes);
+          p->pic = pic;
         }
         else if(p->type == AV_AUDIO) {
-          encodeAudioPacket(p);
+          audio_ring_buffer.read(c->buffer, p->num_bytes);
         }
-      }
 
-      for(std::vector<AVPacket*>::iterator it = work_packets.begin(); it != work_packets.end(); ++it) {
-        delete *it;
-        *it = NULL;
+        uv_mutex_lock(&encode_mutex);
+        {
+          if(p->type == AV_AUDIO) {
+            audio_encode_buffer.write(c->buffer, p->num_bytes);
+            p->is_ready = true;
+            uv_cond_broadcast(&encode_cond);
+          }
+          encode_packets.push_back(p);
+        }
+        uv_mutex_unlock(&encode_mutex);
       }
-      work_packets.clear();
+    }
+    uv_mutex_unlock(&mutex);
 
-      audio_work_buffer.reset();
-      video_work_buffer.reset();
+    if(!p || p->type != AV_VIDEO) {
+      continue;
+    }
 
-      AV_CHECK_MUST_STOP;
+    // convert outside the locks so the other converters and the encoder keep going
+    int h = sws_scale(c->sws,
+                      (uint8_t**)&c->buffer,
+                      &vid_in_stride,
+                      0, 
+                      vid_in_h, 
+                      pic->img.plane, 
+                      pic->img.i_stride);
+
+    uv_mutex_lock(&encode_mutex);
+    {
+      if(h != vid_out_h) {
+        RX_ERROR(("cannot sws_scale().\n"));
+        vid_free_pics.push_back(pic);
+        p->pic = NULL;
+      }
+      p->is_ready = true;
+      uv_cond_broadcast(&encode_cond);
     }
+    uv_mutex_unlock(&encode_mutex);
+
+    pic = NULL;
   }
 
-  // video only loop
-  else {
-    std::vector<AVPacket*> work_packets;
-    while(true) {
+  uv_mutex_lock(&encode_mutex);
+  {
+    if(pic) {
+      vid_free_pics.push_back(pic);
+    }
+    num_running_converters--;
+    uv_cond_broadcast(&encode_cond);
+  }
+  uv_mutex_unlock(&encode_mutex);
+}
 
-      if(!is_initialized) {
-        rx_sleep_millis(vid_millis_per_frame);
-        AV_CHECK_MUST_STOP;
-        continue;
-      }
+// Encoder stage: encodes the converted packets in the order they were added. When 
+// stop() has been called we encode everything the converters have produced, flush
+// the frames x264 delayed and close the file.
+void AV::run() {
 
-      if(!vid_is_buffer_ready) { 
-        AV_CHECK_MUST_STOP;
-        continue;
-      }
+  while(true) {
 
-      uv_mutex_lock(&mutex);
+    AVPacket* p = NULL;
+    uv_mutex_lock(&encode_mutex);
+    {
+      while( (encode_packets.empty() || !encode_packets.front()->is_ready) 
+             && num_running_converters > 0) 
       {
-        std::copy(packets.begin(), packets.end(), std::back_inserter(work_packets));
-        video_work_buffer.write(video_ring_buffer.getReadPtr(), video_ring_buffer.size());
-        packets.clear();
-        video_ring_buffer.reset();
+        uv_cond_wait(&encode_cond, &encode_mutex);
       }
-      uv_mutex_unlock(&mutex);
 
-      for(std::vector<AVPacket*>::iterator it = work_packets.begin(); it != work_packets.end(); ++it) {
-        AVPacket* p = *it;
-        if(p->type == AV_VIDEO) {
-          encodeVideoPacket(p);
-        }
+      if(!encode_packets.empty() && encode_packets.front()->is_ready) {
+        p = encode_packets.front();
+        encode_packets.pop_front();
       }
-  
-      for(std::vector<AVPacket*>::iterator it = work_packets.begin(); it != work_packets.end(); ++it) {
-        delete *it;
-        *it = NULL;
+    }
+    uv_mutex_unlock(&encode_mutex);
+
+    if(!p) {
+      break; // the converters stopped and everything has been encoded
+    }
+
+    if(p->type == AV_VIDEO) {
+      if(p->pic) {
+        encodeVideoPacket(p);
+
+        // x264 copies the picture so we can give it back to the converters 
+        uv_mutex_lock(&encode_mutex);
+        vid_free_pics.push_back(p->pic);
+        uv_cond_broadcast(&encode_cond);
+        uv_mutex_unlock(&encode_mutex);
       }
-      work_packets.clear();
+    }
+    else if(p->type == AV_AUDIO) {
+      encodeAudioPacket(p);
+    }
 
-      video_work_buffer.reset();
+    delete p;
+    p = NULL;
+  }
 
-      AV_CHECK_MUST_STOP;
+  // write the frames x264 delayed because of lookahead/frame threads
+  if(vid_encoder) {
+    while(x264_encoder_delayed_frames(vid_encoder) > 0) {
+      if(!encodeVideoPicture(NULL)) {
+        break;
+      }
+    }
+  }
 
-    } // video only
+  for(std::vector<AVConverter*>::iterator it = converters.begin(); it != converters.end(); ++it) {
+    uv_thread_join(&(*it)->thread);
   }
+
+  AVStats s = getStats();
+  RX_VERBOSE("encoded %d video frames, %0.2f fps, avg latency: %0.2f ms, max latency: %lld ms", 
+             s.num_video_frames, s.fps, s.avg_latency, s.max_latency);
+
   reset();
 }
 
@@ -368,7 +554,18 @@ void AV::encodeAudioPacket(AVPacket* p) {
     return;
   }
 
-  size_t bytes_read = audio_work_buffer.read((char*)audio_tmp_in_buffer, p->num_bytes);
+  if(p->num_bytes > sizeof(audio_tmp_in_buffer)) {
+    RX_ERROR(ERR_AV_AUDIO_PACKET_SIZE, p->num_bytes);
+    uv_mutex_lock(&encode_mutex);
+    audio_encode_buffer.drain(p->num_bytes);
+    uv_mutex_unlock(&encode_mutex);
+    return;
+  }
+
+  uv_mutex_lock(&encode_mutex);
+  size_t bytes_read = audio_encode_buffer.read((char*)audio_tmp_in_buffer, p->num_bytes);
+  uv_mutex_unlock(&encode_mutex);
+
   if(bytes_read != p->num_bytes) {
     RX_ERROR(("cannot read audio from buffer. Skipping encoding."));
     return;
@@ -428,53 +625,74 @@ void AV::encodeAudioPacket(AVPacket* p) {
 
 void AV::encodeVideoPacket(AVPacket* p) {
   if(!is_initialized) {
-    RX_WARNING(("cannot add audio frame when we're not initialized."));
+    RX_WARNING(("cannot add video frame when we're not initialized."));
     return;
   }
 
-  int vid_in_stride = vid_in_w * vid_num_channels; // @todo make member
-  video_work_buffer.read(vid_tmp_buffer, vid_bytes_per_frame); // @todo test/use: p->num_bytes
-  
-  int h = sws_scale(vid_sws,
-                    (uint8_t**)&vid_tmp_buffer,
-                    &vid_in_stride,
-                    0, 
-                    vid_in_h, 
-                    vid_pic_in.img.plane, 
-                    vid_pic_in.img.i_stride);
-
-  if(h != vid_out_h) {
-    RX_ERROR(("cannot sws_scale().\n"));
-    return;
-  }
-
-  vid_pic_in.i_pts = vid_total_frames;
+  p->pic->i_pts = vid_total_frames;
   vid_total_frames++;
+  vid_timestamps.push_back(p->timestamp);
 
+  encodeVideoPicture(p->pic);
+}
+
+bool AV::encodeVideoPicture(x264_picture_t* pic) {
   x264_nal_t* nal = NULL;
   int nals_count = 0;
-  int frame_size = x264_encoder_encode(vid_encoder, &nal, &nals_count, &vid_pic_in, &vid_pic_out);
+  int frame_size = x264_encoder_encode(vid_encoder, &nal, &nals_count, pic, &vid_pic_out);
 
   if(frame_size < 0) {
     RX_WARNING(("x264_encoder_encode fails"));
-    return;
+    return false;
+  }
+  if(frame_size == 0) {
+    return true; // x264 delayed the frame (lookahead, frame threads)
   }
   if(nal == NULL) {
     RX_ERROR(("x264_encoder_encode() return 0 nals."));
-    return;
+    return false;
+  }
+  if(vid_timestamps.empty()) {
+    RX_ERROR(("x264_encoder_encode() returned a frame for which we have no timestamp."));
+    return false;
   }
 
-  if(p->timestamp < vid_last_timestamp) {
-    RX_ERROR(("Given timestamp is smaller the previous one! Current timestamp: %lld, previous: %lld", p->timestamp, vid_last_timestamp));
+  // we use the baseline profile (no b-frames) so the frames are returned in the order we added them
+  rx_uint64 timestamp = vid_timestamps.front();
+  vid_timestamps.pop_front();
+
+  if(timestamp < vid_last_timestamp) {
+    RX_ERROR("Given timestamp is smaller the previous one! Current timestamp: %lld, previous: %lld", timestamp, vid_last_timestamp);
   }
-  vid_last_timestamp = p->timestamp;
+  vid_last_timestamp = timestamp;
       
   FLVVideoPacket flv_vid_packet;
-  flv_vid_packet.timestamp = p->timestamp; //vid_total_frames * vid_millis_per_frame;
+  flv_vid_packet.timestamp = timestamp; 
   flv_vid_packet.is_keyframe = vid_pic_out.b_keyframe;
   flv_vid_packet.nals_size = frame_size;
   flv_vid_packet.nals_data = nal[0].p_payload;
   flv->writeVideoPacket(flv_vid_packet);
+
+  // latency = time between addVideoFrame() and now
+  rx_uint64 now = rx_millis();
+  rx_uint64 latency = (now - vid_time_started) - timestamp;
+
+  uv_mutex_lock(&encode_mutex);
+  {
+    if(!stats_time_started) {
+      stats_time_started = now;
+    }
+    stats.num_video_frames++;
+    stats_total_latency += latency;
+    stats.max_latency = std::max<rx_uint64>(stats.max_latency, latency);
+    stats.avg_latency = double(stats_total_latency) / stats.num_video_frames;
+    if(now > stats_time_started) {
+      stats.fps = (stats.num_video_frames - 1) / ((now - stats_time_started) / 1000.0);
+    }
+  }
+  uv_mutex_unlock(&encode_mutex);
+
+  return true;
 }
 
 void AV::shutdown() {
@@ -492,8 +710,6 @@ void AV::shutdown() {
   audio_total_samples = 0;
   audio_time_started = 0;
 
-  delete[] vid_tmp_buffer;
-  vid_tmp_buffer = NULL;
   vid_in_w = 0;
   vid_in_h = 0;
   vid_fps = 0;
@@ -505,14 +721,24 @@ void AV::shutdown() {
   vid_is_buffer_ready = false;
   vid_last_timestamp = 0;
 
-  delete[] vid_tmp_buffer;
-  vid_tmp_buffer = NULL;
-
   memset((char*)&vid_params, 0, sizeof(vid_params));
 
-  x264_picture_clean(&vid_pic_in);
+  for(std::vector<x264_picture_t*>::iterator it = vid_pics.begin(); it != vid_pics.end(); ++it) {
+    x264_picture_clean(*it);
+    delete *it;
+  }
+  vid_pics.clear();
+  vid_free_pics.clear();
 
-  sws_freeContext(vid_sws);
+  for(std::vector<AVConverter*>::iterator it = converters.begin(); it != converters.end(); ++it) {
+    AVConverter* c = *it;
+    if(c->sws) {
+      sws_freeContext(c->sws);
+    }
+    delete[] c->buffer;
+    delete c;
+  }
+  converters.clear();
 
   if(audio_lame_flags) { 
     lame_close(audio_lame_flags);
@@ -521,8 +747,10 @@ void AV::shutdown() {
   
   uv_mutex_destroy(&mutex);
   uv_mutex_destroy(&stop_mutex);
+  uv_mutex_destroy(&encode_mutex);
+  uv_cond_destroy(&packets_cond);
+  uv_cond_destroy(&encode_cond);
 
-  vid_sws = NULL;
   vid_encoder = NULL;
 }
 
@@ -556,11 +784,12 @@ void AV::reset() {
   vid_time_started = 0;
   vid_is_buffer_ready = false;
   vid_last_timestamp = 0;
+  vid_timestamps.clear();
+  vid_free_pics = vid_pics;
 
   audio_ring_buffer.reset();
   video_ring_buffer.reset();
-  audio_work_buffer.reset();
-  video_work_buffer.reset();
+  audio_encode_buffer.reset();
 
   uv_mutex_lock(&stop_mutex);
   must_stop = false;
@@ -568,11 +797,17 @@ void AV::reset() {
 
   x264_encoder_close(vid_encoder);
 
-  for(std::vector<AVPacket*>::iterator it = packets.begin(); it != packets.end(); ++it) {
+  for(std::deque<AVPacket*>::iterator it = packets.begin(); it != packets.end(); ++it) {
     delete *it;
     *it = NULL;
   }
   packets.clear();
+
+  for(std::deque<AVPacket*>::iterator it = encode_packets.begin(); it != encode_packets.end(); ++it) {
+    delete *it;
+    *it = NULL;
+  }
+  encode_packets.clear();
 }
 
 FLVAudioSampleRate AV::audioSampleRateToFLVSampleRate(int rate) {
@@ -1,8 +1,24 @@
 #include <flv/FLV.h>
 
+FLVTag::FLVTag() {
+  reset();
+}
+
+void FLVTag::reset() {
+  data.clear();
+  timestamp = 0;
+  type = FLV_TAG_NONE;
+  is_keyframe = false;
+  refcount = 0;
+}
+
+// -------------------------------------------------------------------------
+
 FLV::FLV()
-  :cb_flush(NULL)
+  :cb_write(NULL)
+  ,cb_flush(NULL)
   ,cb_rewrite(NULL)
+  ,cb_close(NULL)
   ,cb_user(NULL)
   ,read_dx(0)
   ,sei_data(NULL)
@@ -16,12 +32,33 @@ FLV::FLV()
   ,last_video_timestamp(0)
   ,total_num_frames(0)
   ,is_opened(false)
+  ,has_packets(false)
 {
+  uv_mutex_init(&outputs_mutex);
+  uv_mutex_init(&tags_mutex);
 }
 
 FLV::~FLV() {
   FLVCloseParams p;
   close(p);
+
+  // outputs which were added but never opened
+  uv_mutex_lock(&outputs_mutex);
+  std::vector<FLVOutput*> to_close = outputs;
+  outputs.clear();
+  uv_mutex_unlock(&outputs_mutex);
+
+  for(std::vector<FLVOutput*>::iterator it = to_close.begin(); it != to_close.end(); ++it) {
+    closeOutput(*it);
+  }
+
+  for(std::vector<FLVTag*>::iterator it = free_tags.begin(); it != free_tags.end(); ++it) {
+    delete *it;
+  }
+  free_tags.clear();
+
+  uv_mutex_destroy(&outputs_mutex);
+  uv_mutex_destroy(&tags_mutex);
 }
 
 int FLV::open(FLVHeader header) {
@@ -179,7 +216,7 @@ int FLV::writeVideoPacket(FLVVideoPacket pkt) {
   rewrite24(data_size, data_size_pos);  // DataSize
   put32(size() - start_size);           // PreviousTagSize
 
-  flush();
+  flushPacket(FLV_TAG_VIDEO, pkt.timestamp, pkt.is_keyframe);
 
   last_video_timestamp = pkt.timestamp;
   total_num_frames++;
@@ -240,7 +277,7 @@ int FLV::writeAvcSequenceHeader(FLVAvcSequenceHeader hdr) {
   size_t data_size = size() - tag_size_start;
   rewrite24(data_size, tag_size_pos);
   put32(size() - start_size);
-  //  flush();
+  flush(); // flushed separately so we can give it to outputs which are added later
   return 1;
 }
 
@@ -273,7 +310,7 @@ int FLV::writeAudioPacket(FLVAudioPacket pkt) {
   size_t data_size = size() - tag_size_start;
   rewrite24(data_size, tag_size_pos);
   put32(size() - start_size);
-  flush();
+  flushPacket(FLV_TAG_AUDIO, pkt.timestamp, false);
 
   return 1;
 }
@@ -284,34 +321,32 @@ int FLV::close(FLVCloseParams p) {
     return 0;
   }
 
-  cb_flush(cb_user);
-  
-  double d = 0.0;
-  rx_uint64 v = 0.0;
-
-
-  if(total_num_frames > 0) {
-    // framerate
-    double framerate = double(last_video_timestamp) / total_num_frames;
-    v = swapDouble(framerate);
-    cb_rewrite((char*)&v, sizeof(rx_uint64), framerate_pos, cb_user);
+  if(cb_flush) {
+    cb_flush(cb_user);
+  }
 
-    // duration
-    d = double(last_video_timestamp) / 1000.0;
-    v = swapDouble(d);
-    cb_rewrite((char*)&v, sizeof(rx_uint64), duration_pos, cb_user);
+  rewriteMetaData(cb_rewrite, cb_user, last_video_timestamp, total_num_frames, bytes_flushed);
 
-    // filesize
-    v = swapDouble(bytes_flushed);
-    cb_rewrite((char*)&v, sizeof(rx_uint64), filesize_pos, cb_user);
+  if(cb_close) {
+    cb_close(cb_user);
+  }
 
-    // datarate
-    d = (bytes_flushed * 8) / last_video_timestamp;
-    v = swapDouble(d);
-    cb_rewrite((char*)&v, sizeof(rx_uint64), datarate_pos, cb_user);
+  // close the outputs; this writes everything they have queued
+  uv_mutex_lock(&outputs_mutex);
+  std::vector<FLVOutput*> to_close = outputs;
+  std::vector<FLVTag*> to_release = header_tags;
+  outputs.clear();
+  header_tags.clear();
+  has_packets = false;
+  uv_mutex_unlock(&outputs_mutex);
+
+  for(std::vector<FLVOutput*>::iterator it = to_close.begin(); it != to_close.end(); ++it) {
+    closeOutput(*it);
   }
 
-  cb_close(cb_user);
+  for(std::vector<FLVTag*>::iterator it = to_release.begin(); it != to_release.end(); ++it) {
+    releaseTag(*it);
+  }
 
   read_dx = 0;
   bytes_written = 0;
@@ -323,11 +358,196 @@ int FLV::close(FLVCloseParams p) {
   last_video_timestamp = 0;
   total_num_frames = 0;
   sei_size = 0;
+  has_packets = false;
   is_opened = false;
   buffer.clear();
   return 1;
 }
 
+void FLV::rewriteMetaData(flv_rewrite_data_cb cb, 
+                          void* user, 
+                          rx_uint64 lastVideoTimestamp, 
+                          rx_uint64 numFrames, 
+                          size_t bytesFlushed) 
+{
+  if(!cb || !numFrames) {
+    return;
+  }
+  
+  double d = 0.0;
+  rx_uint64 v = 0.0;
+
+  // framerate
+  double framerate = double(lastVideoTimestamp) / numFrames;
+  v = swapDouble(framerate);
+  cb((char*)&v, sizeof(rx_uint64), framerate_pos, user);
+
+  // duration
+  d = double(lastVideoTimestamp) / 1000.0;
+  v = swapDouble(d);
+  cb((char*)&v, sizeof(rx_uint64), duration_pos, user);
+
+  // filesize
+  v = swapDouble(bytesFlushed);
+  cb((char*)&v, sizeof(rx_uint64), filesize_pos, user);
+
+  // datarate
+  if(lastVideoTimestamp) {
+    d = (bytesFlushed * 8) / lastVideoTimestamp;
+    v = swapDouble(d);
+    cb((char*)&v, sizeof(rx_uint64), datarate_pos, user);
+  }
+}
+
+void FLV::flush() {
+  flushPacket(FLV_TAG_NONE, 0, false);
+}
+
+// Writes the buffer to the callbacks set with setCallbacks() and gives a copy to all outputs.
+// Header data (FLV_TAG_NONE) is kept so we can give it to outputs which are added later.
+void FLV::flushPacket(int type, rx_uint32 timestamp, bool isKeyframe) {
+  if(!is_opened) {
+    printf("VERBOSE: FLV: cannot write data, not yet opened.\n");
+    return;
+  }
+  if(!buffer.size()) {
+    return;
+  }
+
+  if(cb_write) {
+    bytes_flushed += cb_write(&buffer[0], buffer.size(), cb_user);
+  }
+
+  uv_mutex_lock(&outputs_mutex);
+  {
+    if(type == FLV_TAG_NONE || outputs.size()) {
+      FLVTag* tag = acquireTag();
+      tag->data.assign(buffer.begin(), buffer.end());
+      tag->type = type;
+      tag->timestamp = timestamp;
+      tag->is_keyframe = isKeyframe;
+
+      if(type == FLV_TAG_NONE) {
+        retainTag(tag);
+        header_tags.push_back(tag);
+      }
+
+      for(std::vector<FLVOutput*>::iterator it = outputs.begin(); it != outputs.end(); ++it) {
+        (*it)->push(tag);
+      }
+
+      releaseTag(tag);
+    }
+
+    if(type != FLV_TAG_NONE) {
+      has_packets = true;
+    }
+  }
+  uv_mutex_unlock(&outputs_mutex);
+
+  buffer.clear();
+}
+
+FLVOutput* FLV::addOutput(flv_write_data_cb writeCB, 
+                          flv_rewrite_data_cb rewriteCB, 
+                          flv_flush_data_cb flushCB, 
+                          flv_close_cb closeCB, 
+                          void* user,
+                          size_t maxQueuedTags)
+{
+  if(!writeCB) {
+    RX_ERROR(ERR_FLV_OUTPUT_CALLBACK);
+    return NULL;
+  }
+
+  FLVOutput* o = new FLVOutput(this, maxQueuedTags);
+  o->cb_write = writeCB;
+  o->cb_rewrite = rewriteCB;
+  o->cb_flush = flushCB;
+  o->cb_close = closeCB;
+  o->cb_user = user;
+
+  uv_mutex_lock(&outputs_mutex);
+  {
+    for(std::vector<FLVTag*>::iterator it = header_tags.begin(); it != header_tags.end(); ++it) {
+      o->push(*it);
+    }
+    o->must_rebase = has_packets;
+    outputs.push_back(o);
+  }
+  uv_mutex_unlock(&outputs_mutex);
+
+  uv_thread_create(&o->thread, flv_output_thread, o);
+  return o;
+}
+
+bool FLV::removeOutput(FLVOutput* output) {
+  uv_mutex_lock(&outputs_mutex);
+  std::vector<FLVOutput*>::iterator it = std::find(outputs.begin(), outputs.end(), output);
+  if(it == outputs.end()) {
+    uv_mutex_unlock(&outputs_mutex);
+    RX_ERROR(ERR_FLV_OUTPUT_NOT_FOUND);
+    return false;
+  }
+  outputs.erase(it);
+  uv_mutex_unlock(&outputs_mutex);
+
+  closeOutput(output);
+  return true;
+}
+
+void FLV::closeOutput(FLVOutput* o) {
+  o->stop();
+
+  if(o->num_dropped) {
+    RX_VERBOSE(VERBOSE_FLV_OUTPUT_DROPPED, o->num_dropped);
+  }
+
+  if(o->cb_flush) {
+    o->cb_flush(o->cb_user);
+  }
+
+  rewriteMetaData(o->cb_rewrite, o->cb_user, o->last_video_timestamp, o->total_num_frames, o->bytes_flushed);
+
+  if(o->cb_close) {
+    o->cb_close(o->cb_user);
+  }
+
+  delete o;
+}
+
+FLVTag* FLV::acquireTag() {
+  FLVTag* tag = NULL;
+
+  uv_mutex_lock(&tags_mutex);
+  if(free_tags.size()) {
+    tag = free_tags.back();
+    free_tags.pop_back();
+  }
+  uv_mutex_unlock(&tags_mutex);
+
+  if(!tag) {
+    tag = new FLVTag();
+  }
+
+  tag->refcount = 1;
+  return tag;
+}
+
+void FLV::retainTag(FLVTag* tag) {
+  uv_mutex_lock(&tags_mutex);
+  tag->refcount++;
+  uv_mutex_unlock(&tags_mutex);
+}
+
+void FLV::releaseTag(FLVTag* tag) {
+  uv_mutex_lock(&tags_mutex);
+  tag->refcount--;
+  if(tag->refcount == 0) {
+    free_tags.push_back(tag); // we keep the allocated data so we don't have to reallocate for the next tag
+  }
+  uv_mutex_unlock(&tags_mutex);
+}
 
 void FLV::dump() {
   read_dx = 0;
@@ -483,6 +703,234 @@ bool FLVFileWriter::open(std::string filepath) {
   return true;
 }
 
+// -------------------------------------------------------------------------
+
+void flv_output_thread(void* user) {
+  FLVOutput* o = static_cast<FLVOutput*>(user);
+  o->run();
+}
+
+FLVOutput::FLVOutput(FLV* flv, size_t maxQueuedTags)
+  :cb_write(NULL)
+  ,cb_rewrite(NULL)
+  ,cb_flush(NULL)
+  ,cb_close(NULL)
+  ,cb_user(NULL)
+  ,flv(flv)
+  ,max_queued_tags(maxQueuedTags)
+  ,num_dropped(0)
+  ,is_waiting_for_keyframe(true)
+  ,must_rebase(false)
+  ,timestamp_offset(0)
+  ,last_video_timestamp(0)
+  ,total_num_frames(0)
+  ,bytes_flushed(0)
+  ,must_stop(false)
+{
+  uv_mutex_init(&mutex);
+  uv_cond_init(&cond);
+}
+
+FLVOutput::~FLVOutput() {
+  for(std::deque<FLVTag*>::iterator it = tags.begin(); it != tags.end(); ++it) {
+    flv->releaseTag(*it);
+  }
+  tags.clear();
+
+  uv_mutex_destroy(&mutex);
+  uv_cond_destroy(&cond);
+}
+
+bool FLVOutput::push(FLVTag* tag) {
+  uv_mutex_lock(&mutex);
+
+  // header data is always written; packets must start at a video keyframe
+  if(tag->type != FLV_TAG_NONE) {
+
+    if(tags.size() >= max_queued_tags) {
+      is_waiting_for_keyframe = true;
+      num_dropped++;
+      uv_mutex_unlock(&mutex);
+      return false;
+    }
+
+    if(is_waiting_for_keyframe) {
+      if(flv->flv_header.has_video && (tag->type != FLV_TAG_VIDEO || !tag->is_keyframe)) {
+        num_dropped++;
+        uv_mutex_unlock(&mutex);
+        return false;
+      }
+      is_waiting_for_keyframe = false;
+
+      if(must_rebase) {
+        timestamp_offset = tag->timestamp;
+        must_rebase = false;
+      }
+    }
+  }
+
+  flv->retainTag(tag);
+  tags.push_back(tag);
+  uv_cond_signal(&cond);
+  uv_mutex_unlock(&mutex);
+  return true;
+}
+
+void FLVOutput::run() {
+  while(true) {
+
+    FLVTag* tag = NULL;
+    uv_mutex_lock(&mutex);
+    {
+      while(tags.empty() && !must_stop) {
+        uv_cond_wait(&cond, &mutex);
+      }
+      if(!tags.empty()) {
+        tag = tags.front();
+        tags.pop_front();
+      }
+    }
+    uv_mutex_unlock(&mutex);
+
+    if(!tag) {
+      break; // stopped and written everything
+    }
+
+    write(tag);
+    flv->releaseTag(tag);
+  }
+}
+
+void FLVOutput::stop() {
+  uv_mutex_lock(&mutex);
+  must_stop = true;
+  uv_cond_signal(&cond);
+  uv_mutex_unlock(&mutex);
+
+  uv_thread_join(&thread);
+}
+
+void FLVOutput::write(FLVTag* tag) {
+  if(!tag->data.size()) {
+    return;
+  }
+
+  char* data = &tag->data[0];
+  size_t nbytes = tag->data.size();
+  rx_uint32 ts = 0;
+
+  if(tag->type != FLV_TAG_NONE) {
+
+    ts = (tag->timestamp > timestamp_offset) ? (tag->timestamp - timestamp_offset) : 0;
+
+    // the tag data is shared with the other outputs so we patch a copy
+    if(timestamp_offset && nbytes >= FLV_TAG_HEADER_SIZE) {
+      rebased.assign(tag->data.begin(), tag->data.end());
+      rebased[4] = (ts >> 16);
+      rebased[5] = (ts >> 8);
+      rebased[6] = ts;
+      rebased[7] = (ts >> 24);
+      data = &rebased[0];
+    }
+  }
+
+  size_t written = cb_write(data, nbytes, cb_user);
+  bytes_flushed += written;
+
+  if(written >= nbytes) {
+    if(tag->type == FLV_TAG_VIDEO) {
+      last_video_timestamp = ts;
+      total_num_frames++;
+    }
+    return;
+  }
+
+  // the tag didn't make it (completely) so the next video tags can't be decoded; 
+  // like push() we drop the queued tags until the next keyframe.
+  uv_mutex_lock(&mutex);
+  {
+    num_dropped++;
+    bool has_keyframe = false;
+
+    if(flv->flv_header.has_video) {
+      std::deque<FLVTag*>::iterator it = tags.begin();
+      while(it != tags.end()) {
+        FLVTag* queued = *it;
+        if(queued->type == FLV_TAG_VIDEO && queued->is_keyframe) {
+          has_keyframe = true;
+          break;
+        }
+        if(queued->type == FLV_TAG_NONE) {
+          ++it;
+          continue;
+        }
+        it = tags.erase(it);
+        flv->releaseTag(queued);
+        num_dropped++;
+      }
+    }
+
+    // no keyframe queued yet, so push() has to skip the next tags
+    if(!has_keyframe) {
+      is_waiting_for_keyframe = true;
+    }
+  }
+  uv_mutex_unlock(&mutex);
+}
+
+// -------------------------------------------------------------------------
+
+FLVMemoryWriter::FLVMemoryWriter(size_t capacity) 
+  :buffer(capacity)
+  ,is_closed(false)
+{
+  uv_mutex_init(&mutex);
+}
+
+FLVMemoryWriter::~FLVMemoryWriter() {
+  uv_mutex_destroy(&mutex);
+}
+
+size_t FLVMemoryWriter::write(char* data, size_t nbytes) {
+  uv_mutex_lock(&mutex);
+  if((buffer.getCapacity() - buffer.size()) < nbytes) {
+    uv_mutex_unlock(&mutex);
+    RX_WARNING(ERR_FLV_MEMORY_FULL, nbytes);
+    return 0;
+  }
+  size_t n = buffer.write(data, nbytes);
+  uv_mutex_unlock(&mutex);
+  return n;
+}
+
+size_t FLVMemoryWriter::read(char* data, size_t nbytes) {
+  uv_mutex_lock(&mutex);
+  size_t n = buffer.read(data, nbytes);
+  uv_mutex_unlock(&mutex);
+  return n;
+}
+
+size_t FLVMemoryWriter::size() {
+  uv_mutex_lock(&mutex);
+  size_t n = buffer.size();
+  uv_mutex_unlock(&mutex);
+  return n;
+}
+
+size_t flv_memory_write(char* data, size_t nbytes, void* user) {
+  FLVMemoryWriter* m = static_cast<FLVMemoryWriter*>(user);
+  return m->write(data, nbytes);
+}
+
+void flv_memory_close(void* user) {
+  FLVMemoryWriter* m = static_cast<FLVMemoryWriter*>(user);
+  uv_mutex_lock(&m->mutex);
+  m->is_closed = true;
+  uv_mutex_unlock(&m->mutex);
+}
+
+// -------------------------------------------------------------------------
+
 size_t flv_file_write(char* data, size_t nbytes, void* user) {
   if(nbytes <= 0) {
     return 0;
@@ -1,5 +1,7 @@
 #include <flv/FLVScreenRecorder.h>
 
+#if defined(ROXLU_WITH_OPENGL)
+
 // @todo we probably want a bigger distance between the read and write  - tested quickly didnt see a difference
 // @todo check if we need to call AV::waitForEncodingThreadToFinish();
 // PBO indices.
@@ -200,3 +202,5 @@ void FLVScreenRecorderSettings::reset() {
   audio_max_samples = 0;
   audio_format = AV_FMT_INT16;
 }
+
+#endif /* ROXLU_WITH_OPENGL */
@@ -11,10 +11,14 @@ extern "C" {
 #include <http/HTTPRequest.h>
 #include <http/HTTPParameters.h>
 #include <http/HTTPParameter.h>
+#include <http/HTTPDNSCache.h>
+
+#define HTTP_DEFAULT_IDLE_TIMEOUT 30000                 /* close keep-alive connections which weren't used for this many millis */
+#define HTTP_DEFAULT_MAX_PIPELINE_DEPTH 1               /* by default we don't pipeline requests */
 
 //-------------------------------------------------------------------------------
 
-void http_on_connection_event(HTTPConnection* c, HTTPConnectionEvent event, char* data, size_t len, void* user);
+void http_on_connection_event(HTTPConnection* c, HTTPConnectionEvent event, const char* data, size_t len, void* user);
 
 //-------------------------------------------------------------------------------
 
@@ -24,12 +28,48 @@ class HTTP {
   ~HTTP();
 
   bool update();                                                                                                         /* call this as often as possible; it will make sure all data is transferred */
-  HTTPConnection* sendRequest(HTTPRequest& r, httpconnection_event_callback eventCB = NULL, void* user = NULL, SSL* ssl = NULL); /* create a new request, when SSL is not NULL, the request will make use of SSL to encrypt the transfer. the callback function is called when we received data from the remove server, user is passed into this function then.  */
+  HTTPConnection* sendRequest(HTTPRequest& r, httpconnection_event_callback eventCB = NULL, void* user = NULL, SSL* ssl = NULL, HTTPBody* body = NULL); /* create a new request, when SSL is not NULL, the request will make use of SSL to encrypt the transfer. the callback function is called when we received data from the remove server, user is passed into this function then. When we reuse a keep-alive connection the `ssl` object is freed. When `body` is given we stream it (and take ownership); a body with an unknown size is sent with chunked transfer encoding. */
   bool removeConnection(HTTPConnection* c);                                                                              /* delete and removes the connection */
+  void setKeepAlive(bool enable);                                                                                        /* reuse connections for requests to the same host (default: true) */
+  void setIdleTimeout(uint64_t millis);                                                                                  /* close keep-alive connections which were idle for this long */
+  void setMaxPipelineDepth(size_t depth);                                                                                /* max number of GET requests that may be sent on one connection before their responses arrived; 1 disables pipelining */
+  void setSSLContext(SSLContext* ctx);                                                                                   /* when set we resume TLS sessions and can retry secure requests when a reused connection was closed by the server */
+  void closeIdleConnections(bool all = false);                                                                           /* closes the keep-alive connections which passed the idle timeout (or all idle ones) */
+  HTTPDNSCache& getDNSCache();                                                                                           /* the dns cache, e.g. to change the ttl */
+  void retryRequests(HTTPConnection* c);                                                                                 /* used internally; when the server closed a reused connection before answering, we resend the idempotent requests on a new connection */
+
+ private:
+  HTTPConnection* createConnection(std::string host, std::string port, SSL* ssl);                                        /* create a connection which uses our caches */
+  HTTPConnection* findConnection(std::string host, std::string port, bool secure, bool idempotent);                     /* find a connection that can be reused */
 
  public:
   uv_loop_t* loop;
   std::vector<HTTPConnection*> connections;
+  HTTPDNSCache dns_cache;
+  SSLContext* ssl_context;
+  bool keep_alive;
+  uint64_t idle_timeout;
+  size_t max_pipeline_depth;
 };
 
+inline void HTTP::setKeepAlive(bool enable) {
+  keep_alive = enable;
+}
+
+inline void HTTP::setIdleTimeout(uint64_t millis) {
+  idle_timeout = millis;
+}
+
+inline void HTTP::setMaxPipelineDepth(size_t depth) {
+  max_pipeline_depth = (depth) ? depth : 1;
+}
+
+inline void HTTP::setSSLContext(SSLContext* ctx) {
+  ssl_context = ctx;
+}
+
+inline HTTPDNSCache& HTTP::getDNSCache() {
+  return dns_cache;
+}
+
 #endif
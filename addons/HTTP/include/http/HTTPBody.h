@@ -0,0 +1,94 @@
+/*
+
+ # HTTPBody
+
+ Pull based request bodies. Instead of building one big string which contains the
+ headers and the complete body (which means loading every uploaded file into memory),
+ the `HTTPConnection` asks the body for the next chunk of data whenever the amount
+ of queued + in-flight output drops below `HTTP_MAX_OUTPUT_BYTES`. This keeps the
+ memory usage of an upload bounded, no matter how big the file is.
+
+ - `HTTPBodyString`: body from memory (url encoded forms, setBody()).
+ - `HTTPBodyFile`: reads a file in chunks; the file is opened on the first read().
+ - `HTTPBodyParts`: a sequence of other bodies; used for multipart/form-data where
+   the boundaries are strings and the file contents are `HTTPBodyFile`s.
+
+ When `getSize()` returns `HTTP_BODY_SIZE_UNKNOWN` we use `Transfer-Encoding: chunked`
+ (HTTP/1.1 only). `rewind()` is used when we need to resend a request on a new
+ connection.
+
+ */
+#ifndef ROXLU_HTTP_BODY_H
+#define ROXLU_HTTP_BODY_H
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#define HTTP_BODY_SIZE_UNKNOWN -1                                     /* getSize() returns this when we don't know the size up front; we use chunked transfer encoding then */
+#define HTTP_BODY_CHUNK_SIZE (64 * 1024)                              /* the number of bytes we read from a body at once */
+#define HTTP_MAX_OUTPUT_BYTES (256 * 1024)                            /* we stop reading from the body when this number of bytes is queued or in flight */
+
+#define HTTP_BODY_ERR_FILE_OPEN "Cannot open the body file: %s"
+#define HTTP_BODY_ERR_FILE_READ "Error while reading the body file: %s"
+
+//-------------------------------------------------------------------------------
+
+class HTTPBody {
+ public:
+  virtual ~HTTPBody();
+  virtual size_t read(char* dest, size_t nbytes) = 0;                /* copy at most nbytes into dest; returns the number of copied bytes, 0 means we're ready */
+  virtual int64_t getSize() = 0;                                     /* total number of bytes, or HTTP_BODY_SIZE_UNKNOWN */
+  virtual bool rewind() = 0;                                         /* start reading from the beginning again */
+};
+
+//-------------------------------------------------------------------------------
+
+class HTTPBodyString : public HTTPBody {
+ public:
+  HTTPBodyString(const std::string& data);
+  size_t read(char* dest, size_t nbytes);
+  int64_t getSize();
+  bool rewind();
+
+ public:
+  std::string data;
+  size_t read_dx;                                                    /* the next byte we return */
+};
+
+//-------------------------------------------------------------------------------
+
+class HTTPBodyFile : public HTTPBody {
+ public:
+  HTTPBodyFile(const std::string& filepath);
+  ~HTTPBodyFile();
+  size_t read(char* dest, size_t nbytes);
+  int64_t getSize();
+  bool rewind();
+
+ public:
+  std::string filepath;
+  FILE* fp;                                                          /* opened on the first read() */
+  int64_t size;                                                      /* file size, retrieved in the constructor */
+};
+
+//-------------------------------------------------------------------------------
+
+class HTTPBodyParts : public HTTPBody {
+ public:
+  HTTPBodyParts();
+  ~HTTPBodyParts();
+  void add(HTTPBody* part);                                          /* append a part; we take ownership */
+  void add(const std::string& data);                                 /* append a string part; consecutive strings are merged */
+  size_t read(char* dest, size_t nbytes);
+  int64_t getSize();
+  bool rewind();
+
+ public:
+  std::vector<HTTPBody*> parts;
+  HTTPBodyString* last_string;                                       /* when the last part is a string we append new strings to it */
+  size_t part_dx;                                                    /* the part we're reading from */
+};
+
+#endif
@@ -23,6 +23,7 @@ class HTTPBufferBase {
   virtual void update() = 0;
   virtual void flushInputBuffer() = 0;
   virtual void flushOutputBuffer() = 0;
+  virtual size_t getOutputSize() = 0;                                /* number of bytes which are added to the output buffer but not yet flushed */
   
  public:
   size_t read_dx;
@@ -42,16 +43,20 @@ class HTTPBuffer : public HTTPBufferBase {
   void addToOutputBuffer(const char* buf, size_t len);  
   void flushInputBuffer();
   void flushOutputBuffer();
+  size_t getOutputSize();
   void update();
 
  public:
-  std::vector<char> data_in;
   std::vector<char> data_out;
 };
 
 inline void HTTPBuffer::update() {
 }
 
+inline size_t HTTPBuffer::getOutputSize() {
+  return data_out.size();
+}
+
 
 //-------------------------------------------------------------------------------
 void httpbufferssl_on_decrypted_data(const char* data, size_t len, void* user);
@@ -66,11 +71,15 @@ class HTTPBufferSSL : public HTTPBufferBase {
   void addToOutputBuffer(const char* buf, size_t len);  
   void flushInputBuffer();
   void flushOutputBuffer();
+  size_t getOutputSize();
   void update();
 
  public:
   SSLBuffer data;
   std::vector<char> encrypted_data;
-  std::vector<char> decrypted_data;
 };
+
+inline size_t HTTPBufferSSL::getOutputSize() {
+  return data.raw_data.size() + encrypted_data.size();
+}
 #endif
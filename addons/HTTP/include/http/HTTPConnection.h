@@ -11,6 +11,19 @@
  makes using this class very easy; and the couple of extra CPU cycles are neglectible
  on most modern pc's. 
 
+ A connection can be reused for multiple requests (keep-alive). Requests are queued
+ in `requests`; the front request is the one for which we're parsing the response. 
+ Responses arrive in the same order as the requests were written, so when pipelining
+ is used we simply pop the front request when its response has been parsed.
+
+ Request bodies are pulled from a `HTTPBody` in chunks of `HTTP_BODY_CHUNK_SIZE`. We 
+ only read the next chunk when less then `HTTP_MAX_OUTPUT_BYTES` are queued in the 
+ buffer or in flight (see `bytes_in_flight`), so uploading a big file doesn't load it 
+ into memory. When the size of a body is unknown we use chunked transfer encoding.
+ Response bodies are handed to the event callback (HTTP_ON_BODY) as soon as the 
+ parser gives them to us; chunked responses are de-chunked by the parser so you 
+ only get the payload; nothing is accumulated.
+
  */
 
 #ifndef ROXLU_HTTP_CONNECTION_H
@@ -20,10 +33,15 @@ extern "C" {
 #  include <uv.h>
 }
 
+#include <deque>
 #include <ssl/SSLContext.h>
 #include <http/http_parser.h>
+#include <http/HTTPDNSCache.h>
 #include <http/HTTPRequest.h>
 #include <http/HTTPBuffer.h>
+#include <http/HTTPBody.h>
+
+#define HTTP_READ_BUFFER_SIZE (64 * 1024)                                                                                           /* size of the buffer we use for uv_read; it's reused for every read */
 
 // http_parser callback;
 //-------------------------------------------------------------------------------
@@ -54,15 +72,52 @@ void httpconnection_on_flush_output_buffer(const char* data, size_t len, void* u
 //-------------------------------------------------------------------------------
 
 class HTTPConnection;
+
+struct HTTPWriteRequest {                                                                                                           /* a uv_write_t with a copy of the data we write */
+  uv_write_t req;
+  char* data;
+  size_t nbytes;
+  HTTPConnection* c;
+};
+
 typedef void(*httpconnection_event_callback)(HTTPConnection* c, HTTPConnectionEvent event, const char* data, size_t len, void* user);
 //-------------------------------------------------------------------------------
 
+struct HTTPConnectionRequest {                                                                                                      /* a request which is queued or sent on a connection */
+  HTTPConnectionRequest();
+  std::string data;                                                                                                                 /* the request line and headers; we keep it so we can resend it when the server closed a reused connection */
+  HTTPBody* body;                                                                                                                   /* the body which is streamed after `data`; owned by the connection, can be NULL */
+  httpconnection_event_callback cb_event;                                                                                           /* the event callback for this request */
+  void* cb_event_user;                                                                                                              /* passed into cb_event */
+  HTTPTimings timings;                                                                                                              /* timing information */
+  bool is_header_sent;                                                                                                              /* true when `data` has been added to the output buffer */
+  bool is_sent;                                                                                                                     /* true when the headers and the complete body have been added to the output buffer */
+  bool is_chunked;                                                                                                                  /* true when we use chunked transfer encoding for the body */
+  bool is_idempotent;                                                                                                               /* true for GET requests; only these are pipelined or retried */
+  bool is_complete;                                                                                                                 /* true when we received the complete response; these are never resent */
+};
+
+//-------------------------------------------------------------------------------
+
 class HTTPConnection {
 
  public:
   HTTPConnection(uv_loop_t* loop, std::string host, std::string port, SSL* ssl = NULL);
   ~HTTPConnection();
   bool connect(httpconnection_event_callback eventCB, void* eventUser);        /* connect to the set host/port and send the output buffer when connected. When something happens we call the given callback (`cb`) and pass the user param */
+  void addRequest(const std::string& data,                                                                                          /* queue a request; when we're connected it's written directly, otherwise when we're connected */
+                  HTTPBody* body,                                                                                                   /* the body that is streamed after the headers; we take ownership, can be NULL */
+                  httpconnection_event_callback eventCB, 
+                  void* eventUser, 
+                  bool isIdempotent,
+                  uint64_t startTime);
+  void writeRequests();                                                                                                             /* writes all queued requests which haven't been sent yet */
+  bool writeBody(HTTPConnectionRequest& req);                                                                                       /* adds the next chunks of the body to the output buffer; returns true when the complete body has been added */
+  void notifyClosed();                                                                                                              /* calls the event callback of all queued requests with HTTP_ON_CLOSED and clears the queue */
+  bool isIdle();                                                                                                                    /* returns true when this connection can be reused for a new request right away */
+  bool canPipeline();                                                                                                               /* returns true when all queued requests are idempotent so we can pipeline another one */
+  std::string getKey();                                                                                                             /* returns host:port; used for the dns and ssl session caches */
+  HTTPTimings& getTimings();                                                                                                        /* timings of the request for which we're currently handling events */
   void addToOutputBuffer(const char* data, size_t len);                                                                             /* users use addToOutputBuffer to add data to the out queue, internally we use send() */
   void addToOutputBuffer(const std::string str);                                                                                    /* users use addToOutputBuffer to add data to the out queue, internally we use send() */
   void addToInputBuffer(const char* data, size_t len);                                                                              /* whenever we receive data on the socket it will be added to this output buffer (this might be SSL encrypted data) */
@@ -83,13 +138,56 @@ class HTTPConnection {
   uv_connect_t connect_req;                                                                                                         /* used when connecting to the server */
   uv_shutdown_t shutdown_req;                                                                                                       /* used when we request the socket to shutdown */
   uv_tcp_t* sock;                                                                                                                   /* the cross platform socket wrapper */
-  uv_write_t write_req;                                                                                                             /* write request; used when writing data over the socket */
   http_parser parser;                                                                                                               /* joyents excellent http parser */
   http_parser_settings parser_settings;                                                                                             /* struct with info/callback data for the http_parser */
   httpconnection_event_callback cb_event;                                                                                           /* gets called when something happens with the connection (e.g. disconnected) */
   httpconnection_event_callback cb_close;                                                                                           /* gets called when the connection closes (cb_event is called too) */          
   void* cb_event_user;                                                                                                              /* is passed into the event handler */       
   void* cb_close_user;                                                                                                              /* is passed into the close handler */
+
+  std::deque<HTTPConnectionRequest> requests;                                                                                       /* queued requests; the front one is the request for which we parse the response */
+  HTTPTimings last_timings;                                                                                                         /* timings of the last completed request */
+  HTTPDNSCache* dns_cache;                                                                                                          /* when set we use/fill this cache when connecting */
+  SSLContext* ssl_context;                                                                                                          /* when set we resume/store TLS sessions using this context */
+  bool is_connected;                                                                                                                /* true when the tcp connection is established */
+  bool is_closing;                                                                                                                  /* true when we're shutting down/closing */
+  bool is_tls_ready;                                                                                                                /* true when the SSL handshake finished */
+  bool in_response;                                                                                                                 /* true while parsing a response */
+  bool keep_alive;                                                                                                                  /* false when the server (or http version) doesn't allow us to reuse the connection */
+  size_t num_completed;                                                                                                             /* number of responses we've parsed on this connection */
+  uint64_t idle_since;                                                                                                              /* uv_now() when the last request completed */
+  size_t bytes_in_flight;                                                                                                           /* number of bytes passed to uv_write() for which we didn't get the write callback yet */
+  char* body_buffer;                                                                                                                /* HTTP_BODY_CHUNK_SIZE bytes we use to read from a body; allocated on first use */
+  char read_buffer[HTTP_READ_BUFFER_SIZE];                                                                                          /* used for all reads on the socket */
 };
 
+inline std::string HTTPConnection::getKey() {
+  return host + ":" + port;
+}
+
+inline bool HTTPConnection::isIdle() {
+  return is_connected && !is_closing && keep_alive && requests.empty();
+}
+
+inline bool HTTPConnection::canPipeline() {
+  if(is_closing || !keep_alive) {
+    return false;
+  }
+
+  for(std::deque<HTTPConnectionRequest>::iterator it = requests.begin(); it != requests.end(); ++it) {
+    if(!(*it).is_idempotent) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+inline HTTPTimings& HTTPConnection::getTimings() {
+  if(requests.size()) {
+    return requests.front().timings;
+  }
+  return last_timings;
+}
+
 #endif
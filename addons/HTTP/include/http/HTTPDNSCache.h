@@ -0,0 +1,52 @@
+/*
+
+ # HTTPDNSCache
+
+ Caches the results of `uv_getaddrinfo()` per host:port so new connections to 
+ a host we've seen before can connect directly. `getaddrinfo()` doesn't give us 
+ the TTL of the records, so we use a fixed time to live which you can set with 
+ `setTTL()`.
+
+ */
+#ifndef ROXLU_HTTP_DNS_CACHE_H
+#define ROXLU_HTTP_DNS_CACHE_H
+
+extern "C" {
+#  include <uv.h>
+}
+
+#include <map>
+#include <string>
+#include <stdint.h>
+
+#define HTTP_DNS_DEFAULT_TTL (5 * 60 * 1000)                                     /* default time to live of a cached entry, in millis */
+
+struct HTTPDNSEntry {
+  struct sockaddr_in addr;
+  uint64_t expires;                                                             /* uv_now() based timestamp when this entry is no longer valid */
+};
+
+class HTTPDNSCache {
+ public:
+  HTTPDNSCache();
+  ~HTTPDNSCache();
+  bool find(uv_loop_t* loop, const std::string& host, const std::string& port, struct sockaddr_in& result);  /* returns true when we have a valid entry */
+  void add(uv_loop_t* loop, const std::string& host, const std::string& port, const struct sockaddr_in& addr); /* cache the given address */
+  void remove(const std::string& host, const std::string& port);               /* e.g. when we couldn't connect to a cached address */
+  void clear();
+  void setTTL(uint64_t millis);
+
+ public:
+  uint64_t ttl;
+  std::map<std::string, HTTPDNSEntry> entries;
+};
+
+inline void HTTPDNSCache::setTTL(uint64_t millis) {
+  ttl = millis;
+}
+
+inline void HTTPDNSCache::clear() {
+  entries.clear();
+}
+
+#endif
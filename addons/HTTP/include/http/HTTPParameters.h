@@ -13,6 +13,7 @@ extern "C" {
 #include <roxlu/core/Log.h>
 #include <crypto/PercentEncode.h>
 #include <http/HTTPParameter.h>
+#include <http/HTTPBody.h>
 
 //-------------------------------------------------------------------------------
 
@@ -54,6 +55,8 @@ class HTTPParameters {
   std::string getQueryString();                                                        /* create a name=value&name=value string */
   bool toBoundaryString(std::string boundary, std::string& result);                    /* create a string that can be used in a post */
   bool toBoundaryString(HTTPParameter& p, std::string boundary, std::string& result);  /* append the parameter to the result for a multipart form post */
+  bool toBoundaryBody(std::string boundary, HTTPBodyParts& result);                    /* same as toBoundaryString() but files are streamed from disk instead of loaded into memory */
+  std::string getFileHeader(HTTPParameter& p, HTTPFile& f, std::string boundary);     /* returns the part header for a file in a multipart form post */
   HTTPParameter& operator[](const std::string name);                                   /* return the element by reference, when the entry isn't found it's created on the fly */
 
  public:
@@ -7,6 +7,7 @@
 #include <http/HTTPParameter.h>
 #include <http/HTTPParameters.h>
 #include <http/HTTPURL.h>
+#include <http/HTTPBody.h>
 
 class HTTPRequest {
 
@@ -19,11 +20,14 @@ class HTTPRequest {
   void addContentParameter(HTTPParameter p);                         /* add a parameter that will be added into the content of the request (multipart/form-data, or url encoded) */
   void addContentParameters(HTTPParameters& p);                      /* "" */
   void setBody(std::string data);                                /* set the contents of the request body */
+  void setBodyFile(std::string filepath);                            /* use the contents of this file as request body; it's streamed from disk when sending */
   void setURL(HTTPURL url);                                          /* set the url object */
   void setMethod(HTTPMethod method);                                 /* POST, GET, .. */
   void setVersion(HTTPVersion version);                              /* what proto version 1.1 or 1.0 */
   bool toString(std::string& result);                                /* converts the request into a string that can be sent to a http server */
   bool createBody(std::string& result);                              /* generates the contents of the request (which is put after the headers) */
+  HTTPBody* createBodySource();                                      /* creates a pull based body which is read in chunks while sending; returns NULL when there is no body, the caller owns the result */
+  bool toHeaderString(HTTPBody* body, std::string& result);          /* creates the request line + headers; uses the size of `body` for the Content-Length or Transfer-Encoding header */
   void addDefaultHTTPHeaders();                                      /* adds the GET or POST header and the form encoding type if necessary */
 
   std::string getHTTPString();                                       /* returns the first line for the request */
@@ -47,6 +51,7 @@ class HTTPRequest {
   HTTPFormEncoding form_encoding;                                   /* the form encoding in case of an post; if not set we detect it ourself */
   std::string boundary;                                             /* used as boundary string in multipart/form-data */
   std::string body;                                                 /* the body of the request */
+  std::string body_file;                                            /* when set, the contents of this file is streamed as the body */
 };
 
 inline void HTTPRequest::setURL(HTTPURL u) {
@@ -65,6 +70,10 @@ inline void HTTPRequest::setBody(std::string data) {
   body = data;
 }
 
+inline void HTTPRequest::setBodyFile(std::string filepath) {
+  body_file = filepath;
+}
+
 inline HTTPURL& HTTPRequest::getURL() {
   return url;
 }
@@ -2,6 +2,7 @@
 #define ROXLU_HTTP_TYPES_H
 
 #include <string>
+#include <stdint.h>
 
 enum HTTPMethod {
   HTTP_METHOD_GET,
@@ -44,6 +45,50 @@ enum HTTPConnectionEvent {
   HTTP_ON_COMPLETE,                                               /* when parsing has completed */
 };
 
+// Timing information for a request; all values are nanoseconds (uv_hrtime()), 
+// a value of 0 means that this stage didn't happen (e.g. dns for a cached address 
+// or dns/connect/tls for a request on a reused keep-alive connection).
+struct HTTPTimings {
+  HTTPTimings();
+  void reset();
+  uint64_t getDNSTime();                                          /* time spent resolving the host */
+  uint64_t getConnectTime();                                      /* time spent on the tcp connect */
+  uint64_t getTLSTime();                                          /* time spent on the SSL handshake */
+  uint64_t getTimeToFirstByte();                                  /* time between sending the request and the first response byte */
+  uint64_t getTotalTime();                                        /* time between sendRequest() and the complete response */
+
+  uint64_t start;                                                 /* when sendRequest() was called */
+  uint64_t dns_start;
+  uint64_t dns_end;
+  uint64_t connect_start;
+  uint64_t connect_end;
+  uint64_t tls_start;
+  uint64_t tls_end;
+  uint64_t sent;                                                  /* when the request was written to the socket */
+  uint64_t first_byte;                                            /* when we started parsing the response */
+  uint64_t complete;                                              /* when we parsed the complete response */
+};
+
+inline uint64_t HTTPTimings::getDNSTime() {
+  return (dns_end > dns_start) ? dns_end - dns_start : 0;
+}
+
+inline uint64_t HTTPTimings::getConnectTime() {
+  return (connect_end > connect_start) ? connect_end - connect_start : 0;
+}
+
+inline uint64_t HTTPTimings::getTLSTime() {
+  return (tls_end > tls_start) ? tls_end - tls_start : 0;
+}
+
+inline uint64_t HTTPTimings::getTimeToFirstByte() {
+  return (first_byte > sent && sent) ? first_byte - sent : 0;
+}
+
+inline uint64_t HTTPTimings::getTotalTime() {
+  return (complete > start) ? complete - start : 0;
+}
+
 // Used by the HTTPParameter 
 struct HTTPFile {
   HTTPFile();
@@ -9,6 +9,7 @@ extern "C" {
 }
 
 #include <string>
+#include <map>
 
 #define SSLCONTEXT_WHERE_INFO(ssl, w, flag, msg) {  \
     if(w & flag) {                                  \
@@ -32,9 +33,13 @@ class SSLContext {
   SSLContext();
   ~SSLContext();
   SSL* allocateSSL();                                                    /* caller is responsible for managing memory! */
+  bool resumeSession(SSL* ssl, const std::string& key);                  /* set a previously stored session (see storeSession()) on `ssl` so the handshake can be abbreviated; returns false when we have no session for `key` */
+  void storeSession(SSL* ssl, const std::string& key);                   /* store the session of `ssl` (call this after the handshake) for the given key (e.g. host:port) */
+  void removeSession(const std::string& key);                            /* remove a stored session */
 
  public:
   SSL_CTX* ssl_ctx;
+  std::map<std::string, SSL_SESSION*> sessions;                          /* sessions that can be resumed, per host:port */
 };
 
 inline SSL* SSLContext::allocateSSL() {
@@ -5,6 +5,8 @@
 
 void http_on_connection_event(HTTPConnection* c, HTTPConnectionEvent event, const char* data, size_t len, void* user) {
   HTTP* h = static_cast<HTTP*>(user);
+  h->retryRequests(c);
+  c->notifyClosed();
   h->removeConnection(c);
 }
 
@@ -12,6 +14,10 @@ void http_on_connection_event(HTTPConnection* c, HTTPConnectionEvent event, cons
 
 HTTP::HTTP() 
   :loop(NULL)
+  ,ssl_context(NULL)
+  ,keep_alive(true)
+  ,idle_timeout(HTTP_DEFAULT_IDLE_TIMEOUT)
+  ,max_pipeline_depth(HTTP_DEFAULT_MAX_PIPELINE_DEPTH)
 {
 
   loop = uv_loop_new();
@@ -34,6 +40,8 @@ HTTP::~HTTP() {
     uv_loop_delete(loop);
     loop = NULL;
   }
+
+  ssl_context = NULL;
 }
 
 bool HTTP::update() {
@@ -43,7 +51,18 @@ bool HTTP::update() {
     return false;
   }
 
-  uv_run(loop,UV_RUN_ONCE);
+  closeIdleConnections();
+
+  // idle keep-alive sockets would make UV_RUN_ONCE block, so only block when we're waiting for responses
+  bool is_busy = false;
+  for(std::vector<HTTPConnection*>::iterator it = connections.begin(); it != connections.end(); ++it) {
+    if((*it)->requests.size()) {
+      is_busy = true;
+      break;
+    }
+  }
+
+  uv_run(loop, (is_busy) ? UV_RUN_ONCE : UV_RUN_NOWAIT);
 
   return true;
 }
@@ -51,24 +70,59 @@ bool HTTP::update() {
 HTTPConnection* HTTP::sendRequest(HTTPRequest& r,                           /* the request that we will sent */
                                   httpconnection_event_callback eventCB,    /* this function gets called when we receive data, see HTTPConnection.h */
                                   void* user,                               /* the user pointer that gets passed into `eventCB` */
-                                  SSL* ssl)                                 /* pass a SSL* when you want to make a secure connection */
+                                  SSL* ssl,                                 /* pass a SSL* when you want to make a secure connection */
+                                  HTTPBody* body)                           /* pass a body when you want to stream it instead of using the body/parameters of the request; we take ownership */
 {
+  uint64_t start = uv_hrtime();
+
+  // HTTP/1.1 is persistent by default, 1.0 is not.
+  if(keep_alive && r.getVersion() == HTTP_VERSION_1_0) {
+    r.addHeader(HTTPHeader("Connection", "keep-alive"));
+  }
+  else if(!keep_alive && r.getVersion() == HTTP_VERSION_1_1) {
+    r.addHeader(HTTPHeader("Connection", "close"));
+  }
+
+  // create the headers; the body is read in chunks while sending
+  if(!body) {
+    body = r.createBodySource();
+  }
 
-  // create request string.
   std::string request_str;
-  if(!r.toString(request_str)) {
+  if(!r.toHeaderString(body, request_str)) {
     RX_ERROR("Cannot create request string");
+    if(body) {
+      delete body;
+    }
     return NULL;
   }
 
+  bool is_idempotent = (r.getMethod() == HTTP_METHOD_GET);
+  std::string host = r.getURL().getHost();
+  std::string port = r.getURL().getPort();
+
+  // reuse a connection when possible
+  if(keep_alive) {
+    HTTPConnection* c = findConnection(host, port, (ssl != NULL), is_idempotent);
+    if(c) {
+      if(ssl) {
+        SSL_free(ssl); /* we use the SSL object of the connection */
+        ssl = NULL;
+      }
+      c->addRequest(request_str, body, eventCB, user, is_idempotent, start);
+      return c;
+    }
+  }
+
   // create connection
-  HTTPConnection* c = new HTTPConnection(loop, r.getURL().getHost(), r.getURL().getPort(), ssl);
-  c->cb_close = http_on_connection_event;
-  c->cb_close_user = this;
-  c->addToOutputBuffer(request_str);
-  c->connect(eventCB, user);
+  HTTPConnection* c = createConnection(host, port, ssl);
+  c->keep_alive = keep_alive;
+  c->addRequest(request_str, body, eventCB, user, is_idempotent, start);
+
+  if(!c->connect(eventCB, user)) {
+    RX_ERROR("Cannot connect to: %s", c->getKey().c_str());
+  }
 
-  connections.push_back(c);
   return c;
 }
 
@@ -82,3 +136,103 @@ bool HTTP::removeConnection(HTTPConnection* c) {
   delete c;
   return true;
 }
+
+void HTTP::closeIdleConnections(bool all) {
+  uv_update_time(loop);
+  uint64_t now = uv_now(loop);
+
+  for(std::vector<HTTPConnection*>::iterator it = connections.begin(); it != connections.end(); ++it) {
+    HTTPConnection* c = *it;
+    if(!c->isIdle()) {
+      continue;
+    }
+    if(all || (now - c->idle_since) >= idle_timeout) {
+      c->close();
+    }
+  }
+}
+
+HTTPConnection* HTTP::createConnection(std::string host, std::string port, SSL* ssl) {
+  HTTPConnection* c = new HTTPConnection(loop, host, port, ssl);
+  c->cb_close = http_on_connection_event;
+  c->cb_close_user = this;
+  c->dns_cache = &dns_cache;
+  c->ssl_context = ssl_context;
+  connections.push_back(c);
+  return c;
+}
+
+HTTPConnection* HTTP::findConnection(std::string host, std::string port, bool secure, bool idempotent) {
+  HTTPConnection* pipeline = NULL;
+
+  for(std::vector<HTTPConnection*>::iterator it = connections.begin(); it != connections.end(); ++it) {
+    HTTPConnection* c = *it;
+
+    if(c->host != host || c->port != port || (c->ssl != NULL) != secure) {
+      continue;
+    }
+
+    if(c->isIdle()) {
+      return c;
+    }
+
+    // pipeline on the connection with the shortest queue
+    if(idempotent 
+       && max_pipeline_depth > 1
+       && c->requests.size() < max_pipeline_depth
+       && c->canPipeline()
+       && (!pipeline || c->requests.size() < pipeline->requests.size()))
+      {
+        pipeline = c;
+      }
+  }
+
+  return pipeline;
+}
+
+void HTTP::retryRequests(HTTPConnection* c) {
+
+  // only when the server closed a connection we reused
+  if(!c->num_completed || !c->requests.size()) {
+    return;
+  }
+
+  std::deque<HTTPConnectionRequest> pending;
+  std::deque<HTTPConnectionRequest> retry;
+
+  for(size_t i = 0; i < c->requests.size(); ++i) {
+    HTTPConnectionRequest& req = c->requests[i];
+    bool got_response = req.is_complete || (i == 0 && c->in_response);
+    bool can_retry = req.is_idempotent && !got_response && (!c->ssl || ssl_context);
+    if(can_retry) {
+      retry.push_back(req);
+    }
+    else {
+      pending.push_back(req);
+    }
+  }
+
+  c->requests.swap(pending);
+
+  if(!retry.size()) {
+    return;
+  }
+
+  RX_VERBOSE("Server closed a reused connection, resending %ld request(s)", retry.size());
+
+  SSL* ssl = (c->ssl) ? ssl_context->allocateSSL() : NULL;
+  HTTPConnection* nc = createConnection(c->host, c->port, ssl);
+  nc->keep_alive = keep_alive;
+
+  for(std::deque<HTTPConnectionRequest>::iterator it = retry.begin(); it != retry.end(); ++it) {
+    HTTPConnectionRequest& req = *it;
+    if(req.body) {
+      req.body->rewind();
+    }
+    nc->addRequest(req.data, req.body, req.cb_event, req.cb_event_user, req.is_idempotent, req.timings.start);
+  }
+
+  if(!nc->connect(retry.front().cb_event, retry.front().cb_event_user)) {
+    RX_ERROR("Cannot reconnect to: %s", nc->getKey().c_str());
+  }
+}
@@ -0,0 +1,159 @@
+#include <string.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <roxlu/core/Log.h>
+#include <http/HTTPBody.h>
+
+HTTPBody::~HTTPBody() {
+}
+
+//-------------------------------------------------------------------------------
+
+HTTPBodyString::HTTPBodyString(const std::string& data)
+  :data(data)
+  ,read_dx(0)
+{
+}
+
+size_t HTTPBodyString::read(char* dest, size_t nbytes) {
+  size_t n = std::min<size_t>(nbytes, data.size() - read_dx);
+  if(!n) {
+    return 0;
+  }
+
+  memcpy(dest, data.data() + read_dx, n);
+  read_dx += n;
+  return n;
+}
+
+int64_t HTTPBodyString::getSize() {
+  return data.size();
+}
+
+bool HTTPBodyString::rewind() {
+  read_dx = 0;
+  return true;
+}
+
+//-------------------------------------------------------------------------------
+
+HTTPBodyFile::HTTPBodyFile(const std::string& filepath)
+  :filepath(filepath)
+  ,fp(NULL)
+  ,size(0)
+{
+  struct stat st;
+  if(stat(filepath.c_str(), &st) == 0) {
+    size = st.st_size;
+  }
+  else {
+    RX_ERROR(HTTP_BODY_ERR_FILE_OPEN, filepath.c_str());
+  }
+}
+
+HTTPBodyFile::~HTTPBodyFile() {
+  if(fp) {
+    fclose(fp);
+    fp = NULL;
+  }
+}
+
+size_t HTTPBodyFile::read(char* dest, size_t nbytes) {
+  if(!fp) {
+    fp = fopen(filepath.c_str(), "rb");
+    if(!fp) {
+      RX_ERROR(HTTP_BODY_ERR_FILE_OPEN, filepath.c_str());
+      return 0;
+    }
+  }
+
+  size_t n = fread(dest, 1, nbytes, fp);
+  if(n < nbytes && ferror(fp)) {
+    RX_ERROR(HTTP_BODY_ERR_FILE_READ, filepath.c_str());
+  }
+
+  return n;
+}
+
+int64_t HTTPBodyFile::getSize() {
+  return size;
+}
+
+bool HTTPBodyFile::rewind() {
+  if(!fp) {
+    return true;
+  }
+  return fseek(fp, 0, SEEK_SET) == 0;
+}
+
+//-------------------------------------------------------------------------------
+
+HTTPBodyParts::HTTPBodyParts()
+  :last_string(NULL)
+  ,part_dx(0)
+{
+}
+
+HTTPBodyParts::~HTTPBodyParts() {
+  for(std::vector<HTTPBody*>::iterator it = parts.begin(); it != parts.end(); ++it) {
+    delete *it;
+  }
+  parts.clear();
+  last_string = NULL;
+}
+
+void HTTPBodyParts::add(HTTPBody* part) {
+  parts.push_back(part);
+  last_string = NULL;
+}
+
+void HTTPBodyParts::add(const std::string& data) {
+  if(last_string) {
+    last_string->data.append(data);
+    return;
+  }
+
+  last_string = new HTTPBodyString(data);
+  parts.push_back(last_string);
+}
+
+size_t HTTPBodyParts::read(char* dest, size_t nbytes) {
+  size_t total = 0;
+
+  while(total < nbytes && part_dx < parts.size()) {
+    size_t n = parts[part_dx]->read(dest + total, nbytes - total);
+    if(!n) {
+      ++part_dx;
+      continue;
+    }
+    total += n;
+  }
+
+  return total;
+}
+
+int64_t HTTPBodyParts::getSize() {
+  int64_t total = 0;
+
+  for(std::vector<HTTPBody*>::iterator it = parts.begin(); it != parts.end(); ++it) {
+    int64_t n = (*it)->getSize();
+    if(n == HTTP_BODY_SIZE_UNKNOWN) {
+      return HTTP_BODY_SIZE_UNKNOWN;
+    }
+    total += n;
+  }
+
+  return total;
+}
+
+bool HTTPBodyParts::rewind() {
+  part_dx = 0;
+
+  for(std::vector<HTTPBody*>::iterator it = parts.begin(); it != parts.end(); ++it) {
+    if(!(*it)->rewind()) {
+      return false;
+    }
+  }
+
+  return true;
+}
@@ -28,9 +28,11 @@ HTTPBuffer::HTTPBuffer(httpbuffer_callback cbFlushInput,
 HTTPBuffer::~HTTPBuffer() {
 }
 
+// the parser doesn't need the data after it returns, so we pass the received data as is
 void HTTPBuffer::addToInputBuffer(const char* buf, size_t len) {
-  std::copy(buf, buf+len, std::back_inserter(data_in));
-  flushInputBuffer();
+  if(cb_flush_input) {
+    cb_flush_input(buf, len, cb_user);
+  }
 }
 
 void HTTPBuffer::addToOutputBuffer(const char* buf, size_t len) {
@@ -38,13 +40,12 @@ void HTTPBuffer::addToOutputBuffer(const char* buf, size_t len) {
 }
 
 void HTTPBuffer::flushInputBuffer() {
-  if(cb_flush_input) {
-    cb_flush_input(&data_in[0], data_in.size(), cb_user);
-    data_in.clear();
-  }
 }
 
 void HTTPBuffer::flushOutputBuffer() {
+  if(!data_out.size()) {
+    return;
+  }
   if(cb_flush_output) {
     cb_flush_output(&data_out[0], data_out.size(), cb_user);
     data_out.clear();
@@ -55,8 +56,9 @@ void HTTPBuffer::flushOutputBuffer() {
 
 void httpbufferssl_on_decrypted_data(const char* data, size_t len, void* user) {
   HTTPBufferSSL* buf = static_cast<HTTPBufferSSL*>(user);
-  std::copy(data, data+len, std::back_inserter(buf->decrypted_data));
-  buf->flushInputBuffer();
+  if(buf->cb_flush_input) {
+    buf->cb_flush_input(data, len, buf->cb_user);
+  }
 }
 
 void httpbufferssl_on_encrypted_data(const char* data, size_t len, void* user) {
@@ -94,18 +96,8 @@ void HTTPBufferSSL::addToOutputBuffer(const char* buf, size_t len) {
 }  
 
 
+// decrypted data is passed to the input callback directly from SSLBuffer::update()
 void HTTPBufferSSL::flushInputBuffer() {
-  if(!cb_flush_input) {
-    RX_ERROR("No input flush callback set");
-    return;
-  }
-  printf("-------------------------------------------\n");
-  for(size_t i = 0; i < decrypted_data.size(); ++i) {
-    printf("%c", decrypted_data[i]);
-  }
-  printf("=============================================\n");
-  cb_flush_input(&decrypted_data[0], decrypted_data.size(), cb_user);
-  decrypted_data.clear();
 }
 
 void HTTPBufferSSL::flushOutputBuffer() {
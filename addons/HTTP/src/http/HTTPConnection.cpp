@@ -1,8 +1,22 @@
 #include <roxlu/core/Log.h>
 #include <http/HTTPConnection.h>
+#include <stdio.h>
 
 //-------------------------------------------------------------------------------
 int httpconnection_on_message_begin(http_parser* p) {
+  HTTPConnection* c = static_cast<HTTPConnection*>(p->data);
+
+  c->in_response = true;
+  c->headers.entries.clear();
+
+  // responses arrive in the same order as we sent the requests
+  if(c->requests.size()) {
+    HTTPConnectionRequest& req = c->requests.front();
+    req.timings.first_byte = uv_hrtime();
+    c->cb_event = req.cb_event;
+    c->cb_event_user = req.cb_event_user;
+  }
+
   return 0;
 }
 
@@ -54,9 +68,46 @@ int httpconnection_on_body(http_parser* p, const char* at, size_t len) {
 
 int httpconnection_on_message_complete(http_parser* p) {
   HTTPConnection* c = static_cast<HTTPConnection*>(p->data);
+
+  c->keep_alive = c->keep_alive && http_should_keep_alive(p);
+  c->in_response = false;
+
+  // the server responded before we sent the complete body (e.g. 413); the rest of the output is garbage for the server
+  if(c->requests.size() && !c->requests.front().is_sent) {
+    c->keep_alive = false;
+  }
+  c->num_completed++;
+
+  if(c->requests.size()) {
+    c->requests.front().is_complete = true;
+    c->requests.front().timings.complete = uv_hrtime();
+    c->last_timings = c->requests.front().timings;
+  }
+
   if(c->cb_event) {
     c->cb_event(c, HTTP_ON_COMPLETE, NULL, 0, c->cb_event_user);
   }
+
+  // when we can't reuse the connection the request stays in the queue so it gets the HTTP_ON_CLOSED event too;
+  // it's marked as complete so HTTP::retryRequests() doesn't send it again
+  if(!c->keep_alive) {
+    c->close();
+    return 0;
+  }
+
+  if(c->requests.size()) {
+    if(c->requests.front().body) {
+      delete c->requests.front().body;
+    }
+    c->requests.pop_front();
+  }
+
+  c->cb_event = NULL;
+  c->cb_event_user = NULL;
+
+  if(c->requests.empty()) {
+    c->idle_since = uv_now(c->loop);
+  }
   
   return 0;
 }
@@ -65,7 +116,7 @@ int httpconnection_on_message_complete(http_parser* p) {
 //-------------------------------------------------------------------------------
 
 void httpconnection_on_flush_input_buffer(const char* data, size_t len, void* user) {
-#if 1
+#if 0
   for(size_t i = 0; i < len; ++i) {
     printf("%c", data[i]);
   }
@@ -87,43 +138,67 @@ void httpconnection_on_resolved(uv_getaddrinfo_t* req, int status, struct addrin
   HTTPConnection* c = static_cast<HTTPConnection*>(req->data);
   if(status == -1) {
     RX_ERROR("> cannot revolve host: %s", c->host.c_str());
+    uv_close((uv_handle_t*)c->sock, httpconnection_on_close);
     return;
   }
 
-  char ip[17] = {0};
-  uv_ip4_name((struct sockaddr_in*)res->ai_addr, ip, 16);
- 
-  int r = uv_tcp_connect(&c->connect_req, c->sock, 
-                         *(struct sockaddr_in*)res->ai_addr, 
-                         httpconnection_on_connect);
- 
+  if(c->requests.size()) {
+    c->requests.front().timings.dns_end = uv_hrtime();
+  }
+
+  struct sockaddr_in addr = *(struct sockaddr_in*)res->ai_addr;
   uv_freeaddrinfo(res);
+
+  if(c->dns_cache) {
+    c->dns_cache->add(c->loop, c->host, c->port, addr);
+  }
+
+  if(c->requests.size()) {
+    c->requests.front().timings.connect_start = uv_hrtime();
+  }
+ 
+  int r = uv_tcp_connect(&c->connect_req, c->sock, addr, httpconnection_on_connect);
+  if(r) {
+    RX_ERROR("> cannot connect: %s", uv_strerror(uv_last_error(c->loop)));
+    uv_close((uv_handle_t*)c->sock, httpconnection_on_close);
+  }
 }
 
 void httpconnection_on_connect(uv_connect_t* req, int status) {
   HTTPConnection* c = static_cast<HTTPConnection*>(req->data);
   if(status == -1) {
     RX_ERROR("> cannot connect: %s:", uv_strerror(uv_last_error(c->loop)));
-    RX_ERROR("@ todo should be `delete` the connection here?");
+    if(c->dns_cache) {
+      c->dns_cache->remove(c->host, c->port); /* the cached address might be stale */
+    }
+    uv_close((uv_handle_t*)c->sock, httpconnection_on_close);
     return;
   }
 
+  c->is_connected = true;
+
+  if(c->requests.size()) {
+    c->requests.front().timings.connect_end = uv_hrtime();
+  }
 
   int r = uv_read_start((uv_stream_t*)c->sock, httpconnection_on_alloc, httpconnection_on_read);
   if(r) {
     RX_ERROR("> uv_read_start() failed: %s", uv_strerror(uv_last_error(c->loop)));
-    RX_ERROR("@ todo should be `delete` the connection here?");
+    c->close();
     return;
   }
 
   if(c->ssl) {
+    if(c->requests.size()) {
+      c->requests.front().timings.tls_start = uv_hrtime();
+    }
     SSL_set_connect_state(c->ssl);
     SSL_do_handshake(c->ssl);
     c->buffer->update();
    }
 
   // trigger the output buffer 
-  c->buffer->flushOutputBuffer();
+  c->writeRequests();
 }
 
 void httpconnection_on_read(uv_stream_t* handle, ssize_t nread, uv_buf_t buf) {
@@ -135,16 +210,16 @@ void httpconnection_on_read(uv_stream_t* handle, ssize_t nread, uv_buf_t buf) {
       RX_ERROR("> error uv_read_stop: %s", uv_strerror(uv_last_error(handle->loop)));
       
     }
-    if(buf.base) {
-      delete buf.base;
-      buf.base = NULL;
-    }
-
     uv_err_t err = uv_last_error(handle->loop);
     if(err.code != UV_EOF) {
       RX_ERROR("> disconnected from server but not correctly: %s",uv_strerror(uv_last_error(handle->loop))) ;
     }
 
+    // let the parser know we reached EOF; completes responses without a content length
+    c->is_connected = false;
+    c->is_closing = true;
+    http_parser_execute(&c->parser, &c->parser_settings, NULL, 0);
+
     r = uv_shutdown(&c->shutdown_req, handle, httpconnection_on_shutdown);
     if(r) {
       RX_ERROR("> error shutting down client: %s", uv_strerror(uv_last_error(handle->loop)));
@@ -156,14 +231,35 @@ void httpconnection_on_read(uv_stream_t* handle, ssize_t nread, uv_buf_t buf) {
 
   c->addToInputBuffer(buf.base, nread);
 
-  if(buf.base) {
-    delete[] buf.base;
-    buf.base = NULL;
+  if(c->ssl && !c->is_tls_ready && SSL_is_init_finished(c->ssl)) {
+    c->is_tls_ready = true;
+
+    if(c->requests.size()) {
+      c->requests.front().timings.tls_end = uv_hrtime();
+    }
+
+    if(c->ssl_context) {
+      c->ssl_context->storeSession(c->ssl, c->getKey());
+    }
+
+    // body chunks were held back during the handshake
+    c->writeRequests();
   }
 }
 
 void httpconnection_on_write(uv_write_t* req, int status) {
-  delete req;
+  HTTPWriteRequest* wr = static_cast<HTTPWriteRequest*>(req->data);
+  HTTPConnection* c = wr->c;
+
+  c->bytes_in_flight -= wr->nbytes;
+
+  delete[] wr->data;
+  delete wr;
+
+  // pull the next chunks of a body which is being sent
+  if(status == 0 && c->is_connected && !c->is_closing) {
+    c->writeRequests();
+  }
 }
 
 void httpconnection_on_shutdown(uv_shutdown_t* req, int status) {
@@ -177,18 +273,23 @@ void httpconnection_on_close(uv_handle_t* handle) {
   delete handle;
   handle = NULL;
 
-  if(c->cb_event) {
-    c->cb_event(c, HTTP_ON_CLOSED, NULL, 0, c->cb_event_user);
-  }
-  
+  c->sock = NULL;
+  c->is_connected = false;
+  c->is_closing = true;
+
+  // the close handler (HTTP) may retry the pending requests before notifying them
   if(c->cb_close) {
     c->cb_close(c, HTTP_ON_CLOSED, NULL, 0, c->cb_close_user);
   }
+  else {
+    c->notifyClosed();
+  }
 }
 
+// the data is parsed before we return from the read callback, so we can reuse one buffer 
 uv_buf_t httpconnection_on_alloc(uv_handle_t* handle, size_t nbytes) {
-  char* buf = new char[nbytes];
-  return uv_buf_init(buf, nbytes);
+  HTTPConnection* c = static_cast<HTTPConnection*>(handle->data);
+  return uv_buf_init(c->read_buffer, sizeof(c->read_buffer));
 }
 
 //-------------------------------------------------------------------------------
@@ -203,6 +304,17 @@ HTTPConnection::HTTPConnection(uv_loop_t* loop, std::string host, std::string po
   ,cb_close_user(NULL)
   ,ssl(ssl)
   ,buffer(NULL)
+  ,dns_cache(NULL)
+  ,ssl_context(NULL)
+  ,is_connected(false)
+  ,is_closing(false)
+  ,is_tls_ready(false)
+  ,in_response(false)
+  ,keep_alive(true)
+  ,num_completed(0)
+  ,idle_since(0)
+  ,bytes_in_flight(0)
+  ,body_buffer(NULL)
 {
   sock = new uv_tcp_t();
   sock->data = this;
@@ -243,6 +355,18 @@ HTTPConnection::~HTTPConnection() {
     buffer = NULL;
   }
 
+  for(std::deque<HTTPConnectionRequest>::iterator it = requests.begin(); it != requests.end(); ++it) {
+    if((*it).body) {
+      delete (*it).body;
+    }
+  }
+  requests.clear();
+
+  if(body_buffer) {
+    delete[] body_buffer;
+    body_buffer = NULL;
+  }
+
   loop = NULL;
   cb_event = NULL;
   cb_event_user = NULL;
@@ -271,6 +395,30 @@ bool HTTPConnection::connect(httpconnection_event_callback eventCB,  /* gets cal
   cb_event = eventCB;
   cb_event_user = eventUser;
 
+  if(ssl && ssl_context) {
+    ssl_context->resumeSession(ssl, getKey());
+  }
+
+  HTTPTimings* timings = (requests.size()) ? &requests.front().timings : NULL;
+
+  // connect directly when we know the address
+  struct sockaddr_in addr;
+  if(dns_cache && dns_cache->find(loop, host, port, addr)) {
+    if(timings) {
+      timings->connect_start = uv_hrtime();
+    }
+    r = uv_tcp_connect(&connect_req, sock, addr, httpconnection_on_connect);
+    if(r) {
+      RX_ERROR("cannot uv_tcp_connect(): %s", uv_strerror(uv_last_error(loop)));
+      return false;
+    }
+    return true;
+  }
+
+  if(timings) {
+    timings->dns_start = uv_hrtime();
+  }
+
   struct addrinfo hints;
   hints.ai_family = PF_INET;
   hints.ai_socktype = SOCK_STREAM;
@@ -306,15 +454,31 @@ void HTTPConnection::addToInputBuffer(const char* data, size_t len) {
 }
 
 bool HTTPConnection::send(char* data, size_t len) {
-  uv_buf_t buf = uv_buf_init(data, len);
-  uv_write_t* req = new uv_write_t();
-  req->data = this;
+  if(!sock || !is_connected) {
+    RX_ERROR("Cannot send, not connected");
+    return false;
+  }
+
+  // the buffer which calls us reuses its memory, so we need our own copy until the write finished
+  HTTPWriteRequest* wr = new HTTPWriteRequest();
+  wr->data = new char[len];
+  wr->nbytes = len;
+  wr->c = this;
+  wr->req.data = wr;
+  memcpy(wr->data, data, len);
 
-  int r = uv_write(req, (uv_stream_t*)sock, &buf, 1, httpconnection_on_write);
+  uv_buf_t buf = uv_buf_init(wr->data, len);
+
+  int r = uv_write(&wr->req, (uv_stream_t*)sock, &buf, 1, httpconnection_on_write);
   if(r) {
     RX_ERROR("uv_write() failed: %s", uv_strerror(uv_last_error(loop)));
+    delete[] wr->data;
+    delete wr;
+    close();
     return false;
   }
+
+  bytes_in_flight += len;
   
   return true;
 }
@@ -324,6 +488,140 @@ bool HTTPConnection::close() {
     RX_ERROR("Cannot close a socket which haven't been opened yet");
     return false;
   }
+
+  if(is_closing) {
+    return true;
+  }
+
+  is_closing = true;
   uv_shutdown(&shutdown_req, (uv_stream_t*)sock, httpconnection_on_shutdown);
   return true;
 }
+
+void HTTPConnection::addRequest(const std::string& data, 
+                                HTTPBody* body,
+                                httpconnection_event_callback eventCB, 
+                                void* eventUser, 
+                                bool isIdempotent,
+                                uint64_t startTime)
+{
+  HTTPConnectionRequest req;
+  req.data = data;
+  req.body = body;
+  req.is_chunked = (body && body->getSize() == HTTP_BODY_SIZE_UNKNOWN);
+  req.cb_event = eventCB;
+  req.cb_event_user = eventUser;
+  req.is_idempotent = isIdempotent;
+  req.timings.start = startTime;
+  requests.push_back(req);
+
+  if(requests.size() == 1) {
+    cb_event = eventCB;
+    cb_event_user = eventUser;
+  }
+
+  if(is_connected) {
+    writeRequests();
+  }
+}
+
+// requests are written in order; the headers of the next request are written after the complete body of the previous one
+void HTTPConnection::writeRequests() {
+  bool has_new = false;
+  uint64_t now = uv_hrtime();
+
+  for(std::deque<HTTPConnectionRequest>::iterator it = requests.begin(); it != requests.end(); ++it) {
+    HTTPConnectionRequest& req = *it;
+    if(req.is_sent) {
+      continue;
+    }
+
+    if(!req.is_header_sent) {
+      addToOutputBuffer(req.data.c_str(), req.data.size());
+      req.is_header_sent = true;
+      req.timings.sent = now;
+    }
+
+    has_new = true;
+
+    if(req.body && !writeBody(req)) {
+      break;
+    }
+
+    req.is_sent = true;
+  }
+
+  if(!has_new) {
+    return;
+  }
+
+  buffer->update();
+  buffer->flushOutputBuffer();
+}
+
+bool HTTPConnection::writeBody(HTTPConnectionRequest& req) {
+  if(!body_buffer) {
+    body_buffer = new char[HTTP_BODY_CHUNK_SIZE];
+  }
+
+  while(!is_closing && (bytes_in_flight + buffer->getOutputSize()) < HTTP_MAX_OUTPUT_BYTES) {
+
+    size_t nread = req.body->read(body_buffer, HTTP_BODY_CHUNK_SIZE);
+    if(!nread) {
+      if(req.is_chunked) {
+        addToOutputBuffer("0\r\n\r\n", 5);
+      }
+      return true;
+    }
+
+    if(req.is_chunked) {
+      char chunk_size[32];
+      int n = sprintf(chunk_size, "%lx\r\n", (unsigned long)nread);
+      addToOutputBuffer(chunk_size, n);
+      addToOutputBuffer(body_buffer, nread);
+      addToOutputBuffer("\r\n", 2);
+    }
+    else {
+      addToOutputBuffer(body_buffer, nread);
+    }
+
+    // hand the chunk to the socket so bytes_in_flight is updated
+    buffer->update();
+    buffer->flushOutputBuffer();
+  }
+
+  return false;
+}
+
+void HTTPConnection::notifyClosed() {
+  std::deque<HTTPConnectionRequest> reqs;
+  reqs.swap(requests);
+
+  cb_event = NULL;
+  cb_event_user = NULL;
+
+  for(std::deque<HTTPConnectionRequest>::iterator it = reqs.begin(); it != reqs.end(); ++it) {
+    HTTPConnectionRequest& req = *it;
+    if(req.cb_event) {
+      req.cb_event(this, HTTP_ON_CLOSED, NULL, 0, req.cb_event_user);
+    }
+    if(req.body) {
+      delete req.body;
+      req.body = NULL;
+    }
+  }
+}
+
+//-------------------------------------------------------------------------------
+
+HTTPConnectionRequest::HTTPConnectionRequest()
+  :body(NULL)
+  ,cb_event(NULL)
+  ,cb_event_user(NULL)
+  ,is_header_sent(false)
+  ,is_sent(false)
+  ,is_chunked(false)
+  ,is_idempotent(false)
+  ,is_complete(false)
+{
+}
@@ -0,0 +1,39 @@
+#include <http/HTTPDNSCache.h>
+
+HTTPDNSCache::HTTPDNSCache()
+  :ttl(HTTP_DNS_DEFAULT_TTL)
+{
+}
+
+HTTPDNSCache::~HTTPDNSCache() {
+  clear();
+}
+
+bool HTTPDNSCache::find(uv_loop_t* loop, const std::string& host, const std::string& port, struct sockaddr_in& result) {
+  std::map<std::string, HTTPDNSEntry>::iterator it = entries.find(host + ":" + port);
+  if(it == entries.end()) {
+    return false;
+  }
+
+  if(uv_now(loop) >= it->second.expires) {
+    entries.erase(it);
+    return false;
+  }
+
+  result = it->second.addr;
+  return true;
+}
+
+void HTTPDNSCache::add(uv_loop_t* loop, const std::string& host, const std::string& port, const struct sockaddr_in& addr) {
+  HTTPDNSEntry e;
+  e.addr = addr;
+  e.expires = uv_now(loop) + ttl;
+  entries[host + ":" + port] = e;
+}
+
+void HTTPDNSCache::remove(const std::string& host, const std::string& port) {
+  std::map<std::string, HTTPDNSEntry>::iterator it = entries.find(host + ":" + port);
+  if(it != entries.end()) {
+    entries.erase(it);
+  }
+}
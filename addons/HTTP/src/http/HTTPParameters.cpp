@@ -54,11 +54,7 @@ bool HTTPParameters::toBoundaryString(HTTPParameter& p, std::string boundary, st
       for(std::vector<HTTPFile>::iterator fit = p.files.begin(); fit != p.files.end(); ++fit) {
         HTTPFile& file = *fit;
         std::string file_contents = rx_get_file_contents(file.filepath, false);
-        result += "--" +boundary +"\r\n";
-        result += "Content-Type: " +file.content_type +"; name=\"" +name +"\"\r\n";
-        result += "Content-Transfer-Encoding: " +file.transfer_encoding +"\r\n";
-        result += "Content-Disposition: form-data; name=\"" +name +"\"; filename=\"" +file.filename +"\"\r\n";
-        result += "\r\n";
+        result += getFileHeader(p, file, boundary);
         result += file_contents +"\r\n";
       }
       return true; 
@@ -71,6 +67,43 @@ bool HTTPParameters::toBoundaryString(HTTPParameter& p, std::string boundary, st
   }
 }
 
+// creates the multipart/form-data body; file contents are read in chunks when the body is sent
+bool HTTPParameters::toBoundaryBody(std::string boundary, HTTPBodyParts& result) {
+  for(std::map<std::string, HTTPParameter>::iterator it = entries.begin(); it != entries.end(); ++it) {
+    HTTPParameter& p = it->second;
+
+    if(p.type == HTTP_PARAMETER_FILE) {
+      for(std::vector<HTTPFile>::iterator fit = p.files.begin(); fit != p.files.end(); ++fit) {
+        HTTPFile& file = *fit;
+        result.add(getFileHeader(p, file, boundary));
+        result.add(new HTTPBodyFile(file.filepath));
+        result.add("\r\n");
+      }
+      continue;
+    }
+
+    std::string part;
+    if(!toBoundaryString(p, boundary, part)) {
+      RX_ERROR("Cannot add parameter to post: %s", p.name.c_str());
+      continue;
+    }
+    result.add(part);
+  }
+  result.add("--" +boundary +"--\r\n");
+  return true;
+}
+
+std::string HTTPParameters::getFileHeader(HTTPParameter& p, HTTPFile& file, std::string boundary) {
+  std::string name = p.name;
+  std::string result;
+  result += "--" +boundary +"\r\n";
+  result += "Content-Type: " +file.content_type +"; name=\"" +name +"\"\r\n";
+  result += "Content-Transfer-Encoding: " +file.transfer_encoding +"\r\n";
+  result += "Content-Disposition: form-data; name=\"" +name +"\"; filename=\"" +file.filename +"\"\r\n";
+  result += "\r\n";
+  return result;
+}
+
 // percent encodes name/value pairs 
 void HTTPParameters::percentEncode() {
   PercentEncode enc;
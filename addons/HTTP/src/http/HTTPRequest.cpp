@@ -114,7 +114,7 @@ bool HTTPRequest::toString(std::string& result) {
   result += headers.join();
   result += "\r\n";
 
-#if 1
+#if 0
   printf("%s", result.c_str());
   for(size_t i = 0; i < http_body.size(); ++i) {
     if(i > 40) {
@@ -134,7 +134,7 @@ bool HTTPRequest::toString(std::string& result) {
 
   result += http_body;
 
-#if 1 
+#if 0
   std::ofstream ofs(rx_to_data_path("out.raw").c_str(), std::ios::binary | std::ios::out);
   if(!ofs.is_open()) {
     RX_ERROR("Cannot open output file");
@@ -147,6 +147,51 @@ bool HTTPRequest::toString(std::string& result) {
   return true;
 }
 
+// create a body which is read in chunks by the connection; file uploads are not loaded into memory
+HTTPBody* HTTPRequest::createBodySource() {
+  if(body_file.size()) {
+    return new HTTPBodyFile(body_file);
+  }
+
+  if(body.size()) {
+    return new HTTPBodyString(body);
+  }
+
+  if(!content_parameters.size()) {
+    return NULL;
+  }
+
+  if(isPost() && content_parameters.hasFileParameter()) {
+    HTTPBodyParts* parts = new HTTPBodyParts();
+    content_parameters.toBoundaryBody(getBoundary(), *parts);
+    return parts;
+  }
+
+  content_parameters.percentEncode();
+  return new HTTPBodyString(content_parameters.getQueryString());
+}
+
+// create the request line and headers; the body is sent separately
+bool HTTPRequest::toHeaderString(HTTPBody* b, std::string& result) {
+  addDefaultHTTPHeaders();
+
+  if(b && b->getSize() == HTTP_BODY_SIZE_UNKNOWN) {
+    if(version == HTTP_VERSION_1_0) {
+      RX_ERROR("Cannot send a body with an unknown size using HTTP/1.0");
+      return false;
+    }
+    addHeader(HTTPHeader("Transfer-Encoding", "chunked"));
+  }
+  else {
+    addHeader(HTTPHeader("Content-Length", (b) ? b->getSize() : 0));
+  }
+
+  result = getHTTPString() +"\r\n";
+  result += headers.join();
+  result += "\r\n";
+  return true;
+}
+
 // The boundary string is used when posting multipart/form-data 
 void HTTPRequest::generateBoundary() {
   if(boundary.size()) {
@@ -28,3 +28,22 @@ void HTTPFile::setDefaults() {
   content_type = "application/octet-stream";
   transfer_encoding = "binary";
 }
+
+//-------------------------------------------------------------------------------
+
+HTTPTimings::HTTPTimings() {
+  reset();
+}
+
+void HTTPTimings::reset() {
+  start = 0;
+  dns_start = 0;
+  dns_end = 0;
+  connect_start = 0;
+  connect_end = 0;
+  tls_start = 0;
+  tls_end = 0;
+  sent = 0;
+  first_byte = 0;
+  complete = 0;
+}
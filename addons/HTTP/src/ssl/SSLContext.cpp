@@ -39,10 +39,51 @@ SSLContext::SSLContext()
   SSL_CTX_set_options(ssl_ctx, SSL_OP_NO_SSLv2);
   SSL_CTX_set_verify(ssl_ctx, SSL_VERIFY_PEER, sslcontext_verify);
   SSL_CTX_set_info_callback(ssl_ctx, sslcontext_info);
+  SSL_CTX_set_session_cache_mode(ssl_ctx, SSL_SESS_CACHE_CLIENT);
 }
 
 SSLContext::~SSLContext() {
+  for(std::map<std::string, SSL_SESSION*>::iterator it = sessions.begin(); it != sessions.end(); ++it) {
+    SSL_SESSION_free(it->second);
+  }
+  sessions.clear();
+
   if(ssl_ctx) {
     SSL_CTX_free(ssl_ctx);
   }
 }
+
+bool SSLContext::resumeSession(SSL* ssl, const std::string& key) {
+  std::map<std::string, SSL_SESSION*>::iterator it = sessions.find(key);
+  if(it == sessions.end()) {
+    return false;
+  }
+
+  if(SSL_set_session(ssl, it->second) != 1) {
+    RX_ERROR("Cannot set the SSL session for: %s", key.c_str());
+    removeSession(key);
+    return false;
+  }
+
+  return true;
+}
+
+void SSLContext::storeSession(SSL* ssl, const std::string& key) {
+  SSL_SESSION* session = SSL_get1_session(ssl); /* increments the reference count */
+  if(!session) {
+    return;
+  }
+
+  removeSession(key);
+  sessions[key] = session;
+}
+
+void SSLContext::removeSession(const std::string& key) {
+  std::map<std::string, SSL_SESSION*>::iterator it = sessions.find(key);
+  if(it == sessions.end()) {
+    return;
+  }
+
+  SSL_SESSION_free(it->second);
+  sessions.erase(it);
+}
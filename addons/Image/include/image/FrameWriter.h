@@ -0,0 +1,173 @@
+/*
+
+  FrameWriter
+  -----------
+  Writes a sequence of frames (e.g. a screen grab of each frame of an
+  installation) as numbered png or jpg files, encoding them on a pool of
+  threads so the thread that grabs the frames only has to copy the pixels.
+
+  - addFrame() copies the pixels into a pooled buffer and gives the frame
+    the next frame number; the file name is created from the printf-style
+    `filepath` with this number, so the files are numbered in the order you
+    added the frames, even though the threads may finish them out of order.
+    getNumWritten() returns the number of frames from the start of the
+    sequence that are completely written.
+  - When `max_frames` are waiting to be encoded, addFrame() waits for a free
+    slot, or drops the frame when `drop_frames` is true.
+  - Each thread reuses its jpeg encoder, row pointers and output buffers.
+  - Use a low png compression level (1) and a single png filter
+    (PNG_FILTER_SUB) when you need to dump many frames per second; png
+    files are larger then.
+  - Set `flip` when you write pixels from glReadPixels(), which are stored
+    bottom up.
+
+  Examples
+  --------
+
+      FrameWriterSettings cfg;
+      cfg.filepath = "frames/frame_%06llu.jpg";
+      cfg.type = FRAME_WRITER_TYPE_JPG;
+      cfg.width = 1920;
+      cfg.height = 1080;
+      cfg.fmt = RX_FMT_RGB24;
+      cfg.flip = true;
+
+      FrameWriter writer;
+      writer.setup(cfg);
+      writer.start();
+
+      // each frame
+      glReadPixels(0, 0, 1920, 1080, GL_RGB, GL_UNSIGNED_BYTE, pixels);
+      writer.addFrame(pixels, 1920 * 1080 * 3);
+
+      // when ready, writes all queued frames
+      writer.stop();
+
+*/
+#ifndef ROXLU_IMAGE_FRAME_WRITER_H
+#define ROXLU_IMAGE_FRAME_WRITER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <set>
+#include <uv.h>
+#include <roxlu/core/Constants.h>
+#include <roxlu/core/Log.h>
+#include <image/PNG.h>
+#include <image/JPG.h>
+
+#define ERR_FW_ALREADY_STARTED "The frame writer is already started"
+#define ERR_FW_NOT_STARTED "The frame writer is not started"
+#define ERR_FW_TYPE "Invalid frame writer type: %d"
+#define ERR_FW_SIZE "Invalid frame size: %d x %d"
+#define ERR_FW_FMT "Unsupported pixel format for the frame writer: %d"
+#define ERR_FW_FILEPATH "No filepath set"
+#define ERR_FW_NUM_THREADS "Invalid number of threads: %d"
+#define ERR_FW_MAX_FRAMES "Invalid number of max frames: %d"
+#define ERR_FW_NBYTES "Invalid number of bytes for the frame: %ld, we expect: %ld"
+#define ERR_FW_FOPEN "Cannot open: %s"
+#define ERR_FW_PNG "Error while writing the png: %s"
+#define ERR_FW_JPG "Error while writing the jpg: %s, %s"
+#define ERR_FW_JPG_FMT "We can only write RGB or grayscale jpgs"
+
+#define FRAME_WRITER_TYPE_NONE 0
+#define FRAME_WRITER_TYPE_PNG 1
+#define FRAME_WRITER_TYPE_JPG 2
+
+struct FrameWriterSettings {
+  FrameWriterSettings();
+  int type;                                                                  /* FRAME_WRITER_TYPE_PNG or FRAME_WRITER_TYPE_JPG */
+  std::string filepath;                                                      /* printf pattern for the files which gets the frame number as unsigned long long, e.g. "frame_%06llu.png" */
+  bool datapath;                                                             /* when true the filepath is relative to the data path */
+  unsigned int width;
+  unsigned int height;
+  unsigned int fmt;                                                          /* RX_FMT_RGB24, RX_FMT_RGBA32 (png only) or RX_FMT_GRAY8 */
+  bool flip;                                                                 /* write the rows bottom up */
+  int num_threads;                                                           /* number of encode threads */
+  int max_frames;                                                            /* max number of frames waiting to be encoded */
+  bool drop_frames;                                                          /* when true addFrame() drops the frame when max_frames are waiting, otherwise it waits */
+  int png_compression_level;                                                 /* zlib compression level, 0 - 9 */
+  int png_filter;                                                            /* PNG_FILTER_NONE, PNG_FILTER_SUB, ... or PNG_ALL_FILTERS */
+  int jpg_quality;                                                           /* 0 - 100 */
+  J_DCT_METHOD jpg_dct_method;                                               /* JDCT_IFAST is fastest */
+};
+
+struct FrameWriterFrame {
+  uint64_t number;                                                           /* the frame number, used in the filename */
+  std::vector<unsigned char> pixels;
+};
+
+struct FrameWriterJPGError {                                                 /* libjpeg calls exit() on errors, we jump back into the encode function */
+  struct jpeg_error_mgr mgr;
+  jmp_buf jump;
+};
+
+class FrameWriter;
+
+struct FrameWriterWorker {
+  FrameWriterWorker();
+  FrameWriter* writer;
+  uv_thread_t thread;
+  struct jpeg_compress_struct jpg;                                           /* reused for all jpgs this worker writes */
+  FrameWriterJPGError jpg_error;
+  std::vector<png_bytep> row_ptrs;                                           /* reused for all frames */
+  std::vector<char> filepath;                                                /* buffer for the filename */
+  std::vector<char> file_buffer;                                             /* stdio buffer, we write big blocks */
+};
+
+void frame_writer_thread_function(void* user);                               /* runs FrameWriter::encode() for a worker */
+
+class FrameWriter {
+ public:
+  FrameWriter();
+  ~FrameWriter();
+  bool setup(const FrameWriterSettings& cfg);                                /* validates and sets the settings; call before start() */
+  bool start();                                                              /* starts the encode threads; the frame numbers start at 0 */
+  void stop();                                                               /* writes all queued frames and stops the threads */
+  bool addFrame(unsigned char* pixels, size_t nbytes);                       /* copies the pixels and queues the frame; returns false when the frame is dropped */
+  uint64_t getNumWritten();                                                  /* number of frames written, counting from frame 0 without gaps */
+  uint64_t getNumDropped();                                                  /* number of frames dropped because the queue was full */
+  void encode(FrameWriterWorker& worker);                                    /* the encode thread; don't call this yourself */
+
+ private:
+  bool writePNG(FrameWriterWorker& worker, FrameWriterFrame* frame, const char* filepath);
+  bool writeJPG(FrameWriterWorker& worker, FrameWriterFrame* frame, const char* filepath);
+  void setRowPointers(FrameWriterWorker& worker, FrameWriterFrame* frame);   /* fills the row pointers of the worker for the frame, flipped when necessary */
+
+ public:
+  FrameWriterSettings settings;
+  size_t stride;                                                             /* number of bytes per row */
+  size_t nbytes;                                                             /* number of bytes per frame */
+  std::vector<FrameWriterWorker*> workers;
+  std::deque<FrameWriterFrame*> queue;                                       /* frames waiting to be encoded, oldest first */
+  std::vector<FrameWriterFrame*> free_frames;                                /* frames we reuse */
+  std::set<uint64_t> written;                                                /* frames that are written, but not all frames before them yet */
+  uint64_t num_frames;                                                       /* number of added frames, the number of the next frame */
+  uint64_t num_written;                                                      /* all frames before this number are written */
+  uint64_t num_dropped;
+  uv_mutex_t mutex;                                                          /* protects the queue, the frame pool and the counters */
+  uv_cond_t cond_frame;                                                      /* signalled when there is a new frame or when we must stop */
+  uv_cond_t cond_space;                                                      /* signalled when a worker took a frame from the queue */
+  bool must_stop;
+  bool is_started;
+};
+
+inline uint64_t FrameWriter::getNumWritten() {
+  uv_mutex_lock(&mutex);
+  uint64_t n = num_written;
+  uv_mutex_unlock(&mutex);
+  return n;
+}
+
+inline uint64_t FrameWriter::getNumDropped() {
+  uv_mutex_lock(&mutex);
+  uint64_t n = num_dropped;
+  uv_mutex_unlock(&mutex);
+  return n;
+}
+
+#endif
@@ -0,0 +1,162 @@
+/*
+
+  ImageLoader
+  -----------
+  Loads png, jpg and tga files on a pool of decode threads so loading many
+  images (e.g. photos from the Instagram addon) doesn't block the thread
+  that draws.
+
+  - load() puts a request in a queue and returns its id. Requests with a
+    higher priority are decoded first; requests with the same priority in
+    the order you added them. cancel() removes a request from the queue,
+    or drops the result when it's already being decoded.
+  - The pixels are decoded into buffers which are reused for the next
+    images, and each thread reuses its jpeg decoder and png row pointers.
+  - When you pass a max_width/max_height, jpgs are scaled down while
+    decoding (libjpeg scales in the DCT domain by N/8), so thumbnails of big
+    photos are much faster to load. The result is never smaller than the
+    given size. PNG and TGA files are always loaded at their full size.
+  - update() calls the callback for all finished requests, on the thread
+    that calls update(), so you can upload the pixels to a texture there.
+    The pixels are only valid during the callback; copy them when you need
+    them later. When loading failed the callback gets a request with
+    `pixels` set to NULL.
+
+  Examples
+  --------
+
+      void on_loaded(ImageLoaderRequest* req, void* user) {
+        if(!req->pixels) {
+          return;
+        }
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, req->width, req->height, 0, GL_RGB, GL_UNSIGNED_BYTE, req->pixels);
+      }
+
+      ImageLoader loader(on_loaded, NULL);
+      loader.start();
+      int id = loader.load("photo.jpg", 0, 160, 160);  // thumbnail
+
+      // each frame
+      loader.update();
+
+*/
+#ifndef ROXLU_IMAGE_LOADER_H
+#define ROXLU_IMAGE_LOADER_H
+
+#include <stdio.h>
+#include <setjmp.h>
+#include <string>
+#include <vector>
+#include <uv.h>
+#include <roxlu/core/Constants.h>
+#include <roxlu/core/Log.h>
+#include <image/PNG.h>
+#include <image/JPG.h>
+
+#define ERR_IMGL_ALREADY_STARTED "The image loader is already started"
+#define ERR_IMGL_NOT_STARTED "The image loader is not started; call start() first"
+#define ERR_IMGL_NUM_THREADS "Invalid number of threads: %d"
+#define ERR_IMGL_FOPEN "Cannot open the image: %s"
+#define ERR_IMGL_JPG "Cannot decode the jpg: %s, %s"
+#define ERR_IMGL_JPG_COLOR_SPACE "Unsupported jpg color space, we only load RGB and grayscale: %s"
+#define ERR_IMGL_PNG "Cannot decode the png: %s"
+#define ERR_IMGL_PNG_SIG "Not a png file: %s"
+#define ERR_IMGL_PNG_CHANNELS "Unsupported number of channels: %d in: %s"
+#define ERR_IMGL_TGA_CHANNELS "Unsupported number of channels: %d in: %s"
+#define ERR_IMGL_UNSUPPORTED_EXT "Unsupported image type (jpg, png, tga): %s"
+
+#define IMAGE_LOADER_DEFAULT_NUM_THREADS 4
+#define IMAGE_LOADER_MAX_FREE_BUFFERS 16                                    /* we keep at most this many unused pixel buffers */
+
+struct ImageLoaderRequest;
+
+typedef void(*image_loader_cb)(ImageLoaderRequest* req, void* user);       /* gets called by ImageLoader::update() for each finished request */
+
+struct ImageLoaderRequest {
+  ImageLoaderRequest();
+  void reset();
+
+  /* request */
+  int id;
+  std::string filename;
+  int priority;                                                             /* higher priorities are decoded first */
+  unsigned int max_width;                                                   /* jpgs are scaled down while decoding, but never below max_width x max_height; 0 = don't scale */
+  unsigned int max_height;
+  void* user;                                                               /* your data, passed back with the result */
+  uint64_t order;                                                           /* requests with the same priority are decoded in the order they were added */
+  bool is_cancelled;                                                        /* set when the request is cancelled while a worker decodes it */
+
+  /* result */
+  unsigned char* pixels;                                                    /* the decoded pixels, NULL when loading failed; only valid during the callback */
+  unsigned int width;
+  unsigned int height;
+  unsigned int stride;
+  unsigned int fmt;                                                         /* RX_FMT_RGB24, RX_FMT_RGBA32 or RX_FMT_GRAY8 */
+  size_t nbytes;
+  std::vector<unsigned char>* buffer;                                       /* the pooled buffer which holds the pixels */
+};
+
+struct ImageLoaderJPGError {                                                /* libjpeg calls exit() on errors, we jump back into the decode function */
+  struct jpeg_error_mgr mgr;
+  jmp_buf jump;
+};
+
+class ImageLoader;
+
+struct ImageLoaderWorker {
+  ImageLoaderWorker();
+  ImageLoader* loader;
+  uv_thread_t thread;
+  struct jpeg_decompress_struct jpg;                                       /* reused for all jpgs this worker decodes */
+  ImageLoaderJPGError jpg_error;
+  std::vector<png_bytep> row_ptrs;                                         /* reused for all pngs this worker decodes */
+};
+
+void image_loader_thread_function(void* user);                              /* runs ImageLoader::decode() for a worker */
+
+class ImageLoader {
+ public:
+  ImageLoader(image_loader_cb cb, void* user = NULL);
+  ~ImageLoader();
+  bool start(int numThreads = IMAGE_LOADER_DEFAULT_NUM_THREADS);           /* starts the decode threads */
+  void stop();                                                              /* stops the threads; all requests are removed without calling the callback */
+  int load(std::string filename, int priority = 0, unsigned int maxWidth = 0, unsigned int maxHeight = 0, void* user = NULL, bool datapath = false);  /* adds a request, returns its id or -1 */
+  bool cancel(int id);                                                      /* removes the request from the queue or drops the result, returns false when it's already delivered */
+  void update();                                                            /* calls the callback for each finished request, call this often */
+  size_t getNumPending();                                                   /* number of requests that are queued or being decoded */
+  void decode(ImageLoaderWorker& worker);                                   /* the decode thread; don't call this yourself */
+
+ private:
+  bool decodeJPG(ImageLoaderWorker& worker, ImageLoaderRequest* req);
+  bool decodePNG(ImageLoaderWorker& worker, ImageLoaderRequest* req);
+  bool decodeTGA(ImageLoaderRequest* req);
+  bool allocatePixels(ImageLoaderRequest* req, unsigned int w, unsigned int h, unsigned int fmt);  /* gets a pooled buffer for the pixels */
+  void releaseRequest(ImageLoaderRequest* req);                             /* puts the buffer and request back in their pools; lock the mutex first */
+  void releaseBuffer(std::vector<unsigned char>* buffer);                   /* puts the buffer back in the pool; lock the mutex first */
+
+ public:
+  image_loader_cb cb_loaded;
+  void* cb_user;
+  std::vector<ImageLoaderWorker*> workers;
+  std::vector<ImageLoaderRequest*> queue;                                   /* heap, ordered by priority and order */
+  std::vector<ImageLoaderRequest*> decoding;                                /* requests the workers are decoding */
+  std::vector<ImageLoaderRequest*> finished;                                /* decoded requests, delivered by update() */
+  std::vector<ImageLoaderRequest*> delivering;                              /* requests we're delivering in update(), swapped with finished */
+  std::vector<ImageLoaderRequest*> free_requests;
+  std::vector<std::vector<unsigned char>*> free_buffers;
+  uv_mutex_t mutex;                                                         /* protects all the queues and pools above */
+  uv_cond_t cond;                                                           /* signalled when there is a new request or when we must stop */
+  int request_id;
+  uint64_t request_order;
+  bool must_stop;
+  bool is_started;
+};
+
+inline size_t ImageLoader::getNumPending() {
+  uv_mutex_lock(&mutex);
+  size_t n = queue.size() + decoding.size();
+  uv_mutex_unlock(&mutex);
+  return n;
+}
+
+#endif
@@ -52,7 +52,7 @@ class JPG {
 
   /* libjpg types */
   J_COLOR_SPACE color_space;
-  J_DCT_METHOD dct_method;
+  J_DCT_METHOD dct_method;                                                           /* used by save(): JDCT_ISLOW, JDCT_IFAST (fastest) or JDCT_FLOAT */
   J_DITHER_MODE dither_mode; 
 };
 
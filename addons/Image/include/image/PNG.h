@@ -3,6 +3,7 @@
 
 #include <stdio.h>
 #include <string>
+#include <vector>
 #include <png.h>
 
 #define PNG_ERR_LOAD_NO_FILE "Cannot load file, does it exist: %s"
@@ -57,6 +58,9 @@ public:
   png_uint_32 bit_depth;                                                   /* bit depth per color channels, so e.g. per R, per G, per B etc.. */
   png_uint_32 color_type;                                                  /* color type: RGB, RGBA, Luminance, Luminance alpha, palette, etc.. */
   png_uint_32 num_channels;                                                /* number of channels, e.g. 3 for RGB, 1 for grayscale */
+  int compression_level;                                                   /* zlib compression level used by save(), 0 (none) - 9 (best), -1 = zlib default; 1 is a lot faster when you dump frames */
+  int filter;                                                              /* row filters used by save(): PNG_FILTER_NONE, PNG_FILTER_SUB, PNG_FILTER_UP, PNG_FILTER_AVG, PNG_FILTER_PAETH or'd together, or PNG_ALL_FILTERS; -1 = libpng default */
+  std::vector<png_bytep> row_ptrs;                                         /* reused by save() */
 };
 
 
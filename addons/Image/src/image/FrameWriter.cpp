@@ -0,0 +1,393 @@
+#include <roxlu/core/Utils.h>
+#include <image/FrameWriter.h>
+
+// ------------------------------------------------
+
+static void frame_writer_jpg_error_exit(j_common_ptr cinfo) {
+  FrameWriterJPGError* err = (FrameWriterJPGError*)cinfo->err;
+  longjmp(err->jump, 1);
+}
+
+void frame_writer_thread_function(void* user) {
+  FrameWriterWorker* worker = static_cast<FrameWriterWorker*>(user);
+  worker->writer->encode(*worker);
+}
+
+// ------------------------------------------------
+
+FrameWriterSettings::FrameWriterSettings()
+  :type(FRAME_WRITER_TYPE_NONE)
+  ,datapath(false)
+  ,width(0)
+  ,height(0)
+  ,fmt(RX_FMT_RGB24)
+  ,flip(false)
+  ,num_threads(4)
+  ,max_frames(16)
+  ,drop_frames(false)
+  ,png_compression_level(1)
+  ,png_filter(PNG_FILTER_SUB)
+  ,jpg_quality(80)
+  ,jpg_dct_method(JDCT_IFAST)
+{
+}
+
+FrameWriterWorker::FrameWriterWorker()
+  :writer(NULL)
+{
+}
+
+// ------------------------------------------------
+
+FrameWriter::FrameWriter()
+  :stride(0)
+  ,nbytes(0)
+  ,num_frames(0)
+  ,num_written(0)
+  ,num_dropped(0)
+  ,must_stop(false)
+  ,is_started(false)
+{
+  uv_mutex_init(&mutex);
+  uv_cond_init(&cond_frame);
+  uv_cond_init(&cond_space);
+}
+
+FrameWriter::~FrameWriter() {
+  stop();
+
+  for(std::vector<FrameWriterFrame*>::iterator it = free_frames.begin(); it != free_frames.end(); ++it) {
+    delete *it;
+  }
+  free_frames.clear();
+
+  uv_mutex_destroy(&mutex);
+  uv_cond_destroy(&cond_frame);
+  uv_cond_destroy(&cond_space);
+}
+
+bool FrameWriter::setup(const FrameWriterSettings& cfg) {
+
+  if(is_started) {
+    RX_ERROR(ERR_FW_ALREADY_STARTED);
+    return false;
+  }
+
+  if(cfg.type != FRAME_WRITER_TYPE_PNG && cfg.type != FRAME_WRITER_TYPE_JPG) {
+    RX_ERROR(ERR_FW_TYPE, cfg.type);
+    return false;
+  }
+
+  if(!cfg.width || !cfg.height) {
+    RX_ERROR(ERR_FW_SIZE, cfg.width, cfg.height);
+    return false;
+  }
+
+  if(!cfg.filepath.size()) {
+    RX_ERROR(ERR_FW_FILEPATH);
+    return false;
+  }
+
+  if(cfg.num_threads < 1) {
+    RX_ERROR(ERR_FW_NUM_THREADS, cfg.num_threads);
+    return false;
+  }
+
+  if(cfg.max_frames < 1) {
+    RX_ERROR(ERR_FW_MAX_FRAMES, cfg.max_frames);
+    return false;
+  }
+
+  int bpp = 0;
+  switch(cfg.fmt) {
+    case RX_FMT_GRAY8:  { bpp = 1; break; }
+    case RX_FMT_RGB24:  { bpp = 3; break; }
+    case RX_FMT_RGBA32: { bpp = 4; break; }
+    default: {
+      RX_ERROR(ERR_FW_FMT, cfg.fmt);
+      return false;
+    }
+  }
+
+  if(cfg.type == FRAME_WRITER_TYPE_JPG && cfg.fmt == RX_FMT_RGBA32) {
+    RX_ERROR(ERR_FW_JPG_FMT);
+    return false;
+  }
+
+  settings = cfg;
+  if(settings.datapath) {
+    settings.filepath = rx_to_data_path(settings.filepath);
+  }
+
+  stride = settings.width * bpp;
+  nbytes = stride * settings.height;
+  return true;
+}
+
+bool FrameWriter::start() {
+
+  if(is_started) {
+    RX_ERROR(ERR_FW_ALREADY_STARTED);
+    return false;
+  }
+
+  if(!nbytes) {
+    RX_ERROR(ERR_FW_SIZE, settings.width, settings.height);
+    return false;
+  }
+
+  num_frames = 0;
+  num_written = 0;
+  num_dropped = 0;
+  written.clear();
+  must_stop = false;
+  is_started = true;
+
+  for(int i = 0; i < settings.num_threads; ++i) {
+    FrameWriterWorker* worker = new FrameWriterWorker();
+    worker->writer = this;
+    worker->filepath.resize(settings.filepath.size() + 64);
+    worker->file_buffer.resize(1024 * 1024);
+    worker->jpg.err = jpeg_std_error(&worker->jpg_error.mgr);
+    worker->jpg_error.mgr.error_exit = frame_writer_jpg_error_exit;
+    jpeg_create_compress(&worker->jpg);
+    workers.push_back(worker);
+    uv_thread_create(&worker->thread, frame_writer_thread_function, worker);
+  }
+
+  return true;
+}
+
+void FrameWriter::stop() {
+
+  if(!is_started) {
+    return;
+  }
+
+  uv_mutex_lock(&mutex);
+  must_stop = true;
+  uv_cond_broadcast(&cond_frame);
+  uv_mutex_unlock(&mutex);
+
+  for(std::vector<FrameWriterWorker*>::iterator it = workers.begin(); it != workers.end(); ++it) {
+    FrameWriterWorker* worker = *it;
+    uv_thread_join(&worker->thread);
+    jpeg_destroy_compress(&worker->jpg);
+    delete worker;
+  }
+  workers.clear();
+
+  is_started = false;
+}
+
+bool FrameWriter::addFrame(unsigned char* pixels, size_t numBytes) {
+
+  if(!is_started) {
+    RX_ERROR(ERR_FW_NOT_STARTED);
+    return false;
+  }
+
+  if(numBytes != nbytes) {
+    RX_ERROR(ERR_FW_NBYTES, numBytes, nbytes);
+    return false;
+  }
+
+  FrameWriterFrame* frame = NULL;
+
+  uv_mutex_lock(&mutex);
+  {
+    while(int(queue.size()) >= settings.max_frames) {
+      if(settings.drop_frames) {
+        num_dropped++;
+        uv_mutex_unlock(&mutex);
+        return false;
+      }
+      uv_cond_wait(&cond_space, &mutex);
+    }
+
+    if(free_frames.size()) {
+      frame = free_frames.back();
+      free_frames.pop_back();
+    }
+    else {
+      frame = new FrameWriterFrame();
+    }
+
+    frame->number = num_frames++;
+  }
+  uv_mutex_unlock(&mutex);
+
+  // copy without holding the lock; the frame isn't in the queue yet
+  frame->pixels.resize(nbytes);
+  memcpy(&frame->pixels[0], pixels, nbytes);
+
+  uv_mutex_lock(&mutex);
+  queue.push_back(frame);
+  uv_cond_signal(&cond_frame);
+  uv_mutex_unlock(&mutex);
+
+  return true;
+}
+
+// Encode thread
+// ------------------------------------------------
+
+void FrameWriter::encode(FrameWriterWorker& worker) {
+
+  while(true) {
+
+    // when we must stop, we first write all queued frames
+    uv_mutex_lock(&mutex);
+    while(!must_stop && !queue.size()) {
+      uv_cond_wait(&cond_frame, &mutex);
+    }
+
+    if(!queue.size()) {
+      uv_mutex_unlock(&mutex);
+      break;
+    }
+
+    FrameWriterFrame* frame = queue.front();
+    queue.pop_front();
+    uv_cond_signal(&cond_space);
+    uv_mutex_unlock(&mutex);
+
+    snprintf(&worker.filepath[0], worker.filepath.size(), settings.filepath.c_str(), (unsigned long long)frame->number);
+    setRowPointers(worker, frame);
+
+    if(settings.type == FRAME_WRITER_TYPE_PNG) {
+      writePNG(worker, frame, &worker.filepath[0]);
+    }
+    else {
+      writeJPG(worker, frame, &worker.filepath[0]);
+    }
+
+    // a failed frame counts as written, so num_written doesn't get stuck
+    uv_mutex_lock(&mutex);
+    {
+      if(frame->number == num_written) {
+        num_written++;
+        while(written.size() && *written.begin() == num_written) {
+          written.erase(written.begin());
+          num_written++;
+        }
+      }
+      else {
+        written.insert(frame->number);
+      }
+      free_frames.push_back(frame);
+    }
+    uv_mutex_unlock(&mutex);
+  }
+}
+
+void FrameWriter::setRowPointers(FrameWriterWorker& worker, FrameWriterFrame* frame) {
+  worker.row_ptrs.resize(settings.height);
+  for(unsigned int i = 0; i < settings.height; ++i) {
+    unsigned int row = (settings.flip) ? (settings.height - 1 - i) : i;
+    worker.row_ptrs[i] = &frame->pixels[row * stride];
+  }
+}
+
+bool FrameWriter::writePNG(FrameWriterWorker& worker, FrameWriterFrame* frame, const char* filepath) {
+
+  FILE* fp = fopen(filepath, "wb");
+  if(!fp) {
+    RX_ERROR(ERR_FW_FOPEN, filepath);
+    return false;
+  }
+
+  setvbuf(fp, &worker.file_buffer[0], _IOFBF, worker.file_buffer.size());
+
+  png_structp png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+  if(!png_ptr) {
+    RX_ERROR(PNG_ERR_CREATE_WRITE_ST);
+    fclose(fp);
+    return false;
+  }
+
+  png_infop info_ptr = png_create_info_struct(png_ptr);
+  if(!info_ptr) {
+    RX_ERROR(PNG_ERR_CREATE_INFO_PTR);
+    png_destroy_write_struct(&png_ptr, NULL);
+    fclose(fp);
+    return false;
+  }
+
+  if(setjmp(png_jmpbuf(png_ptr))) {
+    RX_ERROR(ERR_FW_PNG, filepath);
+    png_destroy_write_struct(&png_ptr, &info_ptr);
+    fclose(fp);
+    return false;
+  }
+
+  int color_type = PNG_COLOR_TYPE_RGB;
+  if(settings.fmt == RX_FMT_GRAY8) {
+    color_type = PNG_COLOR_TYPE_GRAY;
+  }
+  else if(settings.fmt == RX_FMT_RGBA32) {
+    color_type = PNG_COLOR_TYPE_RGB_ALPHA;
+  }
+
+  png_init_io(png_ptr, fp);
+  png_set_IHDR(png_ptr, info_ptr, settings.width, settings.height, 8, color_type,
+               PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+  png_set_compression_level(png_ptr, settings.png_compression_level);
+  png_set_filter(png_ptr, PNG_FILTER_TYPE_BASE, settings.png_filter);
+  png_set_rows(png_ptr, info_ptr, &worker.row_ptrs[0]);
+  png_write_png(png_ptr, info_ptr, PNG_TRANSFORM_IDENTITY, NULL);
+
+  png_destroy_write_struct(&png_ptr, &info_ptr);
+  fclose(fp);
+
+  return true;
+}
+
+bool FrameWriter::writeJPG(FrameWriterWorker& worker, FrameWriterFrame* frame, const char* filepath) {
+
+  FILE* fp = fopen(filepath, "wb");
+  if(!fp) {
+    RX_ERROR(ERR_FW_FOPEN, filepath);
+    return false;
+  }
+
+  setvbuf(fp, &worker.file_buffer[0], _IOFBF, worker.file_buffer.size());
+
+  struct jpeg_compress_struct& cinfo = worker.jpg;
+
+  if(setjmp(worker.jpg_error.jump)) {
+    char msg[JMSG_LENGTH_MAX];
+    (*cinfo.err->format_message)((j_common_ptr)&cinfo, msg);
+    RX_ERROR(ERR_FW_JPG, filepath, msg);
+    jpeg_abort_compress(&cinfo);
+    fclose(fp);
+    return false;
+  }
+
+  jpeg_stdio_dest(&cinfo, fp);
+
+  cinfo.image_width = settings.width;
+  cinfo.image_height = settings.height;
+  if(settings.fmt == RX_FMT_GRAY8) {
+    cinfo.input_components = 1;
+    cinfo.in_color_space = JCS_GRAYSCALE;
+  }
+  else {
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_RGB;
+  }
+
+  jpeg_set_defaults(&cinfo);
+  cinfo.dct_method = settings.jpg_dct_method;
+  jpeg_set_quality(&cinfo, settings.jpg_quality, TRUE);
+  jpeg_start_compress(&cinfo, TRUE);
+
+  while(cinfo.next_scanline < cinfo.image_height) {
+    jpeg_write_scanlines(&cinfo, &worker.row_ptrs[cinfo.next_scanline], cinfo.image_height - cinfo.next_scanline);
+  }
+
+  jpeg_finish_compress(&cinfo);
+  fclose(fp);
+
+  return true;
+}
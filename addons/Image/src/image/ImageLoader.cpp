@@ -0,0 +1,586 @@
+#include <algorithm>
+#include <math.h>
+#include <roxlu/core/Utils.h>
+#include <image/Image.h>
+#include <image/ImageLoader.h>
+
+// ------------------------------------------------
+
+struct ImageLoaderRequestCompare {                                          /* max-heap: highest priority first, then the oldest request */
+  bool operator()(const ImageLoaderRequest* a, const ImageLoaderRequest* b) const {
+    if(a->priority != b->priority) {
+      return a->priority < b->priority;
+    }
+    return a->order > b->order;
+  }
+};
+
+static void image_loader_jpg_error_exit(j_common_ptr cinfo) {
+  ImageLoaderJPGError* err = (ImageLoaderJPGError*)cinfo->err;
+  longjmp(err->jump, 1);
+}
+
+void image_loader_thread_function(void* user) {
+  ImageLoaderWorker* worker = static_cast<ImageLoaderWorker*>(user);
+  worker->loader->decode(*worker);
+}
+
+// ------------------------------------------------
+
+ImageLoaderRequest::ImageLoaderRequest()
+  :buffer(NULL)
+{
+  reset();
+}
+
+void ImageLoaderRequest::reset() {
+  id = -1;
+  filename.clear();
+  priority = 0;
+  max_width = 0;
+  max_height = 0;
+  user = NULL;
+  order = 0;
+  is_cancelled = false;
+  pixels = NULL;
+  width = 0;
+  height = 0;
+  stride = 0;
+  fmt = RX_FMT_NONE;
+  nbytes = 0;
+  buffer = NULL;
+}
+
+ImageLoaderWorker::ImageLoaderWorker()
+  :loader(NULL)
+{
+}
+
+// ------------------------------------------------
+
+ImageLoader::ImageLoader(image_loader_cb cb, void* user)
+  :cb_loaded(cb)
+  ,cb_user(user)
+  ,request_id(0)
+  ,request_order(0)
+  ,must_stop(false)
+  ,is_started(false)
+{
+  uv_mutex_init(&mutex);
+  uv_cond_init(&cond);
+}
+
+ImageLoader::~ImageLoader() {
+  stop();
+
+  for(std::vector<ImageLoaderRequest*>::iterator it = free_requests.begin(); it != free_requests.end(); ++it) {
+    delete *it;
+  }
+  free_requests.clear();
+
+  for(std::vector<std::vector<unsigned char>*>::iterator it = free_buffers.begin(); it != free_buffers.end(); ++it) {
+    delete *it;
+  }
+  free_buffers.clear();
+
+  uv_mutex_destroy(&mutex);
+  uv_cond_destroy(&cond);
+}
+
+bool ImageLoader::start(int numThreads) {
+
+  if(is_started) {
+    RX_ERROR(ERR_IMGL_ALREADY_STARTED);
+    return false;
+  }
+
+  if(numThreads < 1) {
+    RX_ERROR(ERR_IMGL_NUM_THREADS, numThreads);
+    return false;
+  }
+
+  must_stop = false;
+  is_started = true;
+
+  for(int i = 0; i < numThreads; ++i) {
+    ImageLoaderWorker* worker = new ImageLoaderWorker();
+    worker->loader = this;
+    worker->jpg.err = jpeg_std_error(&worker->jpg_error.mgr);
+    worker->jpg_error.mgr.error_exit = image_loader_jpg_error_exit;
+    jpeg_create_decompress(&worker->jpg);
+    workers.push_back(worker);
+    uv_thread_create(&worker->thread, image_loader_thread_function, worker);
+  }
+
+  return true;
+}
+
+void ImageLoader::stop() {
+
+  if(!is_started) {
+    return;
+  }
+
+  uv_mutex_lock(&mutex);
+  must_stop = true;
+  uv_cond_broadcast(&cond);
+  uv_mutex_unlock(&mutex);
+
+  for(std::vector<ImageLoaderWorker*>::iterator it = workers.begin(); it != workers.end(); ++it) {
+    ImageLoaderWorker* worker = *it;
+    uv_thread_join(&worker->thread);
+    jpeg_destroy_decompress(&worker->jpg);
+    delete worker;
+  }
+  workers.clear();
+
+  uv_mutex_lock(&mutex);
+  {
+    for(std::vector<ImageLoaderRequest*>::iterator it = queue.begin(); it != queue.end(); ++it) {
+      releaseRequest(*it);
+    }
+    for(std::vector<ImageLoaderRequest*>::iterator it = finished.begin(); it != finished.end(); ++it) {
+      releaseRequest(*it);
+    }
+    queue.clear();
+    finished.clear();
+  }
+  uv_mutex_unlock(&mutex);
+
+  is_started = false;
+}
+
+int ImageLoader::load(std::string filename, int priority, unsigned int maxWidth, unsigned int maxHeight, void* user, bool datapath) {
+
+  if(!is_started) {
+    RX_ERROR(ERR_IMGL_NOT_STARTED);
+    return -1;
+  }
+
+  if(datapath) {
+    filename = rx_to_data_path(filename);
+  }
+
+  int id = -1;
+
+  uv_mutex_lock(&mutex);
+  {
+    ImageLoaderRequest* req = NULL;
+    if(free_requests.size()) {
+      req = free_requests.back();
+      free_requests.pop_back();
+    }
+    else {
+      req = new ImageLoaderRequest();
+    }
+
+    id = ++request_id;
+    req->id = id;
+    req->filename = filename;
+    req->priority = priority;
+    req->max_width = maxWidth;
+    req->max_height = maxHeight;
+    req->user = user;
+    req->order = request_order++;
+
+    queue.push_back(req);
+    std::push_heap(queue.begin(), queue.end(), ImageLoaderRequestCompare());
+    uv_cond_signal(&cond);
+  }
+  uv_mutex_unlock(&mutex);
+
+  return id;
+}
+
+bool ImageLoader::cancel(int id) {
+  bool found = false;
+
+  uv_mutex_lock(&mutex);
+  {
+    for(std::vector<ImageLoaderRequest*>::iterator it = queue.begin(); it != queue.end(); ++it) {
+      if((*it)->id == id) {
+        releaseRequest(*it);
+        queue.erase(it);
+        std::make_heap(queue.begin(), queue.end(), ImageLoaderRequestCompare());
+        found = true;
+        break;
+      }
+    }
+
+    // the worker drops the result when it's ready
+    for(std::vector<ImageLoaderRequest*>::iterator it = decoding.begin(); !found && it != decoding.end(); ++it) {
+      if((*it)->id == id) {
+        (*it)->is_cancelled = true;
+        found = true;
+        break;
+      }
+    }
+
+    for(std::vector<ImageLoaderRequest*>::iterator it = finished.begin(); !found && it != finished.end(); ++it) {
+      if((*it)->id == id) {
+        releaseRequest(*it);
+        finished.erase(it);
+        found = true;
+        break;
+      }
+    }
+  }
+  uv_mutex_unlock(&mutex);
+
+  return found;
+}
+
+void ImageLoader::update() {
+
+  uv_mutex_lock(&mutex);
+  delivering.swap(finished);
+  uv_mutex_unlock(&mutex);
+
+  if(!delivering.size()) {
+    return;
+  }
+
+  for(std::vector<ImageLoaderRequest*>::iterator it = delivering.begin(); it != delivering.end(); ++it) {
+    cb_loaded(*it, cb_user);
+  }
+
+  uv_mutex_lock(&mutex);
+  for(std::vector<ImageLoaderRequest*>::iterator it = delivering.begin(); it != delivering.end(); ++it) {
+    releaseRequest(*it);
+  }
+  delivering.clear();
+  uv_mutex_unlock(&mutex);
+}
+
+// Decode thread
+// ------------------------------------------------
+
+void ImageLoader::decode(ImageLoaderWorker& worker) {
+
+  while(true) {
+
+    uv_mutex_lock(&mutex);
+    while(!must_stop && !queue.size()) {
+      uv_cond_wait(&cond, &mutex);
+    }
+
+    if(must_stop) {
+      uv_mutex_unlock(&mutex);
+      break;
+    }
+
+    std::pop_heap(queue.begin(), queue.end(), ImageLoaderRequestCompare());
+    ImageLoaderRequest* req = queue.back();
+    queue.pop_back();
+    decoding.push_back(req);
+    uv_mutex_unlock(&mutex);
+
+    std::string ext = rx_get_file_ext(req->filename);
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+
+    bool r = false;
+    if(ext == "jpg" || ext == "jpeg") {
+      r = decodeJPG(worker, req);
+    }
+    else if(ext == "png") {
+      r = decodePNG(worker, req);
+    }
+    else if(ext == "tga") {
+      r = decodeTGA(req);
+    }
+    else {
+      RX_ERROR(ERR_IMGL_UNSUPPORTED_EXT, req->filename.c_str());
+    }
+
+    uv_mutex_lock(&mutex);
+    {
+      decoding.erase(std::find(decoding.begin(), decoding.end(), req));
+
+      if(req->is_cancelled) {
+        releaseRequest(req);
+      }
+      else {
+        if(!r) {
+          releaseBuffer(req->buffer);
+          req->buffer = NULL;
+          req->pixels = NULL;
+          req->nbytes = 0;
+        }
+        finished.push_back(req);
+      }
+    }
+    uv_mutex_unlock(&mutex);
+  }
+}
+
+bool ImageLoader::decodeJPG(ImageLoaderWorker& worker, ImageLoaderRequest* req) {
+
+  FILE* fp = fopen(req->filename.c_str(), "rb");
+  if(!fp) {
+    RX_ERROR(ERR_IMGL_FOPEN, req->filename.c_str());
+    return false;
+  }
+
+  struct jpeg_decompress_struct& cinfo = worker.jpg;
+
+  if(setjmp(worker.jpg_error.jump)) {
+    char msg[JMSG_LENGTH_MAX];
+    (*cinfo.err->format_message)((j_common_ptr)&cinfo, msg);
+    RX_ERROR(ERR_IMGL_JPG, req->filename.c_str(), msg);
+    jpeg_abort_decompress(&cinfo);
+    fclose(fp);
+    return false;
+  }
+
+  jpeg_stdio_src(&cinfo, fp);
+  jpeg_read_header(&cinfo, TRUE);
+
+  unsigned int fmt = RX_FMT_RGB24;
+  if(cinfo.jpeg_color_space == JCS_GRAYSCALE) {
+    cinfo.out_color_space = JCS_GRAYSCALE;
+    fmt = RX_FMT_GRAY8;
+  }
+  else if(cinfo.jpeg_color_space == JCS_YCbCr || cinfo.jpeg_color_space == JCS_RGB) {
+    cinfo.out_color_space = JCS_RGB;
+  }
+  else {
+    RX_ERROR(ERR_IMGL_JPG_COLOR_SPACE, req->filename.c_str());
+    jpeg_abort_decompress(&cinfo);
+    fclose(fp);
+    return false;
+  }
+
+  // scale by N/8 in the DCT domain, so that the result is just >= max_width x max_height
+  if(req->max_width || req->max_height) {
+    double sx = double(req->max_width) / cinfo.image_width;
+    double sy = double(req->max_height) / cinfo.image_height;
+    unsigned int num = (unsigned int)ceil(std::max<double>(sx, sy) * 8.0);
+    num = std::max<unsigned int>(1, std::min<unsigned int>(8, num));
+    cinfo.scale_num = num;
+    cinfo.scale_denom = 8;
+    if(num < 8) {
+      cinfo.dct_method = JDCT_IFAST;
+    }
+  }
+
+  jpeg_start_decompress(&cinfo);
+
+  if(!allocatePixels(req, cinfo.output_width, cinfo.output_height, fmt)) {
+    jpeg_abort_decompress(&cinfo);
+    fclose(fp);
+    return false;
+  }
+
+  while(cinfo.output_scanline < cinfo.output_height) {
+    JSAMPROW row = req->pixels + cinfo.output_scanline * req->stride;
+    jpeg_read_scanlines(&cinfo, &row, 1);
+  }
+
+  jpeg_finish_decompress(&cinfo);
+  fclose(fp);
+
+  return true;
+}
+
+bool ImageLoader::decodePNG(ImageLoaderWorker& worker, ImageLoaderRequest* req) {
+
+  FILE* fp = fopen(req->filename.c_str(), "rb");
+  if(!fp) {
+    RX_ERROR(ERR_IMGL_FOPEN, req->filename.c_str());
+    return false;
+  }
+
+  unsigned char sig[8];
+  if(fread(sig, 1, 8, fp) != 8 || !png_check_sig(sig, 8)) {
+    RX_ERROR(ERR_IMGL_PNG_SIG, req->filename.c_str());
+    fclose(fp);
+    return false;
+  }
+
+  png_structp png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+  if(!png_ptr) {
+    RX_ERROR(PNG_ERR_CREATE_READ_ST);
+    fclose(fp);
+    return false;
+  }
+
+  png_infop info_ptr = png_create_info_struct(png_ptr);
+  if(!info_ptr) {
+    RX_ERROR(PNG_ERR_CREATE_INFO_PTR);
+    png_destroy_read_struct(&png_ptr, NULL, NULL);
+    fclose(fp);
+    return false;
+  }
+
+#if !defined(_WIN32)
+  if(setjmp(png_jmpbuf(png_ptr))) {
+    RX_ERROR(ERR_IMGL_PNG, req->filename.c_str());
+    png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
+    fclose(fp);
+    return false;
+  }
+#endif
+
+  png_init_io(png_ptr, fp);
+  png_set_sig_bytes(png_ptr, 8);
+  png_read_info(png_ptr, info_ptr);
+
+  // convert everything to 8 bit gray, rgb or rgba
+  png_uint_32 color_type = png_get_color_type(png_ptr, info_ptr);
+  png_uint_32 bit_depth = png_get_bit_depth(png_ptr, info_ptr);
+  bool has_trns = png_get_valid(png_ptr, info_ptr, PNG_INFO_tRNS);
+
+  if(bit_depth == 16) {
+    png_set_strip_16(png_ptr);
+  }
+  if(color_type == PNG_COLOR_TYPE_PALETTE) {
+    png_set_palette_to_rgb(png_ptr);
+  }
+  if(color_type == PNG_COLOR_TYPE_GRAY && bit_depth < 8) {
+    png_set_expand_gray_1_2_4_to_8(png_ptr);
+  }
+  if(has_trns) {
+    png_set_tRNS_to_alpha(png_ptr);
+  }
+  if(color_type == PNG_COLOR_TYPE_GRAY_ALPHA || (color_type == PNG_COLOR_TYPE_GRAY && has_trns)) {
+    png_set_gray_to_rgb(png_ptr);
+  }
+
+  png_read_update_info(png_ptr, info_ptr);
+
+  unsigned int fmt = RX_FMT_NONE;
+  png_uint_32 num_channels = png_get_channels(png_ptr, info_ptr);
+  switch(num_channels) {
+    case 1: { fmt = RX_FMT_GRAY8;  break; }
+    case 3: { fmt = RX_FMT_RGB24;  break; }
+    case 4: { fmt = RX_FMT_RGBA32; break; }
+    default: {
+      RX_ERROR(ERR_IMGL_PNG_CHANNELS, num_channels, req->filename.c_str());
+      png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
+      fclose(fp);
+      return false;
+    }
+  }
+
+  if(!allocatePixels(req, png_get_image_width(png_ptr, info_ptr), png_get_image_height(png_ptr, info_ptr), fmt)) {
+    png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
+    fclose(fp);
+    return false;
+  }
+
+  worker.row_ptrs.resize(req->height);
+  for(unsigned int i = 0; i < req->height; ++i) {
+    worker.row_ptrs[i] = req->pixels + i * req->stride;
+  }
+
+  png_read_image(png_ptr, &worker.row_ptrs[0]);
+  png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
+  fclose(fp);
+
+  return true;
+}
+
+bool ImageLoader::decodeTGA(ImageLoaderRequest* req) {
+
+  TGA tga;
+  if(!tga.load(req->filename)) {
+    return false;
+  }
+
+  unsigned int fmt = RX_FMT_NONE;
+  if(tga.getNumChannels() == 4) {
+    fmt = RX_FMT_RGBA32;
+  }
+  else if(tga.getNumChannels() == 3) {
+    fmt = RX_FMT_RGB24;
+  }
+  else {
+    RX_ERROR(ERR_IMGL_TGA_CHANNELS, tga.getNumChannels(), req->filename.c_str());
+    return false;
+  }
+
+  if(!allocatePixels(req, tga.getWidth(), tga.getHeight(), fmt)) {
+    return false;
+  }
+
+  memcpy(req->pixels, tga.getPixels(), req->nbytes);
+  return true;
+}
+
+bool ImageLoader::allocatePixels(ImageLoaderRequest* req, unsigned int w, unsigned int h, unsigned int fmt) {
+
+  unsigned int bpp = 0;
+  switch(fmt) {
+    case RX_FMT_GRAY8:  { bpp = 1; break; }
+    case RX_FMT_RGB24:  { bpp = 3; break; }
+    case RX_FMT_RGBA32: { bpp = 4; break; }
+    default: {
+      RX_ERROR(ERR_IMG_UNSUPPORTED_FORMAT);
+      return false;
+    }
+  }
+
+  if(!w || !h) {
+    RX_ERROR(PNG_ERR_SIZE, w, h);
+    return false;
+  }
+
+  req->width = w;
+  req->height = h;
+  req->fmt = fmt;
+  req->stride = w * bpp;
+  req->nbytes = size_t(req->stride) * h;
+
+  // use the smallest free buffer that is big enough, otherwise grow the biggest one
+  uv_mutex_lock(&mutex);
+  {
+    std::vector<std::vector<unsigned char>*>::iterator best = free_buffers.end();
+    for(std::vector<std::vector<unsigned char>*>::iterator it = free_buffers.begin(); it != free_buffers.end(); ++it) {
+      if(best == free_buffers.end()) {
+        best = it;
+      }
+      else if((*it)->capacity() >= req->nbytes) {
+        if((*best)->capacity() < req->nbytes || (*it)->capacity() < (*best)->capacity()) {
+          best = it;
+        }
+      }
+      else if((*best)->capacity() < req->nbytes && (*it)->capacity() > (*best)->capacity()) {
+        best = it;
+      }
+    }
+
+    if(best != free_buffers.end()) {
+      req->buffer = *best;
+      free_buffers.erase(best);
+    }
+  }
+  uv_mutex_unlock(&mutex);
+
+  if(!req->buffer) {
+    req->buffer = new std::vector<unsigned char>();
+  }
+
+  req->buffer->resize(req->nbytes);
+  req->pixels = &(*req->buffer)[0];
+  return true;
+}
+
+void ImageLoader::releaseRequest(ImageLoaderRequest* req) {
+  releaseBuffer(req->buffer);
+  req->reset();
+  free_requests.push_back(req);
+}
+
+void ImageLoader::releaseBuffer(std::vector<unsigned char>* buffer) {
+
+  if(!buffer) {
+    return;
+  }
+
+  if(free_buffers.size() < IMAGE_LOADER_MAX_FREE_BUFFERS) {
+    free_buffers.push_back(buffer);
+  }
+  else {
+    delete buffer;
+  }
+}
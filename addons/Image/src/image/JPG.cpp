@@ -272,8 +272,7 @@ bool JPG::save(std::string filename, bool datapath) {
   
   jpeg_set_defaults(&cinfo); // after setting the default we can set our custom settings
   
-  // @todo > set compression level, dither, dct
-
+  cinfo.dct_method = dct_method;
   jpeg_set_quality(&cinfo, quality, TRUE /* limit to jpeg baseline values */);
 
   jpeg_start_compress(&cinfo, TRUE /* write complete data stream */); 
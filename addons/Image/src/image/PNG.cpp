@@ -13,11 +13,15 @@ PNG::PNG()
   ,num_bytes(0)
   ,stride(0)
   ,num_channels(0)
+  ,compression_level(-1)
+  ,filter(-1)
 {
 }
 
 PNG::PNG(const PNG& other)
   :pixels(NULL)
+  ,compression_level(other.compression_level)
+  ,filter(other.filter)
 {
   if(other.num_bytes > 0 && other.pixels) {
     pixels = new unsigned char[other.num_bytes];
@@ -49,6 +53,8 @@ PNG& PNG::operator=(const PNG& other) {
   num_bytes = other.num_bytes;
   stride = other.stride;
   num_channels = other.num_channels;
+  compression_level = other.compression_level;
+  filter = other.filter;
   return *this;
 }
 
@@ -285,21 +291,25 @@ bool PNG::save(std::string filename, bool datapath) {
                PNG_COMPRESSION_TYPE_DEFAULT, 
                PNG_FILTER_TYPE_DEFAULT);
 
-  png_bytep* row_ptrs = new png_bytep[height];
-  
- 
+  if(compression_level >= 0) {
+    png_set_compression_level(png_ptr, compression_level);
+  }
+
+  if(filter >= 0) {
+    png_set_filter(png_ptr, PNG_FILTER_TYPE_BASE, filter);
+  }
+
+  row_ptrs.resize(height);
   for(size_t j = 0; j < height; ++j) {
     row_ptrs[j] = pixels + (j * stride);
   }
 
   png_init_io(png_ptr, fp);
-  png_set_rows(png_ptr, info_ptr, row_ptrs);
+  png_set_rows(png_ptr, info_ptr, &row_ptrs[0]);
   png_write_png(png_ptr, info_ptr, PNG_TRANSFORM_IDENTITY, NULL);
 
   png_destroy_write_struct(&png_ptr, &info_ptr);
 
-  delete[] row_ptrs;
-
   fclose(fp);
 
   return true;
@@ -31,16 +31,24 @@ extern "C" {
 #define ERR_AVD_NO_VIDEO_STREAM "Cannot find a video stream"
 #define ERR_AVD_ALLOC_FRAME "Cannot allocate a avframe"
 #define ERR_AVD_COPY_VIDEO_CONTEXT "Cannot copy the video context: %s"
+#define ERR_AVD_NOT_OPEN "Cannot seek, the decoder is not opened"
+#define ERR_AVD_SEEK "Cannot seek to: %lld ms, error: %s"
 #define V_AVD_EOF "We've read the whole file!"
 #define V_AVD_STREAM_NOT_USED "The stream with index: %d is not used"
 
-struct AVDecoderFrame {
+class AVDecoder;
+
+struct AVDecoderFrame {                                          /* reference counted; frames are recycled by the AVDecoder which returned them, so never delete them, call release() */
   AVDecoderFrame();
   ~AVDecoderFrame();
+  void retain();                                                 /* increment the reference count (e.g. when you pass the frame to another thread) */
+  void release();                                                /* decrement the reference count; when it reaches zero the frame is returned to the pool of the decoder */
 
   AVFrame* frame;
   int64_t pts;                                                   /* the time in millis when we need to present  this packet */
   int type;                                                      /* the frame type AV_TYPE_NONE, AV_TYPE_VIDEO, AV_TYPE_AUDIO */
+  int refcount;
+  AVDecoder* decoder;                                            /* the decoder which owns this frame; when NULL we delete the frame when the refcount reaches zero */
 };
 
 class AVDecoder {
@@ -50,12 +58,20 @@ class AVDecoder {
   bool open(AVFormatContext* context);                           /* open using a custom setup AVFormatContext; which might be handy if you need to do your own I/O */
   bool open(std::string filename, bool datapath = false);        /* open a video file */
   bool close();                                                  /* closes the video file, resetting everything that was opened by open() */
-  AVDecoderFrame* decodeFrame(bool& isEOF);                      /* caller is responsilbe for freeing the returned frame. if no frame is found we return NULL.  */
+  AVDecoderFrame* decodeFrame(bool& isEOF);                      /* returns a frame from our pool with a refcount of 1; call release() when you're ready with it. returns NULL when the packet didn't give us a (video) frame */
+  bool seek(int64_t millis);                                     /* seek to the given time; the next frame returned by decodeFrame() is the first frame with a pts >= millis */
+  void setNumThreads(int n);                                     /* number of threads libav uses to decode (frame and slice threading); 0 = auto detect (default), 1 = no threading. call before open() */
   void print();                                                  /* print debug info */
   int getWidth();                                                /* get the width of the video stream */
   int getHeight();                                               /* get the height of the video stream */
   AVPixelFormat getPixelFormat();                                /* get the pixel format used by the video decoder */
   bool isOpen();                                                 /* returns true when the file has been opened correctly and not closed yet */
+  void retainFrame(AVDecoderFrame* f);                           /* used internally by AVDecoderFrame::retain() */
+  void releaseFrame(AVDecoderFrame* f);                          /* used internally by AVDecoderFrame::release(); puts the frame back into the pool when it's not used anymore */
+
+ private:
+  AVDecoderFrame* getFreeFrame();                                /* get a frame from the pool or allocate a new one */
+
  private:
 
   /* muxer */
@@ -66,6 +82,13 @@ class AVDecoder {
   AVCodec* video_codec;                                        
   AVCodecContext* video_codec_context;                         
   double video_time_millis;                                      /* the video time base in millis, used to set the pts in decodeFrame */
+  int num_threads;                                               /* see setNumThreads() */
+  bool is_flushing;                                              /* set when we've read all packets; we keep calling the decoder to get the delayed frames (frame threading adds a delay of one frame per thread) */
+  int64_t seek_target;                                           /* when >= 0, decodeFrame() drops all frames before this time (in millis), see seek() */
+
+  /* frame pool */
+  std::vector<AVDecoderFrame*> free_frames;                      /* frames which can be reused */
+  uv_mutex_t pool_mutex;                                         /* frames may be released from other threads */
 };
 
 
@@ -87,6 +110,10 @@ inline AVPixelFormat AVDecoder::getPixelFormat() {
   return video_stream->codec->pix_fmt;
 }
 
+inline void AVDecoder::setNumThreads(int n) {
+  num_threads = n;
+}
+
 inline bool AVDecoder::isOpen() {
   return format_context; // when the format_context is set we assume the file has been opened. in close() we set this to NULL.
 }
@@ -1,3 +1,23 @@
+/*
+
+  # AVPlayer
+
+  Decodes a video file in a separate thread and draws the frames using the
+  `VideoCaptureGLSurface`.
+
+  - The decoder thread lets libav decode with multiple threads (frame and slice
+    threading, see `AVPlayerSettings.num_decode_threads`).
+  - `AVPlayerFrame`s are preallocated and recycled through `free_frames`; the
+    `AVDecoderFrame`s are reference counted and recycled by the `AVDecoder`.
+  - When we need to convert the pixel format, the decoder thread hands the frame
+    to a pool of converter threads (`AVPlayerSettings.num_convert_threads`), each
+    with its own `SwsContext`. Frames stay in `decoded_frames` in presentation
+    order; draw() waits until the front frame is converted.
+  - `seek()` is frame accurate: we seek to the keyframe before the given time and
+    drop the frames before it. After play() and seek() we wait until
+    `AVPlayerSettings.num_preroll_frames` frames are ready before we start the clock.
+
+ */
 #ifndef ROXLU_LIBAV_AVPLAYER_H
 #define ROXLU_LIBAV_AVPLAYER_H
 
@@ -17,6 +37,10 @@ extern "C" {
 #define AVP_STATE_PLAY 1
 #define AVP_STATE_PAUSE 2
 
+#define AVP_FRAME_FREE 0                                      /* the frame is in the free list */
+#define AVP_FRAME_CONVERTING 1                                /* a converter thread is converting the pixel format */
+#define AVP_FRAME_READY 2                                     /* the frame can be drawn */
+
 
 #define ERR_AVP_ALREADY_SWS "We already have an SWS context; not creating another one."
 #define ERR_AVP_ALREADY_OPEN "We already opened the decoder"
@@ -29,23 +53,38 @@ extern "C" {
 #define ERR_AVP_ALLOC_SWS "Cannot initialize sws decoder."
 #define ERR_AVP_PREALLOC_NO_SWS "Trying to preallocate the AVPlayerFrames and we need an SWS context to convert between pixel formats, but the SWScontext isn't created yet.. or an error occured when creating the sws context. "
 #define ERR_AVP_INIT_FRAMES_EXIST "Cannot initialize the AVPlayer because we have some pre-allocated frames already. These should be removed first by calling `shutdown()` "
+#define ERR_AVP_SEEK_NOT_PLAYING "Cannot seek because we are not playing; call play() first"
 //#define V_AVP_THREAD_UNHANDLED_VIDEO_FRAME "The decoder thread got a AVDecoderFrame which has a AVFrame with wrong width/height/data; this can be some arbitrary frame that we don't need to handle "
 
 void avplayer_thread(void *user);
+void avplayer_convert_thread(void* user);
+
+class AVPlayer;
 
 struct AVPlayerFrame {                                        /* we decode in a separate thread, and when necessary we will convert the default pixel format of the video to the format specified in the AVPlayerSettings, this frame is used to store the data */
   AVPlayerFrame();
   ~AVPlayerFrame();
 
-  void reset();                                               /* deletes the decoder_frame if it's set; */
+  void reset();                                               /* releases the decoder_frame if it's set; */
 
   AVPicture pic;                                              /* is used when we need to convert between pixel formats; this member is only used for video frames. the AVPlayerFrame.data will be set to pic.data when we convert image data; else it will be set to the AVDecoderFrame.frame.data */
-  AVDecoderFrame* decoder_frame;                              /* reference to the decoder frame. after using the data of this frame, you must free this memory! */
+  AVDecoderFrame* decoder_frame;                              /* reference to the decoder frame; we release it in reset(), or directly after converting the pixel format */
   unsigned char* data;                                        /* the data of this frame. can be audio data, video data, etc.. */
-  bool is_free;                                               /* we preallocate and reuse memory so we don't need to allocate new memory for each frame */
+  int state;                                                  /* AVP_FRAME_FREE, AVP_FRAME_CONVERTING or AVP_FRAME_READY */
+  bool is_dropped;                                            /* set when we seek while a converter thread is working on this frame; the converter recycles it */
+  int64_t pts;                                                /* presentation time in millis; copied from the decoder frame because we release that one after converting */
   size_t nbytes;                                              /* the number fo bytes in data */
 };
 
+struct AVPlayerConverter {                                    /* converts the pixel format of decoded frames, in its own thread */
+  AVPlayerConverter();
+  ~AVPlayerConverter();
+
+  AVPlayer* player;
+  SwsContext* sws;                                            /* a SwsContext can't be shared between threads, so each converter has its own */
+  uv_thread_t thread;
+};
+
 class AVPlayer {
  public:
   AVPlayer();
@@ -55,6 +94,7 @@ class AVPlayer {
   bool play();
   bool stop();
   bool pause();
+  bool seek(uint64_t millis);                                    /* seek to the given time (frame accurate); can be used while playing or paused */
   void draw(int x, int y, int w = 0, int h = 0);
 
   void lock();
@@ -75,11 +115,13 @@ class AVPlayer {
 
   /* faking a ring buffer + contexts used when decoding */
   bool needsToConvertPixelFormat();                              /* returns true if we need to convert from the pixel format that the decoder uses by default and the one we have set in the settings.out_pixel_format */
-  bool initializeSWS();                                          /* creates a SwsContext if necessary */
-  bool getFreeFrames(std::vector<AVPlayerFrame*>& result);       /* will copy all free AVPlayerFrames into the given vector. returns true when there are free frames */                            
+  bool initializeSWS();                                          /* creates the converter threads (each with a SwsContext) if necessary */
+  void shutdownSWS();                                            /* stops the converter threads */
   bool allocateFrames();                                         /* this will allocate the AVPlayerFrames that we use when decodding. */
   void deleteFrames();                                           /* this function will deallocate the allocated AVPlayerFrames */
-  void freeFrames();                                             /* this will make all frames `free` again so the can be reused */
+  void recycleFrame(AVPlayerFrame* f);                           /* puts the frame back into the free list; lock() first */
+  void dropDecodedFrames();                                      /* recycles all decoded frames, e.g. when we seek; lock() first */
+  size_t getNumReadyFrames();                                    /* number of frames at the front of decoded_frames which can be drawn; lock() first */
 
  public:
   AVPlayerSettings settings;                                   /* see AVTypes; can be used to convert the decoders' default pixel format to some other supported format. On Mac it's recommended to use the AV_PIX_FMT_UYVY422 because that can be used by the `GL_YCBCR_422_APPLE` texture format */
@@ -91,15 +133,26 @@ class AVPlayer {
   uint64_t time_started;                                       /* used to calculate what frame we need to show/process */
   uint64_t time_paused;                                        /* we need to keep track of the moment we paused so we can correctly reset/adjust the time started when you call `play()` again. */
   bool must_stop;                                              /* used to stop the thread and shutdown */
+  bool must_seek;                                              /* set by seek(); the decoder thread performs the seek */
+  uint64_t seek_position;                                      /* the time we seek to (or 0 when we start playing) */
+  bool is_prerolling;                                          /* true after play() / seek() until we have `num_preroll_frames` ready frames */
+  bool must_show_frame;                                        /* show the next frame directly, also when paused; set after prerolling */
+  bool is_eof;                                                 /* set by the decoder thread when all frames have been decoded */
   VideoCaptureGLSurface gl_surface;                            /* we use the VideoCapture openGL surface class, because it has an optimized solution for drawing video data; on mac it uses a special texture format */
 
   /* decoding */
   AVDecoder dec;                                                /* the decoder that we use; this interfaces with libav */
   std::vector<AVPlayerFrame*> frames;                           /* we pre-allocate some frames so we have a small buffer that will hold decoded frames. we decode in a separate thread */
-  std::vector<AVPlayerFrame*> decoded_frames;                   /* when a frame is decoded (and maybe the pixel format converted) it's copied to this member that we used to draw the video to the screen */
+  std::vector<AVPlayerFrame*> free_frames;                      /* the frames which can be used by the decoder thread */
+  std::deque<AVPlayerFrame*> decoded_frames;                    /* decoded frames in presentation order; the front frame is drawn when it's ready and its pts has passed */
   int num_frames_to_allocate;                                   /* we pre-allocate and pre-decode a couple of (video) frames so we can playback the frames smoothly */                   
   int nbytes_video_frame;                                       /* number of bytes in the decoded video frames */
-  SwsContext* sws;
+
+  /* pixel format conversion */
+  std::vector<AVPlayerConverter*> converters;                   /* converter threads; empty when we don't need to convert */
+  std::deque<AVPlayerFrame*> convert_queue;                     /* frames which need to be converted */
+  uv_cond_t convert_cond;                                       /* signalled when there is a new frame in the convert_queue or when the converters must stop */
+  bool must_stop_converters;
  
   /* thread */
   uv_mutex_t mutex;
@@ -135,7 +188,7 @@ inline bool AVPlayer::isOpen() {
 
 inline void AVPlayerFrame::reset() {
   if(decoder_frame) {
-    delete decoder_frame;
+    decoder_frame->release();
     decoder_frame = NULL;
   }
 }
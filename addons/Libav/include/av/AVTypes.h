@@ -60,6 +60,9 @@ public:
 struct AVPlayerSettings {                      /* define the behavior of the AVPlayer. e.g. you can use it to convert the decoded frames from the default pixel format to some other format */
   AVPlayerSettings();
   AVPixelFormat out_pixel_format;              /* you can define the output pixel format when decoding. when you don't set this we use the default pixel format in which the video is encoded */
+  int num_decode_threads;                      /* number of threads libav uses to decode (frame + slice threading); 0 = auto detect */
+  int num_convert_threads;                     /* number of threads which convert the decoded frames to `out_pixel_format` (each has its own SwsContext) */
+  int num_preroll_frames;                      /* after play() and seek() we start the clock when this number of frames has been decoded */
 };
 
 inline bool AVEncoderSettings::useAudio() {
@@ -8,6 +8,8 @@ AVDecoderFrame::AVDecoderFrame()
   :frame(NULL)
   ,pts(0)
   ,type(AV_TYPE_NONE)
+  ,refcount(1)
+  ,decoder(NULL)
 {
 }
 
@@ -21,6 +23,26 @@ AVDecoderFrame::~AVDecoderFrame() {
     frame = NULL;
   }
 
+  decoder = NULL;
+}
+
+void AVDecoderFrame::retain() {
+  if(decoder) {
+    decoder->retainFrame(this);
+    return;
+  }
+  refcount++;
+}
+
+void AVDecoderFrame::release() {
+  if(decoder) {
+    decoder->releaseFrame(this);
+    return;
+  }
+  refcount--;
+  if(refcount <= 0) {
+    delete this;
+  }
 }
 
 // ---------------------------------------------
@@ -31,12 +53,25 @@ AVDecoder::AVDecoder()
   ,video_codec(NULL)
   ,video_codec_context(NULL)
   ,video_time_millis(0)
+  ,num_threads(0)
+  ,is_flushing(false)
+  ,seek_target(-1)
 {
+  uv_mutex_init(&pool_mutex);
   rx_init_libav();
 }
 
 AVDecoder::~AVDecoder() {
   close();
+
+  // all frames must have been released at this point
+  for(std::vector<AVDecoderFrame*>::iterator it = free_frames.begin(); it != free_frames.end(); ++it) {
+    (*it)->decoder = NULL;
+    delete *it;
+  }
+  free_frames.clear();
+
+  uv_mutex_destroy(&pool_mutex);
 }
 
 bool AVDecoder::open(AVFormatContext* ctx) {
@@ -127,6 +162,8 @@ bool AVDecoder::open(std::string filename, bool datapath) {
 
 
   video_codec_context->refcounted_frames = 1;   // see reference of avcodec_decode_video2
+  video_codec_context->thread_count = num_threads;
+  video_codec_context->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
 
 #if 0
   // There seems to be a bug in libav regarding copy_context and avcodec_close. 
@@ -176,6 +213,8 @@ bool AVDecoder::close() {
   video_stream = NULL;
   video_codec = NULL; 
   video_time_millis = 0;
+  is_flushing = false;
+  seek_target = -1;
 
   return true; 
 }
@@ -183,45 +222,127 @@ bool AVDecoder::close() {
 AVDecoderFrame* AVDecoder::decodeFrame(bool& isEOF) {
   isEOF = false;
 
-  AVDecoderFrame* decoder_frame = new AVDecoderFrame();
-  decoder_frame->frame = avcodec_alloc_frame();
-  if(!decoder_frame->frame) {
-    RX_ERROR(ERR_AVD_ALLOC_FRAME);
-    delete decoder_frame;
-    return NULL;
-  }
-  
   AVPacket packet;    
   av_init_packet(&packet);
+  packet.data = NULL;
+  packet.size = 0;
+
+  if(!is_flushing) {
+    if(av_read_frame(format_context, &packet) < 0) {
+      // feed empty packets to get the frames which are still buffered by the decoder
+      RX_VERBOSE(V_AVD_EOF);         
+      is_flushing = true;
+      av_init_packet(&packet);
+      packet.data = NULL;
+      packet.size = 0;
+    }
+    else if(packet.stream_index != video_stream->index) {
+      // this is where we could handle other streams (like audio / subtitle)
+      // RX_VERBOSE(V_AVD_STREAM_NOT_USED, packet.stream_index);
+      av_free_packet(&packet);
+      return NULL;
+    }
+  }
+
+  AVDecoderFrame* decoder_frame = getFreeFrame();
+  if(!decoder_frame) {
+    av_free_packet(&packet);
+    return NULL;
+  }
 
-  if(av_read_frame(format_context, &packet) < 0) {
-    RX_VERBOSE(V_AVD_EOF);         
-    isEOF = true;         
-    delete decoder_frame;
-    av_free_packet(&packet); 
+  int got_picture = 0;
+  avcodec_decode_video2(video_codec_context, decoder_frame->frame, &got_picture, &packet);
+  av_free_packet(&packet);   
+
+  if(!got_picture) {
+    decoder_frame->release();
+    isEOF = is_flushing;
     return NULL;
   }
 
-  if(packet.stream_index == video_stream->index) {
+  decoder_frame->pts = video_time_millis * decoder_frame->frame->pkt_pts;
+  decoder_frame->type = AV_TYPE_VIDEO;
 
-    int got_picture = 0;
-    int bytes_used = avcodec_decode_video2(video_codec_context, decoder_frame->frame, &got_picture, &packet);
-    if(got_picture) {
-      decoder_frame->pts = video_time_millis * decoder_frame->frame->pkt_pts;
-      decoder_frame->type = AV_TYPE_VIDEO;
-      
+  // after a seek we start decoding at the keyframe before the seek position; drop the frames before it
+  if(seek_target >= 0) {
+    if(decoder_frame->pts < seek_target) {
+      decoder_frame->release();
+      return NULL;
     }
+    seek_target = -1;
+  }
+
+  return decoder_frame;
+}
+
+bool AVDecoder::seek(int64_t millis) {
+  char err_msg[512];
+
+  if(!format_context || !video_stream || !video_codec_context) {
+    RX_ERROR(ERR_AVD_NOT_OPEN);
+    return false;
   }
-  else {
-    // this is where we could handle other streams (like audio / subtitle)
-    // RX_VERBOSE(V_AVD_STREAM_NOT_USED, packet.stream_index);
-    delete decoder_frame;
-    decoder_frame = NULL;
+
+  if(millis < 0) {
+    millis = 0;
   }
 
-  av_free_packet(&packet);   
+  int64_t ts = int64_t(millis / video_time_millis);
+  int r = av_seek_frame(format_context, video_stream->index, ts, AVSEEK_FLAG_BACKWARD);
+  if(r < 0) {
+    RX_ERROR(ERR_AVD_SEEK, (long long)millis, av_strerror(r, err_msg, sizeof(err_msg)));
+    return false;
+  }
 
-  return decoder_frame;
+  avcodec_flush_buffers(video_codec_context);
+  is_flushing = false;
+  seek_target = millis;
+
+  return true;
+}
+
+AVDecoderFrame* AVDecoder::getFreeFrame() {
+  AVDecoderFrame* f = NULL;
+
+  uv_mutex_lock(&pool_mutex);
+  if(free_frames.size()) {
+    f = free_frames.back();
+    free_frames.pop_back();
+  }
+  uv_mutex_unlock(&pool_mutex);
+
+  if(!f) {
+    f = new AVDecoderFrame();
+    f->frame = avcodec_alloc_frame();
+    if(!f->frame) {
+      RX_ERROR(ERR_AVD_ALLOC_FRAME);
+      delete f;
+      return NULL;
+    }
+    f->decoder = this;
+  }
+
+  f->refcount = 1;
+  f->pts = 0;
+  f->type = AV_TYPE_NONE;
+
+  return f;
+}
+
+void AVDecoder::retainFrame(AVDecoderFrame* f) {
+  uv_mutex_lock(&pool_mutex);
+  f->refcount++;
+  uv_mutex_unlock(&pool_mutex);
+}
+
+void AVDecoder::releaseFrame(AVDecoderFrame* f) {
+  uv_mutex_lock(&pool_mutex);
+  f->refcount--;
+  if(f->refcount <= 0) {
+    av_frame_unref(f->frame);                                    /* gives the buffer back to libav, we keep the AVFrame container */
+    free_frames.push_back(f);
+  }
+  uv_mutex_unlock(&pool_mutex);
 }
 
 void AVDecoder::print() {
@@ -20,144 +20,204 @@ void avplayer_thread(void* user) {
 
   bool is_eof = false;
   bool must_stop = false;
-  SwsContext* sws = player.sws;
-  AVFrame* av_frame = NULL;
+  bool must_seek = false;
+  uint64_t seek_position = 0;
   AVPlayerFrame* player_frame = NULL;
   AVDecoderFrame* decoder_frame = NULL;
-  std::vector<AVPlayerFrame*> free_frames;
-  std::vector<AVPlayerFrame*> work_frames;
 
   while(true) {
-    
-    free_frames.clear();
 
-    if(!player.getFreeFrames(free_frames)) {
-      rx_sleep_millis(10);                                      // @TODO check if this is ok..., it looks like it's no problem, though lets give it a bit time
+    player_frame = NULL;
 
-      player.lock();
+    player.lock();
+    {
       must_stop = player.must_stop;
-      player.unlock();
+      must_seek = player.must_seek;
+      seek_position = player.seek_position;
+      player.must_seek = false;
+
+      if(must_seek) {
+        player.dropDecodedFrames();
+      }
+      else if(!player.is_eof && player.free_frames.size()) {
+        player_frame = player.free_frames.back();
+        player.free_frames.pop_back();
+      }
+    }
+    player.unlock();
+
+    if(must_stop) {
+      break;
+    }
 
-      if(must_stop) {
-        break;
+    if(must_seek) {
+      if(player.dec.seek(seek_position)) {
+        player.lock();
+        player.is_eof = false;
+        player.unlock();
       }
+      continue;
+    }
 
+    if(!player_frame) {
+      rx_sleep_millis(5);                                       // all frames are in use, or we're at the end of the file
       continue;
     }
 
     // decode frames (can be audio, video, subtitle etc..)
-    work_frames.clear();
-    for(std::vector<AVPlayerFrame*>::iterator it = free_frames.begin(); it != free_frames.end(); ++it) {
-      player_frame = *it;
-      decoder_frame = player.dec.decodeFrame(is_eof);
-
-      if(!decoder_frame) {
-         break;
+    decoder_frame = player.dec.decodeFrame(is_eof);
+    if(!decoder_frame) {
+      player.lock();
+      player.free_frames.push_back(player_frame);
+      if(is_eof) {
+        player.is_eof = true;
       }
+      player.unlock();
+      continue;
+    }
 
-      if(is_eof) {
-        must_stop = true;
-        break;
+    if(decoder_frame->type != AV_TYPE_VIDEO) {
+      RX_ERROR(ERR_AVP_THREAD_UNHANDLED_TYPE);
+      decoder_frame->release();
+      player.lock();
+      player.free_frames.push_back(player_frame);
+      player.unlock();
+      continue;
+    }
+
+    player_frame->decoder_frame = decoder_frame;
+    player_frame->pts = decoder_frame->pts;
+    player_frame->nbytes = player.nbytes_video_frame;
+
+    player.lock();
+    {
+      if(player.converters.size()) {
+        player_frame->state = AVP_FRAME_CONVERTING;
+        player.convert_queue.push_back(player_frame);
+        uv_cond_signal(&player.convert_cond);
       }
-      
-      switch(decoder_frame->type) {
-
-        case AV_TYPE_VIDEO: {
-
-          player_frame->reset();
-
-          av_frame = decoder_frame->frame;      
-          player_frame->is_free = false;
-          player_frame->decoder_frame = decoder_frame;
-          player_frame->nbytes = player.nbytes_video_frame;
-                    
-          if(sws) {
-            int h = sws_scale(sws, av_frame->data, av_frame->linesize, 0, 
-                              av_frame->height, player_frame->pic.data, 
-                              player_frame->pic.linesize);
-
-            if(h != av_frame->height) {
-              RX_ERROR(ERR_AVP_SWSCALE_FAILED);
-              player_frame->is_free = true;
-              break;
-            }
+      else {
+        player_frame->data = (unsigned char*)decoder_frame->frame->data[0];
+        player_frame->state = AVP_FRAME_READY;
+      }
+      player.decoded_frames.push_back(player_frame);
+    }
+    player.unlock();
 
-            player_frame->data = (unsigned char*)player_frame->pic.data[0];
-          }
-          else {
-            player_frame->data = (unsigned char*)av_frame->data[0];
-          }
+  }  // end thread loop
 
-          work_frames.push_back(player_frame);                    
+  player.shutdown();
 
-          break;
-        } // AV_TYPE_VIDEO
+}
 
-        default: {
-          RX_ERROR(ERR_AVP_THREAD_UNHANDLED_TYPE);
-          break;
-        }
-      };
+void avplayer_convert_thread(void* user) {
 
-    } // end decode frame loop
+  AVPlayerConverter* converter = static_cast<AVPlayerConverter*>(user);
+  AVPlayer& player = *converter->player;
+  AVPlayerFrame* player_frame = NULL;
+  AVFrame* av_frame = NULL;
 
-    // copy the decoded frames 
-    if(work_frames.size()) {
-      player.lock();
-      std::copy(work_frames.begin(), work_frames.end(), std::back_inserter(player.decoded_frames));
+  while(true) {
+
+    player.lock();
+    while(!player.must_stop_converters && !player.convert_queue.size()) {
+      uv_cond_wait(&player.convert_cond, &player.mutex);
+    }
+
+    if(player.must_stop_converters) {
       player.unlock();
+      break;
     }
 
-    player.lock();
-    must_stop = player.must_stop;
+    player_frame = player.convert_queue.front();
+    player.convert_queue.pop_front();
     player.unlock();
 
-    if(must_stop) {
-      break;
+    av_frame = player_frame->decoder_frame->frame;
+    int h = sws_scale(converter->sws, av_frame->data, av_frame->linesize, 0,
+                      av_frame->height, player_frame->pic.data,
+                      player_frame->pic.linesize);
+
+    bool converted = (h == av_frame->height);
+    if(!converted) {
+      RX_ERROR(ERR_AVP_SWSCALE_FAILED);
     }
-    
-  }  // end thread loop
-  
-  player.shutdown();
 
+    // we have our own copy now; give the decoder frame back to the decoder (av_frame is invalid after this)
+    player_frame->reset();
+    av_frame = NULL;
+
+    player.lock();
+    {
+      player_frame->data = (converted) ? (unsigned char*)player_frame->pic.data[0] : NULL;
+      if(player_frame->is_dropped) {
+        player.recycleFrame(player_frame);
+      }
+      else {
+        player_frame->state = AVP_FRAME_READY;
+      }
+    }
+    player.unlock();
+  }
 }
 
 // ----------------------------------------------
 
-AVPlayerFrame::AVPlayerFrame() 
+AVPlayerFrame::AVPlayerFrame()
   :decoder_frame(NULL)
   ,data(NULL)
-  ,is_free(true)
+  ,state(AVP_FRAME_FREE)
+  ,is_dropped(false)
+  ,pts(0)
   ,nbytes(0)
 {
+  memset(&pic, 0, sizeof(pic));
 }
 
 AVPlayerFrame::~AVPlayerFrame() {
-  if(decoder_frame) {
-    delete decoder_frame;
-    decoder_frame = NULL;
-  }
+  reset();
 
   avpicture_free(&pic);
-  is_free = true;
+  state = AVP_FRAME_FREE;
   data = NULL;
   nbytes = 0;
 }
 
+// ----------------------------------------------
+
+AVPlayerConverter::AVPlayerConverter()
+  :player(NULL)
+  ,sws(NULL)
+{
+}
+
+AVPlayerConverter::~AVPlayerConverter() {
+  if(sws) {
+    sws_freeContext(sws);
+    sws = NULL;
+  }
+  player = NULL;
+}
 
 // ----------------------------------------------
 
-AVPlayer::AVPlayer() 
+AVPlayer::AVPlayer()
   :state(AVP_STATE_NONE)
   ,num_frames_to_allocate(0)
   ,time_started(0)
   ,time_paused(0)
   ,nbytes_video_frame(0)
-  ,sws(NULL)
   ,must_stop(false)
+  ,must_seek(false)
+  ,seek_position(0)
+  ,is_prerolling(false)
+  ,must_show_frame(false)
+  ,is_eof(false)
+  ,must_stop_converters(false)
   ,datapath(false)
 {
   uv_mutex_init(&mutex);
+  uv_cond_init(&convert_cond);
   rx_init_libav();
 }
 
@@ -165,10 +225,12 @@ AVPlayer::~AVPlayer() {
   stop();
 
   uv_thread_join(&thread);
-  uv_mutex_destroy(&mutex);
 
   shutdown();
 
+  uv_cond_destroy(&convert_cond);
+  uv_mutex_destroy(&mutex);
+
   state = AVP_STATE_NONE;
   must_stop = true;
   nbytes_video_frame = 0;
@@ -192,9 +254,9 @@ bool AVPlayer::setup(std::string filename, bool datapath, AVPlayerSettings cfg,
     RX_ERROR("For now we only support the AVPlayerSettings.out_pixel_format = AV_PIX_FMT_UYVY422! on mac.");
     ::exit(EXIT_FAILURE);
   }
-#endif  
+#endif
 
-  gl_surface.setup(dec.getWidth(), dec.getHeight()); 
+  gl_surface.setup(dec.getWidth(), dec.getHeight());
 
   return true;
 }
@@ -206,6 +268,8 @@ bool AVPlayer::open() {
     return false;
   }
 
+  dec.setNumThreads(settings.num_decode_threads);
+
   if(!dec.open(filename, datapath)) {
     return false;
   }
@@ -226,17 +290,17 @@ bool AVPlayer::initialize() {
   nbytes_video_frame = avpicture_get_size(settings.out_pixel_format, getWidth(), getHeight());
 
   dec.print();
-  
+
   if(frames.size()) {
     RX_ERROR(ERR_AVP_INIT_FRAMES_EXIST);
     return false;
   }
-  
-  if(!initializeSWS()) {
+
+  if(!allocateFrames()) {
     return false;
   }
 
-  if(!allocateFrames()) {
+  if(!initializeSWS()) {
     return false;
   }
 
@@ -245,57 +309,54 @@ bool AVPlayer::initialize() {
 
 bool AVPlayer::shutdown() {
 
+  // stop the converters first; they may be using frames
+  shutdownSWS();
+
+  // give all decoder frames back before closing the decoder
+  lock();
+  {
+    convert_queue.clear();
+    decoded_frames.clear();
+    free_frames.clear();
+    for(std::vector<AVPlayerFrame*>::iterator it = frames.begin(); it != frames.end(); ++it) {
+      (*it)->reset();
+    }
+  }
+  unlock();
+
   dec.close();
 
   deleteFrames();
 
-  decoded_frames.clear();
-
-  if(sws) {
-    sws_freeContext(sws);
-    sws = NULL;
-  }
-  
   must_stop = false;
+  must_seek = false;
+  is_eof = false;
 
   return true;
 }
 
 bool AVPlayer::allocateFrames() {
-  
-  if(needsToConvertPixelFormat()) {
-    // allocate frames + a buffer for SWS to put the converted pixels in.    
-    if(!sws) {
-      RX_ERROR(ERR_AVP_PREALLOC_NO_SWS);
-      return false;
-    }
 
-    bool err = false;
-    for(int i = 0; i < num_frames_to_allocate; ++i) {
-      AVPlayerFrame* f = new AVPlayerFrame();
-      frames.push_back(f);
+  bool convert = needsToConvertPixelFormat();
+
+  for(int i = 0; i < num_frames_to_allocate; ++i) {
+    AVPlayerFrame* f = new AVPlayerFrame();
+    frames.push_back(f);
 
-      int r = avpicture_alloc(&f->pic, settings.out_pixel_format, getWidth(), getHeight()); 
+    // allocate a buffer for SWS to put the converted pixels in.
+    if(convert) {
+      int r = avpicture_alloc(&f->pic, settings.out_pixel_format, getWidth(), getHeight());
       if(r < 0) {
         RX_ERROR(ERR_AVP_PREALLOC_PIC);
-        err = true;
-        break;
-      }
-
-      if(err) {
         deleteFrames();
         return false;
       }
     }
   }
-  else {
-
-    for(int i = 0; i < num_frames_to_allocate; ++i) {
-      AVPlayerFrame* f = new AVPlayerFrame();
-      frames.push_back(f);
-    }
 
-  }
+  lock();
+  free_frames.assign(frames.begin(), frames.end());
+  unlock();
 
   return true;
 }
@@ -317,8 +378,16 @@ bool AVPlayer::play() {
 
   time_started = millis();
 
+  lock();
+  {
+    seek_position = 0;
+    is_prerolling = true;
+    must_show_frame = false;
+  }
+  unlock();
+
   uv_thread_create(&thread, avplayer_thread, this);
-  
+
   return true;
 }
 
@@ -334,6 +403,25 @@ bool AVPlayer::pause() {
   return true;
 }
 
+bool AVPlayer::seek(uint64_t millis) {
+
+  if(state != AVP_STATE_PLAY && state != AVP_STATE_PAUSE) {
+    RX_ERROR(ERR_AVP_SEEK_NOT_PLAYING);
+    return false;
+  }
+
+  lock();
+  {
+    must_seek = true;
+    seek_position = millis;
+    is_prerolling = true;
+    must_show_frame = false;
+  }
+  unlock();
+
+  return true;
+}
+
 bool AVPlayer::stop() {
   state = AVP_STATE_NONE;
   time_started = 0; // @TODO -> move to a new function `shutdown()` (?)
@@ -354,40 +442,61 @@ void AVPlayer::draw(int x, int y, int w, int h) {
     return;
   }
 
+  AVPlayerFrame* f = NULL;
+  uint64_t now = millis();
 
-  if(state == AVP_STATE_PLAY) {
-    // check if there is a frame in the queue.
-    AVPlayerFrame* f = NULL;
-    lock();
-    if(decoded_frames.size()) {
-      f = decoded_frames[0];
+  lock();
+  {
+    // start the clock when we've got enough frames
+    if(is_prerolling && !must_seek) {
+      size_t num_needed = std::min<size_t>(settings.num_preroll_frames, frames.size());
+      if(getNumReadyFrames() >= std::max<size_t>(1, num_needed) || (is_eof && !convert_queue.size())) {
+        is_prerolling = false;
+        must_show_frame = true;
+        time_started = now - seek_position;
+        time_paused = now;
+      }
     }
-    unlock();
-
-    // we got a frame, check if we need to display it
-    if(f) { 
-
-      uint64_t time_playing = millis() - time_started;
 
-      if(f->decoder_frame->pts <= time_playing) {
+    if(!is_prerolling && decoded_frames.size() && decoded_frames.front()->state == AVP_FRAME_READY) {
 
-        if(f->decoder_frame->type == AV_TYPE_VIDEO) {
-          gl_surface.setPixels((unsigned char*)f->data, f->nbytes);
+      if(must_show_frame) {
+        f = decoded_frames.front();
+        must_show_frame = false;
+      }
+      else if(state == AVP_STATE_PLAY) {
+        int64_t time_playing = now - time_started;
 
-          lock();
+        // when we're behind, skip to the most recent frame we should show
+        while(decoded_frames.size()
+              && decoded_frames.front()->state == AVP_FRAME_READY
+              && decoded_frames.front()->pts <= time_playing)
           {
-            f->is_free = true;
-            decoded_frames.erase(decoded_frames.begin());
+            if(f) {
+              recycleFrame(f);
+            }
+            f = decoded_frames.front();
+            decoded_frames.pop_front();
           }
-          unlock();
+      }
 
-        }
-        else {
-          RX_VERBOSE("We got a frame which is not a video frame... we need to handle this!!");
-        }
+      if(f && decoded_frames.size() && decoded_frames.front() == f) {
+        decoded_frames.pop_front();
       }
     }
   }
+  unlock();
+
+  // we got a frame which we need to display
+  if(f) {
+    if(f->data) {
+      gl_surface.setPixels((unsigned char*)f->data, f->nbytes);
+    }
+
+    lock();
+    recycleFrame(f);
+    unlock();
+  }
 
   if(time_started) {
     gl_surface.draw(x, y, w, h);
@@ -396,38 +505,103 @@ void AVPlayer::draw(int x, int y, int w, int h) {
 
 bool AVPlayer::initializeSWS() {
 
-  if(sws) {
+  if(converters.size()) {
     RX_ERROR(ERR_AVP_ALREADY_SWS);
     return false;
   }
 
-  sws = sws_getContext(getWidth(), getHeight(), getPixelFormat(), 
-                       getWidth(), getHeight(), settings.out_pixel_format, 
-                       SWS_FAST_BILINEAR, NULL, NULL, NULL);
+  if(!needsToConvertPixelFormat()) {
+    return true;
+  }
+
+  must_stop_converters = false;
 
-  if(!sws) {
-    RX_ERROR(ERR_AVP_ALLOC_SWS);
-    return false;
+  int num_converters = std::max<int>(1, settings.num_convert_threads);
+  for(int i = 0; i < num_converters; ++i) {
+
+    AVPlayerConverter* c = new AVPlayerConverter();
+    c->player = this;
+    c->sws = sws_getContext(getWidth(), getHeight(), getPixelFormat(),
+                            getWidth(), getHeight(), settings.out_pixel_format,
+                            SWS_FAST_BILINEAR, NULL, NULL, NULL);
+
+    if(!c->sws) {
+      RX_ERROR(ERR_AVP_ALLOC_SWS);
+      delete c;
+      shutdownSWS();
+      return false;
+    }
+
+    converters.push_back(c);
+    uv_thread_create(&c->thread, avplayer_convert_thread, c);
   }
 
   return true;
 }
 
+void AVPlayer::shutdownSWS() {
+
+  if(!converters.size()) {
+    return;
+  }
+
+  lock();
+  {
+    must_stop_converters = true;
+    uv_cond_broadcast(&convert_cond);
+  }
+  unlock();
+
+  for(std::vector<AVPlayerConverter*>::iterator it = converters.begin(); it != converters.end(); ++it) {
+    uv_thread_join(&(*it)->thread);
+    delete *it;
+  }
+
+  converters.clear();
+}
+
 bool AVPlayer::needsToConvertPixelFormat() {
   return (settings.out_pixel_format != AV_PIX_FMT_NONE && dec.getPixelFormat() != settings.out_pixel_format);
 }
 
-bool AVPlayer::getFreeFrames(std::vector<AVPlayerFrame*>& result) {
-  lock();
-  for(std::vector<AVPlayerFrame*>::iterator it = frames.begin(); it != frames.end(); ++it) {
+void AVPlayer::recycleFrame(AVPlayerFrame* f) {
+  f->reset();
+  f->data = NULL;
+  f->state = AVP_FRAME_FREE;
+  f->is_dropped = false;
+  free_frames.push_back(f);
+}
+
+void AVPlayer::dropDecodedFrames() {
+
+  // queued frames are not touched by the converters yet
+  for(std::deque<AVPlayerFrame*>::iterator it = convert_queue.begin(); it != convert_queue.end(); ++it) {
+    recycleFrame(*it);
+  }
+  convert_queue.clear();
+
+  // the converters recycle the frames they're working on
+  for(std::deque<AVPlayerFrame*>::iterator it = decoded_frames.begin(); it != decoded_frames.end(); ++it) {
     AVPlayerFrame* f = *it;
-    if(f->is_free) {
-      result.push_back(f);
+    if(f->state == AVP_FRAME_READY) {
+      recycleFrame(f);
+    }
+    else if(f->state == AVP_FRAME_CONVERTING) {
+      f->is_dropped = true;
     }
   }
-  unlock();
+  decoded_frames.clear();
+}
 
-  return result.size();
+size_t AVPlayer::getNumReadyFrames() {
+  size_t n = 0;
+  for(std::deque<AVPlayerFrame*>::iterator it = decoded_frames.begin(); it != decoded_frames.end(); ++it) {
+    if((*it)->state != AVP_FRAME_READY) {
+      break;
+    }
+    ++n;
+  }
+  return n;
 }
 
 void AVPlayer::deleteFrames() {
@@ -435,15 +609,5 @@ void AVPlayer::deleteFrames() {
     delete *it;
   }
   frames.clear();
+  free_frames.clear();
 }
-
-void AVPlayer::freeFrames() {
-  lock();
-  for(std::vector<AVPlayerFrame*>::iterator it = frames.begin(); it != frames.end(); ++it) {
-    AVPlayerFrame* f = *it;
-    f->is_free = true;
-  }
-  unlock();
-}
-
-
@@ -94,5 +94,8 @@ bool AVEncoderSettings::validateAudio() {
 // ---------------------------------------------------
 AVPlayerSettings::AVPlayerSettings() 
   :out_pixel_format(AV_PIX_FMT_NONE)
+  ,num_decode_threads(0)
+  ,num_convert_threads(2)
+  ,num_preroll_frames(5)
 {
 }
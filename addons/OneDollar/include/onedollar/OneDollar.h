@@ -1,5 +1,25 @@
 // TODO - see Gesture::Length() this can be dramatically speed up
 
+/*
+  Matching
+  --------
+  The normalized templates are copied into a contiguous SoA matrix (x and y
+  of point `i` of all templates are stored next to each other). match()
+  runs the golden section search for 4 templates at once: every step we
+  rotate the points of the 4 templates by their own angle and calculate the
+  4 path distances with SSE (see SIMD.h). Because the search interval
+  shrinks by the same factor for every template, all 4 searches need the
+  same number of steps. Nothing is allocated while matching.
+
+  Set `num_candidates` to prune the templates: we first calculate the
+  distance of all templates at angle 0 (the gestures are rotated to their
+  indicative angle so this is a good coarse estimate) and only search the
+  best rotation for the `num_candidates` closest templates.
+
+  The matrix is rebuilt when the number of gestures changed; call
+  updateTemplates() when you change the `gestures` in another way.
+*/
+
 #ifndef ROXLU_ONE_DOLLAR_H
 #define ROXLU_ONE_DOLLAR_H
 
@@ -12,6 +32,9 @@
 #define ERR_DOLLAR_LOAD_FILE "Error while trying to load the gestures file"
 #define ERR_DOLLAR_SAVE_FILE "Error while trying to save the gestures file"
 #define WARN_DOLLAR_SIZE_NOT_SAME "Cannot calculate the path distance as the number of points are not the same: %ld <> %ld"
+#define ERR_DOLLAR_TEMPLATE_SIZE "Skipping gesture `%s`, it has %ld points but the other templates have %ld"
+
+#define ONEDOLLAR_SIMD_WIDTH 4                                          /* the number of templates in the matrix is padded to a multiple of this */
 
 struct OneDollarRect {
 	double x, y, w, h;
@@ -32,13 +55,13 @@ struct Gesture {
 
 	Vec2 centroid();
 	OneDollarRect boundingBox();
-  std::vector<Vec2> rotateBy(std::vector<Vec2> pts, double rad );
+  std::vector<Vec2> rotateBy(const std::vector<Vec2>& pts, double rad);
   
 	double length();
 	double indicativeAngle();	
 	double distanceAtBestAngle(Gesture* gesture);
 	double distanceAtAngle(double radians, Gesture* gesture);
-	double pathDistance(std::vector<Vec2> pts, Gesture* gesture);
+	double pathDistance(const std::vector<Vec2>& pts, Gesture* gesture);
 
 private:
   friend std::ostream& operator<<(std::ostream& os, const Gesture& g);
@@ -54,6 +77,13 @@ public:
 };
 
 
+struct OneDollarMatch {
+  OneDollarMatch();
+  Gesture* gesture;                                                    /* the best matching template or NULL when there was no match */
+  double score;                                                        /* 1.0 - distance / half_diagonal */
+  double distance;                                                     /* the path distance at the best angle */
+};
+
 class OneDollar {
  public:
 	OneDollar();
@@ -64,6 +94,13 @@ class OneDollar {
 	bool load(std::string filename, bool datapath = false);
 	
 	Gesture* match(Gesture* Gesture, double* score);
+  void match(std::vector<Gesture*>& inputs, std::vector<OneDollarMatch>& result);  /* match many input gestures at once; result[i] is the match for inputs[i] */
+  void updateTemplates();                                              /* rebuilds the template matrix from `gestures` */
+
+ private:
+  OneDollarMatch matchNormalized(Gesture* gesture);                    /* match a normalized gesture */
+  void calculateDistances(const float* xs, const float* ys, const float* cxs, const float* cys, size_t stride, size_t t, const float* angles, float* result);  /* path distances between the input and the 4 templates at column t, rotated by angles[k] */
+  void searchBestAngles(const float* xs, const float* ys, const float* cxs, const float* cys, size_t stride, size_t t, float* result);  /* golden section search for the 4 templates at column t */
 	
  public:
 	std::vector<Gesture*> gestures;
@@ -71,6 +108,27 @@ class OneDollar {
 	double half_diagonal;
 	int num_samples;
 	double angle_precision;
+  int num_candidates;                                                  /* when > 0 we only search the best angle for this many templates, see above */
+
+ private:
+  size_t num_templates;                                                /* number of gestures in the template matrix */
+  size_t num_points;                                                   /* number of points per template */
+  size_t stride;                                                       /* num_templates padded to a multiple of ONEDOLLAR_SIMD_WIDTH */
+  std::vector<float> template_x;                                       /* x of point `i` of template `t` is stored at [i * stride + t] */
+  std::vector<float> template_y;                                       /* y of point `i` of template `t` is stored at [i * stride + t] */
+  std::vector<float> template_cx;                                      /* centroid of each template, we rotate around this point */
+  std::vector<float> template_cy;
+  std::vector<Gesture*> template_gestures;                             /* the gesture for each column in the matrix, NULL for padding and skipped gestures */
+
+  /* scratch buffers, reused between calls to match() */
+  std::vector<float> input_x;                                          /* the points of the gesture we match */
+  std::vector<float> input_y;
+  std::vector<float> coarse_distances;                                 /* distance at angle 0 for every template, used to select the candidates */
+  std::vector<size_t> candidates;                                      /* indices of the selected templates */
+  std::vector<float> candidate_x;                                      /* the candidates in the same layout as template_x, etc.. */
+  std::vector<float> candidate_y;
+  std::vector<float> candidate_cx;
+  std::vector<float> candidate_cy;
 };
 
 
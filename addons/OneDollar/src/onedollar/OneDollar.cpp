@@ -1,5 +1,7 @@
 #include <onedollar/OneDollar.h>
 #include <roxlu/core/Log.h>
+#include <roxlu/math/SIMD.h>
+#include <algorithm>
 #include <cmath>
 
 Gesture::Gesture(std::string name) 
@@ -50,7 +52,7 @@ void Gesture::resample(int n) {
   }
 
   if(resampled_points.size() > n) {
-    resampled_points.erase(resampled_points.begin(), resampled_points.begin()+n);
+    resampled_points.erase(resampled_points.begin() + n, resampled_points.end());
   }
 }
 	
@@ -91,14 +93,14 @@ void Gesture::rotateToZero() {
   resampled_points = rotateBy(resampled_points, -angle);
 }
 	
-std::vector<Vec2> Gesture::rotateBy(std::vector<Vec2> pts, double radians) {
+std::vector<Vec2> Gesture::rotateBy(const std::vector<Vec2>& pts, double radians) {
   std::vector<Vec2> rotated;
   Vec2 c = centroid(); // TODO: optimize (we only need to set the centroid once);
   center = c; // TODO: optimize
   double cosa = cos(radians);
   double sina = sin(radians);
 
-  std::vector<Vec2>::iterator it = pts.begin();
+  std::vector<Vec2>::const_iterator it = pts.begin();
   while(it != pts.end()) {
     Vec2 v = (*it);
     double dx = v.x - c.x;
@@ -178,7 +180,7 @@ double Gesture::distanceAtBestAngle(Gesture* gesture) {
 		double x2 = (1.0 - golden_ratio) * start_range + golden_ratio * end_range;
 		double f2 = distanceAtAngle(x2, gesture);
 
-		while(abs(end_range - start_range) > angle_precision) {	
+		while(fabs(end_range - start_range) > angle_precision) {	
 			if(f1 < f2) {
 				end_range = x2;
 				x2 = x1;
@@ -198,14 +200,34 @@ double Gesture::distanceAtBestAngle(Gesture* gesture) {
 		return std::min(f1, f2);
 	}
 	
+// rotates our points around the centroid and calculates the path distance
+// on the fly, so we don't need to allocate a rotated copy.
 double Gesture::distanceAtAngle(double radians, Gesture* gesture) {
-  std::vector<Vec2> points_tmp = resampled_points;
-  points_tmp = rotateBy(points_tmp, radians);
-  return pathDistance(points_tmp, gesture);
+
+  if(resampled_points.size() != gesture->resampled_points.size()) {
+    RX_WARNING(WARN_DOLLAR_SIZE_NOT_SAME, resampled_points.size(), gesture->resampled_points.size());
+    return -1.0;
+  }
+
+  Vec2 c = centroid();
+  double cosa = cos(radians);
+  double sina = sin(radians);
+  double d = 0;
+  center = c;
+
+  for(size_t i = 0; i < resampled_points.size(); ++i) {
+    double dx = resampled_points[i].x - c.x;
+    double dy = resampled_points[i].y - c.y;
+    double rx = dx * cosa - dy * sina + c.x - gesture->resampled_points[i].x;
+    double ry = dx * sina + dy * cosa + c.y - gesture->resampled_points[i].y;
+    d += sqrt(rx * rx + ry * ry);
+  }
+
+  return d/resampled_points.size();
 }
 	
 // distance between two paths.
-double Gesture::pathDistance(std::vector<Vec2> pts, Gesture* gesture) {
+double Gesture::pathDistance(const std::vector<Vec2>& pts, Gesture* gesture) {
 
   if(pts.size() != gesture->resampled_points.size()) {
     RX_WARNING(WARN_DOLLAR_SIZE_NOT_SAME, pts.size(), gesture->resampled_points.size());
@@ -268,10 +290,23 @@ std::istream& operator >>(std::istream& is, Gesture& gesture) {
 
 // -------------------------------------------------------------------------
 
+OneDollarMatch::OneDollarMatch()
+  :gesture(NULL)
+  ,score(0.0)
+  ,distance(0.0)
+{
+}
+
+// -------------------------------------------------------------------------
+
 OneDollar::OneDollar() 
 		:num_samples(64)
 		,square_size(250.0)
 		,angle_precision(1.0)
+    ,num_candidates(0)
+    ,num_templates(0)
+    ,num_points(0)
+    ,stride(0)
 {
 		half_diagonal = 0.5 * sqrt((square_size*square_size) + (square_size*square_size));
 }
@@ -353,23 +388,260 @@ bool OneDollar::load(std::string filename, bool datapath) {
 	
 
 
+void OneDollar::updateTemplates() {
+  num_templates = gestures.size();
+  num_points = (num_templates) ? gestures[0]->resampled_points.size() : 0;
+  stride = ((num_templates + ONEDOLLAR_SIMD_WIDTH - 1) / ONEDOLLAR_SIMD_WIDTH) * ONEDOLLAR_SIMD_WIDTH;
+
+  template_x.assign(num_points * stride, 0.0f);
+  template_y.assign(num_points * stride, 0.0f);
+  template_cx.assign(stride, 0.0f);
+  template_cy.assign(stride, 0.0f);
+  template_gestures.assign(stride, (Gesture*)NULL);
+
+  for(size_t t = 0; t < num_templates; ++t) {
+    Gesture* g = gestures[t];
+    if(g->resampled_points.size() != num_points) {
+      RX_ERROR(ERR_DOLLAR_TEMPLATE_SIZE, g->name.c_str(), g->resampled_points.size(), num_points);
+      continue;
+    }
+
+    for(size_t i = 0; i < num_points; ++i) {
+      template_x[i * stride + t] = g->resampled_points[i].x;
+      template_y[i * stride + t] = g->resampled_points[i].y;
+    }
+
+    Vec2 c = g->centroid();
+    template_cx[t] = c.x;
+    template_cy[t] = c.y;
+    template_gestures[t] = g;
+  }
+}
+
+void OneDollar::calculateDistances(const float* xs, const float* ys, 
+                                   const float* cxs, const float* cys, 
+                                   size_t stride, size_t t, 
+                                   const float* angles, float* result) 
+{
+  float cosa[ONEDOLLAR_SIMD_WIDTH];
+  float sina[ONEDOLLAR_SIMD_WIDTH];
+  for(int k = 0; k < ONEDOLLAR_SIMD_WIDTH; ++k) {
+    cosa[k] = cos(angles[k]);
+    sina[k] = sin(angles[k]);
+  }
+
+#if defined(ROXLU_USE_SSE)
+  __m128 c = _mm_loadu_ps(cosa);
+  __m128 s = _mm_loadu_ps(sina);
+  __m128 cx = _mm_loadu_ps(cxs + t);
+  __m128 cy = _mm_loadu_ps(cys + t);
+  __m128 sum = _mm_setzero_ps();
+
+  for(size_t i = 0; i < num_points; ++i) {
+    __m128 dx = _mm_sub_ps(_mm_loadu_ps(xs + i * stride + t), cx);
+    __m128 dy = _mm_sub_ps(_mm_loadu_ps(ys + i * stride + t), cy);
+    __m128 rx = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(dx, c), _mm_mul_ps(dy, s)), cx);
+    __m128 ry = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, s), _mm_mul_ps(dy, c)), cy);
+    rx = _mm_sub_ps(rx, _mm_set1_ps(input_x[i]));
+    ry = _mm_sub_ps(ry, _mm_set1_ps(input_y[i]));
+    sum = _mm_add_ps(sum, _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(rx, rx), _mm_mul_ps(ry, ry))));
+  }
+
+  _mm_storeu_ps(result, _mm_div_ps(sum, _mm_set1_ps(float(num_points))));
+#else
+  for(int k = 0; k < ONEDOLLAR_SIMD_WIDTH; ++k) {
+    float sum = 0.0f;
+    for(size_t i = 0; i < num_points; ++i) {
+      float dx = xs[i * stride + t + k] - cxs[t + k];
+      float dy = ys[i * stride + t + k] - cys[t + k];
+      float rx = dx * cosa[k] - dy * sina[k] + cxs[t + k] - input_x[i];
+      float ry = dx * sina[k] + dy * cosa[k] + cys[t + k] - input_y[i];
+      sum += sqrtf(rx * rx + ry * ry);
+    }
+    result[k] = sum / num_points;
+  }
+#endif
+}
+
+// Same search as Gesture::distanceAtBestAngle(), but for 4 templates at once. 
+// Each step the search range of every template shrinks with the golden ratio,
+// so we only have to track the width once.
+void OneDollar::searchBestAngles(const float* xs, const float* ys, 
+                                 const float* cxs, const float* cys, 
+                                 size_t stride, size_t t, float* result) 
+{
+  float golden_ratio = 0.5 * (-1.0 + sqrt(5.0));
+  float start_range[ONEDOLLAR_SIMD_WIDTH];
+  float end_range[ONEDOLLAR_SIMD_WIDTH];
+  float x1[ONEDOLLAR_SIMD_WIDTH];
+  float x2[ONEDOLLAR_SIMD_WIDTH];
+  float f1[ONEDOLLAR_SIMD_WIDTH];
+  float f2[ONEDOLLAR_SIMD_WIDTH];
+  float angles[ONEDOLLAR_SIMD_WIDTH];
+  bool moved_down[ONEDOLLAR_SIMD_WIDTH];
+
+  for(int k = 0; k < ONEDOLLAR_SIMD_WIDTH; ++k) {
+    start_range[k] = -PI;
+    end_range[k] = PI;
+    x1[k] = golden_ratio * start_range[k] + (1.0f - golden_ratio) * end_range[k];
+    x2[k] = (1.0f - golden_ratio) * start_range[k] + golden_ratio * end_range[k];
+  }
+
+  calculateDistances(xs, ys, cxs, cys, stride, t, x1, f1);
+  calculateDistances(xs, ys, cxs, cys, stride, t, x2, f2);
+
+  double width = 2.0 * PI;
+  while(width > angle_precision) {
+    width *= golden_ratio;
+
+    for(int k = 0; k < ONEDOLLAR_SIMD_WIDTH; ++k) {
+      moved_down[k] = f1[k] < f2[k];
+      if(moved_down[k]) {
+        end_range[k] = x2[k];
+        x2[k] = x1[k];
+        f2[k] = f1[k];
+        x1[k] = golden_ratio * start_range[k] + (1.0f - golden_ratio) * end_range[k];
+        angles[k] = x1[k];
+      }
+      else {
+        start_range[k] = x1[k];
+        x1[k] = x2[k];
+        f1[k] = f2[k];
+        x2[k] = (1.0f - golden_ratio) * start_range[k] + golden_ratio * end_range[k];
+        angles[k] = x2[k];
+      }
+    }
+
+    calculateDistances(xs, ys, cxs, cys, stride, t, angles, result);
+
+    for(int k = 0; k < ONEDOLLAR_SIMD_WIDTH; ++k) {
+      if(moved_down[k]) {
+        f1[k] = result[k];
+      }
+      else {
+        f2[k] = result[k];
+      }
+    }
+  }
+
+  for(int k = 0; k < ONEDOLLAR_SIMD_WIDTH; ++k) {
+    result[k] = std::min<float>(f1[k], f2[k]);
+  }
+}
+
+// sorts candidates on their coarse distance
+struct OneDollarCoarseSort {
+  OneDollarCoarseSort(const std::vector<float>& distances):distances(distances) {}
+  bool operator()(size_t a, size_t b) const { return distances[a] < distances[b]; }
+  const std::vector<float>& distances;
+};
+
+OneDollarMatch OneDollar::matchNormalized(Gesture* gesture) {
+  OneDollarMatch m;
+  float best_dist = FLT_MAX;
+  float result[ONEDOLLAR_SIMD_WIDTH];
+
+  if(gesture->resampled_points.size() != num_points || !num_templates) {
+    RX_WARNING(WARN_DOLLAR_SIZE_NOT_SAME, gesture->resampled_points.size(), num_points);
+    return m;
+  }
+
+  input_x.resize(num_points);
+  input_y.resize(num_points);
+  for(size_t i = 0; i < num_points; ++i) {
+    input_x[i] = gesture->resampled_points[i].x;
+    input_y[i] = gesture->resampled_points[i].y;
+  }
+
+  if(num_candidates <= 0 || num_templates <= (size_t)num_candidates) {
+
+    // search all templates
+    for(size_t t = 0; t < stride; t += ONEDOLLAR_SIMD_WIDTH) {
+      searchBestAngles(&template_x[0], &template_y[0], &template_cx[0], &template_cy[0], stride, t, result);
+      for(int k = 0; k < ONEDOLLAR_SIMD_WIDTH; ++k) {
+        if(template_gestures[t + k] && result[k] < best_dist) {
+          best_dist = result[k];
+          m.gesture = template_gestures[t + k];
+        }
+      }
+    }
+  }
+  else {
+
+    // coarse distance at angle 0, then only search the closest templates
+    float zero[ONEDOLLAR_SIMD_WIDTH] = { 0.0f };
+    coarse_distances.resize(stride);
+    candidates.clear();
+    for(size_t t = 0; t < stride; t += ONEDOLLAR_SIMD_WIDTH) {
+      calculateDistances(&template_x[0], &template_y[0], &template_cx[0], &template_cy[0], stride, t, zero, &coarse_distances[t]);
+      for(int k = 0; k < ONEDOLLAR_SIMD_WIDTH; ++k) {
+        if(template_gestures[t + k]) {
+          candidates.push_back(t + k);
+        }
+      }
+    }
+
+    size_t num = std::min<size_t>(num_candidates, candidates.size());
+    std::partial_sort(candidates.begin(), candidates.begin() + num, candidates.end(), OneDollarCoarseSort(coarse_distances));
+    candidates.resize(num);
+
+    // copy the candidates into their own (small) matrix; padding repeats the first candidate
+    size_t cstride = ((num + ONEDOLLAR_SIMD_WIDTH - 1) / ONEDOLLAR_SIMD_WIDTH) * ONEDOLLAR_SIMD_WIDTH;
+    candidate_x.resize(num_points * cstride);
+    candidate_y.resize(num_points * cstride);
+    candidate_cx.resize(cstride);
+    candidate_cy.resize(cstride);
+
+    for(size_t c = 0; c < cstride; ++c) {
+      size_t t = (c < num) ? candidates[c] : candidates[0];
+      for(size_t i = 0; i < num_points; ++i) {
+        candidate_x[i * cstride + c] = template_x[i * stride + t];
+        candidate_y[i * cstride + c] = template_y[i * stride + t];
+      }
+      candidate_cx[c] = template_cx[t];
+      candidate_cy[c] = template_cy[t];
+    }
+
+    for(size_t c = 0; c < cstride; c += ONEDOLLAR_SIMD_WIDTH) {
+      searchBestAngles(&candidate_x[0], &candidate_y[0], &candidate_cx[0], &candidate_cy[0], cstride, c, result);
+      for(int k = 0; k < ONEDOLLAR_SIMD_WIDTH && c + k < num; ++k) {
+        if(result[k] < best_dist) {
+          best_dist = result[k];
+          m.gesture = template_gestures[candidates[c + k]];
+        }
+      }
+    }
+  }
+
+  if(m.gesture) {
+    m.distance = best_dist;
+    m.score = 1.0 - (best_dist / half_diagonal);
+  }
+
+  return m;
+}
+
+void OneDollar::match(std::vector<Gesture*>& inputs, std::vector<OneDollarMatch>& result) {
+  if(num_templates != gestures.size()) {
+    updateTemplates();
+  }
+
+  result.resize(inputs.size());
+  for(size_t i = 0; i < inputs.size(); ++i) {
+    inputs[i]->normalize(num_samples);
+    result[i] = matchNormalized(inputs[i]);
+  }
+}
+
 Gesture* OneDollar::match(Gesture* gesture, double* score) {
   // TODO: add a flag to check if the gesture is already normalized
   gesture->normalize(num_samples);
-  
-  double min_dist = FLT_MAX;
-  Gesture* found_gesture = NULL;
-  std::vector<Gesture*>::const_iterator it = gestures.begin();
 
-  while(it != gestures.end()) {
-    double dist = (*it)->distanceAtBestAngle(gesture);
-    if(dist > 0 && dist < min_dist) {
-      min_dist = dist;
-      found_gesture = (*it);
-    }
-    ++it;
+  if(num_templates != gestures.size()) {
+    updateTemplates();
   }
 
-  *score = 1.0 - (min_dist/half_diagonal);
-  return found_gesture;
+  OneDollarMatch m = matchNormalized(gesture);
+  *score = m.score;
+  return m.gesture;
 }
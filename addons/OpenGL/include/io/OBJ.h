@@ -1,10 +1,22 @@
-/* 
-  
+/*
+
    OBJ
    ---
-  Super basic OBJ file importer. Only support the minimum to 
+  Super basic OBJ file importer. Only support the minimum to
   import one object, with the position and normal.
- 
+
+  The file is memory mapped and parsed with a hand written float/int
+  parser. Big files are split into chunks (at line boundaries) which
+  are parsed in parallel by `num_threads` threads. After parsing we
+  deduplicate the (position, texcoord, normal) combinations of the faces
+  into `unique` and store 3 indices per face into `indices`; use
+  `copyIndexedVertices()` to get the data for `glDrawElements()`.
+
+  When `cache` is true (the default), we write a binary cache file next
+  to the OBJ (`filepath` + OBJ_CACHE_EXT). The next call to load() will
+  use the cache when the size and modification time of the OBJ still
+  match, which means loading is one mmap and a couple of memcpys.
+
 */
 
 
@@ -18,13 +30,23 @@
 #include <vector>
 #include <string.h>                        /* memcpy/memset */
 #include <stdlib.h>                        /* atoi */
+#include <stdint.h>
 #include <glr/Vertex.h>
 #include <glr/VBO.h>
 
+#define OBJ_CACHE_EXT ".cache"                                         /* extension of the binary cache file */
+#define OBJ_CACHE_MAGIC 0x4A424F52                                     /* "ROBJ" */
+#define OBJ_CACHE_VERSION 1
+#define OBJ_MIN_CHUNK_SIZE (1024 * 1024)                               /* we don't give a thread less then this number of bytes to parse */
+
 #define ERR_OBJ_FILE_NOT_FOUND "Could not open the file: `%s`"
-#define ERR_OBJ_WRONG_FACE_INDICES "Incorrect number of indices in face: %ld"
+#define ERR_OBJ_SKIPPED_FACES "Skipped %ld faces which are not triangles."
 #define ERR_OBJ_NO_VERTICES "No vertices loaded from OBJ file."
 #define ERR_OBJ_NO_NORMALS "No normals loaded from OBJ file."
+#define ERR_OBJ_NOT_INDEXED "No indices; did you load() the OBJ?"
+#define ERR_OBJ_INDEX_OUT_OF_RANGE "Face index out of range: %d"
+#define ERR_OBJ_CACHE_WRITE "Cannot write the OBJ cache file: `%s`"
+#define VERBOSE_OBJ_CACHE_INVALID "Ignoring the OBJ cache file because it's outdated or invalid: `%s`"
 
 namespace gl {
 
@@ -35,17 +57,28 @@ class OBJ {
   struct XYZ {  float x, y, z; };
   struct TEXCOORD { float s, t; };
 
-  bool load(std::string filepath, bool datapath = false);
-    
+  OBJ();
+  bool load(std::string filepath, bool datapath = false, bool cache = true);
+
   bool copyVertices(VBO<VertexP>& vbo);
   bool copyVertices(VBO<VertexNP>& vbo);
+  bool copyIndexedVertices(std::vector<VertexP>& out);                 /* copies the `unique` vertices; draw them using `indices` */
+  bool copyIndexedVertices(std::vector<VertexNP>& out);
+
+ private:
+  bool parse(const char* data, size_t nbytes);                         /* parses the OBJ data, using num_threads threads */
+  void createIndices();                                                /* fills `unique` and `indices` from `faces` */
+  bool loadCache(const std::string& filepath, uint64_t size, int64_t mtime);
+  bool saveCache(const std::string& filepath, uint64_t size, int64_t mtime);
 
  public:
   std::vector<Vec3> vertices;
   std::vector<Vec3> normals;
   std::vector<Vec3> tex_coords;
   std::vector<OBJ::FACE> faces;
-  std::vector<int> indices;
+  std::vector<OBJ::TRI> unique;                                        /* unique vertex/texcoord/normal combinations */
+  std::vector<int> indices;                                            /* 3 indices into `unique` per face */
+  int num_threads;                                                     /* number of threads used to parse; defaults to the number of cores */
 };
 
 } // gl
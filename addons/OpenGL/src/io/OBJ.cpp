@@ -1,88 +1,770 @@
 #include <roxlu/core/Utils.h>
 #include <io/OBJ.h>
 
+#if defined(_WIN32)
+#  include <windows.h>
+#else
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <fcntl.h>
+#  include <unistd.h>
+#  include <pthread.h>
+#endif
+
 namespace gl {
 
-  bool OBJ::load(std::string filepath, bool datapath) {
+  // MEMORY MAPPED FILE
+  // ---------------------------------------------------
 
-    if(datapath) {
-      filepath = rx_to_data_path(filepath);
+  struct OBJMappedFile {
+    OBJMappedFile();
+    ~OBJMappedFile();
+    bool open(const std::string& filepath);
+    void close();
+
+    const char* data;
+    size_t nbytes;
+    uint64_t size;                                                     /* file size */
+    int64_t mtime;                                                     /* modification time */
+#if defined(_WIN32)
+    HANDLE file;
+    HANDLE mapping;
+#else
+    int fd;
+#endif
+  };
+
+  OBJMappedFile::OBJMappedFile()
+    :data(NULL)
+    ,nbytes(0)
+    ,size(0)
+    ,mtime(0)
+#if defined(_WIN32)
+    ,file(INVALID_HANDLE_VALUE)
+    ,mapping(NULL)
+#else
+    ,fd(-1)
+#endif
+  {
+  }
+
+  OBJMappedFile::~OBJMappedFile() {
+    close();
+  }
+
+  bool OBJMappedFile::open(const std::string& filepath) {
+    close();
+
+#if defined(_WIN32)
+    file = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if(file == INVALID_HANDLE_VALUE) {
+      return false;
     }
 
-    std::ifstream ifs;
-    ifs.open(filepath.c_str());
-    if(!ifs.is_open()) {
-      RX_ERROR(ERR_OBJ_FILE_NOT_FOUND, filepath.c_str());
+    LARGE_INTEGER file_size;
+    FILETIME write_time;
+    if(!GetFileSizeEx(file, &file_size) || !GetFileTime(file, NULL, NULL, &write_time)) {
+      close();
       return false;
-    }	
-
-    char c;
-    std::string line;
-    while(std::getline(ifs, line)) {
-      std::stringstream ss(line);
-      ss >> c;
-      if(c == 'v') {
-        if(line[1] == ' ') {
-          Vec3 p;
-          ss >> p.x >> p.y >> p.z;
-          vertices.push_back(p);
+    }
+
+    size = file_size.QuadPart;
+    mtime = ((int64_t)write_time.dwHighDateTime << 32) | write_time.dwLowDateTime;
+    if(!size) {
+      return true;
+    }
+
+    mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if(!mapping) {
+      close();
+      return false;
+    }
+
+    data = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if(!data) {
+      close();
+      return false;
+    }
+#else
+    fd = ::open(filepath.c_str(), O_RDONLY);
+    if(fd < 0) {
+      return false;
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) != 0) {
+      close();
+      return false;
+    }
+
+    size = st.st_size;
+    mtime = st.st_mtime;
+    if(!size) {
+      return true;
+    }
+
+    void* ptr = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(ptr == MAP_FAILED) {
+      close();
+      return false;
+    }
+
+    madvise(ptr, size, MADV_SEQUENTIAL);
+    data = (const char*)ptr;
+#endif
+
+    nbytes = size;
+    return true;
+  }
+
+  void OBJMappedFile::close() {
+#if defined(_WIN32)
+    if(data) {
+      UnmapViewOfFile(data);
+    }
+    if(mapping) {
+      CloseHandle(mapping);
+      mapping = NULL;
+    }
+    if(file != INVALID_HANDLE_VALUE) {
+      CloseHandle(file);
+      file = INVALID_HANDLE_VALUE;
+    }
+#else
+    if(data) {
+      munmap((void*)data, nbytes);
+    }
+    if(fd >= 0) {
+      ::close(fd);
+      fd = -1;
+    }
+#endif
+    data = NULL;
+    nbytes = 0;
+  }
+
+  // PARSER
+  // ---------------------------------------------------
+
+  static const double obj_pow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+    1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+  };
+
+  static inline const char* obj_skip_space(const char* p, const char* end) {
+    while(p < end && (*p == ' ' || *p == '\t' || *p == '\r')) {
+      ++p;
+    }
+    return p;
+  }
+
+  static inline const char* obj_skip_line(const char* p, const char* end) {
+    while(p < end && *p != '\n') {
+      ++p;
+    }
+    return (p < end) ? p + 1 : end;
+  }
+
+  static inline bool obj_is_digit(char c) {
+    return c >= '0' && c <= '9';
+  }
+
+  static double obj_scale(double v, int exp) {
+    while(exp > 22) {
+      v *= 1e22;
+      exp -= 22;
+    }
+    while(exp < -22) {
+      v /= 1e22;
+      exp += 22;
+    }
+    return (exp >= 0) ? v * obj_pow10[exp] : v / obj_pow10[-exp];
+  }
+
+  // parses [+-]digits[.digits][(e|E)[+-]digits]; returns p when there is no number
+  static const char* obj_parse_float(const char* p, const char* end, float& result) {
+    const char* start = p;
+    bool negative = false;
+    uint64_t mantissa = 0;
+    int num_digits = 0;
+    int exp = 0;
+
+    if(p < end && (*p == '-' || *p == '+')) {
+      negative = (*p == '-');
+      ++p;
+    }
+
+    while(p < end && obj_is_digit(*p)) {
+      if(num_digits < 19) {
+        mantissa = mantissa * 10 + (*p - '0');
+        ++num_digits;
+      }
+      else {
+        ++exp;
+      }
+      ++p;
+    }
+
+    if(p < end && *p == '.') {
+      ++p;
+      while(p < end && obj_is_digit(*p)) {
+        if(num_digits < 19) {
+          mantissa = mantissa * 10 + (*p - '0');
+          ++num_digits;
+          --exp;
         }
-        else if(line[1] == 'n') {
-          Vec3 p;
-          ss >> c;
-          ss >> p.x >> p.y >> p.z;
-          normals.push_back(p);
+        ++p;
+      }
+    }
+
+    if(p == start || (p - start == 1 && (*start == '-' || *start == '+' || *start == '.'))) {
+      return start;
+    }
+
+    if(p < end && (*p == 'e' || *p == 'E')) {
+      const char* e = p + 1;
+      bool exp_negative = false;
+      int exp_value = 0;
+      if(e < end && (*e == '-' || *e == '+')) {
+        exp_negative = (*e == '-');
+        ++e;
+      }
+      if(e < end && obj_is_digit(*e)) {
+        while(e < end && obj_is_digit(*e)) {
+          if(exp_value < 10000) {
+            exp_value = exp_value * 10 + (*e - '0');
+          }
+          ++e;
+        }
+        exp += (exp_negative) ? -exp_value : exp_value;
+        p = e;
+      }
+    }
+
+    double v = obj_scale((double)mantissa, exp);
+    result = (float)((negative) ? -v : v);
+    return p;
+  }
+
+  static inline const char* obj_parse_int(const char* p, const char* end, int& result, bool& found) {
+    bool negative = false;
+    int v = 0;
+
+    found = false;
+    if(p < end && *p == '-') {
+      negative = true;
+      ++p;
+    }
+
+    while(p < end && obj_is_digit(*p)) {
+      v = v * 10 + (*p - '0');
+      found = true;
+      ++p;
+    }
+
+    result = (negative) ? -v : v;
+    return p;
+  }
+
+  // Result of parsing one chunk of the file. Positive face indices are absolute and
+  // converted to 0-based indices; negative (relative) indices are resolved against the
+  // number of elements in this chunk and fixed up with the element count of the
+  // previous chunks when we merge; `relative` stores which ones (face * 9 + corner * 3 + v/t/n).
+  struct OBJChunk {
+    OBJChunk():start(NULL),end(NULL),num_skipped(0) {}
+
+    const char* start;
+    const char* end;
+    std::vector<Vec3> vertices;
+    std::vector<Vec3> normals;
+    std::vector<Vec3> tex_coords;
+    std::vector<OBJ::FACE> faces;
+    std::vector<size_t> relative;
+    size_t num_skipped;
+  };
+
+  static inline int& obj_face_index(OBJ::FACE& f, size_t dx) {
+    OBJ::TRI& t = (dx < 3) ? f.a : ((dx < 6) ? f.b : f.c);
+    dx %= 3;
+    return (dx == 0) ? t.v : ((dx == 1) ? t.t : t.n);
+  }
+
+  static const char* obj_parse_vec(const char* p, const char* end, float* v, int n) {
+    for(int i = 0; i < n; ++i) {
+      p = obj_skip_space(p, end);
+      const char* next = obj_parse_float(p, end, v[i]);
+      if(next == p) {
+        v[i] = 0.0f;
+      }
+      p = next;
+    }
+    return p;
+  }
+
+  static void obj_parse_chunk(OBJChunk* chunk) {
+    const char* p = chunk->start;
+    const char* end = chunk->end;
+    float v[3];
+
+    while(p < end) {
+      p = obj_skip_space(p, end);
+      if(p >= end) {
+        break;
+      }
+
+      if(p[0] == 'v' && p + 1 < end) {
+        if(p[1] == ' ' || p[1] == '\t') {
+          p = obj_parse_vec(p + 2, end, v, 3);
+          chunk->vertices.push_back(Vec3(v[0], v[1], v[2]));
         }
-        else if (line[1] == 't') {
-          Vec2 t;
-          ss >> c;
-          ss >> t.x >> t.y;
-          t.y = 1.0f - t.y;
-          tex_coords.push_back(t);
+        else if(p[1] == 'n') {
+          p = obj_parse_vec(p + 2, end, v, 3);
+          chunk->normals.push_back(Vec3(v[0], v[1], v[2]));
+        }
+        else if(p[1] == 't') {
+          p = obj_parse_vec(p + 2, end, v, 2);
+          chunk->tex_coords.push_back(Vec3(v[0], 1.0f - v[1], 0.0f));
         }
       }
-      else if(c == 'f') {
-        std::string part;
-        std::vector<OBJ::TRI> tris;
-        while(ss >> part) {
-          std::stringstream fss;
-          std::string indices[3];
-          int dx = 0;
-          for(int i = 0; i < part.size(); ++i) {
-            if(part[i] == '/') {
-              dx++;
-              continue;
+      else if(p[0] == 'f' && p + 1 < end && (p[1] == ' ' || p[1] == '\t')) {
+        int counts[3] = { (int)chunk->vertices.size(), (int)chunk->tex_coords.size(), (int)chunk->normals.size() };
+        OBJ::FACE face;
+        size_t num_relative = chunk->relative.size();
+        int num_corners = 0;
+        p += 2;
+
+        while(true) {
+          p = obj_skip_space(p, end);
+          if(p >= end || *p == '\n' || *p == '#') {
+            break;
+          }
+
+          int tri[3] = { -1, -1, -1 };
+          for(int i = 0; i < 3; ++i) {
+            bool found = false;
+            int idx = 0;
+            p = obj_parse_int(p, end, idx, found);
+            if(found) {
+              if(idx > 0) {
+                tri[i] = idx - 1;
+              }
+              else if(idx < 0) {
+                tri[i] = counts[i] + idx;
+                chunk->relative.push_back(chunk->faces.size() * 9 + num_corners * 3 + i);
+              }
             }
-            indices[dx].push_back(part[i]);
+            if(p < end && *p == '/') {
+              ++p;
+            }
+            else {
+              break;
+            }
+          }
+
+          // skip garbage, so we never get stuck
+          while(p < end && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n') {
+            ++p;
           }
-          TRI tri;
-          tri.v = atoi(indices[0].c_str()) - 1;
-          tri.t = atoi(indices[1].c_str()) - 1;
-          tri.n = atoi(indices[2].c_str()) - 1;
-          tris.push_back(tri);
+
+          if(num_corners < 3) {
+            OBJ::TRI& t = (num_corners == 0) ? face.a : ((num_corners == 1) ? face.b : face.c);
+            t.v = tri[0];
+            t.t = tri[1];
+            t.n = tri[2];
+          }
+          ++num_corners;
         }
-        if(tris.size() == 3) {
-          OBJ::FACE face;
-          face.a = tris[0];
-          face.b = tris[1];
-          face.c = tris[2];
-          faces.push_back(face);
+
+        if(num_corners == 3) {
+          chunk->faces.push_back(face);
         }
         else {
-          RX_ERROR(ERR_OBJ_WRONG_FACE_INDICES, tris.size());
+          chunk->relative.resize(num_relative);
+          chunk->num_skipped++;
         }
       }
+
+      p = obj_skip_line(p, end);
+    }
+  }
+
+#if defined(_WIN32)
+  static DWORD WINAPI obj_parse_thread(LPVOID user) {
+    obj_parse_chunk(static_cast<OBJChunk*>(user));
+    return 0;
+  }
+#else
+  static void* obj_parse_thread(void* user) {
+    obj_parse_chunk(static_cast<OBJChunk*>(user));
+    return NULL;
+  }
+#endif
+
+  static int obj_get_num_cores() {
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return (n > 0) ? n : 1;
+#endif
+  }
+
+  // OBJ
+  // ---------------------------------------------------
+
+  OBJ::OBJ()
+    :num_threads(obj_get_num_cores())
+  {
+  }
+
+  bool OBJ::load(std::string filepath, bool datapath, bool cache) {
+
+    if(datapath) {
+      filepath = rx_to_data_path(filepath);
     }
+
+    vertices.clear();
+    normals.clear();
+    tex_coords.clear();
+    faces.clear();
+    unique.clear();
+    indices.clear();
+
+    OBJMappedFile file;
+    if(!file.open(filepath)) {
+      RX_ERROR(ERR_OBJ_FILE_NOT_FOUND, filepath.c_str());
+      return false;
+    }
+
+    std::string cache_filepath = filepath + OBJ_CACHE_EXT;
+    if(cache && loadCache(cache_filepath, file.size, file.mtime)) {
+      return true;
+    }
+
+    if(!parse(file.data, file.nbytes)) {
+      return false;
+    }
+
+    file.close();
+    createIndices();
+
+    if(cache) {
+      saveCache(cache_filepath, file.size, file.mtime);
+    }
+
     return true;
   }
 
+  bool OBJ::parse(const char* data, size_t nbytes) {
+
+    if(!nbytes) {
+      return true;
+    }
+
+    // split at line boundaries
+    int num_chunks = std::max<int>(1, std::min<int>(num_threads, nbytes / OBJ_MIN_CHUNK_SIZE));
+    std::vector<OBJChunk> chunks(num_chunks);
+    const char* end = data + nbytes;
+    const char* p = data;
+
+    for(int i = 0; i < num_chunks; ++i) {
+      chunks[i].start = p;
+      if(i == num_chunks - 1) {
+        p = end;
+      }
+      else {
+        p = std::max<const char*>(p, data + (nbytes / num_chunks) * (i + 1));
+        p = obj_skip_line(p, end);
+      }
+      chunks[i].end = p;
+    }
+
+    // the calling thread parses the first chunk
+#if defined(_WIN32)
+    std::vector<HANDLE> threads(num_chunks, (HANDLE)NULL);
+    for(int i = 1; i < num_chunks; ++i) {
+      threads[i] = CreateThread(NULL, 0, obj_parse_thread, &chunks[i], 0, NULL);
+      if(!threads[i]) {
+        obj_parse_chunk(&chunks[i]);
+      }
+    }
+    obj_parse_chunk(&chunks[0]);
+    for(int i = 1; i < num_chunks; ++i) {
+      if(threads[i]) {
+        WaitForSingleObject(threads[i], INFINITE);
+        CloseHandle(threads[i]);
+      }
+    }
+#else
+    std::vector<pthread_t> threads(num_chunks);
+    std::vector<bool> started(num_chunks, false);
+    for(int i = 1; i < num_chunks; ++i) {
+      started[i] = (pthread_create(&threads[i], NULL, obj_parse_thread, &chunks[i]) == 0);
+      if(!started[i]) {
+        obj_parse_chunk(&chunks[i]);
+      }
+    }
+    obj_parse_chunk(&chunks[0]);
+    for(int i = 1; i < num_chunks; ++i) {
+      if(started[i]) {
+        pthread_join(threads[i], NULL);
+      }
+    }
+#endif
+
+    // merge
+    size_t num_vertices = 0;
+    size_t num_normals = 0;
+    size_t num_tex_coords = 0;
+    size_t num_faces = 0;
+    size_t num_skipped = 0;
+
+    for(std::vector<OBJChunk>::iterator it = chunks.begin(); it != chunks.end(); ++it) {
+      num_vertices += it->vertices.size();
+      num_normals += it->normals.size();
+      num_tex_coords += it->tex_coords.size();
+      num_faces += it->faces.size();
+      num_skipped += it->num_skipped;
+    }
+
+    vertices.reserve(num_vertices);
+    normals.reserve(num_normals);
+    tex_coords.reserve(num_tex_coords);
+    faces.reserve(num_faces);
+
+    for(std::vector<OBJChunk>::iterator it = chunks.begin(); it != chunks.end(); ++it) {
+      OBJChunk& c = *it;
+      int offsets[3] = { (int)vertices.size(), (int)tex_coords.size(), (int)normals.size() };
+      size_t face_offset = faces.size();
+
+      vertices.insert(vertices.end(), c.vertices.begin(), c.vertices.end());
+      normals.insert(normals.end(), c.normals.begin(), c.normals.end());
+      tex_coords.insert(tex_coords.end(), c.tex_coords.begin(), c.tex_coords.end());
+      faces.insert(faces.end(), c.faces.begin(), c.faces.end());
+
+      for(std::vector<size_t>::iterator rit = c.relative.begin(); rit != c.relative.end(); ++rit) {
+        size_t dx = *rit;
+        obj_face_index(faces[face_offset + dx / 9], dx % 9) += offsets[dx % 3];
+      }
+    }
+
+    if(num_skipped) {
+      RX_ERROR(ERR_OBJ_SKIPPED_FACES, (long)num_skipped);
+    }
+
+    return true;
+  }
+
+  static inline uint32_t obj_hash_tri(const OBJ::TRI& t) {
+    uint32_t h = (uint32_t)t.v * 73856093u;
+    h ^= (uint32_t)t.t * 19349663u;
+    h ^= (uint32_t)t.n * 83492791u;
+    return h;
+  }
+
+  void OBJ::createIndices() {
+
+    unique.clear();
+    indices.clear();
+
+    if(!faces.size()) {
+      return;
+    }
+
+    // open addressing hash table with linear probing; stores indices into `unique`
+    size_t num_corners = faces.size() * 3;
+    size_t capacity = 16;
+    while(capacity < num_corners * 2) {
+      capacity <<= 1;
+    }
+
+    std::vector<int> table(capacity, -1);
+    size_t mask = capacity - 1;
+    indices.reserve(num_corners);
+
+    for(std::vector<FACE>::iterator it = faces.begin(); it != faces.end(); ++it) {
+      const TRI* tris[3] = { &it->a, &it->b, &it->c };
+      for(int i = 0; i < 3; ++i) {
+        const TRI& t = *tris[i];
+        size_t slot = obj_hash_tri(t) & mask;
+        while(true) {
+          int dx = table[slot];
+          if(dx < 0) {
+            dx = unique.size();
+            table[slot] = dx;
+            unique.push_back(t);
+            indices.push_back(dx);
+            break;
+          }
+          const TRI& u = unique[dx];
+          if(u.v == t.v && u.t == t.t && u.n == t.n) {
+            indices.push_back(dx);
+            break;
+          }
+          slot = (slot + 1) & mask;
+        }
+      }
+    }
+  }
+
+  // CACHE
+  // ---------------------------------------------------
+
+  struct OBJCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t source_size;                                             /* size of the OBJ file when we created the cache */
+    int64_t source_mtime;                                             /* modification time of the OBJ file when we created the cache */
+    uint32_t num_vertices;
+    uint32_t num_normals;
+    uint32_t num_tex_coords;
+    uint32_t num_faces;
+    uint32_t num_unique;
+    uint32_t num_indices;
+  };
+
+  static void obj_read_vec3(const char*& p, std::vector<Vec3>& out, size_t n) {
+    out.resize(n);
+    for(size_t i = 0; i < n; ++i) {
+      float v[3];
+      memcpy(v, p, sizeof(v));
+      out[i].set(v[0], v[1], v[2]);
+      p += sizeof(v);
+    }
+  }
+
+  template<class T>
+  static void obj_read_array(const char*& p, std::vector<T>& out, size_t n) {
+    out.resize(n);
+    if(n) {
+      memcpy(&out[0], p, n * sizeof(T));
+    }
+    p += n * sizeof(T);
+  }
+
+  static bool obj_write_vec3(FILE* fp, const std::vector<Vec3>& in) {
+    for(std::vector<Vec3>::const_iterator it = in.begin(); it != in.end(); ++it) {
+      float v[3] = { it->x, it->y, it->z };
+      if(fwrite(v, sizeof(v), 1, fp) != 1) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  template<class T>
+  static bool obj_write_array(FILE* fp, const std::vector<T>& in) {
+    return !in.size() || fwrite(&in[0], sizeof(T), in.size(), fp) == in.size();
+  }
+
+  bool OBJ::loadCache(const std::string& filepath, uint64_t size, int64_t mtime) {
+
+    OBJMappedFile file;
+    if(!file.open(filepath)) {
+      return false;
+    }
+
+    if(file.nbytes < sizeof(OBJCacheHeader)) {
+      RX_VERBOSE(VERBOSE_OBJ_CACHE_INVALID, filepath.c_str());
+      return false;
+    }
+
+    OBJCacheHeader h;
+    memcpy(&h, file.data, sizeof(h));
+    if(h.magic != OBJ_CACHE_MAGIC
+       || h.version != OBJ_CACHE_VERSION
+       || h.source_size != size
+       || h.source_mtime != mtime)
+      {
+        RX_VERBOSE(VERBOSE_OBJ_CACHE_INVALID, filepath.c_str());
+        return false;
+      }
+
+    uint64_t expected = sizeof(h)
+      + (uint64_t(h.num_vertices) + h.num_normals + h.num_tex_coords) * sizeof(float) * 3
+      + uint64_t(h.num_faces) * sizeof(FACE)
+      + uint64_t(h.num_unique) * sizeof(TRI)
+      + uint64_t(h.num_indices) * sizeof(int);
+
+    if(expected != file.nbytes) {
+      RX_VERBOSE(VERBOSE_OBJ_CACHE_INVALID, filepath.c_str());
+      return false;
+    }
+
+    const char* p = file.data + sizeof(h);
+    obj_read_vec3(p, vertices, h.num_vertices);
+    obj_read_vec3(p, normals, h.num_normals);
+    obj_read_vec3(p, tex_coords, h.num_tex_coords);
+    obj_read_array(p, faces, h.num_faces);
+    obj_read_array(p, unique, h.num_unique);
+    obj_read_array(p, indices, h.num_indices);
+
+    return true;
+  }
+
+  bool OBJ::saveCache(const std::string& filepath, uint64_t size, int64_t mtime) {
+
+    OBJCacheHeader h;
+    memset(&h, 0, sizeof(h));
+    h.magic = OBJ_CACHE_MAGIC;
+    h.version = OBJ_CACHE_VERSION;
+    h.source_size = size;
+    h.source_mtime = mtime;
+    h.num_vertices = vertices.size();
+    h.num_normals = normals.size();
+    h.num_tex_coords = tex_coords.size();
+    h.num_faces = faces.size();
+    h.num_unique = unique.size();
+    h.num_indices = indices.size();
+
+    // write to a temporary file first so a concurrent load() never sees a partial cache
+    std::string tmp_filepath = filepath + ".tmp";
+    FILE* fp = fopen(tmp_filepath.c_str(), "wb");
+    if(!fp) {
+      RX_ERROR(ERR_OBJ_CACHE_WRITE, filepath.c_str());
+      return false;
+    }
+
+    bool ok = fwrite(&h, sizeof(h), 1, fp) == 1
+      && obj_write_vec3(fp, vertices)
+      && obj_write_vec3(fp, normals)
+      && obj_write_vec3(fp, tex_coords)
+      && obj_write_array(fp, faces)
+      && obj_write_array(fp, unique)
+      && obj_write_array(fp, indices);
+
+    if(fclose(fp) != 0) {
+      ok = false;
+    }
+
+    if(ok) {
+#if defined(_WIN32)
+      ::remove(filepath.c_str());                                     /* rename() doesn't replace existing files on windows */
+#endif
+      ok = rx_rename_file(tmp_filepath, filepath);
+    }
+
+    if(!ok) {
+      ::remove(tmp_filepath.c_str());
+      RX_ERROR(ERR_OBJ_CACHE_WRITE, filepath.c_str());
+      return false;
+    }
+
+    return true;
+  }
+
+  // COPY
+  // ---------------------------------------------------
+
   bool OBJ::copyVertices(VBO<VertexP>& vbo) {
 
     if(!vertices.size()) {
       RX_ERROR(ERR_OBJ_NO_VERTICES);
       return false;
     }
-  
+
     for(std::vector<FACE>::iterator it = faces.begin(); it != faces.end(); ++it) {
       FACE& f = *it;
       vbo.push_back(VertexP(vertices[f.a.v]));
@@ -111,9 +793,69 @@ namespace gl {
       vbo.push_back(VertexNP(normals[f.b.n], vertices[f.b.v]));
       vbo.push_back(VertexNP(normals[f.c.n], vertices[f.c.v]));
     }
-    
+
     return true;
   }
 
-} // gl
+  bool OBJ::copyIndexedVertices(std::vector<VertexP>& out) {
+
+    if(!vertices.size()) {
+      RX_ERROR(ERR_OBJ_NO_VERTICES);
+      return false;
+    }
+
+    if(!indices.size()) {
+      RX_ERROR(ERR_OBJ_NOT_INDEXED);
+      return false;
+    }
+
+    out.clear();
+    out.reserve(unique.size());
+
+    for(std::vector<TRI>::iterator it = unique.begin(); it != unique.end(); ++it) {
+      if(it->v < 0 || it->v >= (int)vertices.size()) {
+        RX_ERROR(ERR_OBJ_INDEX_OUT_OF_RANGE, it->v);
+        return false;
+      }
+      out.push_back(VertexP(vertices[it->v]));
+    }
+
+    return true;
+  }
+
+  bool OBJ::copyIndexedVertices(std::vector<VertexNP>& out) {
+
+    if(!vertices.size()) {
+      RX_ERROR(ERR_OBJ_NO_VERTICES);
+      return false;
+    }
 
+    if(!normals.size()) {
+      RX_ERROR(ERR_OBJ_NO_NORMALS);
+      return false;
+    }
+
+    if(!indices.size()) {
+      RX_ERROR(ERR_OBJ_NOT_INDEXED);
+      return false;
+    }
+
+    out.clear();
+    out.reserve(unique.size());
+
+    for(std::vector<TRI>::iterator it = unique.begin(); it != unique.end(); ++it) {
+      if(it->v < 0 || it->v >= (int)vertices.size()) {
+        RX_ERROR(ERR_OBJ_INDEX_OUT_OF_RANGE, it->v);
+        return false;
+      }
+      if(it->n < 0 || it->n >= (int)normals.size()) {
+        RX_ERROR(ERR_OBJ_INDEX_OUT_OF_RANGE, it->n);
+        return false;
+      }
+      out.push_back(VertexNP(normals[it->n], vertices[it->v]));
+    }
+
+    return true;
+  }
+
+} // gl
@@ -0,0 +1,111 @@
+#ifndef ROXLU_POLYTRI_BATCHH
+#define ROXLU_POLYTRI_BATCHH
+
+#include <poly2tri.h>
+#include <uv.h>
+#include <vector>
+#include <stddef.h>
+
+using std::vector;
+
+/**
+ * Triangulates many independent polygons (with holes) at once, e.g. all
+ * glyph outlines of a text or all shapes of a SVG. In contrast to PolyTri
+ * you pass flat x,y float arrays and get back one indexed triangle array
+ * which can be uploaded directly together with `vertices`.
+ *
+ * All memory is kept between calls: call clear(), add the shapes again and
+ * triangulate() without allocating once the buffers have grown. Each thread
+ * owns a p2t::CDT which allocates its triangles, nodes and edges from
+ * pools that are reused for the next polygon. The shapes are divided over
+ * the threads; the result is the same as when triangulating them one by one.
+ *
+ * A shape must be a simple polygon, holes must be inside the outline and
+ * may not touch it. Repeated vertices (e.g. a closing vertex equal to the
+ * first) are removed.
+ *
+ *
+ * Examples
+ * ------------
+ *
+
+	PolyTriBatch batch;
+
+	// each frame
+	// -----------
+	batch.clear();
+	for(int i = 0; i < glyphs.size(); ++i) {
+		batch.addShape(&glyphs[i].outline[0], glyphs[i].outline.size() / 2);
+		for(int j = 0; j < glyphs[i].holes.size(); ++j) {
+			batch.addHole(&glyphs[i].holes[j][0], glyphs[i].holes[j].size() / 2);
+		}
+	}
+	batch.triangulate();
+
+	glBufferData(GL_ARRAY_BUFFER, batch.vertices.size() * sizeof(float), &batch.vertices[0], GL_STREAM_DRAW);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, batch.indices.size() * sizeof(unsigned int), &batch.indices[0], GL_STREAM_DRAW);
+	glDrawElements(GL_TRIANGLES, batch.indices.size(), GL_UNSIGNED_INT, NULL);
+
+
+ *
+ */
+
+#define POLYTRI_ERR_NUM_VERTICES "A polygon needs at least 3 vertices, we got: %ld"
+#define POLYTRI_ERR_NO_SHAPE "Cannot add a hole, call addShape() first"
+
+#define POLYTRI_BATCH_DEFAULT_NUM_THREADS 4
+
+struct PolyTriShape {
+	PolyTriShape();
+	size_t vertex_offset;                        // index of the first vertex (x,y pair) in `vertices`; the outline is followed by the holes
+	size_t num_outline;                          // number of vertices of the outline
+	size_t num_vertices;                         // number of vertices of the outline and all holes
+	size_t hole_offset;                          // index of the first hole in `hole_sizes`
+	size_t num_holes;
+	size_t index_offset;                         // index of the first triangle index in `indices`, set by triangulate()
+	size_t num_indices;                          // number of triangle indices (3 per triangle), set by triangulate()
+	int worker;                                  // (private) the worker which triangulated this shape
+	size_t worker_offset;                        // (private) index of the first triangle index in the indices of the worker
+};
+
+class PolyTriBatch;
+
+struct PolyTriWorker {
+	PolyTriWorker();
+	PolyTriBatch* batch;
+	int index;                                   // position in PolyTriBatch::workers
+	p2t::CDT cdt;                                // reused for every shape; keeps its memory pools
+	vector<p2t::Point> points;                   // the points of the current shape, reused
+	vector<p2t::Point*> polyline;                // outline or hole we pass to the cdt
+	vector<unsigned int> indices;                // triangles of all shapes this worker triangulated
+	uv_thread_t thread;
+};
+
+void polytri_batch_thread_function(void* user); // triangulates shapes until there are none left
+
+class PolyTriBatch {
+public:
+	PolyTriBatch(int numThreads = POLYTRI_BATCH_DEFAULT_NUM_THREADS);
+	~PolyTriBatch();
+	void clear();                                // removes all shapes; keeps the memory
+	int addShape(const float* p, size_t num);    // adds a polygon of `num` x,y pairs, returns the shape index or -1
+	bool addHole(const float* p, size_t num);    // adds a hole of `num` x,y pairs to the last added shape
+	void triangulate();                          // triangulates all shapes into `indices`
+	void runWorker(PolyTriWorker& worker);       // (private) gets called by the threads
+
+private:
+	size_t addVertices(const float* p, size_t num); // appends the vertices, skipping repeated ones, returns the number of added vertices
+	void triangulateShape(PolyTriWorker& worker, PolyTriShape& shape);
+
+public:
+	vector<float> vertices;                      // x,y pairs of all shapes
+	vector<unsigned int> indices;                // 3 indices into `vertices` (per x,y pair) for each triangle, grouped per shape
+	vector<PolyTriShape> shapes;
+	vector<size_t> hole_sizes;                   // number of vertices of each hole
+	vector<PolyTriWorker*> workers;
+	int num_threads;
+	size_t next_shape;                           // the next shape a worker will triangulate
+	uv_mutex_t mutex;                            // protects next_shape
+};
+
+#endif
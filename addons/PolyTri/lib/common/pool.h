@@ -0,0 +1,96 @@
+/* 
+ * Poly2Tri Copyright (c) 2009-2010, Poly2Tri Contributors
+ * http://code.google.com/p/poly2tri/
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ * * Neither the name of Poly2Tri nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without specific
+ *   prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef POOL_H
+#define POOL_H
+
+#include <vector>
+#include <cstddef>
+#include <new>
+
+namespace p2t {
+
+/**
+ * Chunked storage for the triangles, nodes and edges of a triangulation.
+ * Objects are never freed one by one; Reset() makes all memory available
+ * again without releasing it so a SweepContext can be reused without
+ * allocating. Only use this for types without a destructor.
+ */
+template <class T>
+class Pool {
+public:
+
+  Pool() : used_(0)
+  {
+  }
+
+  ~Pool()
+  {
+    for (unsigned int i = 0; i < chunks_.size(); i++) {
+      ::operator delete(chunks_[i]);
+    }
+  }
+
+  /// Returns memory for one object, use placement new to construct it
+  void* Alloc()
+  {
+    size_t chunk = used_ / kChunkSize;
+    if (chunk == chunks_.size()) {
+      chunks_.push_back(static_cast<T*>(::operator new(sizeof(T) * kChunkSize)));
+    }
+    return chunks_[chunk] + (used_++ % kChunkSize);
+  }
+
+  /// Makes all objects available again
+  void Reset()
+  {
+    used_ = 0;
+  }
+
+  size_t size() const
+  {
+    return used_;
+  }
+
+private:
+
+  enum { kChunkSize = 1024 };
+
+  std::vector<T*> chunks_;
+  size_t used_;
+
+  Pool(const Pool&);
+  Pool& operator=(const Pool&);
+};
+
+}
+
+#endif
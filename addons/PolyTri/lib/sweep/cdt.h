@@ -53,7 +53,12 @@ public:
    * 
    * @param polyline
    */
-  CDT(std::vector<Point*> polyline);
+  CDT(const std::vector<Point*>& polyline);
+
+  /**
+   * Constructor - call Reset() with a polyline before adding holes
+   */
+  CDT();
   
    /**
    * Destructor - clean up memory
@@ -65,7 +70,15 @@ public:
    * 
    * @param polyline
    */
-  void AddHole(std::vector<Point*> polyline);
+  void AddHole(const std::vector<Point*>& polyline);
+
+  /**
+   * Start a new triangulation with another polyline. The triangles of the
+   * previous triangulation become invalid but their memory is reused.
+   * 
+   * @param polyline
+   */
+  void Reset(const std::vector<Point*>& polyline);
   
   /**
    * Add a steiner point
@@ -82,7 +95,7 @@ public:
   /**
    * Get CDT triangles
    */
-  std::vector<Triangle*> GetTriangles();
+  const std::vector<Triangle*>& GetTriangles();
   
   /**
    * Get triangle map
@@ -276,8 +276,6 @@ private:
 
   void FinalizationPolygon(SweepContext& tcx);
 
-  std::vector<Node*> nodes_;
-
 };
 
 }
@@ -34,7 +34,13 @@
 
 namespace p2t {
 
-SweepContext::SweepContext(std::vector<Point*> polyline)
+SweepContext::SweepContext() : front_(NULL), head_(NULL), tail_(NULL),
+  af_head_(NULL), af_middle_(NULL), af_tail_(NULL)
+{
+}
+
+SweepContext::SweepContext(const std::vector<Point*>& polyline) : front_(NULL), head_(NULL), tail_(NULL),
+  af_head_(NULL), af_middle_(NULL), af_tail_(NULL)
 {
   basin = Basin();
   edge_event = EdgeEvent();
@@ -44,7 +50,29 @@ SweepContext::SweepContext(std::vector<Point*> polyline)
   InitEdges(points_);
 }
 
-void SweepContext::AddHole(std::vector<Point*> polyline)
+void SweepContext::Reset(const std::vector<Point*>& polyline)
+{
+  delete front_;
+  front_ = NULL;
+  head_ = tail_ = NULL;
+  af_head_ = af_middle_ = af_tail_ = NULL;
+
+  basin.Clear();
+  edge_event = EdgeEvent();
+
+  triangles_.clear();
+  map_.clear();
+  edge_list.clear();
+  triangle_pool_.Reset();
+  node_pool_.Reset();
+  edge_pool_.Reset();
+
+  points_.assign(polyline.begin(), polyline.end());
+
+  InitEdges(points_);
+}
+
+void SweepContext::AddHole(const std::vector<Point*>& polyline)
 {
   InitEdges(polyline);
   for(unsigned int i = 0; i < polyline.size(); i++) {
@@ -56,14 +84,29 @@ void SweepContext::AddPoint(Point* point) {
   points_.push_back(point);
 }
 
-std::vector<Triangle*> SweepContext::GetTriangles()
+const std::vector<Triangle*>& SweepContext::GetTriangles()
 {
   return triangles_;
 }
 
 std::list<Triangle*> SweepContext::GetMap()
 {
-  return map_;
+  return std::list<Triangle*>(map_.begin(), map_.end());
+}
+
+Triangle* SweepContext::NewTriangle(Point& a, Point& b, Point& c)
+{
+  return new (triangle_pool_.Alloc()) Triangle(a, b, c);
+}
+
+Node* SweepContext::NewNode(Point& p)
+{
+  return new (node_pool_.Alloc()) Node(p);
+}
+
+Node* SweepContext::NewNode(Point& p, Triangle& t)
+{
+  return new (node_pool_.Alloc()) Node(p, t);
 }
 
 void SweepContext::InitTriangulation()
@@ -86,20 +129,28 @@ void SweepContext::InitTriangulation()
 
   double dx = kAlpha * (xmax - xmin);
   double dy = kAlpha * (ymax - ymin);
-  head_ = new Point(xmax + dx, ymin - dy);
-  tail_ = new Point(xmin - dx, ymin - dy);
+  head_point_.set(xmax + dx, ymin - dy);
+  tail_point_.set(xmin - dx, ymin - dy);
+  head_ = &head_point_;
+  tail_ = &tail_point_;
 
   // Sort points along y-axis
   std::sort(points_.begin(), points_.end(), cmp);
 
 }
 
-void SweepContext::InitEdges(std::vector<Point*> polyline)
+void SweepContext::InitEdges(const std::vector<Point*>& polyline)
 {
   int num_points = polyline.size();
+
+  // Points may be reused for another triangulation; drop their old edges
+  for (int i = 0; i < num_points; i++) {
+    polyline[i]->edge_list.clear();
+  }
+
   for (int i = 0; i < num_points; i++) {
     int j = i < num_points - 1 ? i + 1 : 0;
-    edge_list.push_back(new Edge(*polyline[i], *polyline[j]));
+    edge_list.push_back(new (edge_pool_.Alloc()) Edge(*polyline[i], *polyline[j]));
   }
 }
 
@@ -119,18 +170,17 @@ Node& SweepContext::LocateNode(Point& point)
   return *front_->LocateNode(point.x);
 }
 
-void SweepContext::CreateAdvancingFront(std::vector<Node*> nodes)
+void SweepContext::CreateAdvancingFront()
 {
-
-  (void) nodes;
   // Initial triangle
-  Triangle* triangle = new Triangle(*points_[0], *tail_, *head_);
+  Triangle* triangle = NewTriangle(*points_[0], *tail_, *head_);
 
   map_.push_back(triangle);
 
-  af_head_ = new Node(*triangle->GetPoint(1), *triangle);
-  af_middle_ = new Node(*triangle->GetPoint(0), *triangle);
-  af_tail_ = new Node(*triangle->GetPoint(2));
+  af_head_ = NewNode(*triangle->GetPoint(1), *triangle);
+  af_middle_ = NewNode(*triangle->GetPoint(0), *triangle);
+  af_tail_ = NewNode(*triangle->GetPoint(2));
+  delete front_;
   front_ = new AdvancingFront(*af_head_, *af_tail_);
 
   // TODO: More intuitive if head is middles next and not previous?
@@ -143,7 +193,8 @@ void SweepContext::CreateAdvancingFront(std::vector<Node*> nodes)
 
 void SweepContext::RemoveNode(Node* node)
 {
-  delete node;
+  // Nodes are freed by the node pool
+  (void) node;
 }
 
 void SweepContext::MapTriangleToNodes(Triangle& t)
@@ -159,7 +210,7 @@ void SweepContext::MapTriangleToNodes(Triangle& t)
 
 void SweepContext::RemoveFromMap(Triangle* triangle)
 {
-  map_.remove(triangle);
+  map_.erase(std::remove(map_.begin(), map_.end(), triangle), map_.end());
 }
 
 void SweepContext::MeshClean(Triangle& triangle)
@@ -176,27 +227,8 @@ void SweepContext::MeshClean(Triangle& triangle)
 
 SweepContext::~SweepContext()
 {
-
-    // Clean up memory
-
-    delete head_;
-    delete tail_;
-    delete front_;
-    delete af_head_;
-    delete af_middle_;
-    delete af_tail_;
-
-    typedef std::list<Triangle*> type_list;
-
-    for(type_list::iterator iter = map_.begin(); iter != map_.end(); ++iter) {
-        Triangle* ptr = *iter;
-        delete ptr;
-    }
-
-     for(unsigned int i = 0; i < edge_list.size(); i++) {
-        delete edge_list[i];
-    }
-
+  // Triangles, nodes and edges are freed by the pools
+  delete front_;
 }
 
 }
@@ -35,6 +35,8 @@
 #include <list>
 #include <vector>
 #include <cstddef>
+#include "../common/shapes.h"
+#include "../common/pool.h"
 
 namespace p2t {
 
@@ -42,8 +44,6 @@ namespace p2t {
 // PointSet width to both left and right.
 const double kAlpha = 0.3;
 
-struct Point;
-class Triangle;
 struct Node;
 struct Edge;
 class AdvancingFront;
@@ -51,11 +51,16 @@ class AdvancingFront;
 class SweepContext {
 public:
 
+/// Constructor, call Reset() before triangulating
+SweepContext();
 /// Constructor
-SweepContext(std::vector<Point*> polyline);
+SweepContext(const std::vector<Point*>& polyline);
 /// Destructor
 ~SweepContext();
 
+/// Removes everything and starts with a new polyline; keeps the allocated memory
+void Reset(const std::vector<Point*>& polyline);
+
 void set_head(Point* p1);
 
 Point* head();
@@ -70,7 +75,12 @@ Node& LocateNode(Point& point);
 
 void RemoveNode(Node* node);
 
-void CreateAdvancingFront(std::vector<Node*> nodes);
+void CreateAdvancingFront();
+
+/// Triangles, nodes and edges are allocated from pools owned by the context
+Triangle* NewTriangle(Point& a, Point& b, Point& c);
+Node* NewNode(Point& p);
+Node* NewNode(Point& p, Triangle& t);
 
 /// Try to map a node to all sides of this triangle that don't have a neighbor
 void MapTriangleToNodes(Triangle& t);
@@ -83,7 +93,7 @@ Point* GetPoints();
 
 void RemoveFromMap(Triangle* triangle);
 
-void AddHole(std::vector<Point*> polyline);
+void AddHole(const std::vector<Point*>& polyline);
 
 void AddPoint(Point* point);
 
@@ -91,7 +101,7 @@ AdvancingFront* front();
 
 void MeshClean(Triangle& triangle);
 
-std::vector<Triangle*> GetTriangles();
+const std::vector<Triangle*>& GetTriangles();
 std::list<Triangle*> GetMap();
 
 std::vector<Edge*> edge_list;
@@ -134,20 +144,26 @@ private:
 friend class Sweep;
 
 std::vector<Triangle*> triangles_;
-std::list<Triangle*> map_;
+std::vector<Triangle*> map_;
 std::vector<Point*> points_;
 
+Pool<Triangle> triangle_pool_;
+Pool<Node> node_pool_;
+Pool<Edge> edge_pool_;
+
 // Advancing front
 AdvancingFront* front_;
 // head point used with advancing front
 Point* head_;
 // tail point used with advancing front
 Point* tail_;
+// storage for head_ and tail_
+Point head_point_, tail_point_;
 
 Node *af_head_, *af_middle_, *af_tail_;
 
 void InitTriangulation();
-void InitEdges(std::vector<Point*> polyline);
+void InitEdges(const std::vector<Point*>& polyline);
 
 };
 
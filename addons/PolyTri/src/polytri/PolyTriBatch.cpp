@@ -0,0 +1,220 @@
+#include <roxlu/core/Log.h>
+#include <polytri/PolyTriBatch.h>
+#include <algorithm>
+#include <string.h>
+
+void polytri_batch_thread_function(void* user) {
+	PolyTriWorker* worker = static_cast<PolyTriWorker*>(user);
+	worker->batch->runWorker(*worker);
+}
+
+// -----------------------------------------------------------------------------
+
+PolyTriShape::PolyTriShape()
+	:vertex_offset(0)
+	,num_outline(0)
+	,num_vertices(0)
+	,hole_offset(0)
+	,num_holes(0)
+	,index_offset(0)
+	,num_indices(0)
+	,worker(0)
+	,worker_offset(0)
+{
+}
+
+PolyTriWorker::PolyTriWorker()
+	:batch(NULL)
+	,index(0)
+{
+}
+
+// -----------------------------------------------------------------------------
+
+PolyTriBatch::PolyTriBatch(int numThreads)
+	:num_threads(numThreads < 1 ? 1 : numThreads)
+	,next_shape(0)
+{
+	uv_mutex_init(&mutex);
+}
+
+PolyTriBatch::~PolyTriBatch() {
+	for(vector<PolyTriWorker*>::iterator it = workers.begin(); it != workers.end(); ++it) {
+		delete *it;
+	}
+	workers.clear();
+	uv_mutex_destroy(&mutex);
+}
+
+void PolyTriBatch::clear() {
+	vertices.clear();
+	indices.clear();
+	shapes.clear();
+	hole_sizes.clear();
+}
+
+int PolyTriBatch::addShape(const float* p, size_t num) {
+	size_t offset = vertices.size() / 2;
+	size_t added = addVertices(p, num);
+	if(added < 3) {
+		RX_ERROR(POLYTRI_ERR_NUM_VERTICES, added);
+		vertices.resize(offset * 2);
+		return -1;
+	}
+
+	PolyTriShape shape;
+	shape.vertex_offset = offset;
+	shape.num_outline = added;
+	shape.num_vertices = added;
+	shape.hole_offset = hole_sizes.size();
+	shapes.push_back(shape);
+	return shapes.size() - 1;
+}
+
+bool PolyTriBatch::addHole(const float* p, size_t num) {
+	if(!shapes.size()) {
+		RX_ERROR(POLYTRI_ERR_NO_SHAPE);
+		return false;
+	}
+
+	size_t offset = vertices.size() / 2;
+	size_t added = addVertices(p, num);
+	if(added < 3) {
+		RX_ERROR(POLYTRI_ERR_NUM_VERTICES, added);
+		vertices.resize(offset * 2);
+		return false;
+	}
+
+	PolyTriShape& shape = shapes.back();
+	shape.num_vertices += added;
+	shape.num_holes++;
+	hole_sizes.push_back(added);
+	return true;
+}
+
+size_t PolyTriBatch::addVertices(const float* p, size_t num) {
+	size_t start = vertices.size();
+	for(size_t i = 0; i < num; ++i) {
+		float x = p[i * 2 + 0];
+		float y = p[i * 2 + 1];
+		size_t n = vertices.size();
+		if(n > start && vertices[n - 2] == x && vertices[n - 1] == y) {
+			continue;
+		}
+		vertices.push_back(x);
+		vertices.push_back(y);
+	}
+
+	// the closing vertex may be equal to the first one
+	size_t n = vertices.size();
+	if(n - start >= 4 && vertices[n - 2] == vertices[start] && vertices[n - 1] == vertices[start + 1]) {
+		vertices.resize(n - 2);
+	}
+	return (vertices.size() - start) / 2;
+}
+
+void PolyTriBatch::triangulate() {
+	indices.clear();
+	if(!shapes.size()) {
+		return;
+	}
+
+	size_t num_workers = std::min<size_t>(num_threads, shapes.size());
+	while(workers.size() < num_workers) {
+		PolyTriWorker* worker = new PolyTriWorker();
+		worker->batch = this;
+		worker->index = workers.size();
+		workers.push_back(worker);
+	}
+	for(size_t i = 0; i < num_workers; ++i) {
+		workers[i]->indices.clear();
+	}
+
+	next_shape = 0;
+	if(num_workers == 1) {
+		runWorker(*workers[0]);
+	}
+	else {
+		for(size_t i = 0; i < num_workers; ++i) {
+			uv_thread_create(&workers[i]->thread, polytri_batch_thread_function, workers[i]);
+		}
+		for(size_t i = 0; i < num_workers; ++i) {
+			uv_thread_join(&workers[i]->thread);
+		}
+	}
+
+	// gather the triangles in the same order as the shapes
+	size_t num_indices = 0;
+	for(vector<PolyTriShape>::iterator it = shapes.begin(); it != shapes.end(); ++it) {
+		it->index_offset = num_indices;
+		num_indices += it->num_indices;
+	}
+
+	indices.resize(num_indices);
+	for(vector<PolyTriShape>::iterator it = shapes.begin(); it != shapes.end(); ++it) {
+		PolyTriShape& shape = *it;
+		if(!shape.num_indices) {
+			continue;
+		}
+		memcpy(&indices[shape.index_offset], &workers[shape.worker]->indices[shape.worker_offset], shape.num_indices * sizeof(unsigned int));
+	}
+}
+
+void PolyTriBatch::runWorker(PolyTriWorker& worker) {
+	while(true) {
+		uv_mutex_lock(&mutex);
+		size_t dx = next_shape++;
+		uv_mutex_unlock(&mutex);
+
+		if(dx >= shapes.size()) {
+			break;
+		}
+
+		PolyTriShape& shape = shapes[dx];
+		shape.worker = worker.index;
+		shape.worker_offset = worker.indices.size();
+		triangulateShape(worker, shape);
+		shape.num_indices = worker.indices.size() - shape.worker_offset;
+	}
+}
+
+void PolyTriBatch::triangulateShape(PolyTriWorker& worker, PolyTriShape& shape) {
+
+	// the points are stored in one array so a triangle point maps back to a vertex index
+	if(worker.points.size() < shape.num_vertices) {
+		worker.points.resize(shape.num_vertices);
+	}
+
+	const float* src = &vertices[shape.vertex_offset * 2];
+	for(size_t i = 0; i < shape.num_vertices; ++i) {
+		worker.points[i].set(src[i * 2 + 0], src[i * 2 + 1]);
+	}
+
+	worker.polyline.resize(shape.num_outline);
+	for(size_t i = 0; i < shape.num_outline; ++i) {
+		worker.polyline[i] = &worker.points[i];
+	}
+	worker.cdt.Reset(worker.polyline);
+
+	size_t start = shape.num_outline;
+	for(size_t i = 0; i < shape.num_holes; ++i) {
+		size_t num = hole_sizes[shape.hole_offset + i];
+		worker.polyline.resize(num);
+		for(size_t j = 0; j < num; ++j) {
+			worker.polyline[j] = &worker.points[start + j];
+		}
+		worker.cdt.AddHole(worker.polyline);
+		start += num;
+	}
+
+	worker.cdt.Triangulate();
+
+	const p2t::Point* first = &worker.points[0];
+	const vector<p2t::Triangle*>& tris = worker.cdt.GetTriangles();
+	for(vector<p2t::Triangle*>::const_iterator it = tris.begin(); it != tris.end(); ++it) {
+		p2t::Triangle& tri = *(*it);
+		for(int i = 0; i < 3; ++i) {
+			worker.indices.push_back(shape.vertex_offset + (tri.GetPoint(i) - first));
+		}
+	}
+}
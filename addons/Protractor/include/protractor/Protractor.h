@@ -7,6 +7,44 @@
 
  [ ] Todo: Implement rotation variant 
 
+ Matching
+ --------
+ The vectorized templates are copied into a contiguous SoA matrix (x and y
+ of point `i` of all templates are stored next to each other), which lets
+ us score 4 templates at once with SSE (see SIMD.h). Instead of computing
+ atan/cos/sin/acos for every template we compare the templates on
+ sign(a) * (a^2 + b^2), which orders them the same as the cosine distance,
+ and only compute the distance for the best one. Use the batch version of
+ match() to match many strokes (e.g. one per finger) at once; it scores a
+ block of templates for all inputs before it moves to the next block so
+ the templates stay in cache.
+
+ The matrix is rebuilt when the number of gestures changed; call
+ updateTemplates() when you change the `gestures` in another way.
+
+ Spotting
+ --------
+ Use the GestureSpotter to recognize gestures inside a continuous stream
+ of points (e.g. when the user never lifts the pen). It resamples the
+ stream incrementally into equidistant samples and keeps the samples of
+ the last `windowLength` pixels. A test only picks `numSamples` of these
+ samples and vectorizes them, so adding a point and testing don't depend
+ on the length of the stream.
+
+ ````c++
+ GestureSpotter spotter(&protractor, 300.0f);
+ spotter.min_score = 3.0f;
+
+ // for every new input point
+ spotter.addPoint(x, y);
+
+ float score = 0.0f;
+ Gesture* g = spotter.spot(&score);
+ if(g) {
+   RX_VERBOSE("Spotted: %s", g->name.c_str());
+ }
+ ````
+
  */
 #ifndef ROXLU_PROTRACTOR_H
 #define ROXLU_PROTRACTOR_H
@@ -20,6 +58,10 @@
 #define ERR_PROT_NO_GESTURES "No gestures"
 #define ERR_PROT_SAVE_OPEN "Cannot open the file for writing"
 #define ERR_PROT_LOAD_OPEN "Cannot open the file for reading"
+#define ERR_PROT_TEMPLATE_SIZE "Skipping gesture `%s`, it has %ld points but the other templates have %ld"
+
+#define PROTRACTOR_SIMD_WIDTH 4                              /* the number of templates in the matrix is padded to a multiple of this */
+#define PROTRACTOR_BLOCK_SIZE 64                             /* number of templates we score for all inputs at once, see match(inputs, result) */
 
 namespace protractor {
 
@@ -48,6 +90,13 @@ namespace protractor {
     std::vector<Vec2> rotated_points;                         /* rotated towards indicative angle */
   };
 
+  struct ProtractorMatch {
+    ProtractorMatch();
+    Gesture* gesture;                                         /* the best matching template or NULL when there was no match */
+    float score;                                              /* 1.0 / distance */
+    float distance;                                           /* the cosine distance to the best matching template */
+  };
+
   class Protractor {
 
   public:
@@ -55,13 +104,51 @@ namespace protractor {
     ~Protractor();                                            /* destructor, will free all added gestures */
     void addGesture(Gesture* gesture);                        /* This will first resample the gesture + vectorize, then it will be added */
     Gesture* match(Gesture* in, float* score);                /* match an input gesture against all added gestures. */
+    Gesture* matchVectorized(Gesture* in, float* score);      /* same as match() but `in` must be resampled and vectorized already */
+    void match(std::vector<Gesture*>& inputs, std::vector<ProtractorMatch>& result);  /* match many input gestures at once; result[i] is the match for inputs[i] */
+    void updateTemplates();                                   /* rebuilds the template matrix from `gestures` */
 
     bool save(std::string filename, bool datapath = false);
     bool load(std::string filename, bool datapath = false);
 
+  private:
+    void scoreTemplates(Gesture* in, size_t first, size_t count, float& bestValue, size_t& bestTemplate);  /* scores templates [first, first + count), count must be a multiple of PROTRACTOR_SIMD_WIDTH */
+    ProtractorMatch createMatch(float bestValue, size_t bestTemplate);
+
   public:
     std::vector<Gesture*> gestures;
-  
+
+  private:
+    size_t num_templates;                                     /* number of gestures in the template matrix */
+    size_t num_points;                                        /* number of points per template */
+    size_t stride;                                            /* num_templates padded to a multiple of PROTRACTOR_SIMD_WIDTH */
+    std::vector<float> template_x;                            /* x of point `i` of template `t` is stored at [i * stride + t] */
+    std::vector<float> template_y;                            /* y of point `i` of template `t` is stored at [i * stride + t] */
+    std::vector<Gesture*> template_gestures;                  /* the gesture for each column in the matrix, NULL for padding and skipped gestures */
+  };
+
+  class GestureSpotter {
+
+  public:
+    GestureSpotter(Protractor* protractor, float windowLength = 300.0f, int numSamples = 16, int oversampling = 4);
+    void addPoint(float x, float y);                          /* add a point of the stream; adds equidistant samples and drops the ones which fall out of the window */
+    Gesture* spot(float* score);                              /* match the current window; returns NULL when the window isn't filled yet or the score is below `min_score`. After a match we start with an empty window. */
+    void reset();                                             /* removes all samples */
+
+  public:
+    Protractor* protractor;                                   /* the protractor with the templates */
+    Gesture window;                                           /* the resampled and vectorized points of the last spotted window */
+    std::deque<Vec2> samples;                                 /* equidistant samples of the stream, the oldest first */
+    float min_score;                                          /* spot() only returns matches with at least this score */
+
+  private:
+    int num_samples;                                          /* number of points we match, must be the same as the resampled templates */
+    int oversampling;                                         /* we store this many samples per resampled point */
+    size_t window_samples;                                    /* number of samples in a full window: (num_samples - 1) * oversampling + 1 */
+    float spacing;                                            /* distance between two samples */
+    float distance;                                           /* path length since the last sample */
+    Vec2 last_point;                                          /* the last point passed to addPoint() */
+    bool has_point;                                           /* true when last_point is set */
   };
 
 } // namespace 
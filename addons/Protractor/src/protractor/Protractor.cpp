@@ -1,7 +1,9 @@
 #include <assert.h>
 #include <fstream>
+#include <algorithm>
 #include <roxlu/core/Utils.h>
 #include <roxlu/core/Log.h>
+#include <roxlu/math/SIMD.h>
 #include <protractor/Protractor.h>
 
 namespace protractor {
@@ -45,7 +47,7 @@ namespace protractor {
     }
 
     if(resampled_points.size() > n) {
-      resampled_points.erase(resampled_points.begin(), resampled_points.begin()+n);
+      resampled_points.erase(resampled_points.begin() + n, resampled_points.end());
     }
   }
 
@@ -175,7 +177,20 @@ namespace protractor {
 
   // ----------------------------------------------------
 
-  Protractor::Protractor() {
+  ProtractorMatch::ProtractorMatch()
+    :gesture(NULL)
+    ,score(0.0f)
+    ,distance(0.0f)
+  {
+  }
+
+  // ----------------------------------------------------
+
+  Protractor::Protractor() 
+    :num_templates(0)
+    ,num_points(0)
+    ,stride(0)
+  {
   }
 
   Protractor::~Protractor() {
@@ -191,30 +206,152 @@ namespace protractor {
     gestures.push_back(g);
   }
 
+  void Protractor::updateTemplates() {
+    num_templates = gestures.size();
+    num_points = (num_templates) ? gestures[0]->rotated_points.size() : 0;
+    stride = ((num_templates + PROTRACTOR_SIMD_WIDTH - 1) / PROTRACTOR_SIMD_WIDTH) * PROTRACTOR_SIMD_WIDTH;
+
+    template_x.assign(num_points * stride, 0.0f);
+    template_y.assign(num_points * stride, 0.0f);
+    template_gestures.assign(stride, (Gesture*)NULL);
+
+    for(size_t t = 0; t < num_templates; ++t) {
+      Gesture* g = gestures[t];
+      if(g->rotated_points.size() != num_points) {
+        RX_ERROR(ERR_PROT_TEMPLATE_SIZE, g->name.c_str(), g->rotated_points.size(), num_points);
+        continue;
+      }
+      for(size_t i = 0; i < num_points; ++i) {
+        template_x[i * stride + t] = g->rotated_points[i].x;
+        template_y[i * stride + t] = g->rotated_points[i].y;
+      }
+      template_gestures[t] = g;
+    }
+  }
+
+  // For every template we calculate a = sum(in.x * t.x + in.y * t.y) and
+  // b = sum(in.x * t.y - in.y * t.x). The cosine distance is acos(a * cos(atan(b/a)) + b * sin(atan(b/a)))
+  // which is acos(sign(a) * sqrt(a^2 + b^2)), so the template with the largest
+  // sign(a) * (a^2 + b^2) has the smallest distance.
+  void Protractor::scoreTemplates(Gesture* in, size_t first, size_t count, float& bestValue, size_t& bestTemplate) {
+    const Vec2* pts = &in->rotated_points[0];
+
+    for(size_t t = first; t < first + count; t += PROTRACTOR_SIMD_WIDTH) {
+      float values[PROTRACTOR_SIMD_WIDTH];
+
+#if defined(ROXLU_USE_SSE)
+      __m128 a = _mm_setzero_ps();
+      __m128 b = _mm_setzero_ps();
+      for(size_t i = 0; i < num_points; ++i) {
+        __m128 ix = _mm_set1_ps(pts[i].x);
+        __m128 iy = _mm_set1_ps(pts[i].y);
+        __m128 tx = _mm_loadu_ps(&template_x[i * stride + t]);
+        __m128 ty = _mm_loadu_ps(&template_y[i * stride + t]);
+        a = _mm_add_ps(a, _mm_add_ps(_mm_mul_ps(ix, tx), _mm_mul_ps(iy, ty)));
+        b = _mm_add_ps(b, _mm_sub_ps(_mm_mul_ps(ix, ty), _mm_mul_ps(iy, tx)));
+      }
+      __m128 len = _mm_add_ps(_mm_mul_ps(a, a), _mm_mul_ps(b, b));
+      __m128 sign = _mm_and_ps(a, _mm_set1_ps(-0.0f));
+      _mm_storeu_ps(values, _mm_or_ps(len, sign));
+#else
+      float a[PROTRACTOR_SIMD_WIDTH] = { 0.0f };
+      float b[PROTRACTOR_SIMD_WIDTH] = { 0.0f };
+      for(size_t i = 0; i < num_points; ++i) {
+        const float* tx = &template_x[i * stride + t];
+        const float* ty = &template_y[i * stride + t];
+        for(int k = 0; k < PROTRACTOR_SIMD_WIDTH; ++k) {
+          a[k] += pts[i].x * tx[k] + pts[i].y * ty[k];
+          b[k] += pts[i].x * ty[k] - pts[i].y * tx[k];
+        }
+      }
+      for(int k = 0; k < PROTRACTOR_SIMD_WIDTH; ++k) {
+        float len = a[k] * a[k] + b[k] * b[k];
+        values[k] = (a[k] < 0.0f) ? -len : len;
+      }
+#endif
+
+      for(int k = 0; k < PROTRACTOR_SIMD_WIDTH; ++k) {
+        if(values[k] > bestValue && template_gestures[t + k]) {
+          bestValue = values[k];
+          bestTemplate = t + k;
+        }
+      }
+    }
+  }
+
+  ProtractorMatch Protractor::createMatch(float bestValue, size_t bestTemplate) {
+    ProtractorMatch m;
+    if(bestTemplate >= num_templates) {
+      return m;
+    }
+
+    float sim = (bestValue < 0.0f) ? -sqrtf(-bestValue) : sqrtf(bestValue);
+    sim = std::min<float>(1.0f, std::max<float>(-1.0f, sim));
+
+    m.gesture = template_gestures[bestTemplate];
+    m.distance = acos(sim);
+    m.score = 1.0f / m.distance;
+    return m;
+  }
+
   Gesture* Protractor::match(Gesture* in, float* score) {
-    Gesture* matched = NULL;
-    float max_score = 0.0f;
-    float s = 0.0f;
-    float distance = 0.0f;
 
     // @todo add a flag if the input gesture needs to be vectorized
     in->resample();
     in->vectorize();
 
-    for(std::vector<Gesture*>::iterator it = gestures.begin(); it != gestures.end(); ++it) {
-      Gesture* other = *it;
-      distance = in->calculateCosineDistance(other);
-      //RX_VERBOSE("DIST: %f (%s)", distance, other->name.c_str());
-      s = 1.0f/distance;
-
-      if(s > max_score) {
-        max_score = s;
-        matched = other;
+    return matchVectorized(in, score);
+  }
+
+  Gesture* Protractor::matchVectorized(Gesture* in, float* score) {
+    if(num_templates != gestures.size()) {
+      updateTemplates();
+    }
+
+    float best_value = -FLT_MAX;
+    size_t best_template = num_templates;
+
+    if(in->rotated_points.size() == num_points) {
+      scoreTemplates(in, 0, stride, best_value, best_template);
+    }
+    else if(num_templates) {
+      RX_ERROR(ERR_PROT_VECTOR_SIZE_MISMATCH);
+    }
+
+    ProtractorMatch m = createMatch(best_value, best_template);
+    *score = m.score;
+    return m.gesture;
+  }
+
+  void Protractor::match(std::vector<Gesture*>& inputs, std::vector<ProtractorMatch>& result) {
+    result.assign(inputs.size(), ProtractorMatch());
+
+    if(num_templates != gestures.size()) {
+      updateTemplates();
+    }
+
+    std::vector<float> best_values(inputs.size(), -FLT_MAX);
+    std::vector<size_t> best_templates(inputs.size(), num_templates);
+
+    for(size_t j = 0; j < inputs.size(); ++j) {
+      inputs[j]->resample();
+      inputs[j]->vectorize();
+    }
+
+    // score a block of templates for all inputs before we move to the next block
+    for(size_t first = 0; first < stride; first += PROTRACTOR_BLOCK_SIZE) {
+      size_t count = std::min<size_t>(PROTRACTOR_BLOCK_SIZE, stride - first);
+      for(size_t j = 0; j < inputs.size(); ++j) {
+        if(inputs[j]->rotated_points.size() != num_points) {
+          continue;
+        }
+        scoreTemplates(inputs[j], first, count, best_values[j], best_templates[j]);
       }
     }
 
-    *score = s;
-    return matched;
+    for(size_t j = 0; j < inputs.size(); ++j) {
+      result[j] = createMatch(best_values[j], best_templates[j]);
+    }
   }
 
   bool Protractor::save(std::string filename, bool datapath) {
@@ -265,4 +402,93 @@ namespace protractor {
     return true;
   }
 
+  // ----------------------------------------------------
+
+  GestureSpotter::GestureSpotter(Protractor* protractor, float windowLength, int numSamples, int oversampling)
+    :protractor(protractor)
+    ,window("window")
+    ,min_score(0.0f)
+    ,num_samples(numSamples)
+    ,oversampling(oversampling)
+    ,window_samples((numSamples - 1) * oversampling + 1)
+    ,spacing(windowLength / ((numSamples - 1) * oversampling))
+    ,distance(0.0f)
+    ,has_point(false)
+  {
+    assert(numSamples > 1);
+    assert(oversampling > 0);
+    assert(windowLength > 0.0f);
+  }
+
+  // Walks along the new segment and adds a sample every `spacing` units. We
+  // only touch the new segment and the ends of the deque, so the cost
+  // depends on the length of the segment, not on the length of the stream.
+  void GestureSpotter::addPoint(float x, float y) {
+    Vec2 p(x, y);
+
+    if(!has_point) {
+      has_point = true;
+      last_point = p;
+      distance = 0.0f;
+      samples.push_back(p);
+      return;
+    }
+
+    Vec2 prev = last_point;
+    Vec2 dir = p - prev;
+    float d = dir.length();
+    last_point = p;
+
+    if(d <= 0.0f) {
+      return;
+    }
+
+    float walked = 0.0f;  /* distance along this segment of the last sample we added */
+    while(distance + (d - walked) >= spacing) {
+      walked += spacing - distance;
+      samples.push_back(prev + dir * (walked / d));
+      distance = 0.0f;
+
+      if(samples.size() > window_samples) {
+        samples.pop_front();
+      }
+    }
+
+    distance += d - walked;
+  }
+
+  // The samples are equidistant, so resampling the window to `num_samples`
+  // points is picking every `oversampling`-th sample.
+  Gesture* GestureSpotter::spot(float* score) {
+    *score = 0.0f;
+
+    if(samples.size() < window_samples) {
+      return NULL;
+    }
+
+    window.resampled_points.resize(num_samples);
+    for(int i = 0; i < num_samples; ++i) {
+      window.resampled_points[i] = samples[i * oversampling];
+    }
+    window.vectorize();
+
+    Gesture* matched = protractor->matchVectorized(&window, score);
+    if(!matched || *score < min_score) {
+      return NULL;
+    }
+
+    // start with an empty window, so we don't spot the same gesture again
+    samples.clear();
+    samples.push_back(last_point);
+    distance = 0.0f;
+    return matched;
+  }
+
+  void GestureSpotter::reset() {
+    samples.clear();
+    window.reset();
+    distance = 0.0f;
+    has_point = false;
+  }
+
 };
@@ -11,6 +11,7 @@ Twitter::~Twitter() {
 bool Twitter::setup(std::string token, std::string tokenSecret, 
                     std::string consumer, std::string consumerSecret)
 {
+  http.setSSLContext(&ssl_ctx);
   oauth.setConsumer(consumer, consumerSecret);
   oauth.setToken(token, tokenSecret);
   return true;
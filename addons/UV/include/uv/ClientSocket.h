@@ -10,6 +10,7 @@ extern "C" {
 #include <vector>
 #include <string>
 #include <roxlu/core/Log.h>
+#include <uv/WriteQueue.h>
 
 #define CS_WARN_CANT_DISCONNECT "We're not connected so we cant disconnect"
 #define CS_WARN_RECONNECTING "Cannot connect as we're already reconnecting"
@@ -20,12 +21,14 @@ class ClientSocket;
 
 typedef void(*client_socket_on_connected_cb)(ClientSocket* sock);
 typedef void(*client_socket_on_read_cb)(char* buf, size_t nbytes, ClientSocket* sock);
+typedef void(*client_socket_backpressure_cb)(ClientSocket* sock);                             /* gets called when the output queue crosses the high water mark or drained again */
 
 void client_socket_on_resolved(uv_getaddrinfo_t* req, int status, struct addrinfo* res);
 void client_socket_on_connect(uv_connect_t* req, int status);
 void client_socket_on_read(uv_stream_t* handle, ssize_t nread, uv_buf_t buf);
 uv_buf_t client_socket_on_alloc(uv_handle_t* handle, size_t nbytes);
-void client_socket_on_write(uv_write_t* req, int status);
+void client_socket_on_high_water(WriteQueue* queue, void* user);
+void client_socket_on_drain(WriteQueue* queue, void* user);
 void client_socket_on_shutdown(uv_shutdown_t* req, int status);
 void client_socket_on_shutdown_reconnect(uv_shutdown_t* req, int status);
 void client_socket_on_close(uv_handle_t* req);
@@ -42,12 +45,20 @@ class ClientSocket {
              client_socket_on_read_cb readCB,
              void* user);
 
-  void update();                                                /* you must call this repeatetly! each time you call update() we process a bit of socket data */
+  void setBackpressureCallbacks(client_socket_backpressure_cb highWaterCB,   /* set the callbacks which are called when we have more then `highWater` bytes queued and when we dropped below `lowWater` again */
+                                client_socket_backpressure_cb drainCB,
+                                size_t lowWater = WQ_DEFAULT_LOW_WATER,
+                                size_t highWater = WQ_DEFAULT_HIGH_WATER);
+
+  void update();                                                /* you must call this repeatetly! each time you call update() we flush the output queue and process a bit of socket data */
   bool connect();                                               /* connect to the server */
   void disconnect();                                            /* disconnects the current connection; if connected */
   void reconnect();                                             /* used internally; when disconnected we try to reconnect on a given time interval */
-  void write(char* data, size_t nbytes);                        /* write data over sockets */
+  void write(char* data, size_t nbytes);                        /* queue data; small writes are coalesced and written on the next update() */
   void write(const char* data, size_t nbytes);                  /* .... */
+  void write(WriteBuffer* buffer);                              /* queue a shared buffer (we retain it) */
+  bool flush();                                                 /* write all queued data now */
+  size_t getPendingBytes();                                     /* number of bytes queued + in flight */
   //  void clear();                                                 /* clears the buffer */
   void close();                                                 /* shuts down the connection */
   bool isConnected();                                           /* check if the socket is connected.. this is not a 100% safe way to check as the socket can be "alive" but the connection was just closed. Best way is to write something to the socket and check if the result isn't -1 (this is done internally) */
@@ -65,7 +76,11 @@ class ClientSocket {
 
   client_socket_on_connected_cb cb_connected;
   client_socket_on_read_cb cb_read;
+  client_socket_backpressure_cb cb_high_water;
+  client_socket_backpressure_cb cb_drain;
   void* user;
+
+  WriteQueue output;                                            /* output queue; coalesces writes and pools write requests */
   
   bool is_connected;
   bool is_connecting; 
@@ -76,6 +91,10 @@ inline void ClientSocket::write(const char* data, size_t nbytes) {
   write((char*)data, nbytes);
 }
 
+inline size_t ClientSocket::getPendingBytes() {
+  return output.getPendingBytes();
+}
+
 inline bool ClientSocket::isConnected() {
   return is_connected;
 }
@@ -8,6 +8,7 @@ extern "C" {
 
 #include <vector>
 #include <iterator>
+#include <uv/WriteQueue.h>
 
 #define S_VERB_NEW_CONNECTION "Got a new connection: %p"
 #define S_VERB_REMOVED_CONNECTION "Removed connection: %p"
@@ -24,8 +25,6 @@ extern "C" {
 #define S_ERR_READ_STOP "Failed to disable reading on clent socket"
 #define S_ERR_SHUTDOWN "Failed to call uv_shutdown for a client socket"
 #define S_ERR_CON_NOT_FOUND "Cannot remove the connection because we didn't find it"
-#define S_ERR_CANNOT_WRITE "Cannot write to connection"
-#define S_ERR_WRITE_FAILED "Writing to connection failed: %s"
 
 #define SERVER_UV_ERR(r, okval, msg, ret)      \
   if(r != okval) { \
@@ -38,7 +37,8 @@ class ServerSocket;
 class ServerConnection;
 
 /* server connection specific callbacks */
-void server_connection_on_write(uv_write_t* req, int status);
+void server_connection_on_high_water(WriteQueue* queue, void* user);
+void server_connection_on_drain(WriteQueue* queue, void* user);
 
 /* server libuv callbacks */
 void server_socket_on_new_connection(uv_stream_t* sock, int status);
@@ -51,14 +51,20 @@ uv_buf_t server_socket_on_alloc(uv_handle_t* handle, size_t nbytes);
 typedef void(*server_socket_new_connection_callback)(ServerConnection* con, void* user); /* gets called when a new client connects */
 typedef void(*server_socket_read_callback)(ServerConnection* con, void* user); /* gets called when we received new data which was appended to ServerConnection::buffer */
 typedef void(*server_socket_close_connection_callback)(ServerConnection* con, void* user); /* gets called when a client disconnects */
+typedef void(*server_socket_backpressure_callback)(ServerConnection* con, void* user); /* gets called when the output queue of a connection crosses the high water mark or drained again */
 
 struct ServerConnection {                                     /* represents a client connection */
   ServerConnection(ServerSocket* server);
   ~ServerConnection();
-  void write(const char* data, size_t bytes);                 /* write data to the client */
+  void write(const char* data, size_t bytes);                 /* queue data for the client; small writes are coalesced and written on the next ServerSocket::update() */
+  void write(WriteBuffer* buffer);                            /* queue a shared buffer (we retain it) */
+  bool flush();                                               /* write all queued data now */
+  size_t getPendingBytes();                                   /* number of bytes queued + in flight for this client */
+  bool isAboveHighWater();                                    /* true when this client isn't keeping up (see ServerSocket::setBackpressureCallbacks()) */
   uv_tcp_t sock;                                              /* the socket on which we communicate */
   uv_shutdown_t shutdown_req;                                 /* used internally to correctly close a client connection */
   ServerSocket* server;                                       /* points to the server */
+  WriteQueue output;                                          /* output queue; coalesces writes and pools write requests */
   std::vector<char> buffer;
 };
 
@@ -73,10 +79,17 @@ class ServerSocket {                                         /* the server socke
              void* user
   );
 
+  void setBackpressureCallbacks(server_socket_backpressure_callback highWaterCB, /* set the callbacks that are called when a connection queued more then `highWater` bytes, and when it dropped below `lowWater` again */
+                                server_socket_backpressure_callback drainCB,
+                                size_t lowWater = WQ_DEFAULT_LOW_WATER,
+                                size_t highWater = WQ_DEFAULT_HIGH_WATER);
+
   bool start();                                                 /* start the server and accepting new connections */
-  void update();                                                /* call this as often as possible */
+  void update();                                                /* call this as often as possible; flushes the output queues of all connections */
+  void flush();                                                 /* flush the output queues of all connections */
   void removeConnection(ServerConnection* con);                 /* is used internally to cleanup when a client disconnects */
-  void writeToAllConnections(const char* data, size_t nbytes);        
+  void writeToAllConnections(const char* data, size_t nbytes);  /* the data is copied once and shared between all connections */
+  void writeToAllConnections(WriteBuffer* buffer);              /* queue the same buffer on all connections */
  public:
   uv_loop_t* loop;
   uv_tcp_t sock;
@@ -86,8 +99,28 @@ class ServerSocket {                                         /* the server socke
   server_socket_new_connection_callback cb_new_connection;
   server_socket_read_callback cb_read;
   server_socket_close_connection_callback cb_close;
+  server_socket_backpressure_callback cb_high_water;
+  server_socket_backpressure_callback cb_drain;
+  size_t low_water;
+  size_t high_water;
   void* cb_user;
   
 };
 
+inline void ServerConnection::write(WriteBuffer* b) {
+  output.write(b);
+}
+
+inline bool ServerConnection::flush() {
+  return output.flush();
+}
+
+inline size_t ServerConnection::getPendingBytes() {
+  return output.getPendingBytes();
+}
+
+inline bool ServerConnection::isAboveHighWater() {
+  return output.isAboveHighWater();
+}
+
 #endif
@@ -0,0 +1,155 @@
+/*
+  # WriteQueue
+
+  Per stream output queue used by `ServerConnection` and `ClientSocket`. Instead of
+  allocating a `uv_write_t` and issuing a `uv_write()` for every call to `write()`,
+  we append the data to a queue and `flush()` it from `update()`. All pending data is
+  written with one `uv_write()` that uses multiple `uv_buf_t`s.
+
+  - Small writes (< coalesce_size) are copied into one shared, growing block so
+    many tiny messages end up in one `uv_buf_t`.
+  - Bigger writes get their own `WriteBuffer`.
+  - A `WriteBuffer` is reference counted so the same payload can be queued on many
+    streams (see `ServerSocket::writeToAllConnections()`) without copying it per client.
+  - `WriteReq`s (which wrap the `uv_write_t`) are pooled and reused.
+  - When the number of queued + in-flight bytes exceeds `high_water` we call the
+    high water callback once; when it drops below `low_water` again we call the
+    drain callback. Use these to stop producing data for slow clients.
+
+ */
+#ifndef ROXLU_UV_WRITE_QUEUE_H
+#define ROXLU_UV_WRITE_QUEUE_H
+
+extern "C" {
+#  include <uv.h>
+}
+
+#include <vector>
+#include <stdlib.h>
+
+#define WQ_DEFAULT_COALESCE_SIZE 1024               /* writes smaller than this are copied into a shared block */
+#define WQ_DEFAULT_BLOCK_SIZE (16 * 1024)           /* capacity of a coalesce block */
+#define WQ_DEFAULT_HIGH_WATER (4 * 1024 * 1024)     /* call the high water callback when more then this number of bytes is pending */
+#define WQ_DEFAULT_LOW_WATER (1024 * 1024)          /* call the drain callback when we drop below this number of bytes */
+#define WQ_DEFAULT_MAX_BUFS 64                      /* max number of uv_buf_t's per uv_write() */
+
+#define WQ_ERR_CANNOT_WRITE "uv_write() failed: %s"
+#define WQ_ERR_WRITE_FAILED "Writing data failed: %s"
+#define WQ_ERR_NO_STREAM "Cannot flush, no stream set"
+
+class WriteQueue;
+
+typedef void(*write_queue_callback)(WriteQueue* queue, void* user);
+
+void write_queue_on_write(uv_write_t* req, int status);
+
+// ---------------------------------------------------
+
+struct WriteBuffer {                                              /* reference counted payload; create with `WriteBuffer::create()`, never delete directly */
+  static WriteBuffer* create(size_t capacity);                    /* allocate a buffer which can hold `capacity` bytes; refcount is 1 */
+  static WriteBuffer* create(const char* data, size_t nbytes);    /* allocate + copy the given data; refcount is 1 */
+  void retain();                                                  /* increment the reference count */
+  void release();                                                 /* decrement the reference count, frees when it reaches zero */
+  size_t available();                                             /* number of bytes we can still append */
+  void append(const char* data, size_t nbytes);                   /* append data; make sure there is enough space (see available()) */
+
+  char* data;
+  size_t size;                                                    /* number of bytes used */
+  size_t capacity;                                                /* number of bytes allocated */
+  int refcount;
+
+ private:
+  WriteBuffer();
+  ~WriteBuffer();
+};
+
+// ---------------------------------------------------
+
+struct WriteReq {                                                 /* wraps a uv_write_t and keeps the buffers alive which are being written */
+  WriteReq();
+  void reset();                                                   /* releases all buffers */
+
+  uv_write_t req;
+  WriteQueue* queue;
+  size_t nbytes;                                                  /* total number of bytes in this request */
+  std::vector<WriteBuffer*> buffers;
+  std::vector<uv_buf_t> bufs;
+};
+
+// ---------------------------------------------------
+
+struct WriteEntry {                                               /* a queued slice of a WriteBuffer */
+  WriteBuffer* buffer;
+  size_t offset;
+  size_t nbytes;
+};
+
+class WriteQueue {
+ public:
+  WriteQueue();
+  ~WriteQueue();
+  void setStream(uv_stream_t* stream);                            /* set the stream we write to */
+  void setCallbacks(write_queue_callback highWaterCB,             /* set the backpressure callbacks */
+                    write_queue_callback drainCB,
+                    void* user);
+  void setWaterMarks(size_t low, size_t high);                    /* set the low and high water marks (in bytes) */
+  void write(const char* data, size_t nbytes);                    /* queue data; small writes are copied into a shared block */
+  void write(WriteBuffer* buffer);                                /* queue a shared buffer; we retain it; the caller keeps its own reference */
+  bool flush();                                                   /* write all queued data using one uv_write() (per WQ_DEFAULT_MAX_BUFS bufs) */
+  void clear();                                                   /* drops all queued (not in flight) data */
+  size_t getPendingBytes();                                       /* queued + in-flight bytes */
+  size_t getQueuedBytes();                                        /* bytes which are not yet passed to uv_write() */
+  bool isAboveHighWater();                                        /* returns true after we've crossed the high water mark and before we drained again */
+  void onWriteReady(WriteReq* req, int status);                   /* used internally; gets called when a uv_write is ready */
+
+ private:
+  WriteReq* getFreeRequest();
+  void checkWaterMarks();
+
+ public:
+  uv_stream_t* stream;
+  size_t coalesce_size;
+  size_t block_size;
+  size_t max_bufs;
+  size_t low_water;
+  size_t high_water;
+
+ private:
+  std::vector<WriteEntry> entries;                                /* queued data */
+  std::vector<WriteReq*> free_reqs;                               /* pooled requests */
+  std::vector<WriteReq*> all_reqs;                                /* all the requests we allocated */
+  WriteBuffer* block;                                             /* current coalesce block; is also referenced in `entries` */
+  size_t queued_bytes;
+  size_t inflight_bytes;
+  bool above_high_water;
+  write_queue_callback cb_high_water;
+  write_queue_callback cb_drain;
+  void* cb_user;
+};
+
+inline size_t WriteBuffer::available() {
+  return capacity - size;
+}
+
+inline size_t WriteQueue::getPendingBytes() {
+  return queued_bytes + inflight_bytes;
+}
+
+inline size_t WriteQueue::getQueuedBytes() {
+  return queued_bytes;
+}
+
+inline bool WriteQueue::isAboveHighWater() {
+  return above_high_water;
+}
+
+inline void WriteQueue::setStream(uv_stream_t* s) {
+  stream = s;
+}
+
+inline void WriteQueue::setWaterMarks(size_t low, size_t high) {
+  low_water = low;
+  high_water = high;
+}
+
+#endif
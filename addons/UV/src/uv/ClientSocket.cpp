@@ -11,6 +11,8 @@ ClientSocket::ClientSocket(std::string host, std::string port)
    //  ,timer_req(NULL)
   ,cb_connected(NULL)
   ,cb_read(NULL)
+  ,cb_high_water(NULL)
+  ,cb_drain(NULL)
   ,is_connected(false)
   ,is_connecting(false)
 {
@@ -23,6 +25,9 @@ ClientSocket::ClientSocket(std::string host, std::string port)
   connect_req.data = this;
   shutdown_req.data = this;
   timer_req.data = this;
+
+  output.setStream((uv_stream_t*)sock);
+  output.setCallbacks(client_socket_on_high_water, client_socket_on_drain, this);
 }
 
 ClientSocket::~ClientSocket() {
@@ -33,6 +38,8 @@ ClientSocket::~ClientSocket() {
   user = NULL;
   cb_connected = NULL;
   cb_read = NULL;
+  cb_high_water = NULL;
+  cb_drain = NULL;
 
   uv_loop_delete(loop);
   loop = NULL;
@@ -48,6 +55,16 @@ void ClientSocket::setup(client_socket_on_connected_cb conCB,
   user = userData;
 }
 
+void ClientSocket::setBackpressureCallbacks(client_socket_backpressure_cb highWaterCB,
+                                           client_socket_backpressure_cb drainCB,
+                                           size_t lowWater,
+                                           size_t highWater)
+{
+  cb_high_water = highWaterCB;
+  cb_drain = drainCB;
+  output.setWaterMarks(lowWater, highWater);
+}
+
 bool ClientSocket::connect() {
 
   if(is_connecting) {
@@ -107,6 +124,9 @@ void ClientSocket::reconnect() {
 }
 
 void ClientSocket::update() {
+  if(is_connected && !uv_is_closing((uv_handle_t*)sock)) {
+    output.flush();
+  }
   uv_run(loop, UV_RUN_NOWAIT);
 }
 
@@ -116,14 +136,24 @@ void ClientSocket::write(char* data, size_t nbytes) {
     return;
   }
 
-  uv_buf_t buf = uv_buf_init(data, nbytes);
-  uv_write_t* wreq = new uv_write_t();
-  wreq->data = this;
+  output.write(data, nbytes);
+}
 
-  int r = uv_write(wreq, (uv_stream_t*)sock, &buf, 1, client_socket_on_write);
-  if(r < 0) {
-    RX_ERROR("uv_write() to server failed.");
+void ClientSocket::write(WriteBuffer* buffer) {
+  if(!is_connected) {
+    RX_ERROR(CS_ERR_CANT_WRITE);
+    return;
   }
+
+  output.write(buffer);
+}
+
+bool ClientSocket::flush() {
+  if(!is_connected || uv_is_closing((uv_handle_t*)sock)) {
+    return false;
+  }
+
+  return output.flush();
 }
 
 void ClientSocket::close() {
@@ -229,8 +259,18 @@ uv_buf_t client_socket_on_alloc(uv_handle_t* handle, size_t nbytes) {
   return uv_buf_init(buf, nbytes);
 }
 
-void client_socket_on_write(uv_write_t* req, int status) {
-  delete req;
+void client_socket_on_high_water(WriteQueue* queue, void* user) {
+  ClientSocket* c = static_cast<ClientSocket*>(user);
+  if(c->cb_high_water) {
+    c->cb_high_water(c);
+  }
+}
+
+void client_socket_on_drain(WriteQueue* queue, void* user) {
+  ClientSocket* c = static_cast<ClientSocket*>(user);
+  if(c->cb_drain) {
+    c->cb_drain(c);
+  }
 }
 
 void client_socket_on_shutdown(uv_shutdown_t* req, int status) {
@@ -246,11 +286,13 @@ void client_socket_on_shutdown_reconnect(uv_shutdown_t* req, int status) {
 
 void client_socket_on_close(uv_handle_t* handle) {
   ClientSocket* c = static_cast<ClientSocket*>(handle->data);
+  c->output.clear(); /* data was meant for the closed connection */
   c->is_connected = false;
 }
 
 void client_socket_on_close_reconnect(uv_handle_t* handle) {
   ClientSocket* c = static_cast<ClientSocket*>(handle->data);
+  c->output.clear(); /* data was meant for the previous connection */
   c->is_connected = false;
   c->is_connecting = false;
   c->reconnect();
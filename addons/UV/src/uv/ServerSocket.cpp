@@ -64,28 +64,20 @@ void server_socket_on_read(uv_stream_t* sock, ssize_t nbytes, uv_buf_t buf) {
       buf.base = NULL;
     }
     
+    /* 
+       we close the handle (instead of deleting the connection directly) so libuv
+       can cancel the pending writes of the output queue; server_socket_on_close() 
+       removes and deletes the connection.
+    */
     if(nbytes != UV_EOF) {
-
-      if(con->server->cb_close) {
-        con->server->cb_close(con, con->server->cb_user);
-      }
-
-      con->server->removeConnection(con);
-      delete con;
-      con = NULL;
+      uv_close((uv_handle_t*)&con->sock, server_socket_on_close);
       return;
     }
 
     r = uv_shutdown(&con->shutdown_req, sock, server_socket_on_shutdown);
     if(r <  0) {
       RX_ERROR(S_ERR_SHUTDOWN);
-
-      if(con->server->cb_close) {
-        con->server->cb_close(con, con->server->cb_user);
-      }
-
-      delete con;
-      con = NULL;
+      uv_close((uv_handle_t*)&con->sock, server_socket_on_close);
     }
 
     return;
@@ -116,6 +108,7 @@ void server_socket_on_close(uv_handle_t* handle) {
   }
 
   con->server->removeConnection(con);
+  con->output.clear();
 
   delete con;
   con = NULL;
@@ -134,15 +127,18 @@ uv_buf_t server_socket_on_alloc(uv_handle_t* handle, size_t nbytes) {
 
 // SERVER CONNECTION
 // ---------------------------------------------------
-void server_connection_on_write(uv_write_t* req, int status) {
-
-  ServerConnection* con = static_cast<ServerConnection*>(req->data);
-
-  if(status) {
-    RX_ERROR(S_ERR_WRITE_FAILED, status);
+void server_connection_on_high_water(WriteQueue* queue, void* user) {
+  ServerConnection* con = static_cast<ServerConnection*>(user);
+  if(con->server->cb_high_water) {
+    con->server->cb_high_water(con, con->server->cb_user);
   }
+}
 
-  delete req;
+void server_connection_on_drain(WriteQueue* queue, void* user) {
+  ServerConnection* con = static_cast<ServerConnection*>(user);
+  if(con->server->cb_drain) {
+    con->server->cb_drain(con, con->server->cb_user);
+  }
 }
 
 ServerConnection::ServerConnection(ServerSocket* server) 
@@ -150,20 +146,16 @@ ServerConnection::ServerConnection(ServerSocket* server)
 {
   sock.data = this;
   shutdown_req.data = this;
+  output.setStream((uv_stream_t*)&sock);
+  output.setWaterMarks(server->low_water, server->high_water);
+  output.setCallbacks(server_connection_on_high_water, server_connection_on_drain, this);
 }
 
 ServerConnection::~ServerConnection() {
 }
 
 void ServerConnection::write(const char* data, size_t nbytes) {
-  uv_buf_t buf = uv_buf_init((char*)data, nbytes);
-  uv_write_t* req = new uv_write_t();
-  req->data = this;
-  
-  int r = uv_write(req, (uv_stream_t*)&sock, &buf, 1, server_connection_on_write);
-  if(r < 0) {
-    RX_ERROR(S_ERR_CANNOT_WRITE);
-  }
+  output.write(data, nbytes);
 }
 
 
@@ -174,6 +166,10 @@ ServerSocket::ServerSocket(int port)
   ,cb_new_connection(NULL)
   ,cb_read(NULL)
   ,cb_close(NULL)
+  ,cb_high_water(NULL)
+  ,cb_drain(NULL)
+  ,low_water(WQ_DEFAULT_LOW_WATER)
+  ,high_water(WQ_DEFAULT_HIGH_WATER)
   ,cb_user(NULL)
 {
   loop = uv_loop_new();
@@ -185,6 +181,8 @@ ServerSocket::~ServerSocket() {
   cb_close = NULL;
   cb_read = NULL;
   cb_new_connection = NULL;
+  cb_high_water = NULL;
+  cb_drain = NULL;
 }
 
 void ServerSocket::setup(server_socket_new_connection_callback conCB,     
@@ -198,6 +196,20 @@ void ServerSocket::setup(server_socket_new_connection_callback conCB,
   cb_user = user;
 }
 
+void ServerSocket::setBackpressureCallbacks(server_socket_backpressure_callback highWaterCB,
+                                            server_socket_backpressure_callback drainCB,
+                                            size_t lowWater,
+                                            size_t highWater)
+{
+  cb_high_water = highWaterCB;
+  cb_drain = drainCB;
+  low_water = lowWater;
+  high_water = highWater;
+
+  for(std::vector<ServerConnection*>::iterator it = connections.begin(); it != connections.end(); ++it) {
+    (*it)->output.setWaterMarks(low_water, high_water);
+  }
+}
 
 bool ServerSocket::start() {
   if(!loop) {
@@ -222,9 +234,20 @@ bool ServerSocket::start() {
 
 
 void ServerSocket::update() {
+  flush();
   uv_run(loop, UV_RUN_NOWAIT);
 }
 
+void ServerSocket::flush() {
+  for(std::vector<ServerConnection*>::iterator it = connections.begin(); it != connections.end(); ++it) {
+    ServerConnection* con = *it;
+    if(uv_is_closing((uv_handle_t*)&con->sock)) {
+      continue; /* the close callback removes the connection */
+    }
+    con->flush();
+  }
+}
+
 void ServerSocket::removeConnection(ServerConnection* con) {
   std::vector<ServerConnection*>::iterator it = std::find(connections.begin(), connections.end(), con);
   if(it == connections.end()) {
@@ -237,7 +260,25 @@ void ServerSocket::removeConnection(ServerConnection* con) {
 }
 
 void ServerSocket::writeToAllConnections(const char* data, size_t nbytes) {
+  if(!connections.size()) {
+    return;
+  }
+
+  /* small messages are coalesced per connection, bigger ones are shared */
+  if(nbytes < WQ_DEFAULT_COALESCE_SIZE) {
+    for(std::vector<ServerConnection*>::iterator it = connections.begin(); it != connections.end(); ++it) {
+      (*it)->write(data, nbytes);
+    }
+    return;
+  }
+
+  WriteBuffer* b = WriteBuffer::create(data, nbytes);
+  writeToAllConnections(b);
+  b->release();
+}
+
+void ServerSocket::writeToAllConnections(WriteBuffer* b) {
   for(std::vector<ServerConnection*>::iterator it = connections.begin(); it != connections.end(); ++it) {
-    (*it)->write(data, nbytes);
+    (*it)->write(b);
   }
 }
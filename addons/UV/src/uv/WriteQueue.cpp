@@ -0,0 +1,287 @@
+#include <uv/WriteQueue.h>
+#include <roxlu/core/Log.h>
+#include <string.h>
+#include <algorithm>
+
+// CALLBACKS
+// ---------------------------------------------------
+void write_queue_on_write(uv_write_t* req, int status) {
+  WriteReq* wr = static_cast<WriteReq*>(req->data);
+  wr->queue->onWriteReady(wr, status);
+}
+
+// WRITE BUFFER
+// ---------------------------------------------------
+WriteBuffer::WriteBuffer()
+  :data(NULL)
+  ,size(0)
+  ,capacity(0)
+  ,refcount(1)
+{
+}
+
+WriteBuffer::~WriteBuffer() {
+  if(data) {
+    delete[] data;
+    data = NULL;
+  }
+  size = 0;
+  capacity = 0;
+}
+
+WriteBuffer* WriteBuffer::create(size_t capacity) {
+  WriteBuffer* b = new WriteBuffer();
+  b->data = new char[capacity];
+  b->capacity = capacity;
+  return b;
+}
+
+WriteBuffer* WriteBuffer::create(const char* data, size_t nbytes) {
+  WriteBuffer* b = WriteBuffer::create(nbytes);
+  b->append(data, nbytes);
+  return b;
+}
+
+void WriteBuffer::retain() {
+  refcount++;
+}
+
+void WriteBuffer::release() {
+  refcount--;
+  if(refcount <= 0) {
+    delete this;
+  }
+}
+
+void WriteBuffer::append(const char* src, size_t nbytes) {
+  memcpy(data + size, src, nbytes);
+  size += nbytes;
+}
+
+// WRITE REQUEST
+// ---------------------------------------------------
+WriteReq::WriteReq()
+  :queue(NULL)
+  ,nbytes(0)
+{
+  req.data = this;
+}
+
+void WriteReq::reset() {
+  for(std::vector<WriteBuffer*>::iterator it = buffers.begin(); it != buffers.end(); ++it) {
+    (*it)->release();
+  }
+  buffers.clear();
+  bufs.clear();
+  nbytes = 0;
+}
+
+// WRITE QUEUE
+// ---------------------------------------------------
+WriteQueue::WriteQueue()
+  :stream(NULL)
+  ,coalesce_size(WQ_DEFAULT_COALESCE_SIZE)
+  ,block_size(WQ_DEFAULT_BLOCK_SIZE)
+  ,max_bufs(WQ_DEFAULT_MAX_BUFS)
+  ,low_water(WQ_DEFAULT_LOW_WATER)
+  ,high_water(WQ_DEFAULT_HIGH_WATER)
+  ,block(NULL)
+  ,queued_bytes(0)
+  ,inflight_bytes(0)
+  ,above_high_water(false)
+  ,cb_high_water(NULL)
+  ,cb_drain(NULL)
+  ,cb_user(NULL)
+{
+}
+
+WriteQueue::~WriteQueue() {
+  /*
+     All in-flight requests must be finished at this point; libuv calls the
+     write callbacks (with UV_ECANCELED) before the close callback of the stream.
+  */
+  clear();
+
+  for(std::vector<WriteReq*>::iterator it = all_reqs.begin(); it != all_reqs.end(); ++it) {
+    (*it)->reset();
+    delete *it;
+  }
+
+  all_reqs.clear();
+  free_reqs.clear();
+  stream = NULL;
+  cb_high_water = NULL;
+  cb_drain = NULL;
+  cb_user = NULL;
+}
+
+void WriteQueue::setCallbacks(write_queue_callback highWaterCB, write_queue_callback drainCB, void* user) {
+  cb_high_water = highWaterCB;
+  cb_drain = drainCB;
+  cb_user = user;
+}
+
+void WriteQueue::write(const char* data, size_t nbytes) {
+  if(!nbytes) {
+    return;
+  }
+
+  if(nbytes >= coalesce_size) {
+    WriteBuffer* b = WriteBuffer::create(data, nbytes);
+    write(b);
+    b->release();
+    return;
+  }
+
+  if(!block || block->available() < nbytes) {
+    if(block) {
+      block->release();
+    }
+    block = WriteBuffer::create(block_size);
+  }
+
+  /* extend the last entry when it points to the end of the current block */
+  size_t offset = block->size;
+  block->append(data, nbytes);
+  queued_bytes += nbytes;
+
+  if(entries.size()) {
+    WriteEntry& last = entries.back();
+    if(last.buffer == block && last.offset + last.nbytes == offset) {
+      last.nbytes += nbytes;
+      checkWaterMarks();
+      return;
+    }
+  }
+
+  WriteEntry e;
+  e.buffer = block;
+  e.offset = offset;
+  e.nbytes = nbytes;
+  block->retain();
+  entries.push_back(e);
+
+  checkWaterMarks();
+}
+
+void WriteQueue::write(WriteBuffer* buffer) {
+  if(!buffer->size) {
+    return;
+  }
+
+  WriteEntry e;
+  e.buffer = buffer;
+  e.offset = 0;
+  e.nbytes = buffer->size;
+  buffer->retain();
+  entries.push_back(e);
+
+  queued_bytes += buffer->size;
+  checkWaterMarks();
+}
+
+bool WriteQueue::flush() {
+  if(!entries.size()) {
+    return true;
+  }
+
+  if(!stream) {
+    RX_ERROR(WQ_ERR_NO_STREAM);
+    return false;
+  }
+
+  bool result = true;
+  size_t i = 0;
+
+  while(i < entries.size()) {
+
+    WriteReq* wr = getFreeRequest();
+    size_t end = std::min<size_t>(entries.size(), i + max_bufs);
+
+    for(; i < end; ++i) {
+      WriteEntry& e = entries[i];
+      wr->bufs.push_back(uv_buf_init(e.buffer->data + e.offset, e.nbytes));
+      wr->buffers.push_back(e.buffer);  /* takes over the reference of the entry */
+      wr->nbytes += e.nbytes;
+    }
+
+    queued_bytes -= wr->nbytes;
+    inflight_bytes += wr->nbytes;
+    wr->req.data = wr;
+
+    int r = uv_write(&wr->req, stream, &wr->bufs[0], wr->bufs.size(), write_queue_on_write);
+    if(r < 0) {
+      RX_ERROR(WQ_ERR_CANNOT_WRITE, uv_strerror(r));
+      inflight_bytes -= wr->nbytes;
+      wr->reset();
+      free_reqs.push_back(wr);
+      result = false;
+    }
+  }
+
+  entries.clear();
+  checkWaterMarks();
+
+  return result;
+}
+
+void WriteQueue::clear() {
+  for(std::vector<WriteEntry>::iterator it = entries.begin(); it != entries.end(); ++it) {
+    (*it).buffer->release();
+  }
+
+  entries.clear();
+  queued_bytes = 0;
+
+  if(block) {
+    block->release();
+    block = NULL;
+  }
+}
+
+void WriteQueue::onWriteReady(WriteReq* wr, int status) {
+  if(status < 0) {
+    RX_ERROR(WQ_ERR_WRITE_FAILED, uv_strerror(status));
+  }
+
+  inflight_bytes -= wr->nbytes;
+  wr->reset();
+  free_reqs.push_back(wr);
+
+  checkWaterMarks();
+}
+
+WriteReq* WriteQueue::getFreeRequest() {
+  WriteReq* wr = NULL;
+
+  if(free_reqs.size()) {
+    wr = free_reqs.back();
+    free_reqs.pop_back();
+  }
+  else {
+    wr = new WriteReq();
+    wr->queue = this;
+    wr->bufs.reserve(max_bufs);
+    wr->buffers.reserve(max_bufs);
+    all_reqs.push_back(wr);
+  }
+
+  return wr;
+}
+
+void WriteQueue::checkWaterMarks() {
+  size_t pending = getPendingBytes();
+
+  if(!above_high_water && pending > high_water) {
+    above_high_water = true;
+    if(cb_high_water) {
+      cb_high_water(this, cb_user);
+    }
+  }
+  else if(above_high_water && pending < low_water) {
+    above_high_water = false;
+    if(cb_drain) {
+      cb_drain(this, cb_user);
+    }
+  }
+}
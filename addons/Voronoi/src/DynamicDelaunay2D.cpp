@@ -0,0 +1,777 @@
+#include "DynamicDelaunay2D.h"
+#include <algorithm>
+#include <math.h>
+#include <uv.h>
+
+namespace roxlu {
+
+DelaunayVertex::DelaunayVertex()
+	:x(0.0)
+	,y(0.0)
+	,tri(-1)
+	,is_used(false)
+{
+}
+
+void delaunay_thread_function(void* user) {
+	DelaunayJob* job = static_cast<DelaunayJob*>(user);
+	job->del->runJob(*job);
+}
+
+// -------------------------------------------------------------
+
+DynamicDelaunay2D::DynamicDelaunay2D()
+	:min_x(0.0)
+	,max_x(1.0)
+	,min_y(0.0)
+	,max_y(1.0)
+	,last_tri(0)
+	,num_threads(4)
+{
+	vertices.resize(3);
+	reset();
+}
+
+DynamicDelaunay2D::~DynamicDelaunay2D() {
+}
+
+void DynamicDelaunay2D::setup(float minX, float maxX, float minY, float maxY, int numThreads) {
+	min_x = minX;
+	max_x = maxX;
+	min_y = minY;
+	max_y = maxY;
+	num_threads = std::max<int>(1, numThreads);
+	clear();
+}
+
+void DynamicDelaunay2D::clear() {
+	vertices.resize(3);
+	free_ids.clear();
+	cells.clear();
+	reset();
+}
+
+// The super triangle contains the bounding box with a large margin so the
+// triangles between the sites near the border are (close to) delaunay.
+void DynamicDelaunay2D::reset() {
+	double size = std::max<double>(max_x - min_x, max_y - min_y);
+	double cx = (min_x + max_x) * 0.5;
+	double cy = (min_y + max_y) * 0.5;
+	double d = size * 100.0;
+
+	vertices[0].x = cx - d;  vertices[0].y = cy - d;
+	vertices[1].x = cx + d;  vertices[1].y = cy - d;
+	vertices[2].x = cx;      vertices[2].y = cy + d;
+
+	triangles.clear();
+	free_triangles.clear();
+
+	DelaunayTriangle tri;
+	for(int i = 0; i < 3; ++i) {
+		tri.v[i] = i;
+		tri.n[i] = -1;
+		vertices[i].tri = 0;
+	}
+	triangles.push_back(tri);
+	last_tri = 0;
+}
+
+int DynamicDelaunay2D::insert(float x, float y) {
+	int v = 0;
+	if(free_ids.size()) {
+		v = free_ids.back() + 3;
+		free_ids.pop_back();
+	}
+	else {
+		v = vertices.size();
+		vertices.push_back(DelaunayVertex());
+	}
+
+	DelaunayVertex& dv = vertices[v];
+	dv.x = x;
+	dv.y = y;
+	dv.tri = -1;
+	dv.is_used = true;
+	clamp(dv.x, dv.y);
+
+	insertVertex(v, last_tri);
+	return v - 3;
+}
+
+bool DynamicDelaunay2D::remove(int id) {
+	int v = id + 3;
+	if(id < 0 || size_t(v) >= vertices.size() || !vertices[v].is_used) {
+		return false;
+	}
+
+	if(vertices[v].tri >= 0) {
+		removeVertex(v);
+	}
+
+	vertices[v].is_used = false;
+	free_ids.push_back(id);
+	return true;
+}
+
+// When none of the triangles around the site flips over we only have to
+// restore the delaunay property with edge flips, otherwise we remove the
+// site and insert it again at the new position.
+bool DynamicDelaunay2D::move(int id, float x, float y) {
+	int v = id + 3;
+	if(id < 0 || size_t(v) >= vertices.size() || !vertices[v].is_used) {
+		return false;
+	}
+
+	DelaunayVertex& dv = vertices[v];
+	double old_x = dv.x;
+	double old_y = dv.y;
+	double new_x = x;
+	double new_y = y;
+	clamp(new_x, new_y);
+
+	if(dv.tri < 0) {
+		dv.x = new_x;
+		dv.y = new_y;
+		insertVertex(v, last_tri);
+		return true;
+	}
+
+	getLink(v);
+
+	dv.x = new_x;
+	dv.y = new_y;
+
+	bool is_valid = true;
+	for(size_t i = 0; i < link_verts.size(); ++i) {
+		if(orient(v, link_verts[i], link_verts[(i + 1) % link_verts.size()]) <= 0.0) {
+			is_valid = false;
+			break;
+		}
+	}
+
+	if(is_valid) {
+		edges.clear();
+		for(size_t i = 0; i < link_tris.size(); ++i) {
+			pushEdges(link_tris[i]);
+		}
+		legalize();
+		return true;
+	}
+
+	dv.x = old_x;
+	dv.y = old_y;
+	removeVertex(v);
+
+	dv.x = new_x;
+	dv.y = new_y;
+	insertVertex(v, last_tri);
+	return true;
+}
+
+void DynamicDelaunay2D::setPosition(int id, float x, float y) {
+	int v = id + 3;
+	if(id < 0 || size_t(v) >= vertices.size() || !vertices[v].is_used) {
+		return;
+	}
+	vertices[v].x = x;
+	vertices[v].y = y;
+	clamp(vertices[v].x, vertices[v].y);
+}
+
+// Sites which are close to each other on the hilbert curve are close to
+// each other in space, so when we insert them in that order we find the
+// triangle of the next site in a couple of steps.
+void DynamicDelaunay2D::rebuild() {
+	order.clear();
+	for(size_t i = 3; i < vertices.size(); ++i) {
+		if(vertices[i].is_used) {
+			order.push_back(std::pair<uint32_t, int>(0, i));
+		}
+	}
+
+	runJobs(DELAUNAY_JOB_SORT, order.size());
+
+	// merge the sorted parts
+	size_t part = (order.size() + num_threads - 1) / num_threads;
+	for(size_t width = part; width < order.size(); width *= 2) {
+		for(size_t start = 0; start + width < order.size(); start += width * 2) {
+			size_t end = std::min<size_t>(start + width * 2, order.size());
+			std::inplace_merge(order.begin() + start, order.begin() + start + width, order.begin() + end);
+		}
+	}
+
+	reset();
+
+	int hint = 0;
+	for(size_t i = 0; i < order.size(); ++i) {
+		int v = order[i].second;
+		vertices[v].tri = -1;
+		insertVertex(v, hint);
+		hint = vertices[v].tri;
+	}
+}
+
+void DynamicDelaunay2D::computeCells() {
+	cells.resize(vertices.size() - 3);
+	runJobs(DELAUNAY_JOB_CELLS, cells.size());
+}
+
+void DynamicDelaunay2D::runJobs(int type, size_t num) {
+	size_t part = (num + num_threads - 1) / num_threads;
+	vector<DelaunayJob> jobs(num_threads);
+	vector<uv_thread_t> threads(num_threads);
+
+	for(int i = 0; i < num_threads; ++i) {
+		jobs[i].del = this;
+		jobs[i].type = type;
+		jobs[i].start = std::min<size_t>(i * part, num);
+		jobs[i].end = std::min<size_t>(jobs[i].start + part, num);
+	}
+
+	// small sets aren't worth the threads
+	if(num_threads == 1 || num < 256) {
+		for(int i = 0; i < num_threads; ++i) {
+			runJob(jobs[i]);
+		}
+		return;
+	}
+
+	for(int i = 1; i < num_threads; ++i) {
+		uv_thread_create(&threads[i], delaunay_thread_function, &jobs[i]);
+	}
+
+	runJob(jobs[0]);
+
+	for(int i = 1; i < num_threads; ++i) {
+		uv_thread_join(&threads[i]);
+	}
+}
+
+void DynamicDelaunay2D::runJob(DelaunayJob& job) {
+	if(job.type == DELAUNAY_JOB_SORT) {
+		for(size_t i = job.start; i < job.end; ++i) {
+			const DelaunayVertex& dv = vertices[order[i].second];
+			order[i].first = hilbert(dv.x, dv.y);
+		}
+		std::sort(order.begin() + job.start, order.begin() + job.end);
+	}
+	else if(job.type == DELAUNAY_JOB_CELLS) {
+		for(size_t i = job.start; i < job.end; ++i) {
+			getCell(i, cells[i]);
+		}
+	}
+}
+
+bool DynamicDelaunay2D::getCell(int id, vector<float>& cell) const {
+	cell.clear();
+
+	int v = id + 3;
+	if(id < 0 || size_t(v) >= vertices.size() || !vertices[v].is_used || vertices[v].tri < 0) {
+		return false;
+	}
+
+	// the circumcenters of the triangles around v, counter clockwise
+	bool is_inside = true;
+	int start = vertices[v].tri;
+	int t = start;
+	do {
+		const DelaunayTriangle& tri = triangles[t];
+		const DelaunayVertex& a = vertices[tri.v[0]];
+		const DelaunayVertex& b = vertices[tri.v[1]];
+		const DelaunayVertex& c = vertices[tri.v[2]];
+		double bx = b.x - a.x, by = b.y - a.y;
+		double cx = c.x - a.x, cy = c.y - a.y;
+		double d = 2.0 * (bx * cy - by * cx);
+		double b2 = bx * bx + by * by;
+		double c2 = cx * cx + cy * cy;
+		float px = a.x + (cy * b2 - by * c2) / d;
+		float py = a.y + (bx * c2 - cx * b2) / d;
+		is_inside = is_inside && px >= min_x && px <= max_x && py >= min_y && py <= max_y;
+		cell.push_back(px);
+		cell.push_back(py);
+		t = tri.n[(findVertex(t, v) + 1) % 3];
+	} while(t != start && t >= 0);
+
+	if(!is_inside) {
+		clip(cell);
+	}
+	return cell.size() > 0;
+}
+
+void DynamicDelaunay2D::getTriangles(vector<int>& indices) const {
+	indices.clear();
+	for(size_t i = 0; i < triangles.size(); ++i) {
+		const DelaunayTriangle& tri = triangles[i];
+		if(tri.v[0] < 3 || tri.v[1] < 3 || tri.v[2] < 3) {
+			continue; // free or part of the super triangle
+		}
+		indices.push_back(tri.v[0] - 3);
+		indices.push_back(tri.v[1] - 3);
+		indices.push_back(tri.v[2] - 3);
+	}
+}
+
+// Sutherland-Hodgman against the 4 sides of the bounding box
+void DynamicDelaunay2D::clip(vector<float>& cell) const {
+	vector<float> out;
+	for(int side = 0; side < 4; ++side) {
+		out.clear();
+		size_t num = cell.size() / 2;
+		for(size_t i = 0; i < num; ++i) {
+			float ax = cell[i * 2], ay = cell[i * 2 + 1];
+			float bx = cell[((i + 1) % num) * 2], by = cell[((i + 1) % num) * 2 + 1];
+			float da, db;
+			switch(side) {
+				case 0:  { da = ax - min_x; db = bx - min_x; break; }
+				case 1:  { da = max_x - ax; db = max_x - bx; break; }
+				case 2:  { da = ay - min_y; db = by - min_y; break; }
+				default: { da = max_y - ay; db = max_y - by; break; }
+			}
+			if(da >= 0.0f) {
+				out.push_back(ax);
+				out.push_back(ay);
+			}
+			if((da >= 0.0f) != (db >= 0.0f)) {
+				float t = da / (da - db);
+				out.push_back(ax + t * (bx - ax));
+				out.push_back(ay + t * (by - ay));
+			}
+		}
+		cell.swap(out);
+	}
+}
+
+void DynamicDelaunay2D::clamp(double& x, double& y) const {
+	x = std::max<double>(min_x, std::min<double>(max_x, x));
+	y = std::max<double>(min_y, std::min<double>(max_y, y));
+}
+
+// Walk from the hint towards x,y. `edge` is set to the local index of the
+// edge the point lies on (or -1) and numZero to the number of edges the
+// point lies on; 2 means it's on a vertex.
+int DynamicDelaunay2D::locate(double x, double y, int hint, int& edge, int& numZero) {
+	int t = (hint >= 0 && size_t(hint) < triangles.size() && triangles[hint].v[0] >= 0) ? hint : -1;
+	if(t < 0) {
+		size_t dx = 0;
+		while(dx < triangles.size() && triangles[dx].v[0] < 0) {
+			++dx;
+		}
+		t = int(dx);
+	}
+
+	size_t max_steps = triangles.size() + 16;
+	size_t steps = 0;
+	int r = 0;
+
+	while(true) {
+		const DelaunayTriangle& tri = triangles[t];
+		int next = -1;
+		edge = -1;
+		numZero = 0;
+
+		for(int k = 0; k < 3; ++k) {
+			int i = (k + r) % 3;
+			double o = orient(tri.v[(i + 1) % 3], tri.v[(i + 2) % 3], x, y);
+			if(o < 0.0 && tri.n[i] >= 0) {
+				next = tri.n[i];
+				break;
+			}
+			if(o == 0.0) {
+				edge = i;
+				++numZero;
+			}
+		}
+
+		if(next < 0) {
+			break;
+		}
+
+		t = next;
+		r = (r + 1) % 3;
+
+		// should not happen, but when rounding makes us walk in circles we test all triangles
+		if(++steps > max_steps) {
+			size_t dx = 0;
+			for(; dx < triangles.size(); ++dx) {
+				const DelaunayTriangle& ct = triangles[dx];
+				if(ct.v[0] < 0) {
+					continue;
+				}
+				if(orient(ct.v[0], ct.v[1], x, y) >= 0.0
+				   && orient(ct.v[1], ct.v[2], x, y) >= 0.0
+				   && orient(ct.v[2], ct.v[0], x, y) >= 0.0)
+				{
+					break;
+				}
+			}
+			t = int(dx);
+			edge = -1;
+			numZero = 0;
+			break;
+		}
+	}
+
+	return t;
+}
+
+void DynamicDelaunay2D::insertVertex(int v, int hint) {
+	double size = std::max<double>(max_x - min_x, max_y - min_y);
+	int edge = -1;
+	int num_zero = 0;
+	int t = 0;
+
+	// a site on top of another one is moved a bit; we turn the direction
+	// each try so we also get away from sites in a corner or on a border
+	// where clamp() undoes the move, and start at another angle for each
+	// site so duplicates of the same position don't try the same spots
+	double x = vertices[v].x;
+	double y = vertices[v].y;
+	for(int i = 0; i < 32; ++i) {
+		t = locate(vertices[v].x, vertices[v].y, hint, edge, num_zero);
+		if(num_zero < 2) {
+			break;
+		}
+		double angle = (v + i) * 2.39996322972865332;    // golden angle
+		double dist = size * 1e-7 * (i + 1);
+		vertices[v].x = x + cos(angle) * dist;
+		vertices[v].y = y + sin(angle) * dist;
+		clamp(vertices[v].x, vertices[v].y);
+	}
+
+	// inserting on a vertex gives zero area triangles; we keep the site out
+	// of the triangulation, it's tried again when it moves or on rebuild()
+	if(num_zero >= 2) {
+		vertices[v].x = x;
+		vertices[v].y = y;
+		vertices[v].tri = -1;
+		return;
+	}
+
+	edges.clear();
+
+	if(edge < 0) {
+
+		// split t = (a, b, c) into (a, b, v), (b, c, v), (c, a, v)
+		int t1 = createTriangle();
+		int t2 = createTriangle();
+		DelaunayTriangle& tri = triangles[t];
+		int a = tri.v[0], b = tri.v[1], c = tri.v[2];
+		int na = tri.n[0], nb = tri.n[1], nc = tri.n[2];
+
+		tri.v[0] = a;  tri.v[1] = b;  tri.v[2] = v;
+		tri.n[0] = t1; tri.n[1] = t2; tri.n[2] = nc;
+
+		DelaunayTriangle& tri1 = triangles[t1];
+		tri1.v[0] = b; tri1.v[1] = c; tri1.v[2] = v;
+		tri1.n[0] = t2; tri1.n[1] = t; tri1.n[2] = na;
+
+		DelaunayTriangle& tri2 = triangles[t2];
+		tri2.v[0] = c; tri2.v[1] = a; tri2.v[2] = v;
+		tri2.n[0] = t; tri2.n[1] = t1; tri2.n[2] = nb;
+
+		if(na >= 0) {
+			triangles[na].n[findNeighbor(na, t)] = t1;
+		}
+		if(nb >= 0) {
+			triangles[nb].n[findNeighbor(nb, t)] = t2;
+		}
+
+		vertices[a].tri = t;
+		vertices[b].tri = t;
+		vertices[c].tri = t1;
+		vertices[v].tri = t;
+
+		edges.push_back(std::pair<int, int>(t, 2));
+		edges.push_back(std::pair<int, int>(t1, 2));
+		edges.push_back(std::pair<int, int>(t2, 2));
+	}
+	else {
+
+		// v is on the edge (b, c) of t = (a, b, c); split t and its neighbor o = (d, c, b)
+		int t1 = createTriangle();
+		int o1 = createTriangle();
+		DelaunayTriangle& tri = triangles[t];
+		int o = tri.n[edge];
+		int a = tri.v[edge], b = tri.v[(edge + 1) % 3], c = tri.v[(edge + 2) % 3];
+		int tab = tri.n[(edge + 2) % 3];
+		int tca = tri.n[(edge + 1) % 3];
+		int j = findNeighbor(o, t);
+		DelaunayTriangle& otri = triangles[o];
+		int d = otri.v[j];
+		int odc = otri.n[(j + 2) % 3];
+		int obd = otri.n[(j + 1) % 3];
+
+		tri.v[0] = a;  tri.v[1] = b;  tri.v[2] = v;
+		tri.n[0] = o1; tri.n[1] = t1; tri.n[2] = tab;
+
+		DelaunayTriangle& tri1 = triangles[t1];
+		tri1.v[0] = a; tri1.v[1] = v;   tri1.v[2] = c;
+		tri1.n[0] = o; tri1.n[1] = tca; tri1.n[2] = t;
+
+		otri.v[0] = d;  otri.v[1] = c;  otri.v[2] = v;
+		otri.n[0] = t1; otri.n[1] = o1; otri.n[2] = odc;
+
+		DelaunayTriangle& otri1 = triangles[o1];
+		otri1.v[0] = d; otri1.v[1] = v;   otri1.v[2] = b;
+		otri1.n[0] = t; otri1.n[1] = obd; otri1.n[2] = o;
+
+		if(tca >= 0) {
+			triangles[tca].n[findNeighbor(tca, t)] = t1;
+		}
+		if(obd >= 0) {
+			triangles[obd].n[findNeighbor(obd, o)] = o1;
+		}
+
+		vertices[a].tri = t;
+		vertices[b].tri = t;
+		vertices[c].tri = t1;
+		vertices[d].tri = o;
+		vertices[v].tri = t;
+
+		edges.push_back(std::pair<int, int>(t, 2));
+		edges.push_back(std::pair<int, int>(t1, 1));
+		edges.push_back(std::pair<int, int>(o, 2));
+		edges.push_back(std::pair<int, int>(o1, 1));
+	}
+
+	legalize(v);
+	last_tri = vertices[v].tri;
+}
+
+// We flip the edges between v and its neighbors until v has 3 neighbors
+// left and merge those 3 triangles into one. We flip the edge of an "ear"
+// of the polygon around v whose circumcircle has no other vertex of the
+// polygon so the new triangles are delaunay; legalize() fixes the
+// triangles when we had to pick another one. When v is on the new edge the
+// flat triangle (prev, next, v) disappears again when we merge.
+void DynamicDelaunay2D::removeVertex(int v) {
+	vector<int> created;
+
+	while(true) {
+		getLink(v);
+
+		size_t num = link_verts.size();
+		if(num <= 3) {
+			break;
+		}
+
+		int best = -1;
+		int fallback = -1;
+		for(size_t i = 0; i < num && best < 0; ++i) {
+			int prev = link_verts[(i + num - 1) % num];
+			int curr = link_verts[i];
+			int next = link_verts[(i + 1) % num];
+			if(orient(prev, curr, next) <= 0.0) {
+				continue;
+			}
+			double side = orient(prev, next, v);
+			if(side < 0.0) {
+				continue;
+			}
+			if(fallback < 0) {
+				fallback = i;
+			}
+			if(side == 0.0) {
+				continue; // v is on the new edge (e.g. sites on a grid), only ok when there is nothing else
+			}
+			bool is_empty = true;
+			for(size_t k = 0; k < num; ++k) {
+				int other = link_verts[k];
+				if(other != prev && other != curr && other != next && incircle(prev, curr, next, other) > 0.0) {
+					is_empty = false;
+					break;
+				}
+			}
+			if(is_empty) {
+				best = i;
+			}
+		}
+
+		if(best < 0) {
+			best = fallback;
+		}
+
+		if(best < 0) {
+			// rounding problems; triangulate everything again without v
+			vertices[v].tri = -1;
+			vertices[v].is_used = false;
+			rebuild();
+			vertices[v].is_used = true;
+			return;
+		}
+
+		// the spoke (v, curr) is shared by the triangle before and at `best`
+		int t = link_tris[(best + num - 1) % num];
+		int prev = link_verts[(best + num - 1) % num];
+		flip(t, findVertex(t, prev));
+		created.push_back(t);
+	}
+
+	// merge (v, p0, p1), (v, p1, p2), (v, p2, p0) into (p0, p1, p2)
+	int t0 = link_tris[0];
+	int t1 = link_tris[1];
+	int t2 = link_tris[2];
+	int p0 = link_verts[0];
+	int p1 = link_verts[1];
+	int p2 = link_verts[2];
+	int n0 = triangles[t0].n[findVertex(t0, v)];
+	int n1 = triangles[t1].n[findVertex(t1, v)];
+	int n2 = triangles[t2].n[findVertex(t2, v)];
+
+	DelaunayTriangle& tri = triangles[t0];
+	tri.v[0] = p0; tri.v[1] = p1; tri.v[2] = p2;
+	tri.n[0] = n1; tri.n[1] = n2; tri.n[2] = n0;
+
+	if(n1 >= 0) {
+		triangles[n1].n[findNeighbor(n1, t1)] = t0;
+	}
+	if(n2 >= 0) {
+		triangles[n2].n[findNeighbor(n2, t2)] = t0;
+	}
+
+	freeTriangle(t1);
+	freeTriangle(t2);
+
+	vertices[p0].tri = t0;
+	vertices[p1].tri = t0;
+	vertices[p2].tri = t0;
+	vertices[v].tri = -1;
+	last_tri = t0;
+
+	edges.clear();
+	pushEdges(t0);
+	for(size_t i = 0; i < created.size(); ++i) {
+		if(created[i] != t1 && created[i] != t2) {
+			pushEdges(created[i]);
+		}
+	}
+	legalize();
+}
+
+// Fills link_verts with the vertices around v and link_tris with the
+// triangles (v, link_verts[i], link_verts[i + 1]), both counter clockwise.
+void DynamicDelaunay2D::getLink(int v) {
+	link_tris.clear();
+	link_verts.clear();
+
+	int start = vertices[v].tri;
+	int t = start;
+	do {
+		int i = findVertex(t, v);
+		link_tris.push_back(t);
+		link_verts.push_back(triangles[t].v[(i + 1) % 3]);
+		t = triangles[t].n[(i + 1) % 3];
+	} while(t != start && t >= 0);
+}
+
+// t = (a, b, c) with a = t.v[i], o = (d, c, b) becomes t = (a, b, d), o = (a, d, c)
+void DynamicDelaunay2D::flip(int t, int i) {
+	DelaunayTriangle& tri = triangles[t];
+	int o = tri.n[i];
+	int j = findNeighbor(o, t);
+	DelaunayTriangle& otri = triangles[o];
+
+	int a = tri.v[i], b = tri.v[(i + 1) % 3], c = tri.v[(i + 2) % 3];
+	int d = otri.v[j];
+	int tab = tri.n[(i + 2) % 3];
+	int tca = tri.n[(i + 1) % 3];
+	int odc = otri.n[(j + 2) % 3];
+	int obd = otri.n[(j + 1) % 3];
+
+	tri.v[0] = a;   tri.v[1] = b; tri.v[2] = d;
+	tri.n[0] = obd; tri.n[1] = o; tri.n[2] = tab;
+
+	otri.v[0] = a;   otri.v[1] = d;   otri.v[2] = c;
+	otri.n[0] = odc; otri.n[1] = tca; otri.n[2] = t;
+
+	if(obd >= 0) {
+		triangles[obd].n[findNeighbor(obd, o)] = t;
+	}
+	if(tca >= 0) {
+		triangles[tca].n[findNeighbor(tca, t)] = o;
+	}
+
+	vertices[a].tri = t;
+	vertices[b].tri = t;
+	vertices[c].tri = o;
+	vertices[d].tri = t;
+}
+
+// When `apex` is a vertex, all edges on the stack are opposite it (the
+// new vertex of an insertion) and we only have to check the edges of a
+// flipped quad which don't touch it.
+void DynamicDelaunay2D::legalize(int apex) {
+	while(edges.size()) {
+		std::pair<int, int> e = edges.back();
+		edges.pop_back();
+
+		int t = e.first;
+		int i = e.second;
+		const DelaunayTriangle& tri = triangles[t];
+		int o = tri.n[i];
+		if(tri.v[0] < 0 || o < 0) {
+			continue;
+		}
+
+		int a = tri.v[i], b = tri.v[(i + 1) % 3], c = tri.v[(i + 2) % 3];
+		int d = triangles[o].v[findNeighbor(o, t)];
+		if(incircle(a, b, c, d) <= 0.0) {
+			continue;
+		}
+
+		// only flip when both new triangles are valid
+		if(orient(a, b, d) <= 0.0 || orient(a, d, c) <= 0.0) {
+			continue;
+		}
+
+		flip(t, i);
+
+		edges.push_back(std::pair<int, int>(t, 0));
+		edges.push_back(std::pair<int, int>(o, 0));
+		if(apex < 0) {
+			edges.push_back(std::pair<int, int>(t, 2));
+			edges.push_back(std::pair<int, int>(o, 1));
+		}
+	}
+}
+
+int DynamicDelaunay2D::createTriangle() {
+	if(free_triangles.size()) {
+		int t = free_triangles.back();
+		free_triangles.pop_back();
+		return t;
+	}
+	triangles.push_back(DelaunayTriangle());
+	return triangles.size() - 1;
+}
+
+void DynamicDelaunay2D::freeTriangle(int t) {
+	triangles[t].v[0] = -1;
+	free_triangles.push_back(t);
+}
+
+// Position on a hilbert curve through a 2^16 x 2^16 grid over the bounding box
+uint32_t DynamicDelaunay2D::hilbert(double x, double y) const {
+	double w = std::max<double>(max_x - min_x, 1e-20);
+	double h = std::max<double>(max_y - min_y, 1e-20);
+	uint32_t hx = std::min<double>(65535.0, ((x - min_x) / w) * 65535.0);
+	uint32_t hy = std::min<double>(65535.0, ((y - min_y) / h) * 65535.0);
+	uint32_t d = 0;
+
+	for(uint32_t s = 1 << 15; s > 0; s >>= 1) {
+		uint32_t rx = (hx & s) > 0;
+		uint32_t ry = (hy & s) > 0;
+		d += s * s * ((3 * rx) ^ ry);
+		if(ry == 0) {
+			if(rx == 1) {
+				hx = 65535 - hx;
+				hy = 65535 - hy;
+			}
+			std::swap(hx, hy);
+		}
+	}
+
+	return d;
+}
+
+} // roxlu
@@ -0,0 +1,217 @@
+#ifndef ROXLU_DYNAMIC_DELAUNAY2DH
+#define ROXLU_DYNAMIC_DELAUNAY2DH
+
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+#include <utility>
+
+using std::vector;
+
+namespace roxlu {
+
+/**
+ * Delaunay triangulation of a set of 2D sites which you can insert, remove
+ * and move one by one. Only the triangles around the changed site are
+ * re-triangulated (edge flips), so moving a couple of sites per frame is
+ * cheap compared to recomputing everything with Voronoi2D. The Voronoi
+ * cells are the dual of the triangulation: the circumcenters of the
+ * triangles around a site, clipped to the bounding box.
+ *
+ * When most sites move every frame use setPosition() for each site and
+ * call rebuild() once; this sorts the sites along a hilbert curve on
+ * multiple threads and inserts them again in that order. computeCells()
+ * creates all Voronoi cells on multiple threads.
+ *
+ * All sites must be positioned inside the minx/maxx/miny/maxy boundary; we
+ * clamp them. Sites at the exact position of another site are moved by a
+ * tiny offset; when no free spot is found the site isn't triangulated and
+ * gets an empty cell until it moves.
+ *
+ *
+ * Examples
+ * ------------
+ *
+
+ 	// setup once; fill with points.
+	// -----------------------------
+	roxlu::DynamicDelaunay2D del;
+	del.setup(0, 1, 0, 1);
+	for(int i = 0; i < 600; ++i) {
+		ids.push_back(del.insert(rnd(), rnd()));
+	}
+
+	// move a couple of sites each frame
+	// ---------------------------------
+	del.move(ids[0], x, y);
+
+	// or when all sites move
+	// ----------------------
+	for(int i = 0; i < ids.size(); ++i) {
+		del.setPosition(ids[i], xs[i], ys[i]);
+	}
+	del.rebuild();
+
+	// draw the voronoi cells
+	// ----------------------
+	del.computeCells();
+	for(int i = 0; i < del.cells.size(); ++i) {
+		vector<float>& cell = del.cells[i];
+		glBegin(GL_LINE_LOOP);
+		for(int j = 0; j < cell.size(); j += 2) {
+			glVertex2f(cell[j] * w, cell[j+1] * h);
+		}
+		glEnd();
+	}
+
+
+ *
+ */
+
+#define DELAUNAY_JOB_SORT 0                  // compute the hilbert keys and sort a part of the sites
+#define DELAUNAY_JOB_CELLS 1                 // compute the voronoi cells for a part of the sites
+
+struct DelaunayVertex {
+	DelaunayVertex();
+	double x;
+	double y;
+	int tri;                                 // one of the triangles which uses this vertex, -1 when not triangulated
+	bool is_used;                            // false when the site has been removed
+};
+
+struct DelaunayTriangle {
+	int v[3];                                // vertices in counter clockwise order, v[0] is -1 when the triangle is free
+	int n[3];                                // n[i] is the neighbor across the edge opposite v[i], -1 for the edges of the super triangle
+};
+
+class DynamicDelaunay2D;
+
+struct DelaunayJob {
+	DynamicDelaunay2D* del;
+	int type;                                // DELAUNAY_JOB_SORT or DELAUNAY_JOB_CELLS
+	size_t start;                            // the range of sites/keys this job handles
+	size_t end;
+};
+
+void delaunay_thread_function(void* user);   // runs a DelaunayJob
+
+class DynamicDelaunay2D {
+public:
+	DynamicDelaunay2D();
+	~DynamicDelaunay2D();
+
+	void setup(
+			 float minX               // min x of bounding box
+			,float maxX               // max x of bounding box
+			,float minY               // min y of bounding box
+			,float maxY               // max y of bounding box
+			,int numThreads = 4       // number of threads used by rebuild() and computeCells()
+	);
+	void clear();                            // removes all sites
+	int insert(float x, float y);            // adds a site, returns its id; a site on top of another one is moved a tiny bit, or gets no cell when that fails
+	bool remove(int id);                     // removes a site; the id may be reused by insert()
+	bool move(int id, float x, float y);     // moves a site and updates the triangles around it
+	void setPosition(int id, float x, float y); // changes the position of a site without updating the triangulation, call rebuild() after you've changed all of them
+	void rebuild();                          // triangulates all sites again
+	void computeCells();                     // computes the voronoi cell of every site into `cells`
+	bool getCell(int id, vector<float>& cell) const; // gets the voronoi cell (x,y pairs, counter clockwise) of one site
+	void getTriangles(vector<int>& indices) const;   // gets the triangles as site ids, 3 per triangle
+	size_t getNumSites() const;              // returns the number of ids in use, including removed ones
+	bool getPosition(int id, float& x, float& y) const;
+	void runJob(DelaunayJob& job);           // (private) gets called by the threads
+
+private:
+	void reset();                            // reset to the super triangle only
+	void insertVertex(int v, int hint);      // triangulate vertex v; hint is the triangle to start searching
+	void removeVertex(int v);                // remove vertex v from the triangulation
+	int locate(double x, double y, int hint, int& edge, int& numZero); // find the triangle which contains x,y
+	int createTriangle();                    // returns a free triangle
+	void freeTriangle(int t);
+	void flip(int t, int i);                 // flip the edge opposite t.v[i]
+	void legalize(int apex = -1);            // flip the edges in `edges` until they're all delaunay
+	void pushEdges(int t);                   // push all edges of triangle t for legalize()
+	int findVertex(int t, int v) const;      // returns the local index of vertex v in triangle t
+	int findNeighbor(int t, int n) const;    // returns the local index of neighbor n in triangle t
+	void getLink(int v);                     // fills link_tris and link_verts with the triangles/vertices around v, counter clockwise
+	void clip(vector<float>& cell) const;    // clips a cell to the bounding box
+	void clamp(double& x, double& y) const;
+	double orient(int a, int b, int c) const;   // > 0 when a, b, c are counter clockwise
+	double orient(int a, int b, double x, double y) const;
+	double incircle(int a, int b, int c, int d) const; // > 0 when d is inside the circumcircle of a, b, c
+	uint32_t hilbert(double x, double y) const;
+	void runJobs(int type, size_t num);      // runs `num_threads` jobs for the given range
+
+public:
+	vector<DelaunayVertex> vertices;         // the first 3 vertices are the super triangle, site id = index - 3
+	vector<DelaunayTriangle> triangles;
+	vector<int> free_triangles;              // indices of unused triangles
+	vector<int> free_ids;                    // ids of removed sites
+	vector<std::pair<uint32_t, int> > order; // hilbert key + vertex, used by rebuild()
+	vector<std::pair<int, int> > edges;      // triangle + local index of the edges we need to check in legalize()
+	vector<int> link_tris;                   // triangles around a vertex, see getLink()
+	vector<int> link_verts;                  // vertices around a vertex, see getLink()
+	vector<vector<float> > cells;            // voronoi cells, filled by computeCells(), indexed by site id
+	double min_x;
+	double max_x;
+	double min_y;
+	double max_y;
+	int last_tri;                            // triangle where we start searching when we don't have a better hint
+	int num_threads;
+};
+
+inline size_t DynamicDelaunay2D::getNumSites() const {
+	return vertices.size() - 3;
+}
+
+inline bool DynamicDelaunay2D::getPosition(int id, float& x, float& y) const {
+	if(id < 0 || size_t(id) + 3 >= vertices.size() || !vertices[id + 3].is_used) {
+		return false;
+	}
+	x = vertices[id + 3].x;
+	y = vertices[id + 3].y;
+	return true;
+}
+
+inline double DynamicDelaunay2D::orient(int a, int b, int c) const {
+	const DelaunayVertex& pa = vertices[a];
+	const DelaunayVertex& pb = vertices[b];
+	const DelaunayVertex& pc = vertices[c];
+	return (pb.x - pa.x) * (pc.y - pa.y) - (pb.y - pa.y) * (pc.x - pa.x);
+}
+
+inline double DynamicDelaunay2D::orient(int a, int b, double x, double y) const {
+	const DelaunayVertex& pa = vertices[a];
+	const DelaunayVertex& pb = vertices[b];
+	return (pb.x - pa.x) * (y - pa.y) - (pb.y - pa.y) * (x - pa.x);
+}
+
+inline double DynamicDelaunay2D::incircle(int a, int b, int c, int d) const {
+	const DelaunayVertex& pd = vertices[d];
+	double ax = vertices[a].x - pd.x, ay = vertices[a].y - pd.y;
+	double bx = vertices[b].x - pd.x, by = vertices[b].y - pd.y;
+	double cx = vertices[c].x - pd.x, cy = vertices[c].y - pd.y;
+	double a2 = ax * ax + ay * ay;
+	double b2 = bx * bx + by * by;
+	double c2 = cx * cx + cy * cy;
+	return ax * (by * c2 - b2 * cy) - ay * (bx * c2 - b2 * cx) + a2 * (bx * cy - by * cx);
+}
+
+inline int DynamicDelaunay2D::findVertex(int t, int v) const {
+	const DelaunayTriangle& tri = triangles[t];
+	return (tri.v[0] == v) ? 0 : (tri.v[1] == v) ? 1 : 2;
+}
+
+inline int DynamicDelaunay2D::findNeighbor(int t, int n) const {
+	const DelaunayTriangle& tri = triangles[t];
+	return (tri.n[0] == n) ? 0 : (tri.n[1] == n) ? 1 : 2;
+}
+
+inline void DynamicDelaunay2D::pushEdges(int t) {
+	edges.push_back(std::pair<int, int>(t, 0));
+	edges.push_back(std::pair<int, int>(t, 1));
+	edges.push_back(std::pair<int, int>(t, 2));
+}
+
+} // roxlu
+
+#endif
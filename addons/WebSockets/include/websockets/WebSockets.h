@@ -6,6 +6,7 @@ extern "C" {
 #include <event2/bufferevent.h>
 #include <event2/buffer.h>
 #include <event2/listener.h>
+#include <zlib.h>
 }
 
 #include <string>
@@ -18,6 +19,7 @@ enum WebSocketStates {
   ,WS_STATE_HANDSHAKE_RECEIVE
   ,WS_STATE_HANDSHAKE_VERIFY
   ,WS_STATE_OPEN
+  ,WS_STATE_CLOSING                                         /* we sent a close frame and close the connection once it's written */
 };
 
 enum WebSocketFrameStates {
@@ -29,6 +31,22 @@ enum WebSocketFrameStates {
   ,F_STATE_APP_DATA
 };
 
+#define WS_PARSE_OK 0
+#define WS_PARSE_ERROR -1
+#define WS_INFLATE_OK 0
+#define WS_INFLATE_ERROR -1                                 /* invalid deflate data */
+#define WS_INFLATE_TOO_BIG -2                               /* the inflated message is bigger then the max message size */
+#define WS_CLOSE_PROTOCOL_ERROR 1002
+#define WS_CLOSE_INVALID_DATA 1007
+#define WS_CLOSE_MESSAGE_TOO_BIG 1009
+#define WS_MAX_CONTROL_PAYLOAD 125
+#define WS_DEFAULT_MAX_MESSAGE_SIZE (16 * 1024 * 1024)
+#define WS_MAX_PEEK_VECS 16
+#define WS_MAX_HEADER_SIZE 10                               /* max size of a server frame header (we never mask) */
+#define WS_DEFLATE_MIN_SIZE 64                              /* we don't compress messages smaller then this */
+#define WS_DEFLATE_LEVEL Z_DEFAULT_COMPRESSION
+#define WS_DEFLATE_MIN_WINDOW_BITS 9                        /* zlib can't deflate with a 256 byte window, so we decline offers with server_max_window_bits=8 */
+
 enum WebSocketFrameOpCodes {
   F_OPCODE_CONTNUATION_FRAME = 0x00
   ,F_OPCODE_TEXT_FRAME = 0x01
@@ -66,46 +84,123 @@ struct WebSocketHTTPRequest {
   void copyToBuffer(evbuffer* buffer);
 };
 
-struct WebSocketFrame {
+struct WebSocketFrame {                                    /* a complete (reassembled) message or control frame; frames are reused by the parser, so they are only valid inside WebSocketListener::onNewFrame() */
   WebSocketFrame();
   ~WebSocketFrame();
-  bool hasBytes() { return dx < buffer.size(); } 
-  size_t getBytesLeftToRead() { return buffer.size() - dx; }
   void setData(const char* data, size_t len);
   size_t getSize() { return buffer.size(); }
   bool isBinary();
+  bool isControl() { return (opcode & 0x08) == 0x08; }
   
   std::string getAppDataAsText();
 
-  const char* getPtr() { return (const char*)&buffer[0]; }
+  const char* getPtr() { return buffer.size() ? (const char*)&buffer[0] : NULL; }
   const char* getAppDataPtr() { return (const char*)getPtr()+app_data_dx; }
   ev_uint64_t getPayloadLen() { return payload_len; }
 
   std::vector<ev_uint8_t> buffer;
-  int state;
-  size_t dx;
   size_t app_data_dx;
   ev_uint64_t payload_len;
   ev_uint8_t opcode;
-  ev_uint8_t mask_key[4];
-  int mask_key_index;
   bool is_masked;
   bool is_final;
-  bool has_rsv;
+  bool has_rsv;                                            /* RSV1; for received messages this means the payload was compressed with permessage-deflate */
+};
+
+typedef void(*websocket_frame_callback)(WebSocketFrame* frame, void* user);
+
+size_t websocket_encode_header(ev_uint8_t* dest, ev_uint8_t opcode, bool isFinal, bool rsv1, ev_uint64_t len); /* write an unmasked frame header into `dest` (must hold WS_MAX_HEADER_SIZE bytes); returns the header size */
+
+/* 
+   RFC 7692 permessage-deflate. We negotiate server_no_context_takeover and 
+   client_no_context_takeover, so every message is compressed on its own. This 
+   makes it possible to compress a broadcast message once and send the same 
+   bytes to every connection (once per window size the clients asked for).
+*/
+bool websocket_negotiate_deflate(const std::string& extensions, std::string& response, int& windowBits); /* parses the comma separated offers of a Sec-WebSocket-Extensions header and accepts the first permessage-deflate offer we can honour; sets the value of our Sec-WebSocket-Extensions header and the window bits we must compress with; returns false when we decline all offers */
+
+struct WebSocketDeflate {
+  WebSocketDeflate();
+  ~WebSocketDeflate();
+  bool compress(const ev_uint8_t* data, size_t len, std::vector<ev_uint8_t>& result);    /* appends the raw deflate stream without the trailing 0x00 0x00 0xFF 0xFF to `result` */
+  int decompress(const ev_uint8_t* data, size_t len, std::vector<ev_uint8_t>& result, size_t maxSize); /* appends the inflated message to `result`; stops with WS_INFLATE_TOO_BIG when it inflates to more then `maxSize` bytes */
+
+  z_stream def;
+  z_stream inf;
+  bool def_ready;
+  bool inf_ready;
+  int window_bits;                                        /* the window size we compress with, MAX_WBITS unless the client limited it with server_max_window_bits; we always inflate with MAX_WBITS */
 };
 
+/* 
+   A reference counted, encoded frame (header + payload) which is shared by all 
+   connections we broadcast to. We pass it to evbuffer_add_reference() so libevent
+   doesn't copy the data; `websocket_shared_frame_cleanup()` releases it.
+*/
+struct WebSocketSharedFrame {
+  static WebSocketSharedFrame* create();
+  void retain();
+  void release();
+
+  std::vector<ev_uint8_t> data;
+  int refcount;
+
+ private:
+  WebSocketSharedFrame();
+};
+
+void websocket_shared_frame_cleanup(const void* data, size_t len, void* user);
+
+void websocket_unmask(ev_uint8_t* data, size_t nbytes, const ev_uint8_t* mask, ev_uint64_t offset); /* xor `data` with the 4 byte `mask`; `offset` is the number of payload bytes that were already unmasked */
+
+struct WebSocketFrameParser {                             /* resumable parser for client frames; you can feed it any number of bytes; reassembles fragmented messages */
+  WebSocketFrameParser();
+  void setup(websocket_frame_callback frameCB, void* user);
+  int parse(const ev_uint8_t* data, size_t nbytes);       /* parse the given bytes; calls the frame callback for every complete message and control frame; returns WS_PARSE_OK or WS_PARSE_ERROR */
+  void setAllowCompression(bool allow);                   /* allow RSV1 on the first frame of a message (permessage-deflate) */
+  void reset();                                           /* reset the parser state; keeps the allocated memory */
+
+ private:
+  bool beginPayload();
+  void endPayload();
+
+ public:
+  int state;
+  ev_uint8_t header[8];                                   /* extended payload length bytes, big endian */
+  size_t header_dx;
+  ev_uint8_t opcode;
+  ev_uint8_t mask_key[4];
+  ev_uint64_t payload_len;                                /* length of the current frame */
+  ev_uint64_t payload_read;                               /* number of bytes of the current frame we received */
+  bool is_final;
+  bool is_masked;
+  bool is_compressed;                                     /* RSV1 bit of the current frame */
+  bool allow_compression;
+  bool in_message;                                        /* true when we're reassembling a fragmented message */
+  size_t max_message_size;                                /* messages bigger then this are a protocol error */
+  WebSocketFrame message;                                 /* (fragmented) data message; reused */
+  WebSocketFrame control;                                 /* control frames can be interleaved with fragments, so they use a separate frame; reused */
+  WebSocketFrame* frame;                                  /* the frame we're currently filling */
+  websocket_frame_callback cb_frame;
+  void* cb_user;
+};
 
 class WebSockets;
 struct WebSocketConnection {
   WebSocketConnection();
   ~WebSocketConnection();
   void addToOutputBuffer(const char* data, size_t len);
+  void addToOutputBuffer(WebSocketSharedFrame* frame);   /* add a reference to the shared frame to the output buffer (no copy) */
+  size_t getSendQueueDepth();                            /* number of bytes in the output buffer which haven't been sent yet */
   WebSockets* ws;
   bufferevent* bev;
   int state;
   WebSocketHTTPRequest request;
-  WebSocketFrame* frame; // used to parse buffer.
-  std::vector<WebSocketFrame*> frames;
+  WebSocketFrameParser parser;
+  bool use_deflate;                                      /* true when permessage-deflate was negotiated */
+  int deflate_window_bits;                               /* the window size we must compress messages for this connection with */
+  WebSocketDeflate deflate;                              /* used to decompress incoming messages */
+  std::vector<ev_uint8_t> inflate_buffer;                /* reused; we swap it with the frame buffer after decompressing */
 };
 
 class WebSocketListener {
@@ -144,20 +239,32 @@ public:
                             ,short events
                             ,void* ctx
                             );
+
+  static void callbackWriteClose(
+                                 bufferevent* bev
+                                 ,void* ctx
+                                 );
   
   void sendHTTPRequest(WebSocketConnection* c, WebSocketHTTPRequest& req);
-  void sendToAllClients(const char* buf, size_t len, bool binary = false);
+  void sendToAllClients(const char* buf, size_t len, bool binary = false);   /* the frame is encoded (and compressed) once and shared by all connections */
+  void send(WebSocketConnection* c, const char* buf, size_t len, bool binary = false);
   void setListener(WebSocketListener* l);
+  void setCompression(bool enable);                                           /* enable/disable permessage-deflate for new connections; enabled by default */
 private:
   void parseBuffer(WebSocketConnection* c);
+  static void callbackFrame(WebSocketFrame* frame, void* user);
   int createSecurityKey(const char* clientKey, char* result, int size);
-  void removeConnection(WebSocketConnection* c);
+  WebSocketSharedFrame* encodeFrame(const char* buf, size_t len, bool binary, int windowBits); /* windowBits 0 = don't compress */
+  void removeConnection(WebSocketConnection* c);                             /* frees the bufferevent (closing the socket) and deletes the connection */
+  void failConnection(WebSocketConnection* c, ev_uint16_t code);              /* sends a close frame with the status code and removes the connection once it's written */
 private:
   WebSocketListener* ws_listener;
   event_base* evbase;
   evconnlistener* ev_listener;
   sockaddr_in sin;
   int state;
+  bool allow_deflate;
+  WebSocketDeflate deflate[MAX_WBITS + 1];               /* used to compress outgoing messages, indexed by window bits */
   std::vector<WebSocketConnection*> connections;
 };
 
@@ -165,5 +272,13 @@ inline void WebSockets::setListener(WebSocketListener* l) {
   ws_listener = l;
 }
 
+inline void WebSockets::setCompression(bool enable) {
+  allow_deflate = enable;
+}
+
+inline void WebSocketFrameParser::setAllowCompression(bool allow) {
+  allow_compression = allow;
+}
+
 #endif
 
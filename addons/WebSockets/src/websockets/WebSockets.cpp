@@ -1,5 +1,12 @@
 #include <websockets/WebSockets.h>
 #include <websockets/extern/Base64Encoder.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#  include <emmintrin.h>
+#endif
 
 extern "C" {
 #include <websockets/extern/sha1.h>
@@ -15,7 +22,6 @@ void WebSockets::callbackAcceptNewConnection(
                                              ,void* ctx
                                              )
 {
-  printf("callbackAcceptNewConnection()\n");
   WebSockets* ws = static_cast<WebSockets*>(ctx);
   WebSocketConnection* con = new WebSocketConnection();
   ws->connections.push_back(con);
@@ -23,6 +29,8 @@ void WebSockets::callbackAcceptNewConnection(
   con->ws = ws;
   con->bev = bufferevent_socket_new(ws->evbase, fd, BEV_OPT_CLOSE_ON_FREE);
 
+  con->parser.setup(&WebSockets::callbackFrame, con);
+
   bufferevent_setcb(con->bev, &WebSockets::callbackRead, NULL, callbackEvent, con);
   bufferevent_enable(con->bev, EV_READ | EV_WRITE);
 
@@ -36,7 +44,7 @@ void WebSockets::callbackAcceptError(
                                      ,void* ctx
                                      )
 {
-  printf("callbackAcceptError()\n");
+  printf("ERROR: cannot accept a new connection: %s\n", evutil_socket_error_to_string(EVUTIL_SOCKET_ERROR()));
 }
 
 void WebSockets::callbackRead(
@@ -44,18 +52,52 @@ void WebSockets::callbackRead(
                               ,void* ctx
                               )
 {
-  printf("callbackRead()\n");
   WebSocketConnection* wc = static_cast<WebSocketConnection*>(ctx);
   wc->ws->parseBuffer(wc);
 }
 
+void WebSockets::callbackFrame(WebSocketFrame* frame, void* user) {
+  WebSocketConnection* c = static_cast<WebSocketConnection*>(user);
+
+  // the parser may still have frames for a connection we failed
+  if(c->state != WS_STATE_OPEN) {
+    return;
+  }
+
+  if(frame->has_rsv) {
+    c->inflate_buffer.clear();
+    int r = c->deflate.decompress(frame->getPtr() ? (const ev_uint8_t*)frame->getPtr() : NULL, frame->buffer.size(), c->inflate_buffer, c->parser.max_message_size);
+    if(r != WS_INFLATE_OK) {
+      printf("ERROR: cannot decompress message, closing the connection.\n");
+      c->inflate_buffer.clear();
+      c->ws->failConnection(c, (r == WS_INFLATE_TOO_BIG) ? WS_CLOSE_MESSAGE_TOO_BIG : WS_CLOSE_INVALID_DATA);
+      return;
+    }
+    frame->buffer.swap(c->inflate_buffer);
+    frame->payload_len = frame->buffer.size();
+    frame->has_rsv = false;
+  }
+
+  if(frame->opcode == F_OPCODE_PING) {
+    WebSocketFrame pong;
+    pong.is_final = true;
+    pong.opcode = F_OPCODE_PONG;
+    pong.payload_len = frame->payload_len;
+    pong.setData(frame->getAppDataPtr(), frame->payload_len);
+    c->addToOutputBuffer(pong.getPtr(), pong.getSize());
+  }
+
+  if(c->ws->ws_listener != NULL) {
+    c->ws->ws_listener->onNewFrame(c, frame);
+  }
+}
+
 void WebSockets::callbackEvent(
                                bufferevent* bev
                                ,short events
                                ,void* ctx
                                )
 {
-  printf("callbackEvent()\n");
   if(events & BEV_EVENT_ERROR) {
     printf("ERROR: We received an error from libevent.\n");
   }
@@ -65,6 +107,17 @@ void WebSockets::callbackEvent(
   }
 }
 
+void WebSockets::callbackWriteClose(
+                                    bufferevent* bev
+                                    ,void* ctx
+                                    )
+{
+  WebSocketConnection* c = static_cast<WebSocketConnection*>(ctx);
+  if(evbuffer_get_length(bufferevent_get_output(bev)) == 0) {
+    c->ws->removeConnection(c);
+  }
+}
+
 
 // WebSockets
 // ------------------------------------------------------------------------------------
@@ -73,8 +126,11 @@ WebSockets::WebSockets()
   ,ev_listener(NULL)
   ,ws_listener(NULL)
   ,state(WS_STATE_NONE)
+  ,allow_deflate(true)
 {
-
+  for(int i = 0; i <= MAX_WBITS; ++i) {
+    deflate[i].window_bits = i;
+  }
 }
 
 WebSockets::~WebSockets() {
@@ -118,7 +174,6 @@ void WebSockets::update() {
 }
 
 void WebSockets::parseBuffer(WebSocketConnection* c) {
-  printf("parseBuffer();\n");
   evbuffer* input = bufferevent_get_input(c->bev);
   switch(c->state) {
 
@@ -167,7 +222,7 @@ void WebSockets::parseBuffer(WebSocketConnection* c) {
           if(h.name == "sec-websocket-key") {
             c->request.has_websocket_key = true;
           }
-          c->request.headers[h.name] = h;
+          c->request.addHeader(h.name.c_str(), h.value.c_str());
         };
         delete line;
       }
@@ -196,6 +251,20 @@ void WebSockets::parseBuffer(WebSocketConnection* c) {
     response.addHeader("Upgrade", "websocket");
     response.addHeader("Connection", "Upgrade");
     response.addHeader("Sec-WebSocket-Accept", websocket_key_result);
+
+    std::string extensions;
+    std::string accepted;
+    int window_bits = MAX_WBITS;
+    if(allow_deflate 
+       && c->request.findHeader("sec-websocket-extensions", extensions)
+       && websocket_negotiate_deflate(extensions, accepted, window_bits))
+    {
+      response.addHeader("Sec-WebSocket-Extensions", accepted.c_str());
+      c->use_deflate = true;
+      c->deflate_window_bits = window_bits;
+      c->parser.setAllowCompression(true);
+    }
+
     sendHTTPRequest(c, response);
     c->state = WS_STATE_OPEN;
     c->request.reset(); // reset the in request.
@@ -203,152 +272,37 @@ void WebSockets::parseBuffer(WebSocketConnection* c) {
     break;
   };
 
-    // We are connected + verified, parse WebSocket frames.
+    // We are connected + verified, parse WebSocket frames directly from the evbuffer chain.
   case WS_STATE_OPEN: {
-    if(c->frame == NULL) {
-      c->frame = new WebSocketFrame();
-    }
-
-    int copied = 0;
-    ev_uint8_t tmp[1024 * 50];
-    do { 
-      copied = evbuffer_remove(input, tmp, sizeof(tmp));
-      std::copy(tmp, tmp+copied, std::back_inserter(c->frame->buffer));
-    } while(copied > 0);
-
-
-    while(c->frame->hasBytes()) {
-      switch(c->frame->state) {
-
-        // FIN, RSV, OPCODE
-      case F_STATE_HEADER: {
-        ev_uint8_t b =  c->frame->buffer[c->frame->dx];
-        c->frame->is_final = b & 0x80;
-        c->frame->has_rsv = ((b & 0x70) != 0);
-        if(c->frame->has_rsv) {
-          printf("ERROR: We did not implement extensions.\n");
-          return;
-        }
-        c->frame->opcode = (b & 0x0F);
-        c->frame->state = F_STATE_HEADER_LEN_1;
-        c->frame->dx = 1;
-
-        printf("RECEIVED, FIRST BYTE: %02X, OPCODE: %02X, IS_FINAL: %d, HAS_RSV: %d\n", b, c->frame->opcode, c->frame->is_final, c->frame->has_rsv);
+    evbuffer_iovec vecs[WS_MAX_PEEK_VECS];
+    while(evbuffer_get_length(input)) {
+      int nvecs = evbuffer_peek(input, -1, NULL, vecs, WS_MAX_PEEK_VECS);
+      if(nvecs <= 0) {
         break;
-      };
-        
-        // GET THE LENGTH OF THE PAYLOAD
-      case F_STATE_HEADER_LEN_1: {
-        ev_uint8_t b = c->frame->buffer[c->frame->dx];
-        c->frame->dx++;
-        c->frame->is_masked = b & 0x80; 
-        if(!c->frame->is_masked) {
-          printf("ERROR: All client data must be masked!\n");
-          return;
-        }
-        printf("MASKED: %d\n", c->frame->is_masked);
-
-        c->frame->payload_len = (b & 0x7F);
-        if(c->frame->payload_len < 126) {
-          c->frame->state = F_STATE_MASKING_KEY;
-          continue;
-        }
-        else if(c->frame->payload_len == 126){
-          c->frame->state = F_STATE_HEADER_LEN_2;
-          continue;
-        }
-        else if(c->frame->payload_len == 127) {
-          c->frame->state = F_STATE_HEADER_LEN_8;
-          continue;
-        }
-        break;
-      };
-
-      case F_STATE_HEADER_LEN_2: {
-        if(c->frame->getBytesLeftToRead() < 2) {
-          return;
-        }
-        // @todo check endian
-        c->frame->payload_len = ((ev_uint16_t)c->frame->buffer[c->frame->dx]) << 8 | c->frame->buffer[c->frame->dx+1];
-        c->frame->dx += 2;
-        c->frame->state = F_STATE_MASKING_KEY;
-        continue;
+      }
+      if(nvecs > WS_MAX_PEEK_VECS) {
+        nvecs = WS_MAX_PEEK_VECS;
       }
 
-      case F_STATE_HEADER_LEN_8: {
-        if(c->frame->getBytesLeftToRead() < 8) {
-          printf("ERROR: Header_len_8, we do not have enough bytes in buffer yet.\n");
+      size_t nparsed = 0;
+      for(int i = 0; i < nvecs; ++i) {
+        if(c->parser.parse((const ev_uint8_t*)vecs[i].iov_base, vecs[i].iov_len) != WS_PARSE_OK) {
+          printf("ERROR: invalid websocket frame, closing the connection.\n");
+          removeConnection(c);
           return;
         }
-        // @todo check big endian systems
-        char* d = (char*)&c->frame->payload_len;
-        for(int i = 0; i < 8; ++i) {
-          ev_uint8_t b = c->frame->buffer[c->frame->dx];
-          d[7-i] = b;
-          c->frame->dx++;
-        }
-        c->frame->state = F_STATE_MASKING_KEY;
-        continue;
-      }
 
-        // GET THE MASKING KEY
-      case F_STATE_MASKING_KEY: {
-        if(c->frame->is_masked) {
-          memcpy((char*)&c->frame->mask_key, (char*)&c->frame->buffer[c->frame->dx], 4);
-          c->frame->state = F_STATE_APP_DATA;
-          c->frame->dx += 4;
-          c->frame->app_data_dx = c->frame->dx;
-          continue;
-        }
-        else {
-          printf("ERROR: Client data should be masked. @todo disconnect.\n");
+        // the frame callback failed the connection
+        if(c->state != WS_STATE_OPEN) {
+          evbuffer_drain(input, evbuffer_get_length(input));
           return;
         }
-        break;
-      };
 
-        // HANDLE APP DATA
-      case F_STATE_APP_DATA: {
-        size_t app_data_read =  (c->frame->dx - c->frame->app_data_dx); 
-        size_t app_data_received = c->frame->buffer.size() - c->frame->app_data_dx;
-        /*
-        printf("App_Data_Read: %zu, App_Data_Index: %zu, Current_Index: %zu, Payload_Len: %lld, App_Data_Received: %zu\n"
-               ,app_data_read
-               ,c->frame->app_data_dx
-               ,c->frame->dx
-               ,c->frame->payload_len
-               ,app_data_received
-               );
-        */
-        if(app_data_received >= c->frame->payload_len) {
-          ///printf(">>>> WE HAVE RECEIVED ALL PAYLOAD DATA, CONVERT!, STATE: %d / %d,\n", c->state, WS_STATE_OPEN);
-          for(int i = 0; i < c->frame->payload_len; ++i) {
-              c->frame->buffer[c->frame->dx]  = c->frame->buffer[c->frame->dx] ^ c->frame->mask_key[c->frame->mask_key_index];
-              c->frame->mask_key_index = ++c->frame->mask_key_index % 4;
-              c->frame->dx++;
-          }
-          c->frames.push_back(c->frame);  
-          if(ws_listener != NULL) {
-            ws_listener->onNewFrame(c, c->frame);
-          }
-          //printf("Left to rad %zu\n", c->frame->getBytesLeftToRead());
-          WebSocketFrame* new_frame = new WebSocketFrame();
-          if(c->frame->getBytesLeftToRead()) {
-            std::copy(
-                      c->frame->getPtr()+c->frame->dx
-                      ,c->frame->getPtr() + c->frame->dx + c->frame->getBytesLeftToRead()
-                      ,std::back_inserter(new_frame->buffer)
-                      );
-          }
-          c->frame = new_frame;
-          printf("--------- READY WITH FRAME ------------\n");
-        }
-        return; // @todo, this might cause bugs
-        break;
-      };
-      default: printf("ERROR: Unhandled Frame State\n"); break;
-      }; // switch(c->frame->state)
-    } // while (c->frame->hasBytes())
+        nparsed += vecs[i].iov_len;
+      }
+
+      evbuffer_drain(input, nparsed);
+    }
     break; 
   }; // WS_STATE_OPEN
   default:break;
@@ -362,18 +316,73 @@ void WebSockets::sendHTTPRequest(WebSocketConnection* c, WebSocketHTTPRequest& r
 }
 
 void WebSockets::sendToAllClients(const char* buffer, size_t len, bool binary) {
-  printf("sendToAllClients(): '%s', len: %zu\n", buffer, len);
-  WebSocketFrame frame;
-  frame.is_final = true;
-  frame.has_rsv = false;
-  frame.is_masked = false;
-  frame.opcode = (binary) ? F_OPCODE_BINARY_FRAME : F_OPCODE_TEXT_FRAME;
-  frame.payload_len = len;
-  frame.setData(buffer, len);
-  
+  WebSocketSharedFrame* plain = NULL;
+  WebSocketSharedFrame* compressed[MAX_WBITS + 1] = { NULL };
+
+  // encode once for connections without permessage-deflate and once per window size for the others
   for(std::vector<WebSocketConnection*>::iterator it = connections.begin(); it != connections.end(); ++it) {
-    (*it)->addToOutputBuffer(frame.getPtr(), frame.getSize());
+    WebSocketConnection* c = *it;
+    if(c->state != WS_STATE_OPEN) {
+      continue;
+    }
+
+    if(c->use_deflate && len >= WS_DEFLATE_MIN_SIZE) {
+      if(!compressed[c->deflate_window_bits]) {
+        compressed[c->deflate_window_bits] = encodeFrame(buffer, len, binary, c->deflate_window_bits);
+      }
+      c->addToOutputBuffer(compressed[c->deflate_window_bits]);
+    }
+    else {
+      if(!plain) {
+        plain = encodeFrame(buffer, len, binary, 0);
+      }
+      c->addToOutputBuffer(plain);
+    }
+  }
+
+  if(plain) {
+    plain->release();
   }
+  for(int i = 0; i <= MAX_WBITS; ++i) {
+    if(compressed[i]) {
+      compressed[i]->release();
+    }
+  }
+}
+
+void WebSockets::send(WebSocketConnection* c, const char* buffer, size_t len, bool binary) {
+  int window_bits = (c->use_deflate && len >= WS_DEFLATE_MIN_SIZE) ? c->deflate_window_bits : 0;
+  WebSocketSharedFrame* f = encodeFrame(buffer, len, binary, window_bits);
+  c->addToOutputBuffer(f);
+  f->release();
+}
+
+WebSocketSharedFrame* WebSockets::encodeFrame(const char* buffer, size_t len, bool binary, int windowBits) {
+  WebSocketSharedFrame* f = WebSocketSharedFrame::create();
+  ev_uint8_t opcode = (binary) ? F_OPCODE_BINARY_FRAME : F_OPCODE_TEXT_FRAME;
+
+  // compress behind a reserved header and move the payload when the header is smaller
+  if(windowBits) {
+    f->data.resize(WS_MAX_HEADER_SIZE);
+    if(deflate[windowBits].compress((const ev_uint8_t*)buffer, len, f->data)) {
+      size_t compressed_len = f->data.size() - WS_MAX_HEADER_SIZE;
+      ev_uint8_t header[WS_MAX_HEADER_SIZE];
+      size_t header_size = websocket_encode_header(header, opcode, true, true, compressed_len);
+      size_t dx = WS_MAX_HEADER_SIZE - header_size;
+      memcpy(&f->data[dx], header, header_size);
+      f->data.erase(f->data.begin(), f->data.begin() + dx);
+      return f;
+    }
+    printf("ERROR: cannot compress message, sending it uncompressed.\n");
+    f->data.clear();
+  }
+
+  ev_uint8_t header[WS_MAX_HEADER_SIZE];
+  size_t header_size = websocket_encode_header(header, opcode, true, false, len);
+  f->data.reserve(header_size + len);
+  f->data.insert(f->data.end(), header, header + header_size);
+  f->data.insert(f->data.end(), (const ev_uint8_t*)buffer, (const ev_uint8_t*)buffer + len);
+  return f;
 }
 
 // result must be of SHA1HashSize size
@@ -420,6 +429,10 @@ int WebSockets::createSecurityKey(const char* clientKey, char* result, int size)
 void WebSockets::removeConnection(WebSocketConnection* c) {
   for(std::vector<WebSocketConnection*>::iterator it = connections.begin(); it != connections.end(); ++it) {
     if((*it) == c) {
+      if(c->bev) {
+        bufferevent_free(c->bev);
+        c->bev = NULL;
+      }
       delete c;
       connections.erase(it);
       return;
@@ -428,21 +441,37 @@ void WebSockets::removeConnection(WebSocketConnection* c) {
 }
 
 
+void WebSockets::failConnection(WebSocketConnection* c, ev_uint16_t code) {
+  if(c->state == WS_STATE_CLOSING) {
+    return;
+  }
+
+  ev_uint8_t payload[2] = { (ev_uint8_t)((code >> 8) & 0xFF), (ev_uint8_t)(code & 0xFF) };
+  WebSocketFrame close;
+  close.is_final = true;
+  close.opcode = F_OPCODE_CLOSE;
+  close.payload_len = sizeof(payload);
+  close.setData((const char*)payload, sizeof(payload));
+  c->addToOutputBuffer(close.getPtr(), close.getSize());
+
+  // stop reading; callbackWriteClose() removes the connection once the close frame is written
+  c->state = WS_STATE_CLOSING;
+  bufferevent_disable(c->bev, EV_READ);
+  bufferevent_setcb(c->bev, NULL, &WebSockets::callbackWriteClose, callbackEvent, c);
+}
+
 // WebSocketConnection
 // ------------------------------------------------------------------------------------
 WebSocketConnection::WebSocketConnection()
   :ws(NULL)
   ,bev(NULL)
   ,state(WS_STATE_NONE)
-  ,frame(NULL)
+  ,use_deflate(false)
+  ,deflate_window_bits(MAX_WBITS)
 {
 }
 
 WebSocketConnection::~WebSocketConnection() {
-  printf("~WebSocketConnection()\n");
-  for(std::vector<WebSocketFrame*>::iterator it = frames.begin(); it != frames.end(); ++it) {
-    delete *it;
-  }
 }
 
 void WebSocketConnection::addToOutputBuffer(const char* data, size_t len) {
@@ -450,6 +479,19 @@ void WebSocketConnection::addToOutputBuffer(const char* data, size_t len) {
     evbuffer_add(output, data, len);
 }
 
+void WebSocketConnection::addToOutputBuffer(WebSocketSharedFrame* f) {
+  evbuffer* output = bufferevent_get_output(bev);
+  f->retain();
+  if(evbuffer_add_reference(output, &f->data[0], f->data.size(), websocket_shared_frame_cleanup, f) < 0) {
+    printf("ERROR: cannot add frame to output buffer.\n");
+    f->release();
+  }
+}
+
+size_t WebSocketConnection::getSendQueueDepth() {
+  return evbuffer_get_length(bufferevent_get_output(bev));
+}
+
 // HTTPRequest
 // ------------------------------------------------------------------------------------
 WebSocketHTTPRequest::WebSocketHTTPRequest()
@@ -469,7 +511,14 @@ void WebSocketHTTPRequest::print() {
   }
 }
 
+// a header which is given multiple times is combined into one comma separated value (RFC 7230, 3.2.2)
 void WebSocketHTTPRequest::addHeader(const char* name, const char* value) {
+  std::map<std::string, WebSocketHTTPHeader>::iterator it = headers.find(name);
+  if(it != headers.end()) {
+    it->second.value.append(", ");
+    it->second.value.append(value, strlen(value));
+    return;
+  }
   WebSocketHTTPHeader h;
   h.name.append(name, strlen(name));
   h.value.append(value, strlen(value));
@@ -504,42 +553,26 @@ void WebSocketHTTPRequest::reset() {
 // Frame
 // ------------------------------------------------------------------------------------
 WebSocketFrame::WebSocketFrame()
-  :state(F_STATE_HEADER)
-  ,dx(0)
+  :app_data_dx(0)
   ,is_masked(false)
   ,is_final(0)
   ,opcode(0)
   ,has_rsv(false)
   ,payload_len(0)
-  ,mask_key_index(0)
 {
-  memset((char*)mask_key, 0, 4);
 };
 
 WebSocketFrame::~WebSocketFrame() {
-  printf("WebSocketFrame::~WebSocketFrame()\n");
 }
 
 // Create the raw frame buffer that we can send. you need to set the members yourself
 void WebSocketFrame::setData(const char* data, size_t len) {
-  // BYTE 0
-  ev_uint8_t fin_bit = (is_final) ? 0x80 : 0x00;
-  ev_uint8_t rsv_bits = (has_rsv) ? 0x00 : 0x00; // @todo implement extensions
-  ev_uint8_t opcode_bits = opcode;
-  buffer.push_back(fin_bit | rsv_bits | opcode_bits);
-
-  // BYTE 1
-  ev_uint8_t mask_bit = (is_masked) ? 0x80 : 0x00;
-  if(payload_len < 126) {
-    ev_uint8_t size_bits = 0x7F & len;
-    buffer.push_back(size_bits | mask_bit);
-  }
-  else {
-    printf("ERROR: We have not yet implemented frames which are bigger then 125 bytes");
-  }
-
-  // Copy data
-  std::copy(data, data+len, std::back_inserter(buffer));
+  ev_uint8_t header[WS_MAX_HEADER_SIZE];
+  size_t header_size = websocket_encode_header(header, opcode, is_final, has_rsv, len);
+  buffer.reserve(buffer.size() + header_size + len);
+  buffer.insert(buffer.end(), header, header + header_size);
+  app_data_dx = buffer.size();
+  buffer.insert(buffer.end(), data, data + len);
 }
 
 std::string WebSocketFrame::getAppDataAsText() {
@@ -551,6 +584,512 @@ bool WebSocketFrame::isBinary() {
   return opcode == F_OPCODE_BINARY_FRAME;
 }
 
+size_t websocket_encode_header(ev_uint8_t* dest, ev_uint8_t opcode, bool isFinal, bool rsv1, ev_uint64_t len) {
+  dest[0] = (isFinal ? 0x80 : 0x00) | (rsv1 ? 0x40 : 0x00) | (opcode & 0x0F);
+
+  if(len < 126) {
+    dest[1] = (ev_uint8_t)len;
+    return 2;
+  }
+  else if(len <= 0xFFFF) {
+    dest[1] = 126;
+    dest[2] = (len >> 8) & 0xFF;
+    dest[3] = len & 0xFF;
+    return 4;
+  }
+
+  dest[1] = 127;
+  for(int i = 0; i < 8; ++i) {
+    dest[2 + i] = (len >> (56 - i * 8)) & 0xFF;
+  }
+  return 10;
+}
+
+// Shared frame
+// ------------------------------------------------------------------------------------
+void websocket_shared_frame_cleanup(const void* data, size_t len, void* user) {
+  WebSocketSharedFrame* f = static_cast<WebSocketSharedFrame*>(user);
+  f->release();
+}
+
+WebSocketSharedFrame::WebSocketSharedFrame()
+  :refcount(1)
+{
+}
+
+WebSocketSharedFrame* WebSocketSharedFrame::create() {
+  return new WebSocketSharedFrame();
+}
+
+void WebSocketSharedFrame::retain() {
+  refcount++;
+}
+
+void WebSocketSharedFrame::release() {
+  refcount--;
+  if(refcount <= 0) {
+    delete this;
+  }
+}
+
+// permessage-deflate
+// ------------------------------------------------------------------------------------
+
+// splits `str` on `sep`, but not inside quoted strings, and trims the parts
+static void websocket_split(const std::string& str, char sep, std::vector<std::string>& result) {
+  result.clear();
+  std::string part;
+  bool in_quotes = false;
+  for(size_t i = 0; i <= str.size(); ++i) {
+    if(i == str.size() || (str[i] == sep && !in_quotes)) {
+      size_t start = part.find_first_not_of(" \t");
+      size_t end = part.find_last_not_of(" \t");
+      result.push_back((start == std::string::npos) ? std::string() : part.substr(start, end - start + 1));
+      part.clear();
+      continue;
+    }
+    if(str[i] == '"') {
+      in_quotes = !in_quotes;
+    }
+    part.push_back(str[i]);
+  }
+}
+
+// parses a window bits value: 8-15, decimal without leading zeros, optionally quoted (RFC 7692, 7.1.2)
+static bool websocket_parse_window_bits(std::string value, int& result) {
+  if(value.size() >= 2 && value[0] == '"' && value[value.size() - 1] == '"') {
+    value = value.substr(1, value.size() - 2);
+  }
+  if(value.empty() || value.size() > 2 || value[0] == '0') {
+    return false;
+  }
+  for(size_t i = 0; i < value.size(); ++i) {
+    if(value[i] < '0' || value[i] > '9') {
+      return false;
+    }
+  }
+  result = atoi(value.c_str());
+  return result >= 8 && result <= MAX_WBITS;
+}
+
+bool websocket_negotiate_deflate(const std::string& extensions, std::string& response, int& windowBits) {
+  std::vector<std::string> offers;
+  std::vector<std::string> params;
+  websocket_split(extensions, ',', offers);
+
+  for(size_t i = 0; i < offers.size(); ++i) {
+    websocket_split(offers[i], ';', params);
+
+    std::string name = params[0];
+    std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+    if(name != "permessage-deflate") {
+      continue;
+    }
+
+    // we decline offers with unknown, duplicate or invalid parameters (RFC 7692, 5)
+    bool is_valid = true;
+    bool has_server_no_context_takeover = false;
+    bool has_client_no_context_takeover = false;
+    bool has_server_max_window_bits = false;
+    bool has_client_max_window_bits = false;
+    int server_max_window_bits = MAX_WBITS;
+
+    for(size_t j = 1; j < params.size() && is_valid; ++j) {
+      std::string key = params[j];
+      std::string value;
+      bool has_value = false;
+      size_t eq = key.find('=');
+      if(eq != std::string::npos) {
+        value = key.substr(eq + 1);
+        key = key.substr(0, eq);
+        key.erase(key.find_last_not_of(" \t") + 1);
+        value.erase(0, value.find_first_not_of(" \t"));
+        has_value = true;
+      }
+      std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+
+      if(key == "server_no_context_takeover" && !has_value && !has_server_no_context_takeover) {
+        has_server_no_context_takeover = true;
+      }
+      else if(key == "client_no_context_takeover" && !has_value && !has_client_no_context_takeover) {
+        has_client_no_context_takeover = true;
+      }
+      else if(key == "server_max_window_bits" && has_value && !has_server_max_window_bits) {
+        has_server_max_window_bits = true;
+        is_valid = websocket_parse_window_bits(value, server_max_window_bits);
+      }
+      else if(key == "client_max_window_bits" && !has_client_max_window_bits) {
+        // we inflate with the max window, so we accept whatever the client uses
+        int client_max_window_bits = MAX_WBITS;
+        has_client_max_window_bits = true;
+        is_valid = !has_value || websocket_parse_window_bits(value, client_max_window_bits);
+      }
+      else {
+        is_valid = false;
+      }
+    }
+
+    if(!is_valid || server_max_window_bits < WS_DEFLATE_MIN_WINDOW_BITS) {
+      continue;
+    }
+
+    // we always reset both contexts, the server may ask the client to do so too (RFC 7692, 7.1.1)
+    response = "permessage-deflate; server_no_context_takeover; client_no_context_takeover";
+    windowBits = server_max_window_bits;
+    if(has_server_max_window_bits) {
+      char bits[32];
+      sprintf(bits, "; server_max_window_bits=%d", server_max_window_bits);
+      response.append(bits);
+    }
+    return true;
+  }
+
+  return false;
+}
+
+WebSocketDeflate::WebSocketDeflate()
+  :def_ready(false)
+  ,inf_ready(false)
+  ,window_bits(MAX_WBITS)
+{
+  memset(&def, 0, sizeof(def));
+  memset(&inf, 0, sizeof(inf));
+}
+
+WebSocketDeflate::~WebSocketDeflate() {
+  if(def_ready) {
+    deflateEnd(&def);
+  }
+  if(inf_ready) {
+    inflateEnd(&inf);
+  }
+}
+
+bool WebSocketDeflate::compress(const ev_uint8_t* data, size_t len, std::vector<ev_uint8_t>& result) {
+  if(!def_ready) {
+    if(deflateInit2(&def, WS_DEFLATE_LEVEL, Z_DEFLATED, -window_bits, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+      printf("ERROR: cannot initialize deflate.\n");
+      return false;
+    }
+    def_ready = true;
+  }
+  else if(deflateReset(&def) != Z_OK) {   /* server_no_context_takeover */
+    return false;
+  }
+
+  size_t offset = result.size();
+  result.resize(offset + deflateBound(&def, len) + 8);
+
+  def.next_in = (Bytef*)data;
+  def.avail_in = len;
+  def.next_out = &result[offset];
+  def.avail_out = result.size() - offset;
+
+  if(deflate(&def, Z_SYNC_FLUSH) != Z_OK || def.avail_in != 0) {
+    result.resize(offset);
+    return false;
+  }
+
+  size_t nbytes = (result.size() - offset) - def.avail_out;
+
+  // remove the 0x00 0x00 0xFF 0xFF tail of the sync flush (RFC 7692, 7.2.1)
+  if(nbytes >= 4) {
+    nbytes -= 4;
+  }
+
+  result.resize(offset + nbytes);
+  return true;
+}
+
+int WebSocketDeflate::decompress(const ev_uint8_t* data, size_t len, std::vector<ev_uint8_t>& result, size_t maxSize) {
+  static const ev_uint8_t tail[4] = { 0x00, 0x00, 0xFF, 0xFF };
+
+  if(!inf_ready) {
+    if(inflateInit2(&inf, -MAX_WBITS) != Z_OK) {
+      printf("ERROR: cannot initialize inflate.\n");
+      return WS_INFLATE_ERROR;
+    }
+    inf_ready = true;
+  }
+  else if(inflateReset(&inf) != Z_OK) {   /* client_no_context_takeover */
+    return WS_INFLATE_ERROR;
+  }
+
+  size_t offset = result.size();
+
+  ev_uint8_t tmp[16384];
+  const ev_uint8_t* inputs[2] = { data, tail };
+  size_t sizes[2] = { len, sizeof(tail) };
+
+  for(int i = 0; i < 2; ++i) {
+    inf.next_in = (Bytef*)inputs[i];
+    inf.avail_in = sizes[i];
+
+    do {
+      inf.next_out = tmp;
+      inf.avail_out = sizeof(tmp);
+
+      int r = inflate(&inf, Z_SYNC_FLUSH);
+      if(r != Z_OK && r != Z_STREAM_END && r != Z_BUF_ERROR) {
+        return WS_INFLATE_ERROR;
+      }
+
+      // a small message can inflate to gigabytes, so we stop as soon as it gets too big
+      size_t nbytes = sizeof(tmp) - inf.avail_out;
+      if((result.size() - offset) + nbytes > maxSize) {
+        result.resize(offset);
+        return WS_INFLATE_TOO_BIG;
+      }
+
+      result.insert(result.end(), tmp, tmp + nbytes);
+
+      if(r == Z_STREAM_END) {
+        break;
+      }
+    } while(inf.avail_in || inf.avail_out == 0);
+  }
+
+  return WS_INFLATE_OK;
+}
+
+// Frame parser
+// ------------------------------------------------------------------------------------
+
+// The mask repeats every 4 bytes, so we can xor 16 (SSE2) or 8 bytes at once with a
+// rotated copy of the mask; `offset` makes sure we continue at the correct mask byte
+// when a frame arrives in multiple chunks.
+void websocket_unmask(ev_uint8_t* data, size_t nbytes, const ev_uint8_t* mask, ev_uint64_t offset) {
+  ev_uint8_t key[16];
+  for(int i = 0; i < 16; ++i) {
+    key[i] = mask[(offset + i) & 3];
+  }
+
+  size_t i = 0;
+
+#if defined(__SSE2__) || defined(_M_X64)
+  __m128i key128 = _mm_loadu_si128((const __m128i*)key);
+  for(; i + 16 <= nbytes; i += 16) {
+    __m128i d = _mm_loadu_si128((const __m128i*)(data + i));
+    _mm_storeu_si128((__m128i*)(data + i), _mm_xor_si128(d, key128));
+  }
+#endif
+
+  ev_uint64_t key64;
+  memcpy(&key64, key, 8);
+  for(; i + 8 <= nbytes; i += 8) {
+    ev_uint64_t d;
+    memcpy(&d, data + i, 8);
+    d ^= key64;
+    memcpy(data + i, &d, 8);
+  }
+
+  for(; i < nbytes; ++i) {
+    data[i] ^= key[i & 3];
+  }
+}
+
+WebSocketFrameParser::WebSocketFrameParser()
+  :allow_compression(false)
+  ,max_message_size(WS_DEFAULT_MAX_MESSAGE_SIZE)
+  ,cb_frame(NULL)
+  ,cb_user(NULL)
+{
+  control.buffer.reserve(WS_MAX_CONTROL_PAYLOAD);
+  reset();
+}
+
+void WebSocketFrameParser::setup(websocket_frame_callback frameCB, void* user) {
+  cb_frame = frameCB;
+  cb_user = user;
+}
+
+void WebSocketFrameParser::reset() {
+  state = F_STATE_HEADER;
+  header_dx = 0;
+  opcode = 0;
+  payload_len = 0;
+  payload_read = 0;
+  is_final = false;
+  is_masked = false;
+  is_compressed = false;
+  in_message = false;
+  frame = NULL;
+  message.buffer.clear();
+  control.buffer.clear();
+  memset(header, 0, sizeof(header));
+  memset(mask_key, 0, sizeof(mask_key));
+}
+
+int WebSocketFrameParser::parse(const ev_uint8_t* data, size_t nbytes) {
+  size_t dx = 0;
+
+  while(dx < nbytes) {
+    switch(state) {
+
+      // FIN, RSV, OPCODE
+      case F_STATE_HEADER: {
+        ev_uint8_t b = data[dx++];
+        if((b & 0x30) || ((b & 0x40) && !allow_compression)) {
+          printf("ERROR: Received reserved bits for an extension we didn't negotiate.\n");
+          return WS_PARSE_ERROR;
+        }
+        is_compressed = (b & 0x40) == 0x40;
+        is_final = (b & 0x80) == 0x80;
+        opcode = (b & 0x0F);
+        state = F_STATE_HEADER_LEN_1;
+        break;
+      }
+
+      // MASK, PAYLOAD LEN 
+      case F_STATE_HEADER_LEN_1: {
+        ev_uint8_t b = data[dx++];
+        is_masked = (b & 0x80) == 0x80;
+        if(!is_masked) {
+          printf("ERROR: All client data must be masked!\n");
+          return WS_PARSE_ERROR;
+        }
+
+        payload_len = (b & 0x7F);
+        header_dx = 0;
+        if(payload_len == 126) {
+          state = F_STATE_HEADER_LEN_2;
+        }
+        else if(payload_len == 127) {
+          state = F_STATE_HEADER_LEN_8;
+        }
+        else {
+          state = F_STATE_MASKING_KEY;
+        }
+        break;
+      }
+
+      // EXTENDED PAYLOAD LEN (network byte order)
+      case F_STATE_HEADER_LEN_2:
+      case F_STATE_HEADER_LEN_8: {
+        size_t need = (state == F_STATE_HEADER_LEN_2) ? 2 : 8;
+        header[header_dx++] = data[dx++];
+        if(header_dx == need) {
+          payload_len = 0;
+          for(size_t i = 0; i < need; ++i) {
+            payload_len = (payload_len << 8) | header[i];
+          }
+          header_dx = 0;
+          state = F_STATE_MASKING_KEY;
+        }
+        break;
+      }
+
+      // MASKING KEY
+      case F_STATE_MASKING_KEY: {
+        mask_key[header_dx++] = data[dx++];
+        if(header_dx == 4) {
+          header_dx = 0;
+          if(!beginPayload()) {
+            return WS_PARSE_ERROR;
+          }
+          if(payload_len == 0) {
+            endPayload();
+          }
+          else {
+            state = F_STATE_APP_DATA;
+          }
+        }
+        break;
+      }
+
+      // APP DATA; append + unmask in place
+      case F_STATE_APP_DATA: {
+        size_t navail = nbytes - dx;
+        ev_uint64_t nleft = payload_len - payload_read;
+        size_t ncopy = (nleft < navail) ? (size_t)nleft : navail;
+        size_t offset = frame->buffer.size();
+
+        frame->buffer.insert(frame->buffer.end(), data + dx, data + dx + ncopy);
+        websocket_unmask(&frame->buffer[offset], ncopy, mask_key, payload_read);
+
+        dx += ncopy;
+        payload_read += ncopy;
+
+        if(payload_read == payload_len) {
+          endPayload();
+        }
+        break;
+      }
+
+      default: {
+        printf("ERROR: Unhandled Frame State\n"); 
+        return WS_PARSE_ERROR;
+      }
+    }
+  }
+
+  return WS_PARSE_OK;
+}
+
+bool WebSocketFrameParser::beginPayload() {
+  payload_read = 0;
+
+  // control frames may not be fragmented and can be interleaved with data fragments
+  if(opcode & 0x08) {
+    if(!is_final || is_compressed || payload_len > WS_MAX_CONTROL_PAYLOAD) {
+      printf("ERROR: Invalid control frame.\n");
+      return false;
+    }
+    frame = &control;
+    frame->buffer.clear();
+    frame->opcode = opcode;
+    frame->has_rsv = false;
+    return true;
+  }
+
+  if(opcode == F_OPCODE_CONTNUATION_FRAME) {
+    if(!in_message || is_compressed) {
+      printf("ERROR: Received an invalid continuation frame.\n");
+      return false;
+    }
+  }
+  else {
+    if(in_message) {
+      printf("ERROR: Received a new message before the previous one was finished.\n");
+      return false;
+    }
+    in_message = true;
+    message.buffer.clear();
+    message.opcode = opcode;
+    message.has_rsv = is_compressed;
+  }
+
+  if(message.buffer.size() + payload_len > max_message_size) {
+    printf("ERROR: Message is too big: %llu bytes.\n", (unsigned long long)(message.buffer.size() + payload_len));
+    return false;
+  }
+
+  message.buffer.reserve(message.buffer.size() + (size_t)payload_len);
+  frame = &message;
+  return true;
+}
+
+void WebSocketFrameParser::endPayload() {
+  state = F_STATE_HEADER;
+
+  if(frame == &message && !is_final) {
+    return;
+  }
+
+  frame->is_final = true;
+  frame->is_masked = false;
+  frame->app_data_dx = 0;
+  frame->payload_len = frame->buffer.size();
+
+  if(frame == &message) {
+    in_message = false;
+  }
+
+  if(cb_frame) {
+    cb_frame(frame, cb_user);
+  }
+}
+
 /* Example conversation:
 // ------------------------------------------------------------------------------------
 --
@@ -96,6 +96,7 @@ extern "C" {
 #define ID_CLUSTER 0x1f43b675
 #define ID_TIMECODE 0xe7
 #define ID_BLOCK_GROUP 0xa0
+#define ID_BLOCK 0xa1
 #define ID_SIMPLE_BLOCK 0xa3
 
 // ---------------------------------------
@@ -0,0 +1,137 @@
+/*
+
+  EBMLWriter
+  ----------
+  Streaming webm writer. Where `EBML` serializes every element into a
+  std::vector and copies nested elements, the EBMLWriter encodes the element
+  headers into a small scratch buffer and passes the encoded frames by
+  reference to the output (see ebml_writev_cb), so the frame data is never
+  copied by the muxer.
+
+  - The segment and clusters are written with a reserved 8 byte size which is
+    set to "unknown". When the output can rewrite data (cb_pwrite != NULL) we
+    patch the real sizes, else they stay unknown which is fine for live streams.
+  - A new cluster is started at a video keyframe when the current cluster is
+    older than `max_cluster_duration` millis, or when the timecode of a block
+    doesn't fit in the 16 bit relative timecode anymore.
+  - For every cluster that starts with a keyframe we store a cue point. On
+    close() we write the Cues, the SeekHead (into the space we reserved after
+    the segment header) and the Duration, so the files are seekable.
+
+  Usage:
+  ````c++
+  EBMLWriterFile file;
+  file.open("out.webm");
+
+  EBMLWriter writer;
+  writer.setCallbacks(ebml_writer_file_writev, ebml_writer_file_pwrite, ebml_writer_file_close, &file);
+  writer.open(header, info, tracks);
+
+  // for each encoded frame; the data is only used during this call
+  writer.addSimpleBlock(block);
+
+  writer.close();
+  ````
+
+*/
+#ifndef ROXLU_EBML_WRITER_H
+#define ROXLU_EBML_WRITER_H
+
+#include <webm/EBML.h>
+#include <map>
+
+#define EBML_WRITER_MAX_IOVECS 16                                                   /* max number of buffers we pass to one ebml_writev_cb call */
+#define EBML_WRITER_SEEK_HEAD_SIZE 96                                               /* number of bytes we reserve (as a Void element) for the seek head */
+#define EBML_WRITER_MAX_CLUSTER_DURATION 5000                                       /* default max duration of a cluster in millis; we only start a new one at a keyframe */
+#define EBML_WRITER_UNKNOWN_SIZE_NBYTES 8                                           /* number of bytes we use for sizes we rewrite later */
+
+#define ERR_EBMLW_NOT_OPEN "The EBMLWriter is not opened."
+#define ERR_EBMLW_ALREADY_OPEN "The EBMLWriter is already opened; close() first."
+#define ERR_EBMLW_NO_CALLBACKS "No write callback set; call setCallbacks()."
+#define ERR_EBMLW_WRITE "Failed to write all bytes: %ld of %ld."
+#define ERR_EBMLW_TOO_MANY_VECS "Too many buffers for one write: %d."
+#define ERR_EBMLW_FILE_OPEN "Cannot open: %s, error: %d (%s)"
+#define ERR_EBMLW_FILE_WRITE "Cannot write to the webm file, error: %d (%s)"
+#define ERR_EBMLW_FILE_NOT_OPEN "Cannot write; the webm file is not opened."
+
+struct EBMLIOVec {
+  char* data;
+  size_t nbytes;
+};
+
+typedef size_t(*ebml_writev_cb)(EBMLIOVec* vecs, int nvecs, void* user);              /* output: write all buffers in order; return the total number of bytes written */
+typedef bool(*ebml_pwrite_cb)(char* data, size_t nbytes, uint64_t pos, void* user);   /* output: rewrite nbytes at the absolute position pos; set to NULL when the output isn't seekable (e.g. a socket) */
+
+size_t ebml_writer_file_writev(EBMLIOVec* vecs, int nvecs, void* user);
+bool ebml_writer_file_pwrite(char* data, size_t nbytes, uint64_t pos, void* user);
+void ebml_writer_file_close(void* user);
+
+struct EBMLWriterFile {                                                             /* file output for the EBMLWriter, uses writev() and pwrite() */
+  EBMLWriterFile();
+  ~EBMLWriterFile();
+  bool open(const std::string filepath);
+  int fd;
+};
+
+struct EBMLCuePoint {
+  uint64_t timecode;                                                                /* timecode of the keyframe (relative to the start of the stream) */
+  unsigned char track_number;                                                       /* track of the keyframe */
+  uint64_t cluster_position;                                                        /* position of the cluster, relative to the start of the segment data */
+};
+
+struct EBMLWriterTrackTiming {                                                      /* used to estimate the duration of the last block of a track */
+  EBMLWriterTrackTiming();
+  uint64_t last_timecode;                                                           /* timecode of the last block of the track */
+  uint64_t frame_duration;                                                          /* difference between the timecodes of the last two blocks of the track */
+};
+
+class EBMLWriter {
+ public:
+  EBMLWriter();
+  ~EBMLWriter();
+
+  void setCallbacks(ebml_writev_cb writevCB, ebml_pwrite_cb pwriteCB, ebml_close_cb closeCB, void* user);
+  int open(EBMLHeader header, EBMLSegmentInfo info, std::vector<EBMLTrack> tracks);  /* writes the ebml header, segment, reserved seek head, info and tracks */
+  int addSimpleBlock(EBMLSimpleBlock block);                                        /* writes a simple block; b.data is passed directly to the output */
+  int close();                                                                      /* closes the cluster, writes the cues and rewrites the seek head, duration and sizes when the output is seekable */
+
+ private:
+  bool openCluster(uint64_t timecode);
+  bool closeCluster();                                                              /* rewrites the size of the current cluster when we can */
+  bool writeCues();
+  bool writeSeekHead();
+  size_t writev(EBMLIOVec* vecs, int nvecs);                                        /* writes and updates bytes_written */
+  size_t writeBuffer(std::vector<char>& buf);
+
+ public:
+  uint64_t max_cluster_duration;                                                    /* start a new cluster at the next keyframe after this many millis */
+
+ private:
+  ebml_writev_cb cb_writev;
+  ebml_pwrite_cb cb_pwrite;
+  ebml_close_cb cb_close;
+  void* cb_user;
+
+  bool is_open;
+  bool has_video;                                                                   /* when we have a video track, clusters start at video keyframes */
+  uint64_t bytes_written;                                                           /* absolute position in the output */
+  uint64_t segment_size_pos;                                                        /* absolute position of the segment data size */
+  uint64_t segment_data_pos;                                                        /* absolute position of the first byte of the segment data; positions in the seek head and cues are relative to this */
+  uint64_t seek_head_pos;                                                           /* absolute position of the Void element we reserved for the seek head */
+  uint64_t duration_pos;                                                            /* absolute position of the 8 bytes of the duration float */
+  uint64_t info_pos;                                                                /* position of the Info element, relative to segment_data_pos */
+  uint64_t tracks_pos;                                                              /* position of the Tracks element, relative to segment_data_pos */
+  uint64_t cues_pos;                                                                /* position of the Cues element, relative to segment_data_pos */
+  uint64_t cluster_pos;                                                             /* absolute position of the current cluster, 0 when there is no cluster */
+  uint64_t cluster_timecode;                                                        /* timecode of the current cluster */
+  uint64_t time_stream_started;                                                     /* timestamp of the first block */
+  uint64_t last_timecode;                                                           /* last timecode we wrote, used for the duration */
+  uint64_t last_frame_duration;                                                     /* frame duration of the track of the last block; the segment duration is last_timecode + last_frame_duration */
+  std::map<unsigned char, EBMLWriterTrackTiming> track_timings;                     /* per track number */
+  bool has_blocks;                                                                  /* true when we've written the first block */
+  std::vector<EBMLCuePoint> cues;
+  std::vector<char> buffer;                                                         /* used for the (small) header elements */
+  char block_header[32];                                                            /* scratch buffer for the simple block header */
+};
+
+#endif
@@ -14,6 +14,8 @@ class IVFPlayer {
   void play();                                                     /* start playing */
   void pause();                                                    /* pause playback */
   void stop();                                                     /* stop playback and go to the begin */
+  bool seek(uint64_t millis);                                      /* continue playback at millis */
+  void setLoop(bool loop);                                         /* loop the video */
   void update();                                                   /* call this repeatedly, it will update the frames */
   void draw(int x, int y, int w = 0, int h = 0);                   /* draw ... */
   void setFPS(double fps);                                         /* set the FPS, see the info in IVF.h */
@@ -41,6 +43,14 @@ inline void IVFPlayer::pause() {
   ivf.pause();
 }
 
+inline bool IVFPlayer::seek(uint64_t millis) {
+  return ivf.seek(millis);
+}
+
+inline void IVFPlayer::setLoop(bool loop) {
+  ivf.setLoop(loop);
+}
+
 inline void IVFPlayer::update() {
   ivf.update();
 }
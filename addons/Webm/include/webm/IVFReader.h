@@ -1,92 +1,157 @@
+/*
+
+  IVFReader
+  ---------
+  Plays back an IVF file. The file is memory mapped and on open() we walk
+  over all frame headers once to build an index with the offset, size and
+  pts of every frame; after that we never read from the file on the calling
+  thread.
+
+  - A decode thread decodes the frames ahead of the playback time into a
+    bounded ring of decoded frames (`num_decoded_frames` RGB frames). It
+    waits when the ring is full. update() only picks the newest decoded
+    frame for the current time and calls the read callback, so disk access
+    and decoding never stall the thread that calls update().
+  - seek() restarts decoding at the keyframe before the requested time; the
+    frames between that keyframe and the requested time are decoded but not
+    shown. We don't reopen the file for stop(), seek() or looping.
+  - setLoop(true) makes the decode thread continue at the first frame when it
+    reaches the end; the timestamps keep increasing so playback is seamless.
+
+  The read callback is always called from the thread that calls update().
+
+*/
 #ifndef ROXLU_WEBM_IVF_READER_H
 #define ROXLU_WEBM_IVF_READER_H
 
 #include <string>
 #include <vector>
-#include <deque>
-#include <roxlu/io/RingBuffer.h>
+#include <uv.h>
 #include <roxlu/core/Utils.h>
 #include <webm/VPXEncoder.h> /* for the VPXSettings */
 #include <webm/VPXDecoder.h>
 
 #define IVF_ERR_FOPEN "Cannot open the file: %s"
+#define IVF_ERR_MMAP "Cannot map the file: %s"
 #define IVF_ERR_READ_HEADER "Cannot read the ivf-header"
 #define IVF_ERR_INVALID_FILE "Not a correct ivf-file"
 #define IVF_ERR_INVALID_SIZE "The ivf-header contains an invalid width or height (%d, %d)"
-#define IVF_ERR_FRAME_TOO_BIG "The current frame size is too big to handle"
-#define IVF_ERR_READ_FRAME "Cannot read the frame"
-#define IVF_ERR_FRAME_READ_HDR "Cannot read frame header.. at the end the file?"
-#define IVF_ERR_FRAME_STATE "Cannot read a frame because the current state is not IVF_STATE_PLAY"
+#define IVF_ERR_FRAME_TRUNCATED "Frame %ld is truncated; we only use the frames before it."
+#define IVF_ERR_NO_FRAMES "The ivf file has no frames"
 #define IVF_ERR_DECODER_SETUP "Cannot setup the decoder"
 #define IVF_ERR_ALREADY_OPEN "We've already opened a ivf file"
 #define IVF_ERR_CLOSE "Cannot close ivf as we haven't opened a file yet"
 #define IVF_ERR_ALREADY_PLAYING "We're already playing. First call stop, then play again to restart"
-#define IVF_ERR_HDR_FILE "Cannot read the IVF header because the file pointer is invalid"
-#define IVF_ERR_HDR_SEEK "Cannot set the file pointer to the beginning of the file"
+#define IVF_ERR_NOT_OPEN "Cannot play or seek, we haven't opened a file yet"
+#define IVF_ERR_NUM_DECODED_FRAMES "Invalid number of decoded frames: %d, we need at least 2"
 #define IVF_V_ALREADY_PAUSED "We're already paused... not pausing again :) "
 
 #define IVF_FILE_HDR_SIZE 32
 #define IVF_FRAME_HDR_SIZE 12
+#define IVF_DEFAULT_NUM_DECODED_FRAMES 8                             /* default number of frames we decode ahead */
 
 struct IVFFrame {
   IVFFrame();
-  size_t offset;                                                    /* offset in the buffer */
+  size_t offset;                                                    /* offset of the frame data in the mapped file */
   uint64_t pts;                                                     /* presentation timestamp from the ivf file */
-  uint64_t millis;                                                  /* time in millis when this frame should be played back */
   size_t size;                                                      /* number of bytes */
+  bool is_keyframe;                                                 /* true when we can start decoding at this frame */
+};
+
+struct IVFDecodedFrame {
+  IVFDecodedFrame();
+  std::vector<unsigned char> pixels;                                /* the decoded RGB pixels */
+  size_t nbytes;                                                    /* number of used bytes in pixels */
+  size_t dx;                                                        /* index of the frame in IVFReader::frames */
+  uint64_t num_loops;                                               /* number of times we looped before decoding this frame */
 };
 
 #define IVF_STATE_NONE 0
 #define IVF_STATE_PLAY 1
 #define IVF_STATE_PAUSE 2
 
+void ivf_reader_decode_thread(void* user);                          /* calls IVFReader::decode() */
+void ivf_reader_on_decoded(unsigned char* pixels, size_t nbytes, void* user);  /* VPXDecoder callback, stores the frame in the decoded ring */
+
 class IVFReader {
  public:
   IVFReader(vpx_read_cb readCB, void* readUser = NULL);
   ~IVFReader();
-  bool open(std::string filename, bool datapath = false);            /* open a file for reading */
+  bool open(std::string filename, bool datapath = false);            /* open a file for reading, builds the frame index and starts decoding ahead */
   bool close();                                                      /* close the current file and reset everythin */
   void print();                                                      /* print some verbose info */
   void play();                                                       /* start playing back */
-  void stop();                                                       /* stop the current playback */
+  void stop();                                                       /* stop the current playback, the next play() starts at the beginning */
   void pause();                                                      /* pause the current playback */
+  bool seek(uint64_t millis);                                        /* continue playback at millis; decoding restarts at the keyframe before it */
   void update();                                                     /* call this as often as possible */
-  void setFPS(double fps);                                           /* force this FPS, when you use this function we assume you're using `avconv` as described in the README.md because somehow the timebase with avconv is always 1/90000 and it's not setting the correct fps. */
+  void setLoop(bool loop);                                           /* when true we start again at the first frame when we reach the end */
+  bool setNumDecodedFrames(int num);                                 /* number of frames we decode ahead, must be called before open() */
+  void setFPS(double fps);                                           /* force this FPS, when you use this function we assume you're using `avconv` as described in the README.md because somehow the timebase with avconv is always 1/90000 and it's not setting the correct fps. Can be called at any time; playback continues at the current frame. */
+  void decode();                                                     /* the decode thread; don't call this yourself */
+  void onDecoded(unsigned char* pixels, size_t nbytes);              /* gets called by the VPXDecoder on the decode thread */
+
  private:
-  bool readHeader();                                                 /* read the file header, once the file has been opened, this can be called any time after you've opened a file.. it will reset the read pointer to the start of the file. see stop() of all other house keeping you need to do when you want to restart a stream */
-  void reset();                                                      /* resets all members used while decoding (does not reset the state, width/height etc..) */
+  bool readHeader();                                                 /* parses the file header and builds the frame index */
   bool shutdown();                                                   /* destructor; resets everything to the same state as when the object was created */
-  bool readFrame();                                                  /* reads a raw encoded frame and adds a new IVFFrame to the "frames" buffer that is used when playing back */
-  void updateBuffer();                                               /* updates the buffer with read (encoded) frames */ 
+  void restart(size_t dx);                                           /* makes the decode thread continue at frame dx, flushes the decoded frames */
+  size_t findFrame(uint64_t millis);                                 /* returns the index of the last frame with a time <= millis */
+  uint64_t frameMillis(size_t dx);                                   /* time of frame dx in millis */
+  uint64_t decodedMillis(IVFDecodedFrame& f);                        /* time when the decoded frame should be shown; computed with the current time_base */
+  uint64_t loopDuration();                                           /* duration of one loop in millis */
+
  public:
   /* playback */
   int state;                                                         /* current state ... */
   uint64_t time_started;                                             /* time the playback started, in millis */
   uint64_t time_paused;
-  double time_base;                                                  /* used to convert pts (presentation time stamps) to current playback time */
-  size_t frame_dx;                                                   /* current read frame is reset to 0 after decoding, in update() */
-  ssize_t last_frame_dx;                                             /* last frame dx we showed */
-
-  /* buffer */
-  RingBuffer rbuffer;
-  int num_frames_to_buffer;                                          /* number of frames we need to pre-buffer so we have a smooth playback */
-  size_t num_read_frames;                                            /* how many raw frames have been read */
-  std::deque<IVFFrame> frames;                                       /* contains IVFFrame information that is used to synchronize the IVF timestamps when playing back the file*/
-    
+  double time_base;                                                  /* used to convert pts (presentation time stamps) to current playback time, protected by the mutex once we're open */
+  bool loop;                                                         /* loop the video */
+
+  /* index */
+  std::vector<IVFFrame> frames;                                      /* offsets of all frames in the file */
+
+  /* decoded frames, ring buffer shared with the decode thread */
+  std::vector<IVFDecodedFrame> decoded;                              /* the decoded frames */
+  size_t decoded_read_dx;                                            /* index of the oldest decoded frame */
+  size_t num_decoded;                                                /* number of decoded frames in the ring */
+  int num_decoded_frames;                                            /* size of the ring */
+
+  /* decode thread */
+  uv_thread_t thread;
+  uv_mutex_t mutex;                                                  /* protects the ring, the seek request and the flags below */
+  uv_cond_t cond;                                                    /* signalled when there is space in the ring, on seek, loop change and stop */
+  bool must_stop;                                                    /* set to true to stop the decode thread */
+  bool is_decode_finished;                                           /* true when the decode thread reached the end (and we're not looping) */
+  int64_t seek_dx;                                                   /* frame that must be shown next after a seek, -1 when there is no seek request */
+  uint64_t generation;                                               /* incremented on each seek; frames decoded for an older generation are dropped */
+  uint64_t decode_generation;                                        /* decode thread: generation of the frame we're decoding */
+  size_t decode_dx;                                                  /* decode thread: index of the frame we're decoding */
+  uint64_t decode_loops;                                             /* decode thread: number of times we looped */
+  bool decode_visible;                                               /* decode thread: false when we decode a frame only because we seeked past it */
+
   /* decoder */
-  VPXDecoder* decoder;                                               /* the decoder wrapper */
-  vpx_read_cb cb_read;                                               /* function that gets called by the VPXDecoder when it has decoded a frame */
-  void* cb_user;                                                     /* internally used by the VPXDecoder */
+  VPXDecoder* decoder;                                               /* the decoder wrapper, only used by the decode thread */
+  vpx_read_cb cb_read;                                               /* function that gets called by update() with the frame to show */
+  void* cb_user;                                                     /* user data for cb_read */
 
   /* reading IVF */
-  FILE* fp;                                                          /* the file pointer of the currenet ivf file, see IVF::open() */
+  unsigned char* data;                                               /* the mapped ivf file */
+  size_t nbytes;                                                     /* size of the mapped file */
+  int fd;
   uint16_t width;                                                    /* width of the video */
   uint16_t height;                                                   /* height of the video */
   uint32_t rate;                                                     /* time base, rate: used in combination with the pts values (presentation time stamps) while playing back, a value like  90000 is used by the avconv util when converting a 29.97 fps video to ivf */
   uint32_t scale;                                                    /* time base, scale: probably something like 1  */
-  uint32_t num_frames;                                               /* number of frames in the ivf file.. might be 0 when the encoder doesn't store this value.. it's not used for playback */
-  unsigned char frame_hdr[IVF_FRAME_HDR_SIZE];                       /* each frame contains a small header */
-  unsigned char frame_data[256 * 1024];                              /* buffer for one frame */
+  uint32_t num_frames;                                               /* number of frames in the ivf file as stored in the header.. might be 0 when the encoder doesn't store this value, see frames.size() */
 };
 
+inline uint64_t IVFReader::frameMillis(size_t dx) {
+  return (frames[dx].pts * time_base) * 1000;
+}
+
+inline uint64_t IVFReader::decodedMillis(IVFDecodedFrame& f) {
+  return frameMillis(f.dx) + f.num_loops * loopDuration();
+}
+
 #endif
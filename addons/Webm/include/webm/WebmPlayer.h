@@ -0,0 +1,70 @@
+/*
+
+  WebmPlayer
+  ----------
+  Plays the video track of a webm file; the webm version of the IVFPlayer.
+  The WebmReader returns the packets (without copying them) which we pass
+  to the VPXDecoder in update(). All packets up to the current time are
+  decoded, also the ones we're too late for, because the decoder needs
+  all the inter frames. seek() continues at the closest keyframe before
+  the given time.
+
+*/
+#ifndef ROXLU_WEBM_PLAYER_H
+#define ROXLU_WEBM_PLAYER_H
+
+#include <webm/WebmReader.h>
+#include <webm/VPXDecoder.h>
+#include <videocapture/VideoCaptureGLSurface.h>
+
+#define WEBM_STATE_NONE 0
+#define WEBM_STATE_PLAY 1
+#define WEBM_STATE_PAUSE 2
+
+#define ERR_WEBMP_DECODER_SETUP "Cannot setup the VPX decoder for the webm file."
+#define ERR_WEBMP_NOT_OPEN "Cannot play; no webm file opened."
+#define ERR_WEBMP_ALREADY_PLAYING "Already playing."
+#define VERBOSE_WEBMP_ALREADY_PAUSED "We're already paused... not pausing again."
+
+void webm_player_read(unsigned char* pixels, size_t nbytes, void* user);
+
+class WebmPlayer {
+ public:
+  WebmPlayer();
+  ~WebmPlayer();
+  bool open(std::string filename, bool datapath = false);          /* open a webm file */
+  bool close();                                                    /* close the opened file */
+  void play();                                                     /* start playing */
+  void pause();                                                    /* pause playback */
+  void stop();                                                     /* stop playback and go to the begin */
+  bool seek(uint64_t millis);                                      /* continue playback at the keyframe at or before millis */
+  void update();                                                   /* call this repeatedly, it will update the frames */
+  void draw(int x, int y, int w = 0, int h = 0);                   /* draw ... */
+  int getWidth();                                                  /* returns the width of the video track */
+  int getHeight();                                                 /* returns the height of the video track */
+  double getDuration();                                            /* returns the duration in millis */
+
+ public:
+  WebmReader reader;
+  VPXDecoder* decoder;
+  VideoCaptureGLSurface gl_surface;
+  int state;
+  uint64_t time_started;                                           /* rx_millis() at the time the first packet must be shown */
+  uint64_t time_paused;
+  WebmReaderPacket packet;                                         /* the next packet we need to decode */
+  bool has_packet;                                                 /* true when `packet` is not decoded yet */
+};
+
+inline int WebmPlayer::getWidth() {
+  return reader.width;
+}
+
+inline int WebmPlayer::getHeight() {
+  return reader.height;
+}
+
+inline double WebmPlayer::getDuration() {
+  return reader.duration;
+}
+
+#endif
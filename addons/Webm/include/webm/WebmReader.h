@@ -0,0 +1,128 @@
+/*
+
+  WebmReader
+  ----------
+  Demuxer for webm files. The file is memory mapped and parsed
+  incrementally: open() only parses the headers (Info, Tracks) and
+  builds the seek index; readPacket() walks the clusters and returns
+  the next block of the video track. The packet data points directly
+  into the mapped file, so nothing is copied until the decoder gets it.
+
+  - The seek index contains the timecode and the position of every
+    cluster which starts with a keyframe. We build it from the Cues
+    element when the file has one (found directly or via the SeekHead),
+    else we do one pass over the clusters; this pass only reads the
+    element headers and skips the frame data.
+  - seek() does a binary search in the index and continues reading at
+    the found cluster, so decoding always starts at a keyframe.
+  - Laced blocks are not supported (libvpx/EBMLWriter never create them)
+    and are skipped.
+
+  Usage:
+  ````c++
+  WebmReader reader;
+  reader.open("video.webm", true);
+
+  WebmReaderPacket pkt;
+  while(reader.readPacket(pkt)) {
+    decoder.decodeFrame(pkt.data, pkt.nbytes);
+  }
+  ````
+
+*/
+#ifndef ROXLU_WEBM_READER_H
+#define ROXLU_WEBM_READER_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <webm/EBML.h>
+
+#define WEBM_READER_UNKNOWN_SIZE 0xFFFFFFFFFFFFFFFFULL                  /* size of elements with an unknown size (live streams, unfinished files) */
+
+#define ERR_WEBMR_OPEN "Cannot open: %s, error: %d (%s)"
+#define ERR_WEBMR_MMAP "Cannot map: %s, error: %d (%s)"
+#define ERR_WEBMR_ALREADY_OPEN "The WebmReader is already opened; close() first."
+#define ERR_WEBMR_NOT_OPEN "The WebmReader is not opened."
+#define ERR_WEBMR_NO_EBML "Not a webm file; no EBML header found."
+#define ERR_WEBMR_DOCTYPE "Unsupported doctype: %s"
+#define ERR_WEBMR_NO_SEGMENT "No segment found."
+#define ERR_WEBMR_NO_VIDEO "No video track found."
+#define ERR_WEBMR_CODEC "Unsupported video codec: %s, we only decode V_VP8"
+#define ERR_WEBMR_CORRUPT "Corrupt element at: %llu"
+#define ERR_WEBMR_LACING "Skipping laced block at: %llu; lacing is not supported."
+#define ERR_WEBMR_NO_INDEX "Cannot seek; the file has no keyframes in the index."
+
+struct WebmReaderPacket {
+  WebmReaderPacket();
+  unsigned char* data;                                                  /* points into the mapped file, valid until close() */
+  size_t nbytes;                                                        /* number of bytes in data */
+  uint64_t millis;                                                      /* presentation time in millis */
+  bool is_keyframe;                                                     /* true when we can start decoding at this frame */
+};
+
+struct WebmIndexEntry {
+  uint64_t millis;                                                      /* time of the first keyframe of the cluster */
+  uint64_t position;                                                    /* absolute position of the cluster in the file */
+  bool operator<(const WebmIndexEntry& other) const { return millis < other.millis; }
+};
+
+class WebmReader {
+ public:
+  WebmReader();
+  ~WebmReader();
+  bool open(std::string filename, bool datapath = false);               /* maps the file, parses the headers and builds the index */
+  bool close();                                                         /* unmaps the file; packets we returned become invalid */
+  bool readPacket(WebmReaderPacket& pkt);                               /* reads the next video packet; returns false at the end of the file */
+  bool seek(uint64_t millis, uint64_t* keyframeMillis = NULL);          /* continue reading at the last keyframe cluster at or before millis */
+  void rewind();                                                        /* continue reading at the first cluster */
+  void print();
+
+ private:
+  bool parseHeaders();                                                  /* EBML header, segment and the top level elements before the first cluster */
+  bool parseSeekHead(uint64_t pos, uint64_t end);
+  bool parseInfo(uint64_t pos, uint64_t end);
+  bool parseTracks(uint64_t pos, uint64_t end);
+  bool parseTrackEntry(uint64_t pos, uint64_t end);
+  bool parseCues(uint64_t pos, uint64_t end);
+  bool parseCuePoint(uint64_t pos, uint64_t end);
+  bool scanClusters();                                                  /* builds the index with one pass over the clusters when we have no cues */
+  bool readElement(uint64_t pos, uint64_t& id, uint64_t& size, uint64_t& dataPos);  /* reads the id and size of the element at pos; size can be WEBM_READER_UNKNOWN_SIZE */
+  uint64_t readUInt(uint64_t pos, uint64_t size);
+  double readFloat(uint64_t pos, uint64_t size);
+  std::string readString(uint64_t pos, uint64_t size);
+  uint64_t toMillis(uint64_t timecode);
+
+ public:
+  int width;                                                            /* width of the video track */
+  int height;                                                           /* height of the video track */
+  uint64_t video_track;                                                 /* track number of the video track */
+  std::string codec_id;                                                 /* codec of the video track, e.g. V_VP8 */
+  uint64_t timecode_scale;                                              /* nanoseconds per timecode tick */
+  double duration;                                                      /* duration in millis, 0 when unknown */
+  std::vector<WebmIndexEntry> index;                                    /* keyframe clusters sorted on time */
+
+ private:
+  unsigned char* data;                                                  /* the mapped file */
+  uint64_t nbytes;                                                      /* size of the mapped file */
+  int fd;
+  uint64_t segment_pos;                                                 /* absolute position of the segment data; cue and seek positions are relative to this */
+  uint64_t segment_end;                                                 /* end of the segment data */
+  uint64_t first_cluster_pos;                                           /* absolute position of the first cluster */
+  uint64_t cues_pos;                                                    /* absolute position of the Cues element, 0 when we don't have it */
+  uint64_t read_pos;                                                    /* position of the next element readPacket() parses */
+  uint64_t cluster_pos;                                                 /* absolute position of the cluster we're reading */
+  uint64_t cluster_timecode;                                            /* timecode of the cluster we're reading */
+};
+
+inline uint64_t WebmReader::toMillis(uint64_t timecode) {
+  return (timecode * timecode_scale) / 1000000ULL;
+}
+
+inline void WebmReader::rewind() {
+  read_pos = first_cluster_pos;
+  cluster_pos = 0;
+  cluster_timecode = 0;
+}
+
+#endif
@@ -0,0 +1,576 @@
+#include <webm/EBMLWriter.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+// -------------------------------------------------------------------------
+// Element encoding helpers; all write into the given scratch buffer and
+// return the number of bytes written.
+
+static size_t ebml_writer_put_id(uint64_t id, char* dest) {
+  int nbytes = 4;
+  if(id <= 0xFF) {
+    nbytes = 1;
+  }
+  else if(id <= 0xFFFF) {
+    nbytes = 2;
+  }
+  else if(id <= 0xFFFFFF) {
+    nbytes = 3;
+  }
+  for(int i = 0; i < nbytes; ++i) {
+    dest[i] = (id >> ((nbytes - 1 - i) * 8)) & 0xFF;
+  }
+  return nbytes;
+}
+
+// writes `size` as a vint using `nbytes` bytes (1-8)
+static size_t ebml_writer_put_size_fixed(uint64_t size, int nbytes, char* dest) {
+  for(int i = 0; i < nbytes; ++i) {
+    dest[i] = (size >> ((nbytes - 1 - i) * 8)) & 0xFF;
+  }
+  dest[0] |= (0x80 >> (nbytes - 1));
+  return nbytes;
+}
+
+// writes `size` as a vint using the minimum number of bytes; all bits set is reserved for "unknown"
+static size_t ebml_writer_put_size(uint64_t size, char* dest) {
+  int nbytes = 1;
+  while(nbytes < 8 && size >= ((uint64_t(1) << (7 * nbytes)) - 1)) {
+    ++nbytes;
+  }
+  return ebml_writer_put_size_fixed(size, nbytes, dest);
+}
+
+static void ebml_writer_append(std::vector<char>& dest, char* data, size_t nbytes) {
+  dest.insert(dest.end(), data, data + nbytes);
+}
+
+static void ebml_writer_element_header(std::vector<char>& dest, uint64_t id, uint64_t size) {
+  char tmp[16];
+  size_t n = ebml_writer_put_id(id, tmp);
+  n += ebml_writer_put_size(size, tmp + n);
+  ebml_writer_append(dest, tmp, n);
+}
+
+static void ebml_writer_uint(std::vector<char>& dest, uint64_t id, uint64_t v, int nbytes = 0) {
+  if(!nbytes) {
+    nbytes = 1;
+    while(nbytes < 8 && v >= (uint64_t(1) << (8 * nbytes))) {
+      ++nbytes;
+    }
+  }
+  char tmp[8];
+  for(int i = 0; i < nbytes; ++i) {
+    tmp[i] = (v >> ((nbytes - 1 - i) * 8)) & 0xFF;
+  }
+  ebml_writer_element_header(dest, id, nbytes);
+  ebml_writer_append(dest, tmp, nbytes);
+}
+
+static void ebml_writer_double(std::vector<char>& dest, uint64_t id, double v) {
+  uint64_t bits = 0;
+  memcpy((char*)&bits, (char*)&v, sizeof(bits));
+  ebml_writer_uint(dest, id, bits, 8);
+}
+
+static void ebml_writer_string(std::vector<char>& dest, uint64_t id, const std::string& str) {
+  ebml_writer_element_header(dest, id, str.size());
+  ebml_writer_append(dest, (char*)str.data(), str.size());
+}
+
+static void ebml_writer_master(std::vector<char>& dest, uint64_t id, std::vector<char>& children) {
+  ebml_writer_element_header(dest, id, children.size());
+  if(children.size()) {
+    ebml_writer_append(dest, &children[0], children.size());
+  }
+}
+
+// -------------------------------------------------------------------------
+
+EBMLWriterTrackTiming::EBMLWriterTrackTiming()
+  :last_timecode(0)
+  ,frame_duration(0)
+{
+}
+
+// -------------------------------------------------------------------------
+
+EBMLWriter::EBMLWriter()
+  :max_cluster_duration(EBML_WRITER_MAX_CLUSTER_DURATION)
+  ,cb_writev(NULL)
+  ,cb_pwrite(NULL)
+  ,cb_close(NULL)
+  ,cb_user(NULL)
+  ,is_open(false)
+  ,has_video(false)
+  ,bytes_written(0)
+  ,segment_size_pos(0)
+  ,segment_data_pos(0)
+  ,seek_head_pos(0)
+  ,duration_pos(0)
+  ,info_pos(0)
+  ,tracks_pos(0)
+  ,cues_pos(0)
+  ,cluster_pos(0)
+  ,cluster_timecode(0)
+  ,time_stream_started(0)
+  ,last_timecode(0)
+  ,last_frame_duration(0)
+  ,has_blocks(false)
+{
+}
+
+EBMLWriter::~EBMLWriter() {
+  if(is_open) {
+    close();
+  }
+}
+
+void EBMLWriter::setCallbacks(ebml_writev_cb writevCB,
+                              ebml_pwrite_cb pwriteCB,
+                              ebml_close_cb closeCB,
+                              void* user)
+{
+  cb_writev = writevCB;
+  cb_pwrite = pwriteCB;
+  cb_close = closeCB;
+  cb_user = user;
+}
+
+int EBMLWriter::open(EBMLHeader header, EBMLSegmentInfo info, std::vector<EBMLTrack> tracks) {
+  if(is_open) {
+    RX_ERROR(ERR_EBMLW_ALREADY_OPEN);
+    return 0;
+  }
+  if(!cb_writev) {
+    RX_ERROR(ERR_EBMLW_NO_CALLBACKS);
+    return 0;
+  }
+
+  is_open = true;
+  bytes_written = 0;
+  cues.clear();
+  has_blocks = false;
+  cluster_pos = 0;
+  last_timecode = 0;
+  last_frame_duration = 0;
+  track_timings.clear();
+
+  std::vector<char> children;
+  char tmp[16];
+
+  // ebml header
+  ebml_writer_uint(children, ID_EBML_VERSION, header.ebml_version);
+  ebml_writer_uint(children, ID_EBML_READ_VERSION, header.ebml_read_version);
+  ebml_writer_uint(children, ID_EBML_MAX_ID_LENGTH, header.ebml_max_id_length);
+  ebml_writer_uint(children, ID_EBML_MAX_SIZE_LENGTH, header.ebml_max_size_length);
+  ebml_writer_string(children, ID_DOCTYPE, header.doctype);
+  ebml_writer_uint(children, ID_DOCTYPE_VERSION, header.doctype_version);
+  ebml_writer_uint(children, ID_DOCTYPE_READ_VERSION, header.doctype_read_version);
+  ebml_writer_master(buffer, ID_EBML, children);
+  children.clear();
+
+  // segment with a reserved (unknown) size
+  ebml_writer_append(buffer, tmp, ebml_writer_put_id(ID_SEGMENT, tmp));
+  segment_size_pos = buffer.size();
+  ebml_writer_append(buffer, tmp, ebml_writer_put_size_fixed(EBML_DATA_SIZE_UNKNOWN, EBML_WRITER_UNKNOWN_SIZE_NBYTES, tmp));
+  segment_data_pos = buffer.size();
+
+  // reserve space for the seek head; we rewrite this on close()
+  seek_head_pos = buffer.size();
+  ebml_writer_element_header(buffer, ID_VOID, EBML_WRITER_SEEK_HEAD_SIZE - 2);
+  buffer.resize(seek_head_pos + EBML_WRITER_SEEK_HEAD_SIZE, 0);
+
+  // info
+  info_pos = buffer.size() - segment_data_pos;
+  ebml_writer_uint(children, ID_TIMECODE_SCALE, info.timecode_scale);
+  ebml_writer_string(children, ID_TITLE, info.title);
+  ebml_writer_string(children, ID_MUXING_APP, info.muxing_app);
+  ebml_writer_string(children, ID_WRITING_APP, info.writing_app);
+  size_t duration_offset = children.size();
+  ebml_writer_double(children, ID_DURATION, 0.0);
+  ebml_writer_element_header(buffer, ID_INFO, children.size());
+  duration_pos = buffer.size() + duration_offset + 3; // 2 bytes id + 1 byte size
+  ebml_writer_append(buffer, &children[0], children.size());
+  children.clear();
+
+  // tracks
+  has_video = false;
+  tracks_pos = buffer.size() - segment_data_pos;
+  for(std::vector<EBMLTrack>::iterator it = tracks.begin(); it != tracks.end(); ++it) {
+    EBMLTrack& tr = *it;
+    std::vector<char> entry;
+    ebml_writer_uint(entry, ID_TRACK_NUMBER, tr.number);
+    ebml_writer_uint(entry, ID_TRACK_UID, tr.uid);
+    ebml_writer_string(entry, ID_CODEC_ID, tr.codec_id);
+    ebml_writer_uint(entry, ID_TRACK_TYPE, tr.type);
+
+    if(tr.type == EBML_TRACK_TYPE_VIDEO) {
+      std::vector<char> video;
+      ebml_writer_uint(video, ID_PIXEL_WIDTH, tr.vid_pix_width);
+      ebml_writer_uint(video, ID_PIXEL_HEIGHT, tr.vid_pix_height);
+      ebml_writer_master(entry, ID_VIDEO, video);
+      has_video = true;
+    }
+
+    ebml_writer_master(children, ID_TRACK_ENTRY, entry);
+  }
+  ebml_writer_master(buffer, ID_TRACKS, children);
+
+  // the positions above are relative to the buffer which starts at 0
+  segment_size_pos += bytes_written;
+  segment_data_pos += bytes_written;
+  seek_head_pos += bytes_written;
+  duration_pos += bytes_written;
+
+  return (writeBuffer(buffer) > 0) ? 1 : 0;
+}
+
+int EBMLWriter::addSimpleBlock(EBMLSimpleBlock b) {
+  if(!is_open) {
+    RX_ERROR(ERR_EBMLW_NOT_OPEN);
+    return 0;
+  }
+
+  if(!has_blocks) {
+    time_stream_started = b.timestamp;
+    has_blocks = true;
+  }
+
+  uint64_t timecode = (b.timestamp > time_stream_started) ? (b.timestamp - time_stream_started) : 0;
+  int64_t relative = int64_t(timecode) - int64_t(cluster_timecode);
+  bool is_keyframe = (b.flags & 0x80) == 0x80;
+  bool can_start_cluster = is_keyframe || !has_video;
+
+  if(!cluster_pos
+     || (can_start_cluster && relative >= int64_t(max_cluster_duration))
+     || relative > 32767
+     || relative < -32768)
+  {
+    if(!openCluster(timecode)) {
+      return 0;
+    }
+    relative = 0;
+
+    // cue points are stored for clusters which start with a keyframe
+    if(is_keyframe) {
+      EBMLCuePoint cue;
+      cue.timecode = timecode;
+      cue.track_number = b.track_number;
+      cue.cluster_position = cluster_pos - segment_data_pos;
+      cues.push_back(cue);
+    }
+  }
+
+  // simple block header: id, size, track number (vint, 2 bytes from 127), relative timecode, flags
+  char track_vint[8];
+  size_t track_nbytes = ebml_writer_put_size(b.track_number, track_vint);
+  uint64_t data_size = track_nbytes + 2 + 1 + b.nbytes;
+  size_t n = ebml_writer_put_id(ID_SIMPLE_BLOCK, block_header);
+  n += ebml_writer_put_size(data_size, block_header + n);
+  memcpy(block_header + n, track_vint, track_nbytes);
+  n += track_nbytes;
+  block_header[n++] = (relative >> 8) & 0xFF;
+  block_header[n++] = relative & 0xFF;
+  block_header[n++] = b.flags;
+
+  EBMLIOVec vecs[2];
+  vecs[0].data = block_header;
+  vecs[0].nbytes = n;
+  vecs[1].data = b.data;
+  vecs[1].nbytes = b.nbytes;
+
+  // we don't know how long the last block lasts so we use the frame duration of its track
+  std::map<unsigned char, EBMLWriterTrackTiming>::iterator it = track_timings.find(b.track_number);
+  if(it == track_timings.end()) {
+    it = track_timings.insert(std::pair<unsigned char, EBMLWriterTrackTiming>(b.track_number, EBMLWriterTrackTiming())).first;
+  }
+  else if(timecode > it->second.last_timecode) {
+    it->second.frame_duration = timecode - it->second.last_timecode;
+  }
+  it->second.last_timecode = timecode;
+
+  if(timecode >= last_timecode) {
+    last_timecode = timecode;
+    last_frame_duration = it->second.frame_duration;
+  }
+
+  return (writev(vecs, 2) == (n + b.nbytes)) ? 1 : 0;
+}
+
+bool EBMLWriter::openCluster(uint64_t timecode) {
+  closeCluster();
+
+  char tmp[32];
+  size_t n = ebml_writer_put_id(ID_CLUSTER, tmp);
+  n += ebml_writer_put_size_fixed(EBML_DATA_SIZE_UNKNOWN, EBML_WRITER_UNKNOWN_SIZE_NBYTES, tmp + n);
+
+  // timecode element
+  int nbytes = 1;
+  while(nbytes < 8 && timecode >= (uint64_t(1) << (8 * nbytes))) {
+    ++nbytes;
+  }
+  n += ebml_writer_put_id(ID_TIMECODE, tmp + n);
+  n += ebml_writer_put_size(nbytes, tmp + n);
+  for(int i = 0; i < nbytes; ++i) {
+    tmp[n++] = (timecode >> ((nbytes - 1 - i) * 8)) & 0xFF;
+  }
+
+  cluster_pos = bytes_written;
+  cluster_timecode = timecode;
+
+  EBMLIOVec vec;
+  vec.data = tmp;
+  vec.nbytes = n;
+  return writev(&vec, 1) == n;
+}
+
+bool EBMLWriter::closeCluster() {
+  if(!cluster_pos) {
+    return true;
+  }
+
+  uint64_t data_pos = cluster_pos + 4 + EBML_WRITER_UNKNOWN_SIZE_NBYTES;
+  uint64_t size = bytes_written - data_pos;
+  uint64_t pos = cluster_pos + 4;
+  cluster_pos = 0;
+
+  if(!cb_pwrite) {
+    return true; // not seekable, keep the unknown size
+  }
+
+  char tmp[EBML_WRITER_UNKNOWN_SIZE_NBYTES];
+  ebml_writer_put_size_fixed(size, EBML_WRITER_UNKNOWN_SIZE_NBYTES, tmp);
+  return cb_pwrite(tmp, EBML_WRITER_UNKNOWN_SIZE_NBYTES, pos, cb_user);
+}
+
+bool EBMLWriter::writeCues() {
+  if(!cues.size()) {
+    cues_pos = 0;
+    return true;
+  }
+
+  std::vector<char> children;
+  for(std::vector<EBMLCuePoint>::iterator it = cues.begin(); it != cues.end(); ++it) {
+    EBMLCuePoint& cue = *it;
+    std::vector<char> point;
+    std::vector<char> positions;
+
+    ebml_writer_uint(positions, ID_CUE_TRACK, cue.track_number);
+    ebml_writer_uint(positions, ID_CUE_CLUSTER_POSITION, cue.cluster_position);
+
+    ebml_writer_uint(point, ID_CUE_TIME, cue.timecode);
+    ebml_writer_master(point, ID_CUE_TRACK_POSITIONS, positions);
+
+    ebml_writer_master(children, ID_CUE_POINT, point);
+  }
+
+  cues_pos = bytes_written - segment_data_pos;
+  ebml_writer_master(buffer, ID_CUES, children);
+  return writeBuffer(buffer) > 0;
+}
+
+// Writes the seek head into the Void element we reserved in open(); the seek
+// positions are written with 8 bytes so the size of the seek head is fixed.
+bool EBMLWriter::writeSeekHead() {
+  uint64_t ids[3] = { ID_INFO, ID_TRACKS, ID_CUES };
+  uint64_t positions[3] = { info_pos, tracks_pos, cues_pos };
+  int num = (cues_pos) ? 3 : 2;
+
+  std::vector<char> children;
+  for(int i = 0; i < num; ++i) {
+    std::vector<char> seek;
+    char tmp[8];
+    size_t n = ebml_writer_put_id(ids[i], tmp);
+    ebml_writer_element_header(seek, ID_SEEK_ID, n);
+    ebml_writer_append(seek, tmp, n);
+    ebml_writer_uint(seek, ID_SEEK_POSITION, positions[i], 8);
+    ebml_writer_master(children, ID_SEEK, seek);
+  }
+
+  std::vector<char> seek_head;
+  ebml_writer_master(seek_head, ID_SEEK_HEAD, children);
+
+  // fill the rest with a void element
+  size_t left = EBML_WRITER_SEEK_HEAD_SIZE - seek_head.size();
+  if(left < 2) {
+    RX_ERROR("The reserved seek head space is too small.");
+    return false;
+  }
+  ebml_writer_element_header(seek_head, ID_VOID, left - 2);
+  seek_head.resize(EBML_WRITER_SEEK_HEAD_SIZE, 0);
+
+  return cb_pwrite(&seek_head[0], seek_head.size(), seek_head_pos, cb_user);
+}
+
+int EBMLWriter::close() {
+  if(!is_open) {
+    RX_ERROR(ERR_EBMLW_NOT_OPEN);
+    return 0;
+  }
+
+  closeCluster();
+  writeCues();
+
+  if(cb_pwrite) {
+    writeSeekHead();
+
+    // duration (float, big endian)
+    char tmp[8];
+    double duration = double(last_timecode + last_frame_duration);
+    uint64_t bits = 0;
+    memcpy((char*)&bits, (char*)&duration, sizeof(bits));
+    for(int i = 0; i < 8; ++i) {
+      tmp[i] = (bits >> ((7 - i) * 8)) & 0xFF;
+    }
+    cb_pwrite(tmp, 8, duration_pos, cb_user);
+
+    // segment size
+    ebml_writer_put_size_fixed(bytes_written - segment_data_pos, EBML_WRITER_UNKNOWN_SIZE_NBYTES, tmp);
+    cb_pwrite(tmp, EBML_WRITER_UNKNOWN_SIZE_NBYTES, segment_size_pos, cb_user);
+  }
+
+  if(cb_close) {
+    cb_close(cb_user);
+  }
+
+  is_open = false;
+  has_blocks = false;
+  cues.clear();
+  buffer.clear();
+  return 1;
+}
+
+size_t EBMLWriter::writev(EBMLIOVec* vecs, int nvecs) {
+  size_t total = 0;
+  for(int i = 0; i < nvecs; ++i) {
+    total += vecs[i].nbytes;
+  }
+
+  size_t written = cb_writev(vecs, nvecs, cb_user);
+  if(written != total) {
+    RX_ERROR(ERR_EBMLW_WRITE, written, total);
+  }
+
+  bytes_written += written;
+  return written;
+}
+
+size_t EBMLWriter::writeBuffer(std::vector<char>& buf) {
+  if(!buf.size()) {
+    return 0;
+  }
+
+  EBMLIOVec vec;
+  vec.data = &buf[0];
+  vec.nbytes = buf.size();
+
+  size_t n = writev(&vec, 1);
+  buf.clear();
+  return n;
+}
+
+// -------------------------------------------------------------------------
+
+EBMLWriterFile::EBMLWriterFile()
+  :fd(-1)
+{
+}
+
+EBMLWriterFile::~EBMLWriterFile() {
+  if(fd >= 0) {
+    ::close(fd);
+    fd = -1;
+  }
+}
+
+bool EBMLWriterFile::open(const std::string filepath) {
+  fd = ::open(filepath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if(fd < 0) {
+    RX_ERROR(ERR_EBMLW_FILE_OPEN, filepath.c_str(), errno, strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+size_t ebml_writer_file_writev(EBMLIOVec* vecs, int nvecs, void* user) {
+  EBMLWriterFile* f = static_cast<EBMLWriterFile*>(user);
+  if(f->fd < 0) {
+    RX_ERROR(ERR_EBMLW_FILE_NOT_OPEN);
+    return 0;
+  }
+  if(nvecs > EBML_WRITER_MAX_IOVECS) {
+    RX_ERROR(ERR_EBMLW_TOO_MANY_VECS, nvecs);
+    return 0;
+  }
+
+  struct iovec iov[EBML_WRITER_MAX_IOVECS];
+  for(int i = 0; i < nvecs; ++i) {
+    iov[i].iov_base = vecs[i].data;
+    iov[i].iov_len = vecs[i].nbytes;
+  }
+
+  // writev() may write less than we asked for
+  struct iovec* curr = iov;
+  int left = nvecs;
+  size_t written = 0;
+
+  while(left > 0) {
+    ssize_t r = ::writev(f->fd, curr, left);
+    if(r < 0) {
+      if(errno == EINTR) {
+        continue;
+      }
+      RX_ERROR(ERR_EBMLW_FILE_WRITE, errno, strerror(errno));
+      return written;
+    }
+
+    written += r;
+    while(left > 0 && size_t(r) >= curr->iov_len) {
+      r -= curr->iov_len;
+      ++curr;
+      --left;
+    }
+    if(left > 0) {
+      curr->iov_base = (char*)curr->iov_base + r;
+      curr->iov_len -= r;
+    }
+  }
+
+  return written;
+}
+
+bool ebml_writer_file_pwrite(char* data, size_t nbytes, uint64_t pos, void* user) {
+  EBMLWriterFile* f = static_cast<EBMLWriterFile*>(user);
+  if(f->fd < 0) {
+    RX_ERROR(ERR_EBMLW_FILE_NOT_OPEN);
+    return false;
+  }
+
+  size_t written = 0;
+  while(written < nbytes) {
+    ssize_t r = ::pwrite(f->fd, data + written, nbytes - written, pos + written);
+    if(r < 0) {
+      if(errno == EINTR) {
+        continue;
+      }
+      RX_ERROR(ERR_EBMLW_FILE_WRITE, errno, strerror(errno));
+      return false;
+    }
+    written += r;
+  }
+
+  return true;
+}
+
+void ebml_writer_file_close(void* user) {
+  EBMLWriterFile* f = static_cast<EBMLWriterFile*>(user);
+  if(f->fd < 0) {
+    RX_WARNING("already closed.");
+    return;
+  }
+
+  ::close(f->fd);
+  f->fd = -1;
+}
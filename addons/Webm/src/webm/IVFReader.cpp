@@ -1,44 +1,85 @@
 #include <assert.h>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <roxlu/core/Log.h>
 #include <webm/IVFReader.h>
 
 
 IVFFrame::IVFFrame()
-  :pts(0)
-  ,offset(0)
-  ,millis(0)
+  :offset(0)
+  ,pts(0)
   ,size(0)
+  ,is_keyframe(false)
 {
 }
 
+IVFDecodedFrame::IVFDecodedFrame()
+  :nbytes(0)
+  ,dx(0)
+  ,num_loops(0)
+{
+}
+
+// --------------------------------------------------
+
+void ivf_reader_decode_thread(void* user) {
+  IVFReader* ivf = static_cast<IVFReader*>(user);
+  ivf->decode();
+}
+
+void ivf_reader_on_decoded(unsigned char* pixels, size_t nbytes, void* user) {
+  IVFReader* ivf = static_cast<IVFReader*>(user);
+  ivf->onDecoded(pixels, nbytes);
+}
+
 // --------------------------------------------------
 
 IVFReader::IVFReader(vpx_read_cb readCB, void* readUser)
   :state(IVF_STATE_NONE)
   ,time_started(0)
+  ,time_paused(0)
   ,time_base(0)
-  ,frame_dx(0)
-  ,last_frame_dx(-1)
-  ,rbuffer(1024 * 1024 * 5)
-  ,num_frames_to_buffer(300)
-  ,num_read_frames(0)
-  ,fp(NULL)
+  ,loop(false)
+  ,decoded_read_dx(0)
+  ,num_decoded(0)
+  ,num_decoded_frames(IVF_DEFAULT_NUM_DECODED_FRAMES)
+  ,must_stop(false)
+  ,is_decode_finished(false)
+  ,seek_dx(-1)
+  ,generation(0)
+  ,decode_generation(0)
+  ,decode_dx(0)
+  ,decode_loops(0)
+  ,decode_visible(false)
+  ,decoder(NULL)
+  ,cb_read(readCB)
+  ,cb_user(readUser)
+  ,data(NULL)
+  ,nbytes(0)
+  ,fd(-1)
   ,width(0)
   ,height(0)
   ,rate(0)
   ,scale(0)
-  ,cb_read(readCB)
-  ,cb_user(readUser)
-  ,decoder(NULL)
+  ,num_frames(0)
 {
+  uv_mutex_init(&mutex);
+  uv_cond_init(&cond);
 }
 
 IVFReader::~IVFReader() {
-  shutdown();
+  if(data) {
+    shutdown();
+  }
+  uv_mutex_destroy(&mutex);
+  uv_cond_destroy(&cond);
 }
 
 bool IVFReader::open(std::string filename, bool datapath) {
-  if(fp) {
+  if(data) {
     RX_ERROR(IVF_ERR_ALREADY_OPEN);
     return false;
   }
@@ -46,50 +87,116 @@ bool IVFReader::open(std::string filename, bool datapath) {
   if(datapath) {
     filename = rx_to_data_path(filename);
   }
- 
-  fp = fopen(filename.c_str(), "rb");
 
-  if(!fp) {
+  fd = ::open(filename.c_str(), O_RDONLY);
+  if(fd < 0) {
     RX_ERROR(IVF_ERR_FOPEN, filename.c_str());
-    fp = NULL;
     return false;
   }
 
+  struct stat st;
+  if(fstat(fd, &st) != 0 || st.st_size < IVF_FILE_HDR_SIZE) {
+    RX_ERROR(IVF_ERR_READ_HEADER);
+    ::close(fd);
+    fd = -1;
+    return false;
+  }
+
+  void* ptr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if(ptr == MAP_FAILED) {
+    RX_ERROR(IVF_ERR_MMAP, filename.c_str());
+    ::close(fd);
+    fd = -1;
+    return false;
+  }
+
+  data = (unsigned char*)ptr;
+  nbytes = st.st_size;
+
   if(!readHeader()) {
+    shutdown();
+    return false;
+  }
+
+  VPXSettings cfg;
+  cfg.in_w = width;
+  cfg.in_h = height;
+  cfg.out_w = width;
+  cfg.out_h = height;
+  cfg.fps = 30; // @todo
+  cfg.cb_read = ivf_reader_on_decoded;
+  cfg.cb_user = this;
+
+  decoder = new VPXDecoder();
+
+  if(!decoder->setup(cfg)) {
+    RX_ERROR(IVF_ERR_DECODER_SETUP);
+    shutdown();
     return false;
   }
 
+  decoded.clear();
+  decoded.resize(num_decoded_frames);
+  decoded_read_dx = 0;
+  num_decoded = 0;
+  must_stop = false;
+  is_decode_finished = false;
+  seek_dx = 0;
+
+  // start decoding the first frames so play() starts immediately
+  uv_thread_create(&thread, ivf_reader_decode_thread, this);
+
   return true;
 }
 
+// The decoded frames store their frame index and loop count instead of a time,
+// so they are shown at the new rate too. We rescale the playback clock so we
+// continue at the current frame.
 void IVFReader::setFPS(double fps) {
   double fps_millis = 1.0/fps;
-  time_base = (fps_millis / 30000.0); // we assume you used avconv to create the ivf file
+  double new_time_base = (fps_millis / 30000.0); // we assume you used avconv to create the ivf file
+
+  uv_mutex_lock(&mutex);
+  {
+    if(state != IVF_STATE_NONE && time_base > 0.0) {
+      uint64_t now = (state == IVF_STATE_PAUSE) ? time_paused : rx_millis();
+      uint64_t time_playing = (now - time_started) * (new_time_base / time_base);
+      time_started = now - time_playing;
+    }
+    time_base = new_time_base;
+  }
+  uv_mutex_unlock(&mutex);
 }
 
-bool IVFReader::readHeader() {
-  if(!fp) {
-    RX_ERROR(IVF_ERR_HDR_FILE);
-    return false;
+void IVFReader::setLoop(bool l) {
+  uv_mutex_lock(&mutex);
+  {
+    loop = l;
+    uv_cond_signal(&cond);
   }
+  uv_mutex_unlock(&mutex);
+}
 
-  if(fseek(fp, 0, SEEK_SET) != 0) {
-    RX_ERROR(IVF_ERR_HDR_SEEK);
+bool IVFReader::setNumDecodedFrames(int num) {
+  if(num < 2) {
+    RX_ERROR(IVF_ERR_NUM_DECODED_FRAMES, num);
     return false;
   }
-
-  unsigned char file_hdr[IVF_FILE_HDR_SIZE];
-  if(!(fread(file_hdr, 1, IVF_FILE_HDR_SIZE, fp) == IVF_FILE_HDR_SIZE)) {
-    RX_ERROR(IVF_ERR_READ_HEADER);
-    fclose(fp);
-    fp = NULL;
+  if(data) {
+    RX_ERROR(IVF_ERR_ALREADY_OPEN);
     return false;
   }
+  num_decoded_frames = num;
+  return true;
+}
+
+// Parses the file header and walks over all frame headers to create the index.
+// We only touch the headers, the frame data is read by the decode thread.
+bool IVFReader::readHeader() {
+  unsigned char* file_hdr = data;
 
   if(file_hdr[0] != 'D' || file_hdr[1] != 'K' || file_hdr[2] != 'I' || file_hdr[3] != 'F') {
     RX_ERROR(IVF_ERR_INVALID_FILE);
-    fclose(fp);
-    fp = NULL;
     return false;
   }
 
@@ -98,8 +205,6 @@ bool IVFReader::readHeader() {
 
   if(!width || !height) {
     RX_ERROR(IVF_ERR_INVALID_SIZE, width, height);
-    fclose(fp);
-    fp = NULL;
     return false;
   }
 
@@ -111,30 +216,33 @@ bool IVFReader::readHeader() {
     time_base = double(scale)/rate;
   }
 
-  if(decoder) {
-    delete decoder;
-    decoder = NULL;
-  }
+  uint16_t hdr_size = rx_get_le_u16(file_hdr+6);
+  size_t pos = (hdr_size >= IVF_FILE_HDR_SIZE) ? hdr_size : IVF_FILE_HDR_SIZE;
 
-  VPXSettings cfg;
-  cfg.in_w = width;
-  cfg.in_h = height;
-  cfg.out_w = width;
-  cfg.out_h = height;
-  cfg.fps = 30; // @todo 
-  cfg.cb_read = cb_read;
-  cfg.cb_user = cb_user;
+  frames.clear();
+  frames.reserve(num_frames);
 
-  decoder = new VPXDecoder();
+  while(pos + IVF_FRAME_HDR_SIZE <= nbytes) {
+    IVFFrame frame;
+    frame.size = rx_get_le_u32(data + pos);
+    frame.pts = rx_get_le_u64(data + pos + 4);
+    frame.offset = pos + IVF_FRAME_HDR_SIZE;
 
-  if(!decoder->setup(cfg)) {
-    RX_ERROR(IVF_ERR_DECODER_SETUP);
-    return false;
-  }
+    if(frame.offset + frame.size > nbytes) {
+      RX_WARNING(IVF_ERR_FRAME_TRUNCATED, frames.size());
+      break;
+    }
 
+    // VP8 frame tag: bit 0 is 0 for keyframes
+    frame.is_keyframe = frame.size && (data[frame.offset] & 0x01) == 0;
+    frames.push_back(frame);
 
-  if(num_frames > num_frames_to_buffer) {
-    num_frames_to_buffer = num_frames;
+    pos = frame.offset + frame.size;
+  }
+
+  if(!frames.size()) {
+    RX_ERROR(IVF_ERR_NO_FRAMES);
+    return false;
   }
 
   return true;
@@ -145,28 +253,45 @@ bool IVFReader::close() {
 }
 
 bool IVFReader::shutdown() {
-  if(!fp) {
+  if(!data) {
     RX_ERROR(IVF_ERR_CLOSE);
     return false;
   }
 
+  // decode thread
+  if(decoder) {
+    uv_mutex_lock(&mutex);
+    {
+      must_stop = true;
+      uv_cond_signal(&cond);
+    }
+    uv_mutex_unlock(&mutex);
+    uv_thread_join(&thread);
+  }
+
   // playback
   state = IVF_STATE_NONE;
   time_started = 0;
+  time_paused = 0;
   time_base = 0;
-  frame_dx = 0;
-  last_frame_dx = -1;
 
   // buffer
-  rbuffer.reset();
-  num_frames_to_buffer = 0;
-  num_read_frames = 0;
+  decoded.clear();
+  decoded_read_dx = 0;
+  num_decoded = 0;
+  must_stop = false;
+  is_decode_finished = false;
+  seek_dx = -1;
   frames.clear();
 
   /* reading */
-  if(fp) {
-    fclose(fp);
-    fp = NULL;
+  munmap(data, nbytes);
+  data = NULL;
+  nbytes = 0;
+
+  if(fd >= 0) {
+    ::close(fd);
+    fd = -1;
   }
 
   width = 0;
@@ -184,127 +309,156 @@ bool IVFReader::shutdown() {
   return true;
 }
 
-void IVFReader::update() {
-  if(state != IVF_STATE_PLAY) {
-    return ;
-  }
-
-  // Make sure the buffer contains at least "num_frames_to_buffer"
-  updateBuffer();
+// Decode thread: decodes the frames in order as long as there is space in the
+// ring. A seek request (seek_dx) makes us continue at the keyframe before it.
+void IVFReader::decode() {
+  size_t dx = 0;                  /* next frame we decode */
+  size_t visible_dx = 0;          /* first frame after a seek we show */
+  uint64_t num_loops = 0;         /* number of times we started again at the first frame */
+
+  while(true) {
+
+    uv_mutex_lock(&mutex);
+    {
+      while(!must_stop && seek_dx < 0 && (num_decoded == decoded.size() || (dx >= frames.size() && !loop))) {
+        if(dx >= frames.size() && !loop) {
+          is_decode_finished = true;
+        }
+        uv_cond_wait(&cond, &mutex);
+      }
+
+      if(must_stop) {
+        uv_mutex_unlock(&mutex);
+        break;
+      }
+
+      if(seek_dx >= 0) {
+        visible_dx = seek_dx;
+        dx = seek_dx;
+        while(dx > 0 && !frames[dx].is_keyframe) {
+          --dx;
+        }
+        num_loops = 0;
+        seek_dx = -1;
+        is_decode_finished = false;
+      }
+
+      if(dx >= frames.size()) {
+        dx = 0;
+        visible_dx = 0;
+        ++num_loops;
+      }
+
+      decode_generation = generation;
+      decode_visible = dx >= visible_dx;
+      decode_dx = dx;
+      decode_loops = num_loops;
+    }
+    uv_mutex_unlock(&mutex);
 
-  if(!frames.size()) {
-    return;
+    // ivf_reader_on_decoded() is called from here
+    IVFFrame& frame = frames[dx];
+    decoder->decodeFrame(data + frame.offset, frame.size);
+    ++dx;
   }
+}
 
-  if(frame_dx >= frames.size()) {
-    return;
-  }
+// Called on the decode thread. The slot we write into is not visible for
+// update() until we increment num_decoded, so we copy without holding the lock.
+void IVFReader::onDecoded(unsigned char* pixels, size_t nbytes) {
+  size_t write_dx = 0;
 
-  // Find the frame that we need to display
-  uint64_t now = rx_millis();
-  uint64_t time_playing = now - time_started;
-  size_t start_dx = frame_dx;
-  size_t use_frame = frame_dx;
-
-  do {
-    IVFFrame& frame = frames[frame_dx];
-  
-    if(frame.millis > time_playing)  {
-      break;
+  uv_mutex_lock(&mutex);
+  {
+    if(!decode_visible || decode_generation != generation || num_decoded == decoded.size()) {
+      uv_mutex_unlock(&mutex);
+      return;
     }
-    
-    use_frame = frame_dx;
-    frame_dx++;
-
-  } while(frame_dx < frames.size()-1);
-
-  // only process new frames (when update() is called to quickly this makes sure we don't do any unnessary processing)
-  if(last_frame_dx >= 0 && use_frame <= last_frame_dx) {
-    return;
+    write_dx = (decoded_read_dx + num_decoded) % decoded.size();
   }
+  uv_mutex_unlock(&mutex);
 
-  // we must process all the frames, even if they're not all shown (this is necessary so the decoder gets the key + inter frames)
-  for(size_t i = last_frame_dx + 1; i <= use_frame; ++i) {
-    IVFFrame& f = frames[i];
-    size_t read = rbuffer.read((char*)frame_data, f.size); 
-
-    decoder->decodeFrame(frame_data, f.size);
-
-    if(num_read_frames > 0) {
-      num_read_frames--;
+  IVFDecodedFrame& f = decoded[write_dx];
+  if(f.pixels.size() < nbytes) {
+    f.pixels.resize(nbytes);
+  }
+  memcpy(&f.pixels[0], pixels, nbytes);
+  f.nbytes = nbytes;
+  f.dx = decode_dx;
+  f.num_loops = decode_loops;
+
+  uv_mutex_lock(&mutex);
+  {
+    // a seek() flushed the ring while we were copying
+    if(decode_generation == generation) {
+      ++num_decoded;
     }
   }
+  uv_mutex_unlock(&mutex);
+}
 
-  // remove all read frames
-  for(size_t i = 0; i < use_frame; ++i) {
-    frames.erase(frames.begin());
-    frame_dx--;
-    use_frame--;
+void IVFReader::update() {
+  if(state != IVF_STATE_PLAY) {
+    return ;
   }
 
-  if(frames.size() == 1) {
-    stop();
-  }
-  
-  last_frame_dx = use_frame;
-}
+  uint64_t time_playing = rx_millis() - time_started;
+  size_t num_ready = 0;
+  size_t show_dx = 0;
+  bool finished = false;
 
-void IVFReader::updateBuffer() {
-  while(num_read_frames < num_frames_to_buffer) {
-    if(!readFrame()) {
-      num_frames_to_buffer = 0; // makes sure we stop looping when we reached the end of the file or an error occured
+  uv_mutex_lock(&mutex);
+  {
+    while(num_ready < num_decoded && decodedMillis(decoded[(decoded_read_dx + num_ready) % decoded.size()]) <= time_playing) {
+      ++num_ready;
     }
-  }
-}
 
-bool IVFReader::readFrame() {
-  assert(width);
-  assert(height);
-  assert(fp);
+    // we only show the newest frame; drop the ones we're too late for
+    if(num_ready > 1) {
+      decoded_read_dx = (decoded_read_dx + num_ready - 1) % decoded.size();
+      num_decoded -= num_ready - 1;
+      uv_cond_signal(&cond);
+    }
 
-  if(state != IVF_STATE_PLAY) {
-    RX_ERROR(IVF_ERR_FRAME_STATE);
-    return false;
+    show_dx = decoded_read_dx;
+    finished = !num_decoded && is_decode_finished;
   }
+  uv_mutex_unlock(&mutex);
 
-  if((fread(frame_hdr, 1, IVF_FRAME_HDR_SIZE, fp)) != IVF_FRAME_HDR_SIZE) {
-    RX_ERROR(IVF_ERR_FRAME_READ_HDR);
-    return false;
+  if(finished) {
+    stop();
+    return;
   }
 
-  int frame_size = rx_get_le_u16(frame_hdr);
-  if(frame_size > sizeof(frame_data)) {
-    RX_ERROR(IVF_ERR_FRAME_TOO_BIG);
-    return false;
+  if(!num_ready) {
+    return;
   }
 
-  uint64_t pts = rx_get_le_u64(frame_hdr + 4);
-
-  if((fread(frame_data, 1, frame_size, fp)) != frame_size) {
-    RX_ERROR(IVF_ERR_READ_FRAME);
-    return false;
+  // the decode thread doesn't touch this frame until we release it below
+  IVFDecodedFrame& f = decoded[show_dx];
+  if(cb_read) {
+    cb_read(&f.pixels[0], f.nbytes, cb_user);
   }
 
-  IVFFrame frame;
-  frame.offset = rbuffer.getWriteIndex();
-  frame.pts = pts;
-  frame.size = frame_size;
-  frame.millis = (pts * time_base) * 1000;
-  frames.push_back(frame);
-
-  rbuffer.write((char*)frame_data, frame_size);
-
-  ++num_read_frames;
-  return true;
+  uv_mutex_lock(&mutex);
+  {
+    decoded_read_dx = (decoded_read_dx + 1) % decoded.size();
+    num_decoded--;
+    uv_cond_signal(&cond);
+  }
+  uv_mutex_unlock(&mutex);
 }
 
 void IVFReader::play() {
+  if(!data) {
+    RX_ERROR(IVF_ERR_NOT_OPEN);
+    return;
+  }
 
   if(state == IVF_STATE_PAUSE) {
     state = IVF_STATE_PLAY;
-    time_started = time_started + (rx_millis() - time_paused); 
+    time_started = time_started + (rx_millis() - time_paused);
     return;
-
   }
 
   if(state == IVF_STATE_PLAY) {
@@ -312,20 +466,16 @@ void IVFReader::play() {
     return;
   }
 
-  reset();
+  // after open() and stop() the decode thread is already decoding the first frames
   state = IVF_STATE_PLAY;
-
-  updateBuffer(); // make sure we have some raw/encoded frames in the buffer
-
   time_started = rx_millis();
 }
 
 void IVFReader::stop() {
   state = IVF_STATE_NONE;
-  frames.clear();
-  rbuffer.reset();
-  reset();
-  readHeader(); 
+  if(data) {
+    restart(0);
+  }
 }
 
 void IVFReader::pause() {
@@ -339,12 +489,62 @@ void IVFReader::pause() {
   time_paused = rx_millis();
 }
 
-void IVFReader::reset() {
-  time_started = 0;
-  frame_dx = 0;
-  last_frame_dx = -1;
-  num_frames_to_buffer = 300;
-  num_read_frames = 0;
+bool IVFReader::seek(uint64_t millis) {
+  if(!data) {
+    RX_ERROR(IVF_ERR_NOT_OPEN);
+    return false;
+  }
+
+  size_t dx = findFrame(millis);
+  restart(dx);
+
+  // the clock continues at the frame we seeked to; when we're stopped
+  // we pause so the next play() starts at this frame too
+  uint64_t now = rx_millis();
+  time_started = now - frameMillis(dx);
+  time_paused = now;
+  if(state == IVF_STATE_NONE) {
+    state = IVF_STATE_PAUSE;
+  }
+  return true;
+}
+
+void IVFReader::restart(size_t dx) {
+  uv_mutex_lock(&mutex);
+  {
+    ++generation;
+    seek_dx = dx;
+    decoded_read_dx = 0;
+    num_decoded = 0;
+    is_decode_finished = false;
+    uv_cond_signal(&cond);
+  }
+  uv_mutex_unlock(&mutex);
+}
+
+size_t IVFReader::findFrame(uint64_t millis) {
+  size_t lo = 0;
+  size_t hi = frames.size();
+  while(lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if(frameMillis(mid) <= millis) {
+      lo = mid + 1;
+    }
+    else {
+      hi = mid;
+    }
+  }
+  return (lo > 0) ? lo - 1 : 0;
+}
+
+uint64_t IVFReader::loopDuration() {
+  size_t n = frames.size();
+  uint64_t last = frameMillis(n - 1);
+  if(n < 2) {
+    return last + 1;
+  }
+  uint64_t first = frameMillis(0);
+  return last + ((last - first) / (n - 1));
 }
 
 void IVFReader::print() {
@@ -353,6 +553,6 @@ void IVFReader::print() {
   RX_VERBOSE("ivf.rate: %d", rate);
   RX_VERBOSE("ivf.scale: %d", scale);
   RX_VERBOSE("ivf.num_frames: %d", num_frames);
+  RX_VERBOSE("ivf.num_indexed_frames: %ld", frames.size());
   RX_VERBOSE("ivf.time_base: %f", time_base);
-
 }
@@ -0,0 +1,148 @@
+#include <webm/WebmPlayer.h>
+#include <roxlu/core/Utils.h>
+
+void webm_player_read(unsigned char* pixels, size_t nbytes, void* user) {
+  WebmPlayer* p = static_cast<WebmPlayer*>(user);
+  p->gl_surface.setPixels(pixels, nbytes);
+}
+
+// -------------------------------------------------------------
+
+WebmPlayer::WebmPlayer()
+  :decoder(NULL)
+  ,state(WEBM_STATE_NONE)
+  ,time_started(0)
+  ,time_paused(0)
+  ,has_packet(false)
+{
+}
+
+WebmPlayer::~WebmPlayer() {
+  close();
+}
+
+bool WebmPlayer::open(std::string filename, bool datapath) {
+  close();
+
+  if(!reader.open(filename, datapath)) {
+    return false;
+  }
+
+  reader.print();
+
+  VPXSettings cfg;
+  cfg.in_w = reader.width;
+  cfg.in_h = reader.height;
+  cfg.out_w = reader.width;
+  cfg.out_h = reader.height;
+  cfg.fps = 30;
+  cfg.cb_read = webm_player_read;
+  cfg.cb_user = this;
+
+  decoder = new VPXDecoder();
+
+  if(!decoder->setup(cfg)) {
+    RX_ERROR(ERR_WEBMP_DECODER_SETUP);
+    close();
+    return false;
+  }
+
+  gl_surface.setup(reader.width, reader.height, GL_RGBA, GL_RGB, GL_UNSIGNED_BYTE);
+
+  return true;
+}
+
+bool WebmPlayer::close() {
+  state = WEBM_STATE_NONE;
+  has_packet = false;
+
+  if(decoder) {
+    delete decoder;
+    decoder = NULL;
+  }
+
+  return reader.close();
+}
+
+void WebmPlayer::play() {
+  if(!decoder) {
+    RX_ERROR(ERR_WEBMP_NOT_OPEN);
+    return;
+  }
+
+  if(state == WEBM_STATE_PAUSE) {
+    state = WEBM_STATE_PLAY;
+    time_started = time_started + (rx_millis() - time_paused);
+    return;
+  }
+
+  if(state == WEBM_STATE_PLAY) {
+    RX_ERROR(ERR_WEBMP_ALREADY_PLAYING);
+    return;
+  }
+
+  reader.rewind();
+  has_packet = false;
+  state = WEBM_STATE_PLAY;
+  time_started = rx_millis();
+}
+
+void WebmPlayer::pause() {
+  if(state == WEBM_STATE_PAUSE) {
+    RX_VERBOSE(VERBOSE_WEBMP_ALREADY_PAUSED);
+    return;
+  }
+
+  state = WEBM_STATE_PAUSE;
+  time_paused = rx_millis();
+}
+
+void WebmPlayer::stop() {
+  state = WEBM_STATE_NONE;
+  has_packet = false;
+  reader.rewind();
+}
+
+bool WebmPlayer::seek(uint64_t millis) {
+  uint64_t keyframe_millis = 0;
+  if(!reader.seek(millis, &keyframe_millis)) {
+    return false;
+  }
+
+  // we continue at the keyframe; the clock jumps to its time
+  has_packet = false;
+  uint64_t now = rx_millis();
+  time_started = now - keyframe_millis;
+  time_paused = now;
+  return true;
+}
+
+void WebmPlayer::update() {
+  if(state != WEBM_STATE_PLAY) {
+    return;
+  }
+
+  uint64_t dt = rx_millis() - time_started;
+
+  // decode all packets up to now; the decoder needs all of them
+  while(true) {
+    if(!has_packet) {
+      has_packet = reader.readPacket(packet);
+      if(!has_packet) {
+        stop();
+        return;
+      }
+    }
+
+    if(packet.millis > dt) {
+      break;
+    }
+
+    decoder->decodeFrame(packet.data, packet.nbytes);
+    has_packet = false;
+  }
+}
+
+void WebmPlayer::draw(int x, int y, int w, int h) {
+  gl_surface.draw(x, y, w, h);
+}
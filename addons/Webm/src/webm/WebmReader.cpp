@@ -0,0 +1,631 @@
+#include <webm/WebmReader.h>
+#include <roxlu/core/Utils.h>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+WebmReaderPacket::WebmReaderPacket()
+  :data(NULL)
+  ,nbytes(0)
+  ,millis(0)
+  ,is_keyframe(false)
+{
+}
+
+// -------------------------------------------------------------------------
+
+WebmReader::WebmReader()
+  :width(0)
+  ,height(0)
+  ,video_track(0)
+  ,timecode_scale(1000000)
+  ,duration(0.0)
+  ,data(NULL)
+  ,nbytes(0)
+  ,fd(-1)
+  ,segment_pos(0)
+  ,segment_end(0)
+  ,first_cluster_pos(0)
+  ,cues_pos(0)
+  ,read_pos(0)
+  ,cluster_pos(0)
+  ,cluster_timecode(0)
+{
+}
+
+WebmReader::~WebmReader() {
+  close();
+}
+
+bool WebmReader::open(std::string filename, bool datapath) {
+  if(data) {
+    RX_ERROR(ERR_WEBMR_ALREADY_OPEN);
+    return false;
+  }
+
+  if(datapath) {
+    filename = rx_to_data_path(filename);
+  }
+
+  fd = ::open(filename.c_str(), O_RDONLY);
+  if(fd < 0) {
+    RX_ERROR(ERR_WEBMR_OPEN, filename.c_str(), errno, strerror(errno));
+    return false;
+  }
+
+  struct stat st;
+  if(fstat(fd, &st) != 0 || st.st_size == 0) {
+    RX_ERROR(ERR_WEBMR_OPEN, filename.c_str(), errno, strerror(errno));
+    close();
+    return false;
+  }
+
+  void* ptr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if(ptr == MAP_FAILED) {
+    RX_ERROR(ERR_WEBMR_MMAP, filename.c_str(), errno, strerror(errno));
+    close();
+    return false;
+  }
+
+  data = (unsigned char*)ptr;
+  nbytes = st.st_size;
+
+  if(!parseHeaders()) {
+    close();
+    return false;
+  }
+
+  // no (usable) cues; build the index ourself
+  if(!index.size() && !scanClusters()) {
+    close();
+    return false;
+  }
+
+  std::sort(index.begin(), index.end());
+  rewind();
+  return true;
+}
+
+bool WebmReader::close() {
+  if(data) {
+    munmap(data, nbytes);
+    data = NULL;
+  }
+  if(fd >= 0) {
+    ::close(fd);
+    fd = -1;
+  }
+
+  nbytes = 0;
+  width = 0;
+  height = 0;
+  video_track = 0;
+  codec_id.clear();
+  timecode_scale = 1000000;
+  duration = 0.0;
+  segment_pos = 0;
+  segment_end = 0;
+  first_cluster_pos = 0;
+  cues_pos = 0;
+  index.clear();
+  rewind();
+  return true;
+}
+
+bool WebmReader::parseHeaders() {
+  uint64_t id = 0;
+  uint64_t size = 0;
+  uint64_t pos = 0;
+
+  // EBML header
+  if(!readElement(0, id, size, pos) || id != ID_EBML || size == WEBM_READER_UNKNOWN_SIZE) {
+    RX_ERROR(ERR_WEBMR_NO_EBML);
+    return false;
+  }
+
+  uint64_t end = pos + size;
+  uint64_t child_id, child_size, child_pos;
+  for(uint64_t p = pos; p < end; p = child_pos + child_size) {
+    if(!readElement(p, child_id, child_size, child_pos)) {
+      return false;
+    }
+    if(child_id == ID_DOCTYPE) {
+      std::string doctype = readString(child_pos, child_size);
+      if(doctype != "webm" && doctype != "matroska") {
+        RX_ERROR(ERR_WEBMR_DOCTYPE, doctype.c_str());
+        return false;
+      }
+    }
+  }
+
+  // Segment
+  if(!readElement(end, id, size, pos) || id != ID_SEGMENT) {
+    RX_ERROR(ERR_WEBMR_NO_SEGMENT);
+    return false;
+  }
+
+  segment_pos = pos;
+  segment_end = (size == WEBM_READER_UNKNOWN_SIZE || pos + size > nbytes) ? nbytes : pos + size;
+
+  // top level elements up to the first cluster
+  for(uint64_t p = segment_pos; p < segment_end; p = pos + size) {
+    if(!readElement(p, id, size, pos)) {
+      return false;
+    }
+
+    if(id == ID_CLUSTER) {
+      first_cluster_pos = p;
+      break;
+    }
+
+    if(size == WEBM_READER_UNKNOWN_SIZE) {
+      RX_ERROR(ERR_WEBMR_CORRUPT, (unsigned long long)p);
+      return false;
+    }
+
+    switch(id) {
+      case ID_SEEK_HEAD: {
+        if(!parseSeekHead(pos, pos + size)) {
+          return false;
+        }
+        break;
+      }
+      case ID_INFO: {
+        if(!parseInfo(pos, pos + size)) {
+          return false;
+        }
+        break;
+      }
+      case ID_TRACKS: {
+        if(!parseTracks(pos, pos + size)) {
+          return false;
+        }
+        break;
+      }
+      case ID_CUES: {
+        cues_pos = p;
+        break;
+      }
+      default: break;
+    }
+  }
+
+  if(!video_track) {
+    RX_ERROR(ERR_WEBMR_NO_VIDEO);
+    return false;
+  }
+
+  if(codec_id != "V_VP8") {
+    RX_ERROR(ERR_WEBMR_CODEC, codec_id.c_str());
+    return false;
+  }
+
+  if(!first_cluster_pos) {
+    first_cluster_pos = segment_end;
+  }
+
+  // the cues are normally stored after the clusters; we find them via the seek head
+  if(cues_pos) {
+    if(!readElement(cues_pos, id, size, pos) || id != ID_CUES || size == WEBM_READER_UNKNOWN_SIZE) {
+      RX_WARNING(ERR_WEBMR_CORRUPT, (unsigned long long)cues_pos);
+      return true;
+    }
+    if(!parseCues(pos, pos + size)) {
+      index.clear();
+    }
+  }
+
+  return true;
+}
+
+bool WebmReader::parseSeekHead(uint64_t pos, uint64_t end) {
+  uint64_t id, size, dp;
+  for(uint64_t p = pos; p < end; p = dp + size) {
+    if(!readElement(p, id, size, dp)) {
+      return false;
+    }
+    if(id != ID_SEEK) {
+      continue;
+    }
+
+    uint64_t seek_id = 0;
+    uint64_t seek_pos = 0;
+    uint64_t cid, csize, cdp;
+    for(uint64_t c = dp; c < dp + size; c = cdp + csize) {
+      if(!readElement(c, cid, csize, cdp)) {
+        return false;
+      }
+      if(cid == ID_SEEK_ID) {
+        seek_id = readUInt(cdp, csize);
+      }
+      else if(cid == ID_SEEK_POSITION) {
+        seek_pos = readUInt(cdp, csize);
+      }
+    }
+
+    if(seek_id == ID_CUES && segment_pos + seek_pos < segment_end) {
+      cues_pos = segment_pos + seek_pos;
+    }
+  }
+  return true;
+}
+
+bool WebmReader::parseInfo(uint64_t pos, uint64_t end) {
+  uint64_t id, size, dp;
+  double dur = 0.0;
+  for(uint64_t p = pos; p < end; p = dp + size) {
+    if(!readElement(p, id, size, dp)) {
+      return false;
+    }
+    if(id == ID_TIMECODE_SCALE) {
+      timecode_scale = readUInt(dp, size);
+    }
+    else if(id == ID_DURATION) {
+      dur = readFloat(dp, size);
+    }
+  }
+
+  if(!timecode_scale) {
+    timecode_scale = 1000000;
+  }
+
+  // the duration is stored in timecode ticks
+  duration = (dur * timecode_scale) / 1000000.0;
+  return true;
+}
+
+bool WebmReader::parseTracks(uint64_t pos, uint64_t end) {
+  uint64_t id, size, dp;
+  for(uint64_t p = pos; p < end; p = dp + size) {
+    if(!readElement(p, id, size, dp)) {
+      return false;
+    }
+    if(id == ID_TRACK_ENTRY && !parseTrackEntry(dp, dp + size)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool WebmReader::parseTrackEntry(uint64_t pos, uint64_t end) {
+  uint64_t id, size, dp;
+  uint64_t number = 0;
+  uint64_t type = 0;
+  uint64_t w = 0;
+  uint64_t h = 0;
+  std::string codec;
+
+  for(uint64_t p = pos; p < end; p = dp + size) {
+    if(!readElement(p, id, size, dp)) {
+      return false;
+    }
+    switch(id) {
+      case ID_TRACK_NUMBER: { number = readUInt(dp, size);   break; }
+      case ID_TRACK_TYPE:   { type = readUInt(dp, size);     break; }
+      case ID_CODEC_ID:     { codec = readString(dp, size);  break; }
+      case ID_VIDEO: {
+        uint64_t vid, vsize, vdp;
+        for(uint64_t v = dp; v < dp + size; v = vdp + vsize) {
+          if(!readElement(v, vid, vsize, vdp)) {
+            return false;
+          }
+          if(vid == ID_PIXEL_WIDTH) {
+            w = readUInt(vdp, vsize);
+          }
+          else if(vid == ID_PIXEL_HEIGHT) {
+            h = readUInt(vdp, vsize);
+          }
+        }
+        break;
+      }
+      default: break;
+    }
+  }
+
+  // we use the first video track
+  if(type == EBML_TRACK_TYPE_VIDEO && !video_track) {
+    video_track = number;
+    codec_id = codec;
+    width = w;
+    height = h;
+  }
+  return true;
+}
+
+bool WebmReader::parseCues(uint64_t pos, uint64_t end) {
+  uint64_t id, size, dp;
+  for(uint64_t p = pos; p < end; p = dp + size) {
+    if(!readElement(p, id, size, dp)) {
+      return false;
+    }
+    if(id == ID_CUE_POINT && !parseCuePoint(dp, dp + size)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool WebmReader::parseCuePoint(uint64_t pos, uint64_t end) {
+  uint64_t id, size, dp;
+  uint64_t time = 0;
+  for(uint64_t p = pos; p < end; p = dp + size) {
+    if(!readElement(p, id, size, dp)) {
+      return false;
+    }
+    if(id == ID_CUE_TIME) {
+      time = readUInt(dp, size);
+    }
+    else if(id == ID_CUE_TRACK_POSITIONS) {
+      uint64_t track = 0;
+      uint64_t cluster = WEBM_READER_UNKNOWN_SIZE;
+      uint64_t cid, csize, cdp;
+      for(uint64_t c = dp; c < dp + size; c = cdp + csize) {
+        if(!readElement(c, cid, csize, cdp)) {
+          return false;
+        }
+        if(cid == ID_CUE_TRACK) {
+          track = readUInt(cdp, csize);
+        }
+        else if(cid == ID_CUE_CLUSTER_POSITION) {
+          cluster = readUInt(cdp, csize);
+        }
+      }
+
+      if(track == video_track && cluster != WEBM_READER_UNKNOWN_SIZE && segment_pos + cluster < segment_end) {
+        WebmIndexEntry entry;
+        entry.millis = toMillis(time);
+        entry.position = segment_pos + cluster;
+        index.push_back(entry);
+      }
+    }
+  }
+  return true;
+}
+
+// Reads all packets once; every cluster in which the first video packet is
+// a keyframe is added to the index. readPacket() only parses the element
+// headers, so this doesn't touch the frame data.
+bool WebmReader::scanClusters() {
+  WebmReaderPacket pkt;
+  uint64_t last_cluster = 0;
+
+  rewind();
+  while(readPacket(pkt)) {
+    if(cluster_pos == last_cluster) {
+      continue;
+    }
+    last_cluster = cluster_pos;
+    if(pkt.is_keyframe) {
+      WebmIndexEntry entry;
+      entry.millis = pkt.millis;
+      entry.position = cluster_pos;
+      index.push_back(entry);
+    }
+  }
+
+  if(duration == 0.0) {
+    duration = pkt.millis;
+  }
+  return true;
+}
+
+bool WebmReader::readPacket(WebmReaderPacket& pkt) {
+  if(!data) {
+    RX_ERROR(ERR_WEBMR_NOT_OPEN);
+    return false;
+  }
+
+  uint64_t id, size, dp;
+  while(read_pos < segment_end) {
+    if(!readElement(read_pos, id, size, dp)) {
+      read_pos = segment_end;
+      return false;
+    }
+
+    switch(id) {
+      // master elements we descend into
+      case ID_CLUSTER: {
+        cluster_pos = read_pos;
+        cluster_timecode = 0;
+        read_pos = dp;
+        continue;
+      }
+      case ID_BLOCK_GROUP: {
+        read_pos = dp;
+        continue;
+      }
+      default: break;
+    }
+
+    if(size == WEBM_READER_UNKNOWN_SIZE || dp + size > nbytes) {
+      RX_ERROR(ERR_WEBMR_CORRUPT, (unsigned long long)read_pos);
+      read_pos = segment_end;
+      return false;
+    }
+
+    uint64_t block_pos = read_pos;
+    read_pos = dp + size;
+
+    if(id == ID_TIMECODE) {
+      cluster_timecode = readUInt(dp, size);
+      continue;
+    }
+
+    if(id != ID_SIMPLE_BLOCK && id != ID_BLOCK) {
+      continue;
+    }
+
+    // block header: track number (vint), int16 relative timecode, flags
+    unsigned char* ptr = data + dp;
+    int len = 1;
+    while(len <= 8 && !(ptr[0] & (0x80 >> (len - 1)))) {
+      ++len;
+    }
+    if(len > 8 || (uint64_t)len + 3 > size) {
+      RX_ERROR(ERR_WEBMR_CORRUPT, (unsigned long long)block_pos);
+      continue;
+    }
+
+    uint64_t track = ptr[0] & (0xFF >> len);
+    for(int i = 1; i < len; ++i) {
+      track = (track << 8) | ptr[i];
+    }
+
+    if(track != video_track) {
+      continue;
+    }
+
+    int16_t rel = (int16_t)((ptr[len] << 8) | ptr[len + 1]);
+    unsigned char flags = ptr[len + 2];
+    if(flags & 0x06) {
+      RX_WARNING(ERR_WEBMR_LACING, (unsigned long long)block_pos);
+      continue;
+    }
+
+    int64_t timecode = (int64_t)cluster_timecode + rel;
+    pkt.data = ptr + len + 3;
+    pkt.nbytes = size - (len + 3);
+    pkt.millis = toMillis((timecode < 0) ? 0 : timecode);
+
+    // a Block (in a BlockGroup) has no keyframe flag, use the VP8 frame tag
+    if(id == ID_SIMPLE_BLOCK) {
+      pkt.is_keyframe = (flags & 0x80) == 0x80;
+    }
+    else {
+      pkt.is_keyframe = pkt.nbytes && (pkt.data[0] & 0x01) == 0;
+    }
+    return true;
+  }
+
+  return false;
+}
+
+bool WebmReader::seek(uint64_t millis, uint64_t* keyframeMillis) {
+  if(!data) {
+    RX_ERROR(ERR_WEBMR_NOT_OPEN);
+    return false;
+  }
+  if(!index.size()) {
+    RX_ERROR(ERR_WEBMR_NO_INDEX);
+    return false;
+  }
+
+  // last entry with entry.millis <= millis
+  WebmIndexEntry key;
+  key.millis = millis;
+  key.position = 0;
+  std::vector<WebmIndexEntry>::iterator it = std::upper_bound(index.begin(), index.end(), key);
+  if(it != index.begin()) {
+    --it;
+  }
+
+  read_pos = it->position;
+  cluster_pos = 0;
+  cluster_timecode = 0;
+
+  if(keyframeMillis) {
+    *keyframeMillis = it->millis;
+  }
+  return true;
+}
+
+bool WebmReader::readElement(uint64_t pos, uint64_t& id, uint64_t& size, uint64_t& dataPos) {
+  if(pos >= nbytes) {
+    return false;
+  }
+
+  // id; we keep the length marker bits like the ID_* defines
+  unsigned char* ptr = data + pos;
+  int len = 1;
+  while(len <= 4 && !(ptr[0] & (0x80 >> (len - 1)))) {
+    ++len;
+  }
+  if(len > 4 || pos + len >= nbytes) {
+    RX_ERROR(ERR_WEBMR_CORRUPT, (unsigned long long)pos);
+    return false;
+  }
+
+  id = 0;
+  for(int i = 0; i < len; ++i) {
+    id = (id << 8) | ptr[i];
+  }
+
+  // size
+  ptr += len;
+  pos += len;
+  int slen = 1;
+  while(slen <= 8 && !(ptr[0] & (0x80 >> (slen - 1)))) {
+    ++slen;
+  }
+  if(slen > 8 || pos + slen > nbytes) {
+    RX_ERROR(ERR_WEBMR_CORRUPT, (unsigned long long)pos);
+    return false;
+  }
+
+  uint64_t mask = 0xFF >> slen;
+  bool all_ones = (ptr[0] & mask) == mask;
+  size = ptr[0] & mask;
+  for(int i = 1; i < slen; ++i) {
+    size = (size << 8) | ptr[i];
+    all_ones = all_ones && ptr[i] == 0xFF;
+  }
+
+  if(all_ones) {
+    size = WEBM_READER_UNKNOWN_SIZE;
+  }
+
+  dataPos = pos + slen;
+
+  // truncated files: clamp to what we have
+  if(size != WEBM_READER_UNKNOWN_SIZE && dataPos + size > nbytes && id != ID_SEGMENT && id != ID_CLUSTER) {
+    RX_ERROR(ERR_WEBMR_CORRUPT, (unsigned long long)(pos - len));
+    return false;
+  }
+  return true;
+}
+
+uint64_t WebmReader::readUInt(uint64_t pos, uint64_t size) {
+  uint64_t result = 0;
+  for(uint64_t i = 0; i < size && i < 8; ++i) {
+    result = (result << 8) | data[pos + i];
+  }
+  return result;
+}
+
+double WebmReader::readFloat(uint64_t pos, uint64_t size) {
+  uint64_t bits = readUInt(pos, size);
+  if(size == 4) {
+    uint32_t b = bits;
+    float f;
+    memcpy(&f, &b, 4);
+    return f;
+  }
+  else if(size == 8) {
+    double d;
+    memcpy(&d, &bits, 8);
+    return d;
+  }
+  return 0.0;
+}
+
+std::string WebmReader::readString(uint64_t pos, uint64_t size) {
+  std::string result((char*)data + pos, size);
+  size_t zero = result.find('\0');
+  if(zero != std::string::npos) {
+    result.resize(zero);
+  }
+  return result;
+}
+
+void WebmReader::print() {
+  RX_VERBOSE("webm.width: %d", width);
+  RX_VERBOSE("webm.height: %d", height);
+  RX_VERBOSE("webm.codec: %s", codec_id.c_str());
+  RX_VERBOSE("webm.video_track: %llu", (unsigned long long)video_track);
+  RX_VERBOSE("webm.timecode_scale: %llu", (unsigned long long)timecode_scale);
+  RX_VERBOSE("webm.duration: %f", duration);
+  RX_VERBOSE("webm.keyframes in index: %ld", index.size());
+}
@@ -0,0 +1,145 @@
+/*
+
+  Bullet benchmark
+  ----------------
+  Drops a grid of boxes and spheres on a static plane and measures the
+  World with and without the physics thread. Without it, update() steps the
+  simulation on the calling thread; with it, update() only picks up the
+  newest transforms and the physics thread steps at `fixed_time_step`.
+
+  For both we run a "render loop" for BENCH_SECONDS which calls update() and
+  copies the matrix of every body, and we print the milliseconds this loop
+  spends per frame, how many physics steps per second were made and how
+  fast the simulation runs compared to real time (1.0 means it keeps up
+  with the fixed time step).
+
+  This needs a bullet build for your platform (e.g. libbullet-dev on linux).
+
+  Run: ./build_release.sh && ../../bin/bullet_benchmark
+
+*/
+#include <roxlu/Roxlu.h>
+#include <Bullet.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define BENCH_SECONDS 5                                          /* how long we run the render loop for each test */
+#define BENCH_LAYERS 10                                          /* number of layers of bodies we stack above the plane */
+#define BENCH_SPACING 1.5f                                       /* distance between two bodies in the grid */
+
+static int bench_num_steps = 0;
+
+// Called by bullet after each internal step, on the thread that steps
+void bench_on_tick(btDynamicsWorld* world, btScalar timeStep) {
+  bench_num_steps++;
+}
+
+// Creates `numBodies` bodies, alternating boxes and spheres, in a grid of BENCH_LAYERS layers
+static void bench_create_scene(rb::World& world, size_t numBodies, std::vector<rbb::Body*>& bodies, std::vector<btCollisionShape*>& shapes) {
+  btBoxShape* box_shape = world.createBoxShape(0.5f, 0.5f, 0.5f);
+  btSphereShape* sphere_shape = world.sphereCreateShape(0.5f);
+  btStaticPlaneShape* plane_shape = world.createStaticPlaneShape(Vec3(0.0f, 1.0f, 0.0f), 0.0f);
+  shapes.push_back(box_shape);
+  shapes.push_back(sphere_shape);
+  shapes.push_back(plane_shape);
+  bodies.push_back(world.createStaticPlaneBody(plane_shape, Vec3(0.0f, 0.0f, 0.0f)));
+
+  size_t per_layer = (numBodies + BENCH_LAYERS - 1) / BENCH_LAYERS;
+  size_t side = 1;
+  while(side * side < per_layer) {
+    ++side;
+  }
+
+  float offset = (side * BENCH_SPACING) * 0.5f;
+  for(size_t i = 0; i < numBodies; ++i) {
+    size_t layer = i / per_layer;
+    size_t dx = i % per_layer;
+    Vec3 pos((dx % side) * BENCH_SPACING - offset, 2.0f + layer * BENCH_SPACING, (dx / side) * BENCH_SPACING - offset);
+    if(i & 1) {
+      bodies.push_back(world.sphereCreateBody(sphere_shape, pos, 1.0f));
+    }
+    else {
+      bodies.push_back(world.createBoxBody(box_shape, pos, 1.0f));
+    }
+  }
+}
+
+// The world doesn't own the bodies and shapes
+static void bench_delete_scene(std::vector<rbb::Body*>& bodies, std::vector<btCollisionShape*>& shapes) {
+  for(std::vector<rbb::Body*>::iterator it = bodies.begin(); it != bodies.end(); ++it) {
+    rbb::Body* body = *it;
+    delete body->rigid_body;
+    delete body->motion_state;
+    delete body;
+  }
+  for(std::vector<btCollisionShape*>::iterator it = shapes.begin(); it != shapes.end(); ++it) {
+    delete *it;
+  }
+  bodies.clear();
+  shapes.clear();
+}
+
+static void bench_run(size_t numBodies, bool physicsThread) {
+  std::vector<rbb::Body*> bodies;
+  std::vector<btCollisionShape*> shapes;
+  rb::WorldSettings settings;
+  settings.use_physics_thread = physicsThread;
+  settings.max_persistent_manifolds = std::max<int>(settings.max_persistent_manifolds, numBodies * 4);
+
+  {
+    rb::World world;
+    world.create(settings);
+
+    world.setGravity(0.0f, -9.81f, 0.0f);
+    bench_create_scene(world, numBodies, bodies, shapes);
+
+    // the physics thread is already stepping; we only count the steps of the render loop
+    world.lock();
+    world.getBulletWorld()->setInternalTickCallback(bench_on_tick);
+    bench_num_steps = 0;
+    world.unlock();
+
+    Mat4 m;
+    size_t num_frames = 0;
+    int64_t start = rx_millis();
+    int64_t end = start + BENCH_SECONDS * 1000;
+    while(rx_millis() < end) {
+      world.update();
+      for(size_t i = 0; i < bodies.size(); ++i) {
+        bodies[i]->copyMatrix(m);
+      }
+      ++num_frames;
+    }
+    int64_t elapsed = rx_millis() - start;
+
+    world.lock();
+    int num_steps = bench_num_steps;
+    world.unlock();
+
+    double steps_per_sec = num_steps / (elapsed / 1000.0);
+    printf("%8zu %16s %14.3f %12.1f %12.2f\n",
+           numBodies, (physicsThread) ? "physics thread" : "update()",
+           double(elapsed) / num_frames, steps_per_sec,
+           steps_per_sec * settings.fixed_time_step);
+  }
+
+  // the world has been destroyed, now we can free the bodies
+  bench_delete_scene(bodies, shapes);
+}
+
+int main() {
+  size_t bodies[] = { 1000, 2000, 4000, 8000 };
+  size_t num_tests = sizeof(bodies) / sizeof(bodies[0]);
+
+  printf("\nBullet, boxes and spheres, %d seconds per test\n", BENCH_SECONDS);
+  printf("--------------------------------------------------------------------------------\n");
+  printf("%8s %16s %14s %12s %12s\n", "bodies", "stepped by", "ms per frame", "steps/sec", "real time");
+
+  for(size_t i = 0; i < num_tests; ++i) {
+    bench_run(bodies[i], false);
+    bench_run(bodies[i], true);
+  }
+
+  printf("\n");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,198 @@
+/*
+
+  EBML benchmark
+  --------------
+  Measures how many MB/s of encoded frames the EBML muxer (which serializes
+  every element into a std::vector) and the streaming EBMLWriter write, for
+  different frame sizes. Both write into the same memory output, which copies
+  the data like a socket or file would. We also write a file with the
+  EBMLWriter file output (writev/pwrite) to include the system calls.
+
+  Run: ./build_release.sh && ../../bin/ebml_benchmark
+
+*/
+#include <roxlu/Roxlu.h>
+#include <webm/EBML.h>
+#include <webm/EBMLWriter.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define BENCH_STREAM_SIZE (64 * 1024 * 1024)                     /* number of frame bytes we write per run */
+#define BENCH_OUTPUT_SIZE (4 * 1024 * 1024)                      /* the memory output wraps around at this size */
+#define BENCH_FPS 30                                             /* used for the timestamps of the frames */
+#define BENCH_KEYFRAME_INTERVAL 60                               /* every Nth frame is a keyframe */
+#define BENCH_MIN_MILLIS 300                                     /* we repeat a measurement until it took at least this long */
+
+struct BenchOutput {
+  BenchOutput():dx(0),num_bytes(0) { data.resize(BENCH_OUTPUT_SIZE); }
+  void write(char* src, size_t nbytes);
+  std::vector<char> data;
+  size_t dx;
+  uint64_t num_bytes;
+};
+
+void BenchOutput::write(char* src, size_t nbytes) {
+  while(nbytes) {
+    size_t n = std::min<size_t>(nbytes, data.size() - dx);
+    memcpy(&data[dx], src, n);
+    dx = (dx + n) % data.size();
+    src += n;
+    nbytes -= n;
+    num_bytes += n;
+  }
+}
+
+size_t bench_ebml_write(char* data, size_t nbytes, void* user) {
+  static_cast<BenchOutput*>(user)->write(data, nbytes);
+  return nbytes;
+}
+
+size_t bench_ebml_writer_writev(EBMLIOVec* vecs, int nvecs, void* user) {
+  BenchOutput* out = static_cast<BenchOutput*>(user);
+  size_t total = 0;
+  for(int i = 0; i < nvecs; ++i) {
+    out->write(vecs[i].data, vecs[i].nbytes);
+    total += vecs[i].nbytes;
+  }
+  return total;
+}
+
+void bench_ebml_close(void* user) {
+}
+
+static void bench_setup(EBMLHeader& header, EBMLSegmentInfo& info, std::vector<EBMLTrack>& tracks) {
+  header.ebml_version = 1;
+  header.ebml_read_version = 1;
+  header.ebml_max_id_length = 4;
+  header.ebml_max_size_length = 8;
+  header.doctype = "webm";
+  header.doctype_version = 2;
+  header.doctype_read_version = 2;
+
+  info.title = "ebml_benchmark";
+  info.muxing_app = "roxlu";
+  info.writing_app = "roxlu";
+  info.timecode_scale = 1000000;
+
+  EBMLTrack track;
+  track.type = EBML_TRACK_TYPE_VIDEO;
+  track.number = 1;
+  track.uid = 1;
+  track.codec_id = "V_VP8";
+  track.vid_pix_width = 1280;
+  track.vid_pix_height = 720;
+  tracks.push_back(track);
+}
+
+static void bench_fill_block(EBMLSimpleBlock& block, size_t frame, std::vector<char>& data) {
+  block.track_number = 1;
+  block.timestamp = (frame * 1000) / BENCH_FPS;
+  block.flags = ((frame % BENCH_KEYFRAME_INTERVAL) == 0) ? 0x80 : 0x00;
+  block.nbytes = data.size();
+  block.data = &data[0];
+}
+
+// Writes BENCH_STREAM_SIZE bytes of frames with the EBML muxer; returns the number of frame bytes
+static uint64_t bench_run_ebml(std::vector<char>& frame, BenchOutput& out) {
+  EBMLHeader header;
+  EBMLSegmentInfo info;
+  std::vector<EBMLTrack> tracks;
+  bench_setup(header, info, tracks);
+
+  EBML ebml;
+  ebml.setCallbacks(bench_ebml_write, bench_ebml_close, NULL, NULL, NULL, NULL, NULL, &out);
+  ebml.open(header);
+  ebml.openSegment(info);
+  ebml.openTracks(tracks);
+
+  size_t num_frames = BENCH_STREAM_SIZE / frame.size();
+  for(size_t i = 0; i < num_frames; ++i) {
+    EBMLSimpleBlock block;
+    bench_fill_block(block, i, frame);
+    ebml.addSimpleBlock(block);
+  }
+
+  ebml.close();
+  return uint64_t(num_frames) * frame.size();
+}
+
+// Same as bench_run_ebml() but with the EBMLWriter; when `file` is set we write to that file instead of memory
+static uint64_t bench_run_writer(std::vector<char>& frame, BenchOutput& out, EBMLWriterFile* file) {
+  EBMLHeader header;
+  EBMLSegmentInfo info;
+  std::vector<EBMLTrack> tracks;
+  bench_setup(header, info, tracks);
+
+  EBMLWriter writer;
+  if(file) {
+    writer.setCallbacks(ebml_writer_file_writev, ebml_writer_file_pwrite, NULL, file);
+  }
+  else {
+    writer.setCallbacks(bench_ebml_writer_writev, NULL, bench_ebml_close, &out);
+  }
+  writer.open(header, info, tracks);
+
+  size_t num_frames = BENCH_STREAM_SIZE / frame.size();
+  for(size_t i = 0; i < num_frames; ++i) {
+    EBMLSimpleBlock block;
+    bench_fill_block(block, i, frame);
+    writer.addSimpleBlock(block);
+  }
+
+  writer.close();
+  return uint64_t(num_frames) * frame.size();
+}
+
+// Returns MB/s of frame data; type 0 = EBML, 1 = EBMLWriter to memory, 2 = EBMLWriter to a file
+static double bench_run(int type, size_t frameSize) {
+  std::vector<char> frame(frameSize);
+  for(size_t i = 0; i < frame.size(); ++i) {
+    frame[i] = rand() & 0xFF;
+  }
+
+  BenchOutput out;
+  uint64_t num_bytes = 0;
+  int64_t start = rx_millis();
+  int64_t elapsed = 0;
+
+  do {
+    if(type == 0) {
+      num_bytes += bench_run_ebml(frame, out);
+    }
+    else if(type == 1) {
+      num_bytes += bench_run_writer(frame, out, NULL);
+    }
+    else {
+      EBMLWriterFile file;
+      if(!file.open(rx_to_data_path("ebml_benchmark.webm"))) {
+        ::exit(EXIT_FAILURE);
+      }
+      num_bytes += bench_run_writer(frame, out, &file);
+    }
+    elapsed = rx_millis() - start;
+  } while(elapsed < BENCH_MIN_MILLIS);
+
+  return (double(num_bytes) / (1024.0 * 1024.0)) / (elapsed / 1000.0);
+}
+
+int main() {
+  size_t sizes[] = { 512, 4 * 1024, 32 * 1024, 128 * 1024, 512 * 1024 };
+  size_t num_sizes = sizeof(sizes) / sizeof(sizes[0]);
+
+  // the EBML muxer logs every element it writes
+  rx_log_set_level(RX_LOG_LEVEL_ERROR);
+
+  printf("\nEBML, MB/s of frames\n");
+  printf("----------------------------------------------------------------\n");
+  printf("%12s %12s %14s %14s\n", "frame size", "EBML", "EBMLWriter", "EBMLWriter fd");
+
+  for(size_t i = 0; i < num_sizes; ++i) {
+    double ebml = bench_run(0, sizes[i]);
+    double writer = bench_run(1, sizes[i]);
+    double file = bench_run(2, sizes[i]);
+    printf("%12zu %12.1f %14.1f %14.1f\n", sizes[i], ebml, writer, file);
+  }
+
+  printf("\n");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,156 @@
+/*
+
+  File read benchmark
+  -------------------
+  Measures how fast we read a text file (an OBJ-like mesh) with:
+
+  - std::getline(), appending each line to a std::string; this is what
+    rx_get_file_contents() used to do.
+  - rx_read_file(), which sizes the result once and uses a single read().
+  - rx_mmap_file, which maps the file without copying it.
+
+  Each method counts the lines of the file, so all of them touch every byte.
+  The file is written just before we read it, so it's in the page cache and
+  we measure the copying and parsing, not the disk.
+
+  Run: ./build_release.sh && ../../bin/file_read_benchmark [size in MB]
+
+*/
+#include <roxlu/Roxlu.h>
+#include <fstream>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define BENCH_MIN_MILLIS 500                                     /* we repeat a measurement until it took at least this long */
+
+enum BenchMethod {
+  BENCH_GETLINE,
+  BENCH_READ_FILE,
+  BENCH_MMAP
+};
+
+// Writes a file with vertices, normals and faces like an OBJ file
+static bool bench_create_file(std::string filepath, size_t nbytes) {
+  FILE* fp = fopen(filepath.c_str(), "wb");
+  if(!fp) {
+    return false;
+  }
+
+  size_t written = 0;
+  size_t dx = 0;
+  char line[128];
+  while(written < nbytes) {
+    int n = 0;
+    switch(dx % 3) {
+      case 0: n = sprintf(line, "v %f %f %f\n", rand() / float(RAND_MAX), rand() / float(RAND_MAX), rand() / float(RAND_MAX)); break;
+      case 1: n = sprintf(line, "vn %f %f %f\n", rand() / float(RAND_MAX), rand() / float(RAND_MAX), rand() / float(RAND_MAX)); break;
+      case 2: n = sprintf(line, "f %zu//%zu %zu//%zu %zu//%zu\n", dx, dx, dx + 1, dx + 1, dx + 2, dx + 2); break;
+    }
+    fwrite(line, n, 1, fp);
+    written += n;
+    ++dx;
+  }
+
+  fclose(fp);
+  return true;
+}
+
+static size_t bench_count_lines(const char* data, size_t nbytes) {
+  size_t lines = 0;
+  const char* end = data + nbytes;
+  while(data < end) {
+    const char* nl = (const char*)memchr(data, '\n', end - data);
+    if(!nl) {
+      break;
+    }
+    ++lines;
+    data = nl + 1;
+  }
+  return lines;
+}
+
+// Reads the file once and returns the number of lines
+static size_t bench_read(BenchMethod method, std::string filepath) {
+  switch(method) {
+    case BENCH_GETLINE: {
+      std::ifstream ifs(filepath.c_str());
+      std::string result;
+      std::string line;
+      size_t lines = 0;
+      while(std::getline(ifs, line)) {
+        result += line + "\n";
+        ++lines;
+      }
+      return lines;
+    }
+    case BENCH_READ_FILE: {
+      std::string result;
+      if(!rx_read_file(filepath, result)) {
+        return 0;
+      }
+      return bench_count_lines(result.c_str(), result.size());
+    }
+    case BENCH_MMAP: {
+      rx_mmap_file file;
+      if(!file.open(filepath)) {
+        return 0;
+      }
+      file.advise(RX_MMAP_SEQUENTIAL);
+      return bench_count_lines(file.ptr(), file.size());
+    }
+  };
+
+  return 0;
+}
+
+// Returns the milliseconds per read; `lines` is set to the number of lines we counted
+static double bench_run(BenchMethod method, std::string filepath, size_t& lines) {
+  int64_t start = rx_millis();
+  int64_t elapsed = 0;
+  size_t num_reads = 0;
+
+  do {
+    lines = bench_read(method, filepath);
+    ++num_reads;
+    elapsed = rx_millis() - start;
+  } while(elapsed < BENCH_MIN_MILLIS);
+
+  return double(elapsed) / num_reads;
+}
+
+int main(int argc, char** argv) {
+  const char* names[] = { "std::getline()", "rx_read_file()", "rx_mmap_file" };
+  BenchMethod methods[] = { BENCH_GETLINE, BENCH_READ_FILE, BENCH_MMAP };
+  size_t num_methods = sizeof(methods) / sizeof(methods[0]);
+  int mb = (argc > 1) ? atoi(argv[1]) : 64;
+
+  if(mb <= 0) {
+    printf("ERROR: invalid file size: %d MB\n", mb);
+    return EXIT_FAILURE;
+  }
+
+  std::string filepath = rx_to_data_path("file_read_benchmark.obj");
+  if(!rx_create_path(rx_to_data_path("")) || !bench_create_file(filepath, size_t(mb) * 1024 * 1024)) {
+    printf("ERROR: cannot create the test file: %s\n", filepath.c_str());
+    return EXIT_FAILURE;
+  }
+
+  printf("\nFile read, %d MB OBJ-like text file (in the page cache)\n", mb);
+  printf("----------------------------------------------------------------\n");
+  printf("%18s %12s %10s %10s %12s\n", "method", "ms per read", "MB/s", "speedup", "lines");
+
+  double baseline = 0.0;
+  for(size_t i = 0; i < num_methods; ++i) {
+    size_t lines = 0;
+    double millis = bench_run(methods[i], filepath, lines);
+    if(i == 0) {
+      baseline = millis;
+    }
+    printf("%18s %12.2f %10.1f %9.2fx %12zu\n", names[i], millis, mb / (millis / 1000.0), baseline / millis, lines);
+  }
+
+  remove(filepath.c_str());
+
+  printf("\n");
+  return EXIT_SUCCESS;
+}
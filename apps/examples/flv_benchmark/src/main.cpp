@@ -0,0 +1,123 @@
+/*
+
+  FLV benchmark
+  -------------
+  Headless run of the AV encoding pipeline for each x264 preset. We feed
+  generated RGB frames at BENCH_FPS (like a recorder does with
+  wantsNewVideoFrame()) for BENCH_SECONDS and print the fps the encoder
+  achieved, the average and max latency between addVideoFrame() and writing
+  the encoded frame, and the bitrate. When a preset can't keep up the fps
+  drops below BENCH_FPS and the latency keeps growing.
+
+  Run: ./build_release.sh && ../../bin/flv_benchmark [width] [height] [x264 threads]
+
+*/
+#include <roxlu/Roxlu.h>
+#include <flv/AV.h>
+#include <flv/FLV.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define BENCH_FPS 30                                             /* rate at which we add video frames */
+#define BENCH_SECONDS 5                                          /* how long we encode with each preset */
+#define BENCH_NUM_FRAMES 30                                      /* number of different frames we generate and cycle through */
+
+static size_t bench_bytes_written = 0;
+
+size_t bench_flv_write(char* data, size_t nbytes, void* user) {
+  bench_bytes_written += nbytes;
+  return nbytes;
+}
+
+// A moving gradient with some noise so x264 has motion and detail to encode
+static void bench_create_frames(int w, int h, std::vector<std::vector<unsigned char> >& frames) {
+  frames.resize(BENCH_NUM_FRAMES);
+  for(int f = 0; f < BENCH_NUM_FRAMES; ++f) {
+    std::vector<unsigned char>& pixels = frames[f];
+    pixels.resize(w * h * 3);
+    int offset = f * 8;
+    for(int j = 0; j < h; ++j) {
+      for(int i = 0; i < w; ++i) {
+        unsigned char* p = &pixels[(j * w + i) * 3];
+        p[0] = (i + offset) & 0xFF;
+        p[1] = (j + offset / 2) & 0xFF;
+        p[2] = ((i ^ j) + (rand() & 0x0F)) & 0xFF;
+      }
+    }
+  }
+}
+
+static bool bench_run(const char* preset, int w, int h, int threads, std::vector<std::vector<unsigned char> >& frames) {
+  FLV flv;
+  flv.setCallbacks(bench_flv_write, NULL, NULL, NULL, NULL);
+  bench_bytes_written = 0;
+
+  AV* av = new AV();
+  AVX264Settings settings;
+  settings.preset = preset;
+  settings.threads = threads;
+
+  if(!av->setupVideo(w, h, w, h, BENCH_FPS, AV_FMT_RGB24, &flv)
+     || !av->setupX264(settings)
+     || !av->initialize())
+  {
+    printf("ERROR: cannot setup the encoder for preset: %s\n", preset);
+    delete av;
+    return false;
+  }
+
+  av->start();
+
+  size_t frame = 0;
+  int64_t end = rx_millis() + BENCH_SECONDS * 1000;
+  while(rx_millis() < end) {
+    if(av->wantsNewVideoFrame()) {
+      av->addVideoFrame(&frames[frame % frames.size()][0]);
+      frame++;
+    }
+    else {
+      rx_sleep_millis(1);
+    }
+  }
+
+  av->stop();
+  av->waitForEncodingThreadToFinish();
+
+  AVStats stats = av->getStats();
+  double kbps = (bench_bytes_written * 8.0 / 1000.0) / BENCH_SECONDS;
+  printf("%12s %8zu %8d %10.2f %12.2f %12llu %10.0f\n",
+         preset, frame, stats.num_video_frames, stats.fps, stats.avg_latency,
+         (unsigned long long)stats.max_latency, kbps);
+
+  delete av;
+  return true;
+}
+
+int main(int argc, char** argv) {
+  const char* presets[] = { "ultrafast", "superfast", "veryfast", "faster", "fast", "medium" };
+  size_t num_presets = sizeof(presets) / sizeof(presets[0]);
+  int w = (argc > 1) ? atoi(argv[1]) : 640;
+  int h = (argc > 2) ? atoi(argv[2]) : 480;
+  int threads = (argc > 3) ? atoi(argv[3]) : 1;
+  std::vector<std::vector<unsigned char> > frames;
+
+  if(w <= 0 || h <= 0 || (w & 1) || (h & 1)) {
+    printf("ERROR: invalid size: %d x %d, we need an even width and height.\n", w, h);
+    return EXIT_FAILURE;
+  }
+
+  bench_create_frames(w, h, frames);
+
+  printf("\nFLV, %dx%d @ %d fps, %d seconds per preset, %d x264 thread(s), tune: zerolatency\n", w, h, BENCH_FPS, BENCH_SECONDS, threads);
+  printf("--------------------------------------------------------------------------------\n");
+  printf("%12s %8s %8s %10s %12s %12s %10s\n", "preset", "added", "encoded", "fps", "avg latency", "max latency", "kbit/s");
+
+  for(size_t i = 0; i < num_presets; ++i) {
+    if(!bench_run(presets[i], w, h, threads, frames)) {
+      return EXIT_FAILURE;
+    }
+  }
+
+  printf("\n");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,12 @@
+@echo off
+
+if exist build.debug (
+   rd /s/q build.debug
+)
+
+if exist build.release (
+   rd /s/q build.release
+)
+
+mkdir build.release
+mkdir build.debug
\ No newline at end of file
@@ -0,0 +1,189 @@
+/*
+
+  Image benchmark
+  ---------------
+  Measures how many 1920 x 1080 RGB frames per second we write as png and
+  jpg files. We compare saving each frame with PNG::save() / JPG::save() on
+  the calling thread with the FrameWriter, using 1 and N encode threads. For
+  the FrameWriter the time includes stop(), so all frames are on disk. We
+  write BENCH_NUM_FRAMES files for each test into the data directory and
+  remove them afterwards.
+
+  Run: ./build_release.sh && ../../bin/image_benchmark [threads]
+
+*/
+#include <roxlu/Roxlu.h>
+#include <image/PNG.h>
+#include <image/JPG.h>
+#include <image/FrameWriter.h>
+#include <sys/stat.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define BENCH_WIDTH 1920
+#define BENCH_HEIGHT 1080
+#define BENCH_NUM_FRAMES 30                                      /* number of files we write per test */
+#define BENCH_NUM_SOURCES 8                                      /* number of different frames we generate and cycle through */
+
+enum BenchMethod {
+  BENCH_PNG_SAVE,
+  BENCH_JPG_SAVE,
+  BENCH_FRAME_WRITER
+};
+
+struct BenchTest {
+  const char* name;
+  BenchMethod method;
+  int type;                                                      /* FRAME_WRITER_TYPE_PNG or FRAME_WRITER_TYPE_JPG */
+  int png_compression_level;
+  int png_filter;
+  J_DCT_METHOD jpg_dct_method;
+  int num_threads;                                               /* FrameWriter only; 0 = the number of threads passed on the command line */
+};
+
+static std::vector<std::vector<unsigned char> > bench_frames;
+
+// A moving gradient with a bit of noise; something between a UI and camera footage
+static void bench_create_frames() {
+  bench_frames.resize(BENCH_NUM_SOURCES);
+  for(int f = 0; f < BENCH_NUM_SOURCES; ++f) {
+    std::vector<unsigned char>& pixels = bench_frames[f];
+    pixels.resize(BENCH_WIDTH * BENCH_HEIGHT * 3);
+    int offset = f * 16;
+    for(int j = 0; j < BENCH_HEIGHT; ++j) {
+      for(int i = 0; i < BENCH_WIDTH; ++i) {
+        unsigned char* p = &pixels[(j * BENCH_WIDTH + i) * 3];
+        p[0] = ((i + offset) >> 3) & 0xFF;
+        p[1] = ((j + offset) >> 2) & 0xFF;
+        p[2] = (((i ^ j) >> 4) + (rand() & 0x07)) & 0xFF;
+      }
+    }
+  }
+}
+
+static std::string bench_filepath(const char* ext, size_t frame) {
+  char name[64];
+  sprintf(name, "image_benchmark_%03zu.%s", frame, ext);
+  return rx_to_data_path(name);
+}
+
+static size_t bench_file_size(std::string filepath) {
+  struct stat st;
+  if(stat(filepath.c_str(), &st) != 0) {
+    return 0;
+  }
+  return st.st_size;
+}
+
+// Returns the frames per second; `kb` is set to the average file size
+static double bench_run(BenchTest& test, int numThreads, double& kb) {
+  const char* ext = (test.type == FRAME_WRITER_TYPE_PNG) ? "png" : "jpg";
+  FrameWriter writer;
+  PNG png;
+  JPG jpg;
+
+  if(test.method == BENCH_FRAME_WRITER) {
+    FrameWriterSettings cfg;
+    cfg.type = test.type;
+    cfg.filepath = std::string("image_benchmark_%03llu.") + ext;
+    cfg.datapath = true;
+    cfg.width = BENCH_WIDTH;
+    cfg.height = BENCH_HEIGHT;
+    cfg.fmt = RX_FMT_RGB24;
+    cfg.num_threads = (test.num_threads) ? test.num_threads : numThreads;
+    cfg.png_compression_level = test.png_compression_level;
+    cfg.png_filter = test.png_filter;
+    cfg.jpg_dct_method = test.jpg_dct_method;
+    if(!writer.setup(cfg) || !writer.start()) {
+      printf("ERROR: cannot start the frame writer.\n");
+      ::exit(EXIT_FAILURE);
+    }
+  }
+
+  png.compression_level = test.png_compression_level;
+  png.filter = test.png_filter;
+  jpg.dct_method = test.jpg_dct_method;
+
+  int64_t start = rx_millis();
+
+  for(size_t i = 0; i < BENCH_NUM_FRAMES; ++i) {
+    std::vector<unsigned char>& pixels = bench_frames[i % bench_frames.size()];
+    switch(test.method) {
+      case BENCH_PNG_SAVE: {
+        png.setPixels(&pixels[0], BENCH_WIDTH, BENCH_HEIGHT, PNG_COLOR_TYPE_RGB);
+        png.save(bench_filepath(ext, i));
+        break;
+      }
+      case BENCH_JPG_SAVE: {
+        jpg.setPixels(&pixels[0], BENCH_WIDTH, BENCH_HEIGHT, JCS_RGB);
+        jpg.save(bench_filepath(ext, i));
+        break;
+      }
+      case BENCH_FRAME_WRITER: {
+        writer.addFrame(&pixels[0], pixels.size());
+        break;
+      }
+    };
+  }
+
+  if(test.method == BENCH_FRAME_WRITER) {
+    writer.stop();
+  }
+
+  int64_t elapsed = std::max<int64_t>(1, rx_millis() - start);
+
+  size_t total = 0;
+  for(size_t i = 0; i < BENCH_NUM_FRAMES; ++i) {
+    std::string filepath = bench_filepath(ext, i);
+    total += bench_file_size(filepath);
+    remove(filepath.c_str());
+  }
+
+  kb = (double(total) / BENCH_NUM_FRAMES) / 1024.0;
+  return BENCH_NUM_FRAMES / (elapsed / 1000.0);
+}
+
+int main(int argc, char** argv) {
+  int threads = (argc > 1) ? atoi(argv[1]) : 4;
+
+  if(threads <= 0) {
+    printf("ERROR: invalid number of threads: %d\n", threads);
+    return EXIT_FAILURE;
+  }
+
+  // the PNG and JPG classes log every file they save
+  rx_log_set_level(RX_LOG_LEVEL_ERROR);
+
+  BenchTest tests[] = {
+    { "PNG::save(), default",  BENCH_PNG_SAVE,     FRAME_WRITER_TYPE_PNG, -1, -1,              JDCT_ISLOW, 1 },
+    { "PNG::save(), level 1",  BENCH_PNG_SAVE,     FRAME_WRITER_TYPE_PNG,  1, PNG_FILTER_SUB,  JDCT_ISLOW, 1 },
+    { "FrameWriter png",       BENCH_FRAME_WRITER, FRAME_WRITER_TYPE_PNG,  1, PNG_FILTER_SUB,  JDCT_IFAST, 1 },
+    { "FrameWriter png",       BENCH_FRAME_WRITER, FRAME_WRITER_TYPE_PNG,  1, PNG_FILTER_SUB,  JDCT_IFAST, 0 },
+    { "JPG::save(), islow",    BENCH_JPG_SAVE,     FRAME_WRITER_TYPE_JPG,  1, PNG_FILTER_SUB,  JDCT_ISLOW, 1 },
+    { "JPG::save(), ifast",    BENCH_JPG_SAVE,     FRAME_WRITER_TYPE_JPG,  1, PNG_FILTER_SUB,  JDCT_IFAST, 1 },
+    { "FrameWriter jpg",       BENCH_FRAME_WRITER, FRAME_WRITER_TYPE_JPG,  1, PNG_FILTER_SUB,  JDCT_IFAST, 1 },
+    { "FrameWriter jpg",       BENCH_FRAME_WRITER, FRAME_WRITER_TYPE_JPG,  1, PNG_FILTER_SUB,  JDCT_IFAST, 0 }
+  };
+  size_t num_tests = sizeof(tests) / sizeof(tests[0]);
+
+  if(!rx_create_path(rx_to_data_path(""))) {
+    printf("ERROR: cannot create the data directory.\n");
+    return EXIT_FAILURE;
+  }
+
+  bench_create_frames();
+
+  printf("\nImage, %dx%d RGB frames written per second (%d frames per test)\n", BENCH_WIDTH, BENCH_HEIGHT, BENCH_NUM_FRAMES);
+  printf("----------------------------------------------------------------\n");
+  printf("%24s %8s %10s %12s\n", "method", "threads", "fps", "KB per file");
+
+  for(size_t i = 0; i < num_tests; ++i) {
+    double kb = 0.0;
+    int num_threads = (tests[i].num_threads) ? tests[i].num_threads : threads;
+    double fps = bench_run(tests[i], threads, kb);
+    printf("%24s %8d %10.1f %12.0f\n", tests[i].name, num_threads, fps, kb);
+  }
+
+  printf("\n");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,208 @@
+/*
+
+  Mat4 benchmark
+  --------------
+  Compares the scalar Mat4 code with the SIMD kernels (see SIMD.h) for
+  multiply, batch multiply, inverse, affine inverse and the batch point
+  transform. Each kernel runs over the same set of random affine matrices
+  and we print millions of operations per second and the largest difference
+  between the two results. When the library is built without SSE/NEON (e.g.
+  with -DROXLU_NO_SIMD) both columns run the scalar code.
+
+  Run: ./build_release.sh && ../../bin/mat4_benchmark
+
+*/
+#include <roxlu/Roxlu.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#define BENCH_NUM_MATRICES 4096                                  /* number of matrices we run each kernel on */
+#define BENCH_NUM_POINTS (64 * 1024)                             /* number of points for the batch transforms */
+#define BENCH_MIN_MILLIS 300                                     /* we repeat a measurement until it took at least this long */
+
+enum BenchKernel {
+  BENCH_MULTIPLY,
+  BENCH_MULTIPLY_BATCH,
+  BENCH_INVERSE,
+  BENCH_AFFINE_INVERSE,
+  BENCH_TRANSFORM_POINTS
+};
+
+static std::vector<Mat4> bench_in;
+static std::vector<Mat4> bench_out;
+static std::vector<Vec3> bench_points;
+static std::vector<Vec3> bench_points_out;
+
+static float bench_random(float minV, float maxV) {
+  return minV + (maxV - minV) * (float(rand()) / float(RAND_MAX));
+}
+
+static void bench_create_matrices() {
+  bench_in.resize(BENCH_NUM_MATRICES);
+  bench_out.resize(BENCH_NUM_MATRICES);
+  for(size_t i = 0; i < bench_in.size(); ++i) {
+    Mat4 m;
+    m.rotateX(bench_random(0.0f, TWO_PI));
+    m.rotateY(bench_random(0.0f, TWO_PI));
+    m.rotateZ(bench_random(0.0f, TWO_PI));
+    m.scale(bench_random(0.5f, 2.0f), bench_random(0.5f, 2.0f), bench_random(0.5f, 2.0f));
+    m.setPosition(bench_random(-100.0f, 100.0f), bench_random(-100.0f, 100.0f), bench_random(-100.0f, 100.0f));
+    bench_in[i] = m;
+  }
+
+  bench_points.resize(BENCH_NUM_POINTS);
+  bench_points_out.resize(BENCH_NUM_POINTS);
+  for(size_t i = 0; i < bench_points.size(); ++i) {
+    bench_points[i].set(bench_random(-10.0f, 10.0f), bench_random(-10.0f, 10.0f), bench_random(-10.0f, 10.0f));
+  }
+}
+
+// The scalar multiply, like the non SIMD path of mat4_multiply()
+static void bench_multiply_scalar(const Mat4& a, const Mat4& b, Mat4& out) {
+  const float* m = a.m;
+  const float* o = b.m;
+  for(int j = 0; j < 16; j += 4) {
+    out.m[j + 0] = m[0] * o[j] + m[4] * o[j + 1] + m[8]  * o[j + 2] + m[12] * o[j + 3];
+    out.m[j + 1] = m[1] * o[j] + m[5] * o[j + 1] + m[9]  * o[j + 2] + m[13] * o[j + 3];
+    out.m[j + 2] = m[2] * o[j] + m[6] * o[j + 1] + m[10] * o[j + 2] + m[14] * o[j + 3];
+    out.m[j + 3] = m[3] * o[j] + m[7] * o[j + 1] + m[11] * o[j + 2] + m[15] * o[j + 3];
+  }
+}
+
+static void bench_transform_points_scalar(const Mat4& m, const Vec3* in, Vec3* out, size_t n) {
+  for(size_t i = 0; i < n; ++i) {
+    out[i] = m.transform(in[i]);
+  }
+}
+
+// Runs the kernel once over all matrices (or points) and returns the number of operations
+static size_t bench_run_once(BenchKernel kernel, bool simd) {
+  const Mat4& parent = bench_in[0];
+  size_t n = bench_in.size();
+
+  switch(kernel) {
+    case BENCH_MULTIPLY: {
+      for(size_t i = 0; i < n; ++i) {
+        if(simd) {
+          mat4_multiply(parent, bench_in[i], bench_out[i]);
+        }
+        else {
+          bench_multiply_scalar(parent, bench_in[i], bench_out[i]);
+        }
+      }
+      return n;
+    }
+    case BENCH_MULTIPLY_BATCH: {
+      if(simd) {
+        mat4_multiply(parent, &bench_in[0], &bench_out[0], n);
+      }
+      else {
+        for(size_t i = 0; i < n; ++i) {
+          bench_multiply_scalar(parent, bench_in[i], bench_out[i]);
+        }
+      }
+      return n;
+    }
+    case BENCH_INVERSE: {
+      for(size_t i = 0; i < n; ++i) {
+        if(simd) {
+          mat4_inverse(bench_in[i], bench_out[i]);
+        }
+        else {
+          mat4_inverse_scalar(bench_in[i], bench_out[i]);
+        }
+      }
+      return n;
+    }
+    case BENCH_AFFINE_INVERSE: {
+      for(size_t i = 0; i < n; ++i) {
+        bench_out[i] = (simd) ? affine_inverse(bench_in[i]) : affine_inverse_scalar(bench_in[i]);
+      }
+      return n;
+    }
+    case BENCH_TRANSFORM_POINTS: {
+      if(simd) {
+        parent.transformPoints(&bench_points[0], &bench_points_out[0], bench_points.size());
+      }
+      else {
+        bench_transform_points_scalar(parent, &bench_points[0], &bench_points_out[0], bench_points.size());
+      }
+      return bench_points.size();
+    }
+  };
+
+  return 0;
+}
+
+// Returns millions of operations per second
+static double bench_run(BenchKernel kernel, bool simd) {
+  int64_t start = rx_millis();
+  int64_t elapsed = 0;
+  size_t num_ops = 0;
+
+  do {
+    num_ops += bench_run_once(kernel, simd);
+    elapsed = rx_millis() - start;
+  } while(elapsed < BENCH_MIN_MILLIS);
+
+  return (double(num_ops) / 1000000.0) / (elapsed / 1000.0);
+}
+
+// Runs the kernel once with both implementations and returns the largest difference
+static float bench_max_error(BenchKernel kernel) {
+  float max_error = 0.0f;
+
+  if(kernel == BENCH_TRANSFORM_POINTS) {
+    bench_run_once(kernel, false);
+    std::vector<Vec3> expected = bench_points_out;
+    bench_run_once(kernel, true);
+    for(size_t i = 0; i < expected.size(); ++i) {
+      max_error = std::max<float>(max_error, fabsf(expected[i].x - bench_points_out[i].x));
+      max_error = std::max<float>(max_error, fabsf(expected[i].y - bench_points_out[i].y));
+      max_error = std::max<float>(max_error, fabsf(expected[i].z - bench_points_out[i].z));
+    }
+    return max_error;
+  }
+
+  bench_run_once(kernel, false);
+  std::vector<Mat4> expected = bench_out;
+  bench_run_once(kernel, true);
+  for(size_t i = 0; i < expected.size(); ++i) {
+    for(int j = 0; j < 16; ++j) {
+      max_error = std::max<float>(max_error, fabsf(expected[i].m[j] - bench_out[i].m[j]));
+    }
+  }
+  return max_error;
+}
+
+int main() {
+  const char* names[] = { "multiply", "multiply batch", "inverse", "affine inverse", "transform points" };
+  BenchKernel kernels[] = { BENCH_MULTIPLY, BENCH_MULTIPLY_BATCH, BENCH_INVERSE, BENCH_AFFINE_INVERSE, BENCH_TRANSFORM_POINTS };
+  size_t num_kernels = sizeof(kernels) / sizeof(kernels[0]);
+
+#if defined(ROXLU_USE_SSE)
+  const char* simd = "SSE";
+#elif defined(ROXLU_USE_NEON)
+  const char* simd = "NEON";
+#else
+  const char* simd = "none";
+#endif
+
+  srand(1);
+  bench_create_matrices();
+
+  printf("\nMat4, millions of operations per second (SIMD: %s)\n", simd);
+  printf("----------------------------------------------------------------\n");
+  printf("%18s %10s %10s %10s %12s\n", "kernel", "scalar", "simd", "speedup", "max error");
+
+  for(size_t i = 0; i < num_kernels; ++i) {
+    float max_error = bench_max_error(kernels[i]);
+    double scalar = bench_run(kernels[i], false);
+    double vectorized = bench_run(kernels[i], true);
+    printf("%18s %10.1f %10.1f %9.2fx %12g\n", names[i], scalar, vectorized, vectorized / scalar, max_error);
+  }
+
+  printf("\n");
+  return EXIT_SUCCESS;
+}
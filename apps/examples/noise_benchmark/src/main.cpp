@@ -0,0 +1,166 @@
+/*
+
+  Noise benchmark
+  ---------------
+  Measures how many million noise samples per second we generate with the
+  scalar functions (one call per sample), the batch functions (4 samples at
+  once with SSE2 when available) and the threaded Noise::fill(). All grids
+  are 512 x 512 (2D) or 64 x 64 x 64 (3D) with 4 octaves. We also print the
+  largest difference between the scalar fbm() and the batch results.
+
+  Run: ./build_release.sh && ../../bin/noise_benchmark
+
+*/
+#include <roxlu/Roxlu.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#define BENCH_SIZE_2D 512                                        /* width and height of the 2D grid */
+#define BENCH_SIZE_3D 64                                         /* width, height and depth of the 3D grid */
+#define BENCH_STEP 0.731f                                        /* distance between two samples */
+#define BENCH_MIN_MILLIS 300                                     /* we repeat a measurement until it took at least this long */
+
+enum BenchMethod {
+  BENCH_SCALAR_2D,
+  BENCH_FILL_2D,
+  BENCH_POINTS_2D,
+  BENCH_SCALAR_3D,
+  BENCH_FILL_3D,
+  BENCH_POINTS_3D
+};
+
+static NoiseSettings bench_settings;
+static std::vector<float> bench_out;
+static std::vector<float> bench_xy;
+static std::vector<float> bench_xyz;
+
+static void bench_setup() {
+  bench_settings.octaves = 4;
+  bench_settings.frequency = 0.01f;
+  bench_out.resize(BENCH_SIZE_2D * BENCH_SIZE_2D);
+
+  // the same coordinates as the grids, but interleaved for noise2() / noise3()
+  for(int j = 0; j < BENCH_SIZE_2D; ++j) {
+    for(int i = 0; i < BENCH_SIZE_2D; ++i) {
+      bench_xy.push_back(i * BENCH_STEP);
+      bench_xy.push_back(j * BENCH_STEP);
+    }
+  }
+
+  for(int k = 0; k < BENCH_SIZE_3D; ++k) {
+    for(int j = 0; j < BENCH_SIZE_3D; ++j) {
+      for(int i = 0; i < BENCH_SIZE_3D; ++i) {
+        bench_xyz.push_back(i * BENCH_STEP);
+        bench_xyz.push_back(j * BENCH_STEP);
+        bench_xyz.push_back(k * BENCH_STEP);
+      }
+    }
+  }
+}
+
+// Generates one grid and returns the number of samples
+static size_t bench_run_once(BenchMethod method, int numThreads) {
+  const int s2 = BENCH_SIZE_2D;
+  const int s3 = BENCH_SIZE_3D;
+
+  switch(method) {
+    case BENCH_SCALAR_2D: {
+      float* out = &bench_out[0];
+      for(int j = 0; j < s2; ++j) {
+        for(int i = 0; i < s2; ++i) {
+          *out++ = Noise::fbm(i * BENCH_STEP, j * BENCH_STEP, bench_settings);
+        }
+      }
+      return s2 * s2;
+    }
+    case BENCH_FILL_2D: {
+      Noise::fill(&bench_out[0], s2, s2, 0.0f, 0.0f, BENCH_STEP, bench_settings, numThreads);
+      return s2 * s2;
+    }
+    case BENCH_POINTS_2D: {
+      Noise::noise2(&bench_xy[0], &bench_out[0], s2 * s2, bench_settings);
+      return s2 * s2;
+    }
+    case BENCH_SCALAR_3D: {
+      float* out = &bench_out[0];
+      for(int k = 0; k < s3; ++k) {
+        for(int j = 0; j < s3; ++j) {
+          for(int i = 0; i < s3; ++i) {
+            *out++ = Noise::fbm(i * BENCH_STEP, j * BENCH_STEP, k * BENCH_STEP, bench_settings);
+          }
+        }
+      }
+      return s3 * s3 * s3;
+    }
+    case BENCH_FILL_3D: {
+      Noise::fill(&bench_out[0], s3, s3, s3, 0.0f, 0.0f, 0.0f, BENCH_STEP, bench_settings, numThreads);
+      return s3 * s3 * s3;
+    }
+    case BENCH_POINTS_3D: {
+      Noise::noise3(&bench_xyz[0], &bench_out[0], s3 * s3 * s3, bench_settings);
+      return s3 * s3 * s3;
+    }
+  };
+
+  return 0;
+}
+
+// Returns millions of samples per second
+static double bench_run(BenchMethod method, int numThreads) {
+  int64_t start = rx_millis();
+  int64_t elapsed = 0;
+  size_t num_samples = 0;
+
+  do {
+    num_samples += bench_run_once(method, numThreads);
+    elapsed = rx_millis() - start;
+  } while(elapsed < BENCH_MIN_MILLIS);
+
+  return (double(num_samples) / 1000000.0) / (elapsed / 1000.0);
+}
+
+// Largest difference between the scalar fbm() and the given batch method
+static float bench_max_error(BenchMethod scalar, BenchMethod batch) {
+  size_t n = bench_run_once(scalar, 1);
+  std::vector<float> expected(bench_out.begin(), bench_out.begin() + n);
+  bench_run_once(batch, 1);
+
+  float max_error = 0.0f;
+  for(size_t i = 0; i < n; ++i) {
+    max_error = std::max<float>(max_error, fabsf(expected[i] - bench_out[i]));
+  }
+  return max_error;
+}
+
+static void bench_print(const char* name, double samples, double baseline, float maxError) {
+  printf("%18s %12.2f %9.2fx %12g\n", name, samples, samples / baseline, maxError);
+}
+
+int main() {
+  int num_threads = 4;
+  char name[64];
+
+  bench_setup();
+
+  printf("\nNoise, millions of samples per second (%d octaves)\n", bench_settings.octaves);
+  printf("----------------------------------------------------------------\n");
+  printf("%18s %12s %10s %12s\n", "method", "samples", "speedup", "max error");
+
+  double scalar = bench_run(BENCH_SCALAR_2D, 1);
+  bench_print("2D fbm()", scalar, scalar, 0.0f);
+  bench_print("2D noise2()", bench_run(BENCH_POINTS_2D, 1), scalar, bench_max_error(BENCH_SCALAR_2D, BENCH_POINTS_2D));
+  bench_print("2D fill()", bench_run(BENCH_FILL_2D, 1), scalar, bench_max_error(BENCH_SCALAR_2D, BENCH_FILL_2D));
+  sprintf(name, "2D fill(), %d thr", num_threads);
+  bench_print(name, bench_run(BENCH_FILL_2D, num_threads), scalar, 0.0f);
+
+  scalar = bench_run(BENCH_SCALAR_3D, 1);
+  bench_print("3D fbm()", scalar, scalar, 0.0f);
+  bench_print("3D noise3()", bench_run(BENCH_POINTS_3D, 1), scalar, bench_max_error(BENCH_SCALAR_3D, BENCH_POINTS_3D));
+  bench_print("3D fill()", bench_run(BENCH_FILL_3D, 1), scalar, bench_max_error(BENCH_SCALAR_3D, BENCH_FILL_3D));
+  sprintf(name, "3D fill(), %d thr", num_threads);
+  bench_print(name, bench_run(BENCH_FILL_3D, num_threads), scalar, 0.0f);
+
+  printf("\n");
+  return EXIT_SUCCESS;
+}
@@ -25,6 +25,7 @@ Simulation::Simulation()
   ,gesture(NULL)
   ,state(STATE_NONE)
   ,realtime("realtime")
+  ,spotter(&protractor)
 {
 
 }
@@ -40,6 +41,7 @@ void Simulation::setup() {
 
   protractor.load("gestures.txt", true);
   input_gesture = new Gesture("input");
+  spotter.min_score = SPOTTER_MIN_SCORE;
 
 #if defined(USE_LEAPMOTION)
   lm.setup(lm_connect, lm_frame, this);
@@ -180,28 +182,13 @@ void Simulation::onMouseDrag(int x, int y, int dx, int dy, int button) {
       realtime.points.erase(realtime.points.begin());
     }
 
-    std::deque<Vec2> orig_points = realtime.points;
-    std::deque<Vec2> points = realtime.points;
-    int jump_size = 10;
-    for(size_t i = 0; i < points.size(); ++i) {
-      
-      float score = 0.0f;
-      realtime.points = points;
-      Gesture* realtime_matched = protractor.match(&realtime, &score);
-
-      if(realtime_matched) { 
-        //RX_VERBOSE("SCORE: %f, MATCHED: %p", score, realtime_matched);
-        //RX_VERBOSE("NAME: %s", realtime_matched->name.c_str());     
-      }
-      
-      if(points.size() < jump_size) {
-        break;
-      }
-      points.erase(points.begin(), points.begin() + jump_size);
+    spotter.addPoint(x, y);
 
+    float score = 0.0f;
+    Gesture* realtime_matched = spotter.spot(&score);
+    if(realtime_matched) { 
+      RX_VERBOSE("SCORE: %f, SPOTTED: %s", score, realtime_matched->name.c_str());
     }
-
-    realtime.points = orig_points;
   }
 }
 
@@ -15,6 +15,8 @@
 #define STATE_MATCH 3
 #define STATE_MATCH_REALTIME 4  /* match continously if the input contains a gesture */
 
+#define SPOTTER_MIN_SCORE 3.0f  /* the score is 1 / angular distance; 3.0 means the window is within ~19 degrees of a template */
+
 using namespace gl;
 using namespace protractor;
 
@@ -54,6 +56,7 @@ class Simulation : public SimulationBase {
   Gesture realtime;
 
   Protractor protractor;
+  GestureSpotter spotter;
   int state;
 
 #if defined(USE_LEAPMOTION)
@@ -0,0 +1,117 @@
+/*
+
+  Voronoi benchmark
+  -----------------
+  Measures what one frame costs with the DynamicDelaunay2D when only a part
+  of the sites change. Each frame we remove BENCH_CHANGES random sites and
+  insert the same number of new ones (like particles which die and spawn),
+  or move that many sites. We compare this with moving all sites and
+  triangulating them again with rebuild(), and print how long computeCells()
+  takes. All times are milliseconds per frame.
+
+  Run: ./build_release.sh && ../../bin/voronoi_benchmark [threads]
+
+*/
+#include <roxlu/Roxlu.h>
+#include <DynamicDelaunay2D.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define BENCH_MIN_MILLIS 300                                     /* we repeat a measurement until it took at least this long */
+
+enum BenchMethod {
+  BENCH_INSERT_REMOVE,
+  BENCH_MOVE,
+  BENCH_REBUILD,
+  BENCH_CELLS
+};
+
+static float bench_random() {
+  return float(rand()) / float(RAND_MAX);
+}
+
+// One frame: changes `numChanges` sites with the given method
+static void bench_frame(BenchMethod method, roxlu::DynamicDelaunay2D& del, std::vector<int>& ids, size_t numChanges) {
+  switch(method) {
+    case BENCH_INSERT_REMOVE: {
+      for(size_t i = 0; i < numChanges; ++i) {
+        size_t dx = rand() % ids.size();
+        del.remove(ids[dx]);
+        ids[dx] = del.insert(bench_random(), bench_random());
+      }
+      break;
+    }
+    case BENCH_MOVE: {
+      for(size_t i = 0; i < numChanges; ++i) {
+        del.move(ids[rand() % ids.size()], bench_random(), bench_random());
+      }
+      break;
+    }
+    case BENCH_REBUILD: {
+      for(size_t i = 0; i < ids.size(); ++i) {
+        del.setPosition(ids[i], bench_random(), bench_random());
+      }
+      del.rebuild();
+      break;
+    }
+    case BENCH_CELLS: {
+      del.computeCells();
+      break;
+    }
+  };
+}
+
+// Returns milliseconds per frame
+static double bench_run(BenchMethod method, size_t numSites, size_t numChanges, int numThreads) {
+  roxlu::DynamicDelaunay2D del;
+  std::vector<int> ids;
+
+  del.setup(0.0f, 1.0f, 0.0f, 1.0f, numThreads);
+  for(size_t i = 0; i < numSites; ++i) {
+    ids.push_back(del.insert(bench_random(), bench_random()));
+  }
+
+  int64_t start = rx_millis();
+  int64_t elapsed = 0;
+  size_t num_frames = 0;
+
+  do {
+    bench_frame(method, del, ids, numChanges);
+    ++num_frames;
+    elapsed = rx_millis() - start;
+  } while(elapsed < BENCH_MIN_MILLIS);
+
+  return double(elapsed) / num_frames;
+}
+
+int main(int argc, char** argv) {
+  size_t sites[] = { 1000, 10000, 50000 };
+  size_t changes[] = { 10, 100, 1000 };
+  size_t num_sites = sizeof(sites) / sizeof(sites[0]);
+  size_t num_changes = sizeof(changes) / sizeof(changes[0]);
+  int threads = (argc > 1) ? atoi(argv[1]) : 4;
+
+  if(threads <= 0) {
+    printf("ERROR: invalid number of threads: %d\n", threads);
+    return EXIT_FAILURE;
+  }
+
+  srand(1);
+
+  printf("\nDynamicDelaunay2D, milliseconds per frame (%d thread(s) for rebuild() and computeCells())\n", threads);
+  printf("--------------------------------------------------------------------------------\n");
+  printf("%8s %10s %15s %10s %10s %10s\n", "sites", "changes", "insert+remove", "move", "rebuild", "cells");
+
+  for(size_t i = 0; i < num_sites; ++i) {
+    double rebuild = bench_run(BENCH_REBUILD, sites[i], 0, threads);
+    double cells = bench_run(BENCH_CELLS, sites[i], 0, threads);
+    for(size_t j = 0; j < num_changes; ++j) {
+      double insert_remove = bench_run(BENCH_INSERT_REMOVE, sites[i], changes[j], threads);
+      double move = bench_run(BENCH_MOVE, sites[i], changes[j], threads);
+      printf("%8zu %10zu %15.3f %10.3f %10.3f %10.3f\n", sites[i], changes[j], insert_remove, move, rebuild, cells);
+    }
+  }
+
+  printf("\n");
+  return EXIT_SUCCESS;
+}
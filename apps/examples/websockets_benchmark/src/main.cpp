@@ -0,0 +1,161 @@
+/*
+
+  WebSockets benchmark
+  --------------------
+  Measures how many MB/s of masked client frames the WebSocketFrameParser
+  parses (header parsing, unmasking and reassembly), for different payload
+  sizes. Each stream is fed to the parser in 4096 byte reads, like we get
+  them from libevent, and in one call. We also compare the unmasking with
+  the byte wise loop we used before.
+
+  Run: ./build_release.sh && ../../bin/websockets_benchmark
+
+*/
+#include <roxlu/Roxlu.h>
+#include <websockets/WebSockets.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define BENCH_STREAM_SIZE (32 * 1024 * 1024)                     /* number of payload bytes per stream */
+#define BENCH_READ_SIZE 4096                                     /* size of the reads we feed to the parser */
+#define BENCH_MIN_MILLIS 300                                     /* we repeat a measurement until it took at least this long */
+
+struct BenchResult {
+  BenchResult():num_frames(0),num_bytes(0) {}
+  size_t num_frames;
+  size_t num_bytes;
+};
+
+void bench_on_frame(WebSocketFrame* frame, void* user) {
+  BenchResult* r = static_cast<BenchResult*>(user);
+  r->num_frames++;
+  r->num_bytes += frame->getSize();
+}
+
+// Creates masked client frames; when numFragments > 1 each message is split into fragments
+static void bench_create_stream(size_t payloadSize, int numFragments, std::vector<ev_uint8_t>& stream, size_t& numMessages) {
+  std::vector<ev_uint8_t> payload(payloadSize);
+  for(size_t i = 0; i < payloadSize; ++i) {
+    payload[i] = rand() & 0xFF;
+  }
+
+  stream.clear();
+  numMessages = std::max<size_t>(1, BENCH_STREAM_SIZE / payloadSize);
+  size_t fragment_size = payloadSize / numFragments;
+
+  for(size_t i = 0; i < numMessages; ++i) {
+    size_t offset = 0;
+    for(int f = 0; f < numFragments; ++f) {
+      size_t len = (f == numFragments - 1) ? (payloadSize - offset) : fragment_size;
+      ev_uint8_t header[WS_MAX_HEADER_SIZE];
+      ev_uint8_t opcode = (f == 0) ? 0x02 : 0x00;
+      size_t header_size = websocket_encode_header(header, opcode, f == numFragments - 1, false, len);
+      header[1] |= 0x80; // client frames are masked
+
+      ev_uint8_t mask[4] = { (ev_uint8_t)rand(), (ev_uint8_t)rand(), (ev_uint8_t)rand(), (ev_uint8_t)rand() };
+      stream.insert(stream.end(), header, header + header_size);
+      stream.insert(stream.end(), mask, mask + 4);
+
+      size_t start = stream.size();
+      stream.insert(stream.end(), payload.begin() + offset, payload.begin() + offset + len);
+      websocket_unmask(&stream[start], len, mask, 0);
+      offset += len;
+    }
+  }
+}
+
+static double bench_parse(std::vector<ev_uint8_t>& stream, size_t readSize, size_t numMessages) {
+  WebSocketFrameParser parser;
+  BenchResult result;
+  parser.setup(bench_on_frame, &result);
+
+  int64_t start = rx_millis();
+  int64_t elapsed = 0;
+  size_t num_runs = 0;
+
+  do {
+    for(size_t dx = 0; dx < stream.size(); dx += readSize) {
+      size_t nbytes = std::min<size_t>(readSize, stream.size() - dx);
+      if(parser.parse(&stream[dx], nbytes) != WS_PARSE_OK) {
+        printf("ERROR: the parser failed on our stream.\n");
+        ::exit(EXIT_FAILURE);
+      }
+    }
+    num_runs++;
+    elapsed = rx_millis() - start;
+  } while(elapsed < BENCH_MIN_MILLIS);
+
+  if(result.num_frames != num_runs * numMessages) {
+    printf("ERROR: expected %zu messages, got %zu.\n", num_runs * numMessages, result.num_frames);
+    ::exit(EXIT_FAILURE);
+  }
+
+  return (double(stream.size()) * num_runs / (1024.0 * 1024.0)) / (elapsed / 1000.0);
+}
+
+// The unmasking we used before: one byte at a time with a modulo
+static void bench_unmask_bytewise(ev_uint8_t* data, size_t nbytes, const ev_uint8_t* mask) {
+  for(size_t i = 0; i < nbytes; ++i) {
+    data[i] = data[i] ^ mask[i % 4];
+  }
+}
+
+static double bench_unmask(bool bytewise) {
+  std::vector<ev_uint8_t> data(1024 * 1024, 0x33);
+  ev_uint8_t mask[4] = { 0x12, 0x34, 0x56, 0x78 };
+  int64_t start = rx_millis();
+  int64_t elapsed = 0;
+  size_t num_runs = 0;
+
+  do {
+    for(int i = 0; i < 64; ++i) {
+      if(bytewise) {
+        bench_unmask_bytewise(&data[0], data.size(), mask);
+      }
+      else {
+        websocket_unmask(&data[0], data.size(), mask, 0);
+      }
+    }
+    num_runs += 64;
+    elapsed = rx_millis() - start;
+  } while(elapsed < BENCH_MIN_MILLIS);
+
+  // use the result so the compiler doesn't remove the loops
+  if(data[0] == 0x01 && data[1] == 0x02) {
+    printf(".");
+  }
+
+  return double(num_runs) / (elapsed / 1000.0);
+}
+
+int main() {
+  size_t sizes[] = { 16, 125, 1024, 16 * 1024, 64 * 1024, 1024 * 1024 };
+  size_t num_sizes = sizeof(sizes) / sizeof(sizes[0]);
+  std::vector<ev_uint8_t> stream;
+  size_t num_messages = 0;
+
+  printf("\nParse, MB/s of frames\n");
+  printf("----------------------------------------------------------------\n");
+  printf("%12s %12s %16s %16s\n", "payload", "fragments", "4096 byte reads", "one call");
+
+  for(size_t i = 0; i < num_sizes; ++i) {
+    int fragments[] = { 1, 4 };
+    for(int f = 0; f < 2; ++f) {
+      if(sizes[i] < 1024 && fragments[f] > 1) {
+        continue;
+      }
+      bench_create_stream(sizes[i], fragments[f], stream, num_messages);
+      double reads = bench_parse(stream, BENCH_READ_SIZE, num_messages);
+      double whole = bench_parse(stream, stream.size(), num_messages);
+      printf("%12zu %12d %16.1f %16.1f\n", sizes[i], fragments[f], reads, whole);
+    }
+  }
+
+  printf("\nUnmask, MB/s\n");
+  printf("----------------------------------------------------------------\n");
+  printf("%12s %12.1f\n", "byte wise", bench_unmask(true));
+  printf("%12s %12.1f\n", "vectorized", bench_unmask(false));
+  printf("\n");
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,144 @@
+/*
+
+  FileWatcher
+  -----------
+  Reloads assets (shaders, fonts, images, ...) when their files change,
+  without rescanning directories and without reloading everything.
+
+  - addAsset() registers a file with two callbacks. The load callback runs
+    on the watcher thread, so you can read and parse the file there without
+    stalling your frame. The apply callback runs from update() on the
+    thread that draws, e.g. to upload the new data to the GPU. Both are
+    optional. Return false from the load callback to skip apply (e.g. when
+    the new shader doesn't compile).
+  - addDependency() tells the watcher that an asset uses another file, e.g.
+    a shader which includes a glsl file. When the dependency changes, all
+    assets that use it (directly or through other dependencies) are
+    reloaded.
+  - Events are coalesced: a file is only handled when it didn't change for
+    `delay` milliseconds, so an editor that writes a file in a couple of
+    steps triggers one reload, and an asset whose dependencies changed
+    together is reloaded once.
+  - On Linux we watch the directories of the files with inotify, which also
+    catches editors that save to a temporary file and rename it. On other
+    platforms the watcher thread checks the modification times of the
+    registered files each `delay` milliseconds.
+  - addAsset() does not load the asset; load it yourself at startup.
+
+  Examples
+  --------
+
+      bool load_shader(const std::string& filepath, void* user) {
+        Shader* s = static_cast<Shader*>(user);
+        return s->loadSource();                                  // reads the files, on the watcher thread
+      }
+
+      void apply_shader(const std::string& filepath, void* user) {
+        static_cast<Shader*>(user)->compile();                   // GL, on the draw thread
+      }
+
+      FileWatcher watcher;
+      watcher.addAsset(rx_to_data_path("shader.frag"), load_shader, apply_shader, &shader);
+      watcher.addDependency(rx_to_data_path("shader.frag"), rx_to_data_path("noise.glsl"));
+      watcher.start();
+
+      // each frame
+      watcher.update();
+
+*/
+#ifndef ROXLU_FILE_WATCHER_H
+#define ROXLU_FILE_WATCHER_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <stdint.h>
+#include <time.h>
+#include <roxlu/core/Log.h>
+
+#if defined(_WIN32)
+#  include <windows.h>
+#else
+#  include <pthread.h>
+#endif
+
+#define RX_FILE_WATCHER_DEFAULT_DELAY 100                                    /* default number of millis a file must be unchanged before we reload */
+
+#define ERR_FW_WATCH_ALREADY_STARTED "The file watcher is already started"
+#define ERR_FW_WATCH_INIT "Cannot initialize inotify: %s"
+#define ERR_FW_WATCH_THREAD "Cannot create the file watcher thread"
+#define ERR_FW_WATCH_DIR "Cannot watch the directory: %s, %s"
+#define ERR_FW_WATCH_READ "Cannot read the inotify events: %s"
+#define ERR_FW_WATCH_ASSET_EXISTS "The asset is already added: %s"
+#define ERR_FW_WATCH_NO_ASSET "Asset not found: %s"
+#define ERR_FW_WATCH_SELF_DEPENDENCY "A file cannot depend on itself: %s"
+
+typedef bool(*rx_asset_load_cb)(const std::string& filepath, void* user);  /* runs on the watcher thread; return false to skip the apply callback */
+typedef void(*rx_asset_apply_cb)(const std::string& filepath, void* user); /* runs on the thread that calls FileWatcher::update() */
+
+struct FileWatcherAsset {
+  FileWatcherAsset();
+  std::string filepath;
+  rx_asset_load_cb cb_load;
+  rx_asset_apply_cb cb_apply;
+  void* user;
+};
+
+#if defined(_WIN32)
+DWORD WINAPI file_watcher_thread_function(LPVOID user);                     /* runs FileWatcher::run() */
+#else
+void* file_watcher_thread_function(void* user);                            /* runs FileWatcher::run() */
+#endif
+
+class FileWatcher {
+ public:
+  FileWatcher();
+  ~FileWatcher();
+  bool start(int delayMillis = RX_FILE_WATCHER_DEFAULT_DELAY);             /* starts the watcher thread */
+  void stop();
+  bool addAsset(std::string filepath, rx_asset_load_cb loadCb, rx_asset_apply_cb applyCb, void* user = NULL); /* watches the file and calls the callbacks when it or one of its dependencies changes */
+  bool removeAsset(std::string filepath);                                  /* stops reloading the asset; its dependencies stay registered */
+  bool addDependency(std::string filepath, std::string dependency);        /* reload `filepath` when `dependency` changes; filepath can be an asset or another dependency */
+  void update();                                                           /* calls the apply callbacks of the reloaded assets; call this on the thread that draws */
+  void run();                                                              /* the watcher thread; don't call this yourself */
+
+ private:
+  std::string normalizePath(std::string filepath);                         /* makes the paths of assets and events comparable */
+  bool watchFile(const std::string& filepath);                             /* starts watching the file (or its directory); lock first */
+  void collectAssets(const std::string& filepath, std::set<std::string>& visited, std::vector<std::string>& result); /* finds the assets that need a reload when filepath changed; lock first */
+  void readEvents();                                                       /* reads the file system events and marks the changed files */
+  void reloadChangedFiles();                                               /* reloads the assets of files which didn't change for `delay` millis */
+  void lock();
+  void unlock();
+
+ public:
+  std::map<std::string, FileWatcherAsset*> assets;
+  std::map<std::string, std::set<std::string> > dependents;               /* file -> files that depend on it */
+  std::map<std::string, int64_t> changed;                                  /* changed files -> time of their last change, we wait until they're unchanged for `delay` millis */
+  std::vector<std::string> ready;                                          /* loaded assets that wait for their apply callback */
+  std::vector<std::string> applying;                                       /* swapped with ready in update() */
+  std::set<std::string> files;                                             /* all assets and dependencies */
+  int delay;
+  bool must_stop;
+  bool is_started;
+
+#if defined(__linux)
+  int fd;                                                                  /* inotify */
+  std::map<int, std::string> watch_dirs;                                   /* inotify watch descriptor -> directory */
+  std::map<std::string, int> dir_watches;                                  /* directory -> inotify watch descriptor */
+  std::vector<char> event_buffer;
+#else
+  std::map<std::string, time_t> mtimes;                                    /* last modification time of each file */
+#endif
+
+#if defined(_WIN32)
+  HANDLE thread;
+  CRITICAL_SECTION mutex;
+#else
+  pthread_t thread;
+  pthread_mutex_t mutex;                                                   /* protects everything above except the settings */
+#endif
+};
+
+#endif
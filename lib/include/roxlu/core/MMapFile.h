@@ -0,0 +1,113 @@
+/*
+
+  rx_mmap_file
+  ------------
+  Maps a file into memory so you can read (and write) it without copying it
+  into a buffer first. The file is unmapped when the rx_mmap_file goes out of
+  scope. Use the advise() hints to tell the OS how you're going to access the
+  file, e.g. RX_MMAP_SEQUENTIAL when you parse it from begin to end.
+
+  - RX_MMAP_READ maps an existing file read only.
+  - RX_MMAP_READ_WRITE maps a file so you can change it; the changes are
+    written back to the file. When you pass `nbytes`, the file is created
+    and/or resized to this size first.
+  - Mapping an empty file succeeds; ptr() returns NULL and size() 0.
+
+  rx_read_file() is the fast path for when you want a copy of the whole file:
+  it sizes the result once from the file size and reads it with a single
+  read() call.
+
+  Examples
+  --------
+
+      rx_mmap_file file;
+      if(file.open("mesh.obj")) {
+        file.advise(RX_MMAP_SEQUENTIAL);
+        parse(file.ptr(), file.size());
+      }
+
+      std::string json;
+      rx_read_file("settings.json", json);
+
+*/
+#ifndef ROXLU_MMAP_FILE_H
+#define ROXLU_MMAP_FILE_H
+
+#include <string>
+#include <vector>
+#include <stddef.h>
+#include <roxlu/core/Log.h>
+
+#if defined(_WIN32)
+#  include <windows.h>
+#endif
+
+#define RX_MMAP_READ 0
+#define RX_MMAP_READ_WRITE 1
+
+#define RX_MMAP_NORMAL 0                                                       /* no special treatment */
+#define RX_MMAP_SEQUENTIAL 1                                                   /* read ahead aggressively, pages can be freed soon after they're read */
+#define RX_MMAP_RANDOM 2                                                       /* don't read ahead */
+#define RX_MMAP_WILLNEED 3                                                     /* start reading the pages now */
+#define RX_MMAP_DONTNEED 4                                                     /* we're done with the pages */
+
+#define ERR_MMAP_ALREADY_OPEN "The file is already mapped, close() it first: %s"
+#define ERR_MMAP_OPEN "Cannot open the file: %s, %s"
+#define ERR_MMAP_STAT "Cannot get the size of: %s, %s"
+#define ERR_MMAP_RESIZE "Cannot resize: %s to %ld bytes, %s"
+#define ERR_MMAP_MAP "Cannot map the file: %s, %s"
+#define ERR_MMAP_MODE "Invalid mmap mode: %d"
+#define ERR_MMAP_NOT_OPEN "The file isn't mapped"
+#define ERR_MMAP_ADVISE "Cannot apply the mmap advice: %d, %s"
+#define ERR_MMAP_RANGE "Invalid range: offset %ld, %ld bytes for a file of %ld bytes"
+#define ERR_MMAP_SYNC "Cannot sync the mapped file: %s"
+#define ERR_READ_FILE_OPEN "Cannot open file: '%s', %s"
+#define ERR_READ_FILE_READ "Cannot read file: '%s', %s"
+
+class rx_mmap_file {
+ public:
+  rx_mmap_file();
+  ~rx_mmap_file();                                                           /* unmaps the file */
+  bool open(std::string filepath, int mode = RX_MMAP_READ, size_t nbytes = 0); /* maps the file, nbytes is only used with RX_MMAP_READ_WRITE */
+  void close();
+  bool advise(int advice, size_t offset = 0, size_t nbytes = 0);             /* RX_MMAP_{NORMAL, SEQUENTIAL, RANDOM, WILLNEED, DONTNEED} for the given range, nbytes 0 = until the end */
+  bool sync();                                                               /* writes the changes of a RX_MMAP_READ_WRITE mapping to disk and waits until they're written */
+  char* ptr();
+  size_t size();
+  bool isOpen();
+
+ private:
+  rx_mmap_file(const rx_mmap_file& other);                                   /* not copyable, the mapping is owned by one object */
+  rx_mmap_file& operator=(const rx_mmap_file& other);
+
+ public:
+  std::string filepath;
+  int mode;
+  char* data;                                                                /* the mapped memory, NULL for empty files */
+  size_t nbytes;                                                             /* size of the mapping */
+  bool is_open;
+#if defined(_WIN32)
+  HANDLE file_handle;
+  HANDLE map_handle;
+#else
+  int fd;
+#endif
+};
+
+bool rx_read_file(std::string filepath, std::string& result);               /* reads the whole file with one read() into result, which is sized from the file size */
+bool rx_read_file(std::string filepath, std::vector<char>& result);
+bool rx_read_file(std::string filepath, std::vector<unsigned char>& result);
+
+inline char* rx_mmap_file::ptr() {
+  return data;
+}
+
+inline size_t rx_mmap_file::size() {
+  return nbytes;
+}
+
+inline bool rx_mmap_file::isOpen() {
+  return is_open;
+}
+
+#endif
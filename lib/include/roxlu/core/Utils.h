@@ -5,6 +5,7 @@
 #include <roxlu/opengl/Error.h>
 #include <roxlu/core/Constants.h>
 #include <roxlu/core/Log.h>
+#include <roxlu/core/MMapFile.h>
 #include <stdio.h>
 #include <time.h>
 #include <string.h>
@@ -353,16 +354,8 @@ static std::string rx_get_file_contents(std::string filepath, bool datapath = fa
     filepath = rx_to_data_path(filepath);
   }
 
-  std::string result = "";
-  std::string line = "";
-  std::ifstream ifs(filepath.c_str());
-  if(!ifs.is_open()) {
-    RX_ERROR("Cannot open file: '%s'", filepath.c_str());
-    return result;
-  }
-  while(getline(ifs,line)) {
-    result += line +"\n";
-  }
+  std::string result;
+  rx_read_file(filepath, result);
   return result;
 }
 
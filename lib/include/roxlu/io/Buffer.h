@@ -9,6 +9,7 @@
 #include <algorithm>
 
 #include <roxlu/Roxlu.h>
+#include <roxlu/core/MMapFile.h>
 
 /* When on a little endian machine swap bytes */
 #define USE_LITTLE_ENDIAN
@@ -75,6 +76,7 @@ class Buffer {
  public:
 	Buffer();
   Buffer(char* data, size_t nbytes);
+  Buffer(rx_mmap_file& file); // reads directly from the mapped file without copying it; the file must stay open while you use the buffer. The data is copied when you write to the buffer.
   ~Buffer();
 
 	bool loadFile(const char* file);
@@ -202,12 +204,21 @@ class Buffer {
 	void compareWith(Buffer& other, int start, int stop);
 
  private:
+	rx_uint8* bytes(); // the mapped file or data
+	void detach(); // copies the mapped file into data so we can write to it
+
 	rx_uint32 read_dx;
 	std::vector<rx_uint8> data;
+	rx_uint8* view; // the mapped file we read from, NULL when we use data
+	size_t view_nbytes;
 };
 
+inline rx_uint8* Buffer::bytes() {
+	return (view) ? view : &data[0];
+}
+
 inline rx_uint8 Buffer::operator[](const unsigned int dx) {
-	return data[dx];
+	return bytes()[dx];
 }
 
 inline rx_uint32 Buffer::getReadIndex() {
@@ -215,23 +226,25 @@ inline rx_uint32 Buffer::getReadIndex() {
 }
 
 inline size_t Buffer::size() {
-	return data.size();
+	return (view) ? view_nbytes : data.size();
 }
 
 inline rx_uint8* Buffer::getPtr() {
-	return &data[0];
+	return bytes();
 }
 
 inline char* Buffer::ptr() {
-	return (char*)&data[0];
+	return (char*)bytes();
 }
 
 inline rx_uint8* Buffer::getReadPtr() {
-	return &data[read_dx];
+	return bytes() + read_dx;
 }
 
 inline void Buffer::clear() {
 	data.clear();
+	view = NULL;
+	view_nbytes = 0;
 	read_dx = 0;
 }
 
@@ -7,6 +7,7 @@
 #include <cstdlib>
 #include <roxlu/core/platform/Platform.h>
 #include <roxlu/core/Log.h>
+#include <roxlu/core/MMapFile.h>
 #include <sys/stat.h>
 #include <stdio.h>
 #include <errno.h>
@@ -61,21 +62,12 @@ namespace roxlu {
       of.close();
     }
 
-    // @todo > switch over to rx_get_file_contents
     static string getFileContents(string file, bool inDataPath = true) {
       if(inDataPath) {
         file = File::toDataPath(file);
       }
-      std::string result = "";
-      std::string line = "";
-      std::ifstream ifs(file.c_str());
-      if(!ifs.is_open()) {
-        RX_ERROR("File: cannot open file: '%s'", file.c_str());
-        return result;
-      }
-      while(getline(ifs,line)) {
-        result += line +"\n";
-      }
+      std::string result;
+      rx_read_file(file, result);
       return result;
     }
 	
@@ -5,11 +5,14 @@
 #include <iomanip>
 #include <cstring> // memcpy
 #include <stdio.h>
+#include <roxlu/math/SIMD.h>
 #include <roxlu/math/Vec4.h>
 #include <roxlu/math/Vec3.h>
 
 // see here: https://github.com/evanw/gl4/blob/master/gl4.cpp
 // 2012.09, rotation is in RADIANS! (was in degrees)
+// 2013.10, multiply, inverse, affine inverse and the batch transforms use SSE/NEON when available (see SIMD.h).
+//          Define ROXLU_MAT4_ALIGNED to store the matrix 16 byte aligned.
 using std::ostream;
 
 namespace roxlu {
@@ -109,6 +112,10 @@ namespace roxlu {
     // rotate and translate
     inline Vec3 transform(const Vec3& v) const;
 
+    // batch transforms; `in` and `out` may be the same array
+    void transformPoints(const Vec3* in, Vec3* out, size_t n) const; // rotate and translate `n` points (w = 1)
+    void transformPoints(const Vec4* in, Vec4* out, size_t n) const; // full 4x4 transform of `n` vectors
+
     Mat4& operator+=(const Mat4& o);
     Mat4& operator-=(const Mat4& o);
     Mat4& operator*=(const Mat4& o);
@@ -130,7 +137,11 @@ namespace roxlu {
     inline float* getPtr() { return &m[0]; }
     inline const float* getPtr() const { return &m[0]; }
 	
+#if defined(ROXLU_MAT4_ALIGNED)
+    ROXLU_ALIGN16 float m[16];
+#else
     float m[16];
+#endif
 	
     // stream operator, debug.
     void print() const;
@@ -138,9 +149,17 @@ namespace roxlu {
   };
 
   extern Mat4 operator*(float s, const Mat4& o);
-  extern Mat4 affine_inverse(const Mat4& o);
+  extern Mat4 affine_inverse(const Mat4& o);                                           // uses SSE when available
+  extern Mat4 affine_inverse_scalar(const Mat4& o);                                    // the non SIMD fallback
   extern Mat4 transpose(const Mat4& o);
-  extern int mat4_inverse(const Mat4& o, Mat4& out);
+  extern int mat4_inverse(const Mat4& o, Mat4& out);                                   // returns 0 when the matrix can't be inverted; uses SSE when available
+  extern int mat4_inverse_scalar(const Mat4& o, Mat4& out);                            // gauss-jordan with partial pivoting (the non SIMD fallback)
+#if defined(ROXLU_USE_SSE)
+  extern int mat4_inverse_sse(const Mat4& o, Mat4& out);                               // cramer's rule
+  extern Mat4 affine_inverse_sse(const Mat4& o);
+#endif
+  extern void mat4_multiply(const Mat4& a, const Mat4& b, Mat4& out);                  // out = a * b, `out` may be `a` or `b`
+  extern void mat4_multiply(const Mat4& a, const Mat4* b, Mat4* out, size_t n);       // out[i] = a * b[i], e.g. parent * local transforms
 
   inline Mat4::Mat4() {
     m[0]  = 1.0f;
@@ -186,6 +205,8 @@ namespace roxlu {
     m[11] = m11;
     m[12] = m12;
     m[13] = m13;
+    m[14] = m14;
+    m[15] = m15;
   }
 
   inline Mat4::Mat4(Vec3 axX, Vec3 axY, Vec3 axZ, Vec3 pos) {
@@ -7,7 +7,35 @@
  * Copyright  2003-2011, Stefan Gustavson
  * Contact: stegu@itn.liu.se
  * URL: http://staffwww.itn.liu.se/~stegu/aqsis/aqsis-newnoise/
+ *
+ * Batch functions
+ * ---------------
+ * The `fill()` and `noise2()/noise3()` functions compute 4 samples at once using 
+ * SSE2 (when available, see SIMD.h) and apply fractal brownian motion / turbulence 
+ * with the given `NoiseSettings`. When you pass `numThreads > 1` to `fill()` the rows
+ * of the grid are split into bands which are computed on separate threads.
+ *
+ *   NoiseSettings ns;
+ *   ns.octaves = 4;
+ *   ns.frequency = 0.01f;
+ *   std::vector<float> field(w * h);
+ *   Noise::fill(&field[0], w, h, 0.0f, 0.0f, 1.0f, ns, 4);
+ *
  */
+#ifndef ROXLU_NOISEH
+#define ROXLU_NOISEH
+
+#include <stddef.h>
+
+/* Fractal settings for fbm() and the batch functions; the defaults give plain noise */
+struct NoiseSettings {
+  NoiseSettings();
+  int octaves;                                                     /* number of noise layers which are added together */
+  float frequency;                                                 /* the input coordinates are multiplied by this value */
+  float lacunarity;                                                /* frequency multiplier for each next octave */
+  float gain;                                                      /* amplitude multiplier for each next octave */
+  bool turbulence;                                                 /* when true we add abs(noise), the result is between 0.0f and 1.0f */
+};
 
 class Noise {
 
@@ -28,6 +56,22 @@ class Noise {
     static float unoise( float x, float y, float z );
     static float unoise( float x, float y, float z, float w );
 
+    /* FRACTAL: sum of octaves, normalized to -1.0f - 1.0f (or 0.0f - 1.0f for turbulence) */
+    static float fbm( float x, float y, const NoiseSettings& settings );
+    static float fbm( float x, float y, float z, const NoiseSettings& settings );
+
+    /* BATCH: fill a w * h (* d) grid, row major; sample (i,j,k) is taken at (x + i * step, y + j * step, z + k * step) */
+    static void fill( float* out, int w, int h, float x, float y, float step, const NoiseSettings& settings, int numThreads = 1 );
+    static void fill( float* out, int w, int h, int d, float x, float y, float z, float step, const NoiseSettings& settings, int numThreads = 1 );
+
+    /* BATCH: evaluate n points; `xy` / `xyz` are interleaved coordinates (e.g. an array of Vec2 / Vec3) */
+    static void noise2( const float* xy, float* out, size_t n, const NoiseSettings& settings );
+    static void noise3( const float* xyz, float* out, size_t n, const NoiseSettings& settings );
+
+    /* used by the batch functions; evaluates 4 samples at the given coordinates */
+    static void fbm4( const float* x, const float* y, float* out, const NoiseSettings& settings );
+    static void fbm4( const float* x, const float* y, const float* z, float* out, const NoiseSettings& settings );
+
   private:
     static unsigned char perm[];
     static float grad( int hash, float x );
@@ -36,4 +80,4 @@ class Noise {
     static float grad( int hash, float x, float y, float z, float t );
 };
 
-
+#endif
@@ -0,0 +1,78 @@
+/*
+
+  # SIMD
+
+  Detects which SIMD instruction set we can use for the math kernels (Mat4 multiply,
+  inverse and the batch transforms). Define `ROXLU_NO_SIMD` to force the scalar code
+  paths (e.g. to compare results or performance).
+
+  - `ROXLU_USE_SSE`   is defined for x86/x64 builds with SSE (always true on x64).
+  - `ROXLU_USE_NEON`  is defined for ARM builds with NEON.
+  - `ROXLU_ALIGN16`   use this to declare 16 byte aligned storage, e.g.
+                      `ROXLU_ALIGN16 float data[16];`. All kernels use unaligned loads
+                      so aligned storage is optional, but it avoids loads which cross
+                      a cache line.
+  - `rx_aligned_malloc()` / `rx_aligned_free()` allocate aligned arrays for batch transforms.
+
+ */
+#ifndef ROXLU_MATH_SIMD_H
+#define ROXLU_MATH_SIMD_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#if !defined(ROXLU_NO_SIMD)
+#  if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#    define ROXLU_USE_SSE
+#    include <xmmintrin.h>
+#  elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#    define ROXLU_USE_NEON
+#    include <arm_neon.h>
+#  endif
+#endif
+
+#if defined(_MSC_VER)
+#  define ROXLU_ALIGN16 __declspec(align(16))
+#  include <malloc.h>
+#else
+#  define ROXLU_ALIGN16 __attribute__((aligned(16)))
+#endif
+
+// allocate `nbytes` with the given alignment (must be a power of two); free with rx_aligned_free()
+static inline void* rx_aligned_malloc(size_t nbytes, size_t alignment = 16) {
+#if defined(_MSC_VER)
+  return _aligned_malloc(nbytes, alignment);
+#else
+  void* ptr = NULL;
+  if(posix_memalign(&ptr, alignment, nbytes) != 0) {
+    return NULL;
+  }
+  return ptr;
+#endif
+}
+
+static inline void rx_aligned_free(void* ptr) {
+#if defined(_MSC_VER)
+  _aligned_free(ptr);
+#else
+  free(ptr);
+#endif
+}
+
+// fast 1/sqrt(v); ~22 bits of precision with SSE, ~17 bits otherwise
+static inline float rx_rsqrt(float v) {
+#if defined(ROXLU_USE_SSE)
+  float r = _mm_cvtss_f32(_mm_rsqrt_ss(_mm_set_ss(v)));
+  return r * (1.5f - 0.5f * v * r * r);
+#else
+  int32_t i;
+  float r;
+  memcpy(&i, &v, sizeof(i));
+  i = 0x5f3759df - (i >> 1);
+  memcpy(&r, &i, sizeof(r));
+  return r * (1.5f - 0.5f * v * r * r);
+#endif
+}
+
+#endif
@@ -2,8 +2,11 @@
 #define ROXLU_SPLINEH
 
 #include <vector>
+#include <algorithm>
 #include <roxlu/math/Vec2.h>
 
+#define SPLINE_ARC_SUBDIVISIONS 16           /* number of line pieces per catmull rom segment we use to approximate the arc length */
+
 /**
  * Catmull Rom interpolation. 
  * --------------------------
@@ -15,6 +18,25 @@
  * for points A and Bs.
  *
  * Everything is normalized between [0,1]
+ *
+ * Arc length cache
+ * ----------------
+ * `length()`, `get()`, `atUniform()` and `sample()` use tables which are 
+ * built on first use and invalidated by `add()`, `clear()` and the non-const
+ * `operator[]`. When you change `points` directly call `invalidate()`.
+ *
+ *  - `lengths`:     cumulative polyline length at each point; `get()` does a 
+ *                   binary search in this table.
+ *  - `arc_lengths`: cumulative length of the catmull rom curve, sampled 
+ *                   SPLINE_ARC_SUBDIVISIONS times per segment. `atUniform()`
+ *                   and `sample()` use it to move at a constant speed over
+ *                   the curve (`at()` moves at a constant speed per segment
+ *                   so short segments are traversed slower than long ones).
+ *
+ *   Spline<Vec3> path;
+ *   ...
+ *   std::vector<Vec3> samples;
+ *   path.sample(1000, samples);        // 1000 equally spaced points on the curve
  */
  
 namespace roxlu {
@@ -33,6 +55,25 @@ namespace roxlu {
     result.x = 0.5 * ((2 * p1.x) + (-p0.x + p2.x) * t + (2 * p0.x - 5 * p1.x + 4 * p2.x - p3.x) * t2 + (-p0.x + 3 * p1.x - 3 * p2.x + p3.x) * t3);
     result.y = 0.5 * ((2 * p1.y) + (-p0.y + p2.y) * t + (2 * p0.y - 5 * p1.y + 4 * p2.y - p3.y) * t2 + (-p0.y + 3 * p1.y - 3 * p2.y + p3.y) * t3);	
   }
+
+  // generic version for any vector type (Vec3, Vec4, ...)
+  template<class T>
+  inline void spline_interpolate_catmull(
+    const T& p0
+    ,const T& p1
+    ,const T& p2
+    ,const T& p3
+    ,float t
+    ,float t2
+    ,float t3
+    ,T& result
+  )
+  {
+    result = (p1 * 2.0f
+              + (p2 - p0) * t 
+              + (p0 * 2.0f - p1 * 5.0f + p2 * 4.0f - p3) * t2 
+              + (p1 * 3.0f - p0 - p2 * 3.0f + p3) * t3) * 0.5f;
+  }
  
  
   // T: vector type
@@ -46,21 +87,37 @@ namespace roxlu {
 
       size_t size();                         /* the number of points */
       void clear();                          /* remove all points */
-      float length();                        /* get the length of the polyline */
+      float length();                        /* get the length of the polyline (cached) */
+      float curveLength();                   /* get the (approximated) length of the catmull rom curve (cached) */
       T at(float t);                         /* interpolate using catmull rom */
+      T atUniform(float t);                  /* interpolate using catmull rom, `t` is the normalized arc length so equal steps in t give equal distances on the curve */
       T get(float t);                        /* get a point which is exactly on the line, at this time step, t is between 0 and 1 */
+      void sample(size_t n, T* out);         /* fill `out` with `n` points, equally spaced over the catmull rom curve (including the first and last point) */
+      void sample(size_t n, std::vector<T>& out);
       void add(const T point);
+      void invalidate();                     /* call this when you changed `points` directly */
 
       T& operator[](const unsigned int);
+
+    private:
+      void update();                         /* rebuilds the length tables when necessary */
+      T catmull(size_t segment, float t);    /* evaluate the catmull rom curve for the given segment (b = segment, c = segment + 1), local t [0,1] */
+      T catmullAtArc(float s, size_t& k);    /* evaluate at arc length `s`; `k` is the arc_lengths index we start searching from, so increasing `s` values are found in one pass */
 	
+    public:
       std::vector<T> points;
+      std::vector<float> lengths;            /* cumulative polyline length per point */
+      std::vector<float> arc_lengths;        /* cumulative curve length per subdivision */
+      bool is_dirty;                         /* when true the length tables need to be rebuild */
 	
     };
 
 
 
   template<class T>
-    inline Spline<T>::Spline() {
+    inline Spline<T>::Spline() 
+    :is_dirty(true)
+  {
   }
 
   template<class T>
@@ -69,6 +126,7 @@ namespace roxlu {
 
   template<class T>
     T& Spline<T>::operator[](const unsigned int dx) {
+    is_dirty = true;
     return points[dx];
   }
 
@@ -79,23 +137,73 @@ namespace roxlu {
 
   template<class T>
     inline void Spline<T>::clear() {
-    return points.clear();
+    points.clear();
+    lengths.clear();
+    arc_lengths.clear();
+    is_dirty = true;
   }
 
   template<class T>
     inline void Spline<T>::add(const T p) {
     points.push_back(p);
+    is_dirty = true;
+  }
+
+  template<class T>
+    inline void Spline<T>::invalidate() {
+    is_dirty = true;
+  }
+
+  template<class T>
+    void Spline<T>::update() {
+    if(!is_dirty) {
+      return;
+    }
+
+    is_dirty = false;
+    lengths.clear();
+    arc_lengths.clear();
+
+    if(!points.size()) {
+      return;
+    }
+
+    // polyline
+    lengths.reserve(points.size());
+    lengths.push_back(0.0f);
+    for(size_t i = 1; i < points.size(); ++i) {
+      lengths.push_back(lengths.back() + (points[i] - points[i - 1]).length());
+    }
+
+    // catmull rom curve
+    if(points.size() < 2) {
+      return;
+    }
+
+    size_t num_segments = points.size() - 1;
+    arc_lengths.reserve(num_segments * SPLINE_ARC_SUBDIVISIONS + 1);
+    arc_lengths.push_back(0.0f);
+
+    T prev = points[0];
+    for(size_t i = 0; i < num_segments; ++i) {
+      for(int j = 1; j <= SPLINE_ARC_SUBDIVISIONS; ++j) {
+        T curr = catmull(i, float(j) / SPLINE_ARC_SUBDIVISIONS);
+        arc_lengths.push_back(arc_lengths.back() + (curr - prev).length());
+        prev = curr;
+      }
+    }
   }
   
   template<class T>
     inline float Spline<T>::length() {
-    float l = 0.0f;
-    for(size_t i = 0; i < points.size() - 1; ++i) {
-      T a = points[i];
-      T b = points[i + 1];
-      l += (b - a).length();
-    }
-    return l;
+    update();
+    return (lengths.size()) ? lengths.back() : 0.0f;
+  }
+
+  template<class T>
+    inline float Spline<T>::curveLength() {
+    update();
+    return (arc_lengths.size()) ? arc_lengths.back() : 0.0f;
   }
 
   // get the position at the line using linear interpolation
@@ -126,32 +234,18 @@ namespace roxlu {
     }
 
     // -------
-    float line_length = length();
-    float curr_l = 0.0;
-    float sample_at = line_length * t;
-    float curr_dist = 0;
-    float prev_dist = 0;
-    size_t start_dx = 0;
-    size_t end_dx = 0;
-
-    for(size_t i = 0; i < points.size()-1; ++i) {
-      T a = points[i];
-      T b = points[i + 1];
-      curr_l = (b-a).length();
-      curr_dist += curr_l;
-      start_dx = i;
-      end_dx = i + 1;
-
-      if(curr_dist >= sample_at) {
-        break;
-      }
-      prev_dist = curr_dist;
-    }
+    float sample_at = length() * t;
 
+    // find the first point at or beyond `sample_at`; the segment ends there
+    size_t end_dx = std::lower_bound(lengths.begin() + 1, lengths.end(), sample_at) - lengths.begin();
+    if(end_dx >= points.size()) {
+      end_dx = points.size() - 1;
+    }
+    size_t start_dx = end_dx - 1;
 
     T segment_start = points[start_dx];
     T segment_end = points[end_dx];
-    float segment_length = sample_at - prev_dist;
+    float segment_length = sample_at - lengths[start_dx];
     T segment_dir = (segment_end - segment_start).normalize();
     if(segment_length <= 0.01) {
       return segment_start;
@@ -209,6 +303,97 @@ namespace roxlu {
     return result;
   }
 
+  template<class T>
+    inline T Spline<T>::catmull(size_t segment, float t) {
+    size_t b = segment;
+    size_t a = (b) ? b - 1 : 0;
+    size_t c = b + 1;
+    size_t d = c + 1;
+    if(d >= points.size()) {
+      d = points.size() - 1;
+    }
+
+    T result;
+    spline_interpolate_catmull(points[a], points[b], points[c], points[d], t, t * t, t * t * t, result);
+    return result;
+  }
+
+  template<class T>
+    inline T Spline<T>::catmullAtArc(float s, size_t& k) {
+    size_t last = arc_lengths.size() - 1;
+    if(k > last - 1) {
+      k = last - 1;             /* s == curveLength(): use the end of the last subdivision */
+    }
+
+    while(k < last - 1 && arc_lengths[k + 1] < s) {
+      ++k;
+    }
+
+    float span = arc_lengths[k + 1] - arc_lengths[k];
+    float frac = (span > 0.0f) ? (s - arc_lengths[k]) / span : 0.0f;
+    if(frac < 0.0f) {
+      frac = 0.0f;
+    }
+    else if(frac > 1.0f) {
+      frac = 1.0f;
+    }
+
+    size_t segment = k / SPLINE_ARC_SUBDIVISIONS;
+    float local_t = (float(k % SPLINE_ARC_SUBDIVISIONS) + frac) / SPLINE_ARC_SUBDIVISIONS;
+    return catmull(segment, local_t);
+  }
+
+  template<class T>
+    inline T Spline<T>::atUniform(float t) {
+    if(points.size() < 2) {
+      return (points.size()) ? points[0] : T();
+    }
+
+    if(t < 0.0f) {
+      t = 0.0f;
+    }
+    else if(t >= 1.0f) {
+      return points.back();
+    }
+
+    float s = curveLength() * t;
+    size_t k = std::upper_bound(arc_lengths.begin(), arc_lengths.end(), s) - arc_lengths.begin();
+    k = (k) ? k - 1 : 0;
+    return catmullAtArc(s, k);
+  }
+
+  template<class T>
+    void Spline<T>::sample(size_t n, T* out) {
+    if(!n) {
+      return;
+    }
+
+    if(points.size() < 2 || n == 1) {
+      T p = (points.size()) ? points[0] : T();
+      for(size_t i = 0; i < n; ++i) {
+        out[i] = p;
+      }
+      return;
+    }
+
+    // the samples are sorted, so we walk the arc length table once
+    float total = curveLength();
+    float step = total / (n - 1);
+    size_t k = 0;
+    for(size_t i = 0; i < n - 1; ++i) {
+      out[i] = catmullAtArc(step * i, k);
+    }
+    out[n - 1] = points.back();
+  }
+
+  template<class T>
+    inline void Spline<T>::sample(size_t n, std::vector<T>& out) {
+    out.resize(n);
+    if(n) {
+      sample(n, &out[0]);
+    }
+  }
+
   typedef Spline<Vec2> Spline2;
 
 
@@ -1,6 +1,8 @@
 #ifndef ROXLU_VEC3H
 #define ROXLU_VEC3H
 
+#include <roxlu/math/SIMD.h>
+
 // When you're smarter than the compiler optimizer
 // -----------------------------------------------------------------------------
 #define roxlu_dot3(a,b,r) r = (a.x * b.x) + (a.y * b.y) + (a.z * b.z);
@@ -10,13 +12,7 @@
 
 
 #define roxlu_isqrt3(a,odist)  {                \
-    odist=(float)(a.x*a.x+a.y*a.y + a.z * a.z); \
-    float rsf=odist*0.5f;                       \
-    long rsl=*(long*)&odist;                    \
-    const float rsopf = 1.5f;                   \
-    rsl=0x5f3759df-(rsl>>1);                    \
-    odist=*(float*)&rsl;                        \
-    odist=odist*(rsopf-(rsf*odist*odist));      \
+    odist = rx_rsqrt(a.x * a.x + a.y * a.y + a.z * a.z); \
   }
 #define roxlu_length3(a,r)			roxlu_isqrt3(a,r);      \
   r = 1/r;
@@ -0,0 +1,530 @@
+#include <roxlu/core/Utils.h>
+#include <roxlu/core/FileWatcher.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <algorithm>
+
+#if defined(__linux)
+#  include <sys/inotify.h>
+#  include <poll.h>
+#  include <unistd.h>
+#  include <limits.h>
+#endif
+
+#if !defined(_WIN32)
+#  include <sys/stat.h>
+#endif
+
+#if defined(__linux)
+#  define FILE_WATCHER_EVENTS (IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE | IN_ATTRIB)
+#endif
+
+// ------------------------------------------------
+
+#if defined(_WIN32)
+DWORD WINAPI file_watcher_thread_function(LPVOID user) {
+  static_cast<FileWatcher*>(user)->run();
+  return 0;
+}
+#else
+void* file_watcher_thread_function(void* user) {
+  static_cast<FileWatcher*>(user)->run();
+  return NULL;
+}
+#endif
+
+#if !defined(__linux)
+static time_t file_watcher_get_mtime(const std::string& filepath) {
+#if defined(_WIN32)
+  struct _stat st;
+  if(_stat(filepath.c_str(), &st) != 0) {
+    return 0;
+  }
+#else
+  struct stat st;
+  if(stat(filepath.c_str(), &st) != 0) {
+    return 0;
+  }
+#endif
+  return st.st_mtime;
+}
+#endif
+
+// ------------------------------------------------
+
+FileWatcherAsset::FileWatcherAsset()
+  :cb_load(NULL)
+  ,cb_apply(NULL)
+  ,user(NULL)
+{
+}
+
+// ------------------------------------------------
+
+FileWatcher::FileWatcher()
+  :delay(RX_FILE_WATCHER_DEFAULT_DELAY)
+  ,must_stop(false)
+  ,is_started(false)
+#if defined(__linux)
+  ,fd(-1)
+#endif
+{
+#if defined(_WIN32)
+  thread = NULL;
+  InitializeCriticalSection(&mutex);
+#else
+  pthread_mutex_init(&mutex, NULL);
+#endif
+
+#if defined(__linux)
+  fd = inotify_init();
+  if(fd < 0) {
+    RX_ERROR(ERR_FW_WATCH_INIT, strerror(errno));
+  }
+  event_buffer.resize(64 * (sizeof(struct inotify_event) + NAME_MAX + 1));
+#endif
+}
+
+FileWatcher::~FileWatcher() {
+  stop();
+
+  for(std::map<std::string, FileWatcherAsset*>::iterator it = assets.begin(); it != assets.end(); ++it) {
+    delete it->second;
+  }
+  assets.clear();
+
+#if defined(__linux)
+  if(fd >= 0) {
+    close(fd); /* removes all watches */
+    fd = -1;
+  }
+#endif
+
+#if defined(_WIN32)
+  DeleteCriticalSection(&mutex);
+#else
+  pthread_mutex_destroy(&mutex);
+#endif
+}
+
+bool FileWatcher::start(int delayMillis) {
+
+  if(is_started) {
+    RX_ERROR(ERR_FW_WATCH_ALREADY_STARTED);
+    return false;
+  }
+
+#if defined(__linux)
+  if(fd < 0) {
+    RX_ERROR(ERR_FW_WATCH_INIT, "no inotify instance");
+    return false;
+  }
+#endif
+
+  delay = (delayMillis > 0) ? delayMillis : 1;
+  must_stop = false;
+
+#if defined(_WIN32)
+  thread = CreateThread(NULL, 0, file_watcher_thread_function, this, 0, NULL);
+  if(!thread) {
+    RX_ERROR(ERR_FW_WATCH_THREAD);
+    return false;
+  }
+#else
+  if(pthread_create(&thread, NULL, file_watcher_thread_function, this) != 0) {
+    RX_ERROR(ERR_FW_WATCH_THREAD);
+    return false;
+  }
+#endif
+
+  is_started = true;
+  return true;
+}
+
+void FileWatcher::stop() {
+
+  if(!is_started) {
+    return;
+  }
+
+  lock();
+  must_stop = true;
+  unlock();
+
+  /* the thread checks must_stop at least every `delay` millis */
+#if defined(_WIN32)
+  WaitForSingleObject(thread, INFINITE);
+  CloseHandle(thread);
+  thread = NULL;
+#else
+  pthread_join(thread, NULL);
+#endif
+
+  is_started = false;
+}
+
+bool FileWatcher::addAsset(std::string filepath, rx_asset_load_cb loadCb, rx_asset_apply_cb applyCb, void* user) {
+
+  filepath = normalizePath(filepath);
+
+  lock();
+
+  if(assets.find(filepath) != assets.end()) {
+    unlock();
+    RX_ERROR(ERR_FW_WATCH_ASSET_EXISTS, filepath.c_str());
+    return false;
+  }
+
+  if(!watchFile(filepath)) {
+    unlock();
+    return false;
+  }
+
+  FileWatcherAsset* asset = new FileWatcherAsset();
+  asset->filepath = filepath;
+  asset->cb_load = loadCb;
+  asset->cb_apply = applyCb;
+  asset->user = user;
+  assets[filepath] = asset;
+
+  unlock();
+  return true;
+}
+
+bool FileWatcher::removeAsset(std::string filepath) {
+
+  filepath = normalizePath(filepath);
+
+  lock();
+
+  std::map<std::string, FileWatcherAsset*>::iterator it = assets.find(filepath);
+  if(it == assets.end()) {
+    unlock();
+    RX_ERROR(ERR_FW_WATCH_NO_ASSET, filepath.c_str());
+    return false;
+  }
+
+  delete it->second;
+  assets.erase(it);
+
+  std::vector<std::string>::iterator rit = std::find(ready.begin(), ready.end(), filepath);
+  if(rit != ready.end()) {
+    ready.erase(rit);
+  }
+
+  unlock();
+  return true;
+}
+
+bool FileWatcher::addDependency(std::string filepath, std::string dependency) {
+
+  filepath = normalizePath(filepath);
+  dependency = normalizePath(dependency);
+
+  if(filepath == dependency) {
+    RX_ERROR(ERR_FW_WATCH_SELF_DEPENDENCY, filepath.c_str());
+    return false;
+  }
+
+  lock();
+
+  if(!watchFile(dependency)) {
+    unlock();
+    return false;
+  }
+
+  dependents[dependency].insert(filepath);
+
+  unlock();
+  return true;
+}
+
+void FileWatcher::update() {
+
+  lock();
+  std::swap(ready, applying);
+  unlock();
+
+  for(std::vector<std::string>::iterator it = applying.begin(); it != applying.end(); ++it) {
+
+    /* the asset may have been removed in the meantime */
+    rx_asset_apply_cb cb = NULL;
+    void* user = NULL;
+
+    lock();
+    std::map<std::string, FileWatcherAsset*>::iterator ait = assets.find(*it);
+    if(ait != assets.end()) {
+      cb = ait->second->cb_apply;
+      user = ait->second->user;
+    }
+    unlock();
+
+    if(cb) {
+      cb(*it, user);
+    }
+  }
+
+  applying.clear();
+}
+
+// Watcher thread
+// ------------------------------------------------
+
+void FileWatcher::run() {
+
+  while(true) {
+
+    lock();
+    bool stopping = must_stop;
+    unlock();
+
+    if(stopping) {
+      break;
+    }
+
+    readEvents();
+    reloadChangedFiles();
+  }
+}
+
+#if defined(__linux)
+
+void FileWatcher::readEvents() {
+
+  /* wait for events, but wake up in time to reload coalesced changes */
+  struct pollfd pfd;
+  pfd.fd = fd;
+  pfd.events = POLLIN;
+  pfd.revents = 0;
+
+  int r = poll(&pfd, 1, std::max(delay / 2, 1));
+  if(r <= 0 || !(pfd.revents & POLLIN)) {
+    return;
+  }
+
+  ssize_t nread = read(fd, &event_buffer[0], event_buffer.size());
+  if(nread < 0) {
+    if(errno != EINTR && errno != EAGAIN) {
+      RX_ERROR(ERR_FW_WATCH_READ, strerror(errno));
+    }
+    return;
+  }
+
+  int64_t now = rx_millis();
+
+  lock();
+  {
+    ssize_t offset = 0;
+    while(offset < nread) {
+
+      struct inotify_event* ev = (struct inotify_event*)&event_buffer[offset];
+      offset += sizeof(struct inotify_event) + ev->len;
+
+      if(!ev->len || (ev->mask & IN_ISDIR)) {
+        continue;
+      }
+
+      std::map<int, std::string>::iterator it = watch_dirs.find(ev->wd);
+      if(it == watch_dirs.end()) {
+        continue;
+      }
+
+      /* we watch directories, so we get events for files we don't know */
+      std::string filepath = it->second + ev->name;
+      if(files.find(filepath) == files.end()) {
+        continue;
+      }
+
+      changed[filepath] = now;
+    }
+  }
+  unlock();
+}
+
+bool FileWatcher::watchFile(const std::string& filepath) {
+
+  files.insert(filepath);
+
+  std::string dir = rx_strip_filename(filepath);
+  if(dir_watches.find(dir) != dir_watches.end()) {
+    return true;
+  }
+
+  /* we watch the directory so we also see files that are saved with a rename */
+  int wd = inotify_add_watch(fd, dir.c_str(), FILE_WATCHER_EVENTS);
+  if(wd < 0) {
+    RX_ERROR(ERR_FW_WATCH_DIR, dir.c_str(), strerror(errno));
+    files.erase(filepath);
+    return false;
+  }
+
+  dir_watches[dir] = wd;
+  watch_dirs[wd] = dir;
+  return true;
+}
+
+#else
+
+void FileWatcher::readEvents() {
+
+  rx_sleep_millis(delay);
+
+  int64_t now = rx_millis();
+
+  /* the set of files is small (only the registered files), so checking them is cheap */
+  lock();
+  std::set<std::string> to_check = files;
+  unlock();
+
+  std::vector<std::string> modified;
+  for(std::set<std::string>::iterator it = to_check.begin(); it != to_check.end(); ++it) {
+    time_t mtime = file_watcher_get_mtime(*it);
+    lock();
+    std::map<std::string, time_t>::iterator mit = mtimes.find(*it);
+    if(mit != mtimes.end() && mit->second != mtime) {
+      modified.push_back(*it);
+    }
+    mtimes[*it] = mtime;
+    unlock();
+  }
+
+  lock();
+  for(std::vector<std::string>::iterator it = modified.begin(); it != modified.end(); ++it) {
+    changed[*it] = now;
+  }
+  unlock();
+}
+
+bool FileWatcher::watchFile(const std::string& filepath) {
+  files.insert(filepath);
+  if(mtimes.find(filepath) == mtimes.end()) {
+    mtimes[filepath] = file_watcher_get_mtime(filepath);
+  }
+  return true;
+}
+
+#endif
+
+void FileWatcher::reloadChangedFiles() {
+
+  std::vector<std::string> reload;
+  int64_t now = rx_millis();
+
+  lock();
+  {
+    /* collect the assets of all settled files at once, so an asset is loaded once */
+    std::set<std::string> visited;
+    std::map<std::string, int64_t>::iterator it = changed.begin();
+    while(it != changed.end()) {
+      if(now - it->second < delay) {
+        ++it;
+        continue;
+      }
+      collectAssets(it->first, visited, reload);
+      changed.erase(it++);
+    }
+  }
+  unlock();
+
+  for(std::vector<std::string>::iterator it = reload.begin(); it != reload.end(); ++it) {
+
+    rx_asset_load_cb cb = NULL;
+    void* user = NULL;
+    bool found = false;
+
+    lock();
+    std::map<std::string, FileWatcherAsset*>::iterator ait = assets.find(*it);
+    if(ait != assets.end()) {
+      cb = ait->second->cb_load;
+      user = ait->second->user;
+      found = true;
+    }
+    unlock();
+
+    if(!found) {
+      continue;
+    }
+
+    if(cb && !cb(*it, user)) {
+      continue;
+    }
+
+    lock();
+    if(std::find(ready.begin(), ready.end(), *it) == ready.end()) {
+      ready.push_back(*it);
+    }
+    unlock();
+  }
+}
+
+void FileWatcher::collectAssets(const std::string& filepath, std::set<std::string>& visited, std::vector<std::string>& result) {
+
+  if(visited.find(filepath) != visited.end()) {
+    return;
+  }
+
+  visited.insert(filepath);
+
+  if(assets.find(filepath) != assets.end()) {
+    result.push_back(filepath);
+  }
+
+  std::map<std::string, std::set<std::string> >::iterator it = dependents.find(filepath);
+  if(it == dependents.end()) {
+    return;
+  }
+
+  for(std::set<std::string>::iterator dit = it->second.begin(); dit != it->second.end(); ++dit) {
+    collectAssets(*dit, visited, result);
+  }
+}
+
+std::string FileWatcher::normalizePath(std::string filepath) {
+
+  std::string dir = rx_strip_filename(filepath);
+  std::string name = rx_strip_dir(filepath);
+  if(!dir.size()) {
+    dir = "./";
+  }
+
+  /* the directory exists even while an editor replaces the file */
+#if defined(_WIN32)
+  char full[MAX_PATH];
+  if(!_fullpath(full, dir.c_str(), MAX_PATH)) {
+    return filepath;
+  }
+  dir = full;
+  if(dir.size() && dir[dir.size() - 1] != '\\') {
+    dir.push_back('\\');
+  }
+#else
+  char* full = realpath(dir.c_str(), NULL);
+  if(!full) {
+    return filepath;
+  }
+  dir = full;
+  free(full);
+  if(dir.size() && dir[dir.size() - 1] != '/') {
+    dir.push_back('/');
+  }
+#endif
+
+  return dir + name;
+}
+
+void FileWatcher::lock() {
+#if defined(_WIN32)
+  EnterCriticalSection(&mutex);
+#else
+  pthread_mutex_lock(&mutex);
+#endif
+}
+
+void FileWatcher::unlock() {
+#if defined(_WIN32)
+  LeaveCriticalSection(&mutex);
+#else
+  pthread_mutex_unlock(&mutex);
+#endif
+}
@@ -0,0 +1,369 @@
+#include <roxlu/core/MMapFile.h>
+#include <string.h>
+#include <errno.h>
+#include <stdio.h>
+
+#if defined(_WIN32)
+#  include <io.h>
+#  include <fcntl.h>
+#  include <sys/stat.h>
+#else
+#  include <fcntl.h>
+#  include <unistd.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#endif
+
+// ------------------------------------------------
+
+rx_mmap_file::rx_mmap_file()
+  :mode(RX_MMAP_READ)
+  ,data(NULL)
+  ,nbytes(0)
+  ,is_open(false)
+#if defined(_WIN32)
+  ,file_handle(INVALID_HANDLE_VALUE)
+  ,map_handle(NULL)
+#else
+  ,fd(-1)
+#endif
+{
+}
+
+rx_mmap_file::~rx_mmap_file() {
+  close();
+}
+
+#if defined(_WIN32)
+
+bool rx_mmap_file::open(std::string path, int m, size_t size) {
+
+  if(is_open) {
+    RX_ERROR(ERR_MMAP_ALREADY_OPEN, filepath.c_str());
+    return false;
+  }
+
+  if(m != RX_MMAP_READ && m != RX_MMAP_READ_WRITE) {
+    RX_ERROR(ERR_MMAP_MODE, m);
+    return false;
+  }
+
+  DWORD access = (m == RX_MMAP_READ) ? GENERIC_READ : (GENERIC_READ | GENERIC_WRITE);
+  DWORD creation = (m == RX_MMAP_READ_WRITE && size) ? OPEN_ALWAYS : OPEN_EXISTING;
+  file_handle = CreateFileA(path.c_str(), access, FILE_SHARE_READ, NULL, creation, FILE_ATTRIBUTE_NORMAL, NULL);
+  if(file_handle == INVALID_HANDLE_VALUE) {
+    RX_ERROR(ERR_MMAP_OPEN, path.c_str(), "CreateFile failed");
+    return false;
+  }
+
+  LARGE_INTEGER file_size;
+  if(m == RX_MMAP_READ_WRITE && size) {
+    file_size.QuadPart = size;
+    if(!SetFilePointerEx(file_handle, file_size, NULL, FILE_BEGIN) || !SetEndOfFile(file_handle)) {
+      RX_ERROR(ERR_MMAP_RESIZE, path.c_str(), size, "SetEndOfFile failed");
+      close();
+      return false;
+    }
+  }
+  else if(!GetFileSizeEx(file_handle, &file_size)) {
+    RX_ERROR(ERR_MMAP_STAT, path.c_str(), "GetFileSizeEx failed");
+    close();
+    return false;
+  }
+
+  filepath = path;
+  mode = m;
+  nbytes = (size_t)file_size.QuadPart;
+  is_open = true;
+
+  if(!nbytes) {
+    return true;
+  }
+
+  map_handle = CreateFileMapping(file_handle, NULL, (m == RX_MMAP_READ) ? PAGE_READONLY : PAGE_READWRITE, 0, 0, NULL);
+  if(!map_handle) {
+    RX_ERROR(ERR_MMAP_MAP, path.c_str(), "CreateFileMapping failed");
+    close();
+    return false;
+  }
+
+  data = (char*)MapViewOfFile(map_handle, (m == RX_MMAP_READ) ? FILE_MAP_READ : FILE_MAP_WRITE, 0, 0, 0);
+  if(!data) {
+    RX_ERROR(ERR_MMAP_MAP, path.c_str(), "MapViewOfFile failed");
+    close();
+    return false;
+  }
+
+  return true;
+}
+
+void rx_mmap_file::close() {
+
+  if(data) {
+    UnmapViewOfFile(data);
+    data = NULL;
+  }
+
+  if(map_handle) {
+    CloseHandle(map_handle);
+    map_handle = NULL;
+  }
+
+  if(file_handle != INVALID_HANDLE_VALUE) {
+    CloseHandle(file_handle);
+    file_handle = INVALID_HANDLE_VALUE;
+  }
+
+  nbytes = 0;
+  is_open = false;
+}
+
+bool rx_mmap_file::advise(int advice, size_t offset, size_t size) {
+  /* windows has no madvise(); the hints are only an optimisation */
+  return is_open;
+}
+
+bool rx_mmap_file::sync() {
+
+  if(!is_open) {
+    RX_ERROR(ERR_MMAP_NOT_OPEN);
+    return false;
+  }
+
+  if(!data) {
+    return true;
+  }
+
+  if(!FlushViewOfFile(data, 0) || !FlushFileBuffers(file_handle)) {
+    RX_ERROR(ERR_MMAP_SYNC, "FlushViewOfFile failed");
+    return false;
+  }
+
+  return true;
+}
+
+#else
+
+bool rx_mmap_file::open(std::string path, int m, size_t size) {
+
+  if(is_open) {
+    RX_ERROR(ERR_MMAP_ALREADY_OPEN, filepath.c_str());
+    return false;
+  }
+
+  if(m != RX_MMAP_READ && m != RX_MMAP_READ_WRITE) {
+    RX_ERROR(ERR_MMAP_MODE, m);
+    return false;
+  }
+
+  int flags = O_RDONLY;
+  if(m == RX_MMAP_READ_WRITE) {
+    flags = (size) ? (O_RDWR | O_CREAT) : O_RDWR;
+  }
+
+  fd = ::open(path.c_str(), flags, 0644);
+  if(fd < 0) {
+    RX_ERROR(ERR_MMAP_OPEN, path.c_str(), strerror(errno));
+    return false;
+  }
+
+  if(m == RX_MMAP_READ_WRITE && size) {
+    if(ftruncate(fd, size) != 0) {
+      RX_ERROR(ERR_MMAP_RESIZE, path.c_str(), size, strerror(errno));
+      close();
+      return false;
+    }
+  }
+  else {
+    struct stat st;
+    if(fstat(fd, &st) != 0) {
+      RX_ERROR(ERR_MMAP_STAT, path.c_str(), strerror(errno));
+      close();
+      return false;
+    }
+    size = st.st_size;
+  }
+
+  filepath = path;
+  mode = m;
+  nbytes = size;
+  is_open = true;
+
+  if(!nbytes) {
+    return true;
+  }
+
+  int prot = (m == RX_MMAP_READ) ? PROT_READ : (PROT_READ | PROT_WRITE);
+  void* mem = mmap(NULL, nbytes, prot, MAP_SHARED, fd, 0);
+  if(mem == MAP_FAILED) {
+    RX_ERROR(ERR_MMAP_MAP, path.c_str(), strerror(errno));
+    close();
+    return false;
+  }
+
+  data = (char*)mem;
+
+  /* the mapping keeps a reference to the file */
+  ::close(fd);
+  fd = -1;
+
+  return true;
+}
+
+void rx_mmap_file::close() {
+
+  if(data) {
+    munmap(data, nbytes);
+    data = NULL;
+  }
+
+  if(fd >= 0) {
+    ::close(fd);
+    fd = -1;
+  }
+
+  nbytes = 0;
+  is_open = false;
+}
+
+bool rx_mmap_file::advise(int advice, size_t offset, size_t size) {
+
+  if(!is_open) {
+    RX_ERROR(ERR_MMAP_NOT_OPEN);
+    return false;
+  }
+
+  if(!data) {
+    return true;
+  }
+
+  if(offset > nbytes || size > nbytes - offset) {
+    RX_ERROR(ERR_MMAP_RANGE, offset, size, nbytes);
+    return false;
+  }
+
+  if(!size) {
+    size = nbytes - offset;
+  }
+
+  int flag = MADV_NORMAL;
+  switch(advice) {
+    case RX_MMAP_NORMAL:     { flag = MADV_NORMAL;     break; }
+    case RX_MMAP_SEQUENTIAL: { flag = MADV_SEQUENTIAL; break; }
+    case RX_MMAP_RANDOM:     { flag = MADV_RANDOM;     break; }
+    case RX_MMAP_WILLNEED:   { flag = MADV_WILLNEED;   break; }
+    case RX_MMAP_DONTNEED:   { flag = MADV_DONTNEED;   break; }
+    default: {
+      RX_ERROR(ERR_MMAP_ADVISE, advice, "unknown advice");
+      return false;
+    }
+  }
+
+  /* madvise() wants a page aligned address */
+  size_t page_size = sysconf(_SC_PAGESIZE);
+  size_t aligned = offset - (offset % page_size);
+  if(madvise(data + aligned, size + (offset - aligned), flag) != 0) {
+    RX_ERROR(ERR_MMAP_ADVISE, advice, strerror(errno));
+    return false;
+  }
+
+  return true;
+}
+
+bool rx_mmap_file::sync() {
+
+  if(!is_open) {
+    RX_ERROR(ERR_MMAP_NOT_OPEN);
+    return false;
+  }
+
+  if(!data) {
+    return true;
+  }
+
+  if(msync(data, nbytes, MS_SYNC) != 0) {
+    RX_ERROR(ERR_MMAP_SYNC, strerror(errno));
+    return false;
+  }
+
+  return true;
+}
+
+#endif
+
+// ------------------------------------------------
+
+template<class T>
+static bool rx_read_file_into(const std::string& filepath, T& result) {
+
+#if defined(_WIN32)
+  int fd = _open(filepath.c_str(), _O_RDONLY | _O_BINARY);
+#else
+  int fd = ::open(filepath.c_str(), O_RDONLY);
+#endif
+
+  if(fd < 0) {
+    RX_ERROR(ERR_READ_FILE_OPEN, filepath.c_str(), strerror(errno));
+    return false;
+  }
+
+  struct stat st;
+  if(fstat(fd, &st) != 0) {
+    RX_ERROR(ERR_READ_FILE_READ, filepath.c_str(), strerror(errno));
+#if defined(_WIN32)
+    _close(fd);
+#else
+    ::close(fd);
+#endif
+    return false;
+  }
+
+  size_t size = st.st_size;
+  size_t nread = 0;
+  result.resize(size);
+
+  /* one read() normally gets everything; we only loop on short reads */
+  while(nread < size) {
+#if defined(_WIN32)
+    int r = _read(fd, &result[nread], (unsigned int)(size - nread));
+#else
+    ssize_t r = ::read(fd, &result[nread], size - nread);
+#endif
+    if(r < 0) {
+      if(errno == EINTR) {
+        continue;
+      }
+      RX_ERROR(ERR_READ_FILE_READ, filepath.c_str(), strerror(errno));
+      break;
+    }
+    if(r == 0) {
+      break;
+    }
+    nread += r;
+  }
+
+#if defined(_WIN32)
+  _close(fd);
+#else
+  ::close(fd);
+#endif
+
+  if(nread != size) {
+    result.resize(nread);
+    return false;
+  }
+
+  return true;
+}
+
+bool rx_read_file(std::string filepath, std::string& result) {
+  return rx_read_file_into(filepath, result);
+}
+
+bool rx_read_file(std::string filepath, std::vector<char>& result) {
+  return rx_read_file_into(filepath, result);
+}
+
+bool rx_read_file(std::string filepath, std::vector<unsigned char>& result) {
+  return rx_read_file_into(filepath, result);
+}
@@ -2,32 +2,42 @@
 
 Buffer::Buffer()
 	:read_dx(0)
+	,view(NULL)
+	,view_nbytes(0)
 {
 }
 
 Buffer::Buffer(char* raw, size_t nbytes) {
   read_dx = 0;
+  view = NULL;
+  view_nbytes = 0;
   putBytes(raw, nbytes);
 }
 
+Buffer::Buffer(rx_mmap_file& file)
+	:read_dx(0)
+	,view((rx_uint8*)file.ptr())
+	,view_nbytes(file.size())
+{
+}
+
 Buffer::~Buffer() {
 	//	printf("~Buffer()\n");
 }
 
 bool Buffer::loadFile(const char* filename) {
-	std::ifstream ifs(filename, std::ios::binary | std::ios::in | std::ios::ate) ;
-	if(!ifs.is_open()){
-		printf("Cannot load: %s\n", filename);
+	detach();
+
+	// read straight into our buffer when it's empty
+	if(!data.size()) {
+		return rx_read_file(filename, data);
+	}
+
+	std::vector<rx_uint8> tmp;
+	if(!rx_read_file(filename, tmp)) {
 		return false;
 	}
-	rx_uint32 size = ifs.tellg();
-	ifs.seekg(0, std::ios::beg);
-	char* tmp_buf = new char[size];
-	ifs.read(tmp_buf, size);
-	ifs.close();
-	
-	putBytes((rx_uint8*)tmp_buf, size);
-	delete[] tmp_buf;
+	data.insert(data.end(), tmp.begin(), tmp.end());
 	return true;
 }
 
@@ -50,16 +60,28 @@ void Buffer::drain(rx_uint32 num) {
 	read_dx += num;
 }
 
+void Buffer::detach() {
+	if(!view) {
+		return;
+	}
+	data.assign(view, view + view_nbytes);
+	view = NULL;
+	view_nbytes = 0;
+}
+
 // Store in native byte order.
 void Buffer::putByte(rx_uint8 b) {
+	detach();
 	data.push_back(b);
 }
 
 void Buffer::putBytes(rx_uint8* b, int num) {
+	detach();
 	data.insert(data.end(), b, b+num);
 }
 
 void Buffer::putBytes(rx_uint8* b, int num, int pos) {
+	detach();
 	for(int i = pos, j = 0; i < (pos+num); ++i, ++j) {
 		data[i] = b[j];
 	}
@@ -73,10 +95,12 @@ void Buffer::putReversed(rx_uint8* b, int num) {
 }
 
 void Buffer::rewriteByte(rx_uint32 position, rx_uint8 b) {
+	detach();
 	data[position] = b;
 }
 
 void Buffer::rewriteReversed(rx_uint32 position, rx_uint8* b, rx_uint32 num) {
+	detach();
 	int start = position + num;
 	int end = position;
 	rx_uint32 c = 0;
@@ -214,12 +238,12 @@ void Buffer::putLittleEndianS64(rx_int64 b) {
 // Retrieving values from the buffer
 // ----------------------------------------------------------------
 void Buffer::getBytes(rx_uint8* result, rx_uint32 num) {
-	memcpy((char*)result, (char*)&data[read_dx], num);
+	memcpy((char*)result, (char*)(bytes() + read_dx), num);
 	read_dx += num;
 }
 
 rx_uint8 Buffer::getByte() {
-	rx_uint8 b = data[read_dx];
+	rx_uint8 b = bytes()[read_dx];
 	read_dx++;
 	return b;
 }
@@ -254,7 +278,7 @@ rx_uint64 Buffer::getU64() {
 
 rx_int8 Buffer::getS8() {
 	read_dx++;
-	return data[read_dx];
+	return bytes()[read_dx];
 }
 
 rx_int16 Buffer::getS16() {
@@ -345,7 +369,7 @@ rx_uint16 Buffer::getBigEndianU16() {
 
 rx_uint32 Buffer::getBigEndianU24() {
 	rx_uint32 r = 0;
-	memcpy((char*)&r, (char*)&data[read_dx], 4);
+	memcpy((char*)&r, (char*)(bytes() + read_dx), 4);
 	r = CONVERT_FROM_BE_U24(r);
 	read_dx += 3;
 	return r;
@@ -382,7 +406,7 @@ rx_int16 Buffer::getBigEndianS16() {
 
 rx_int32 Buffer::getBigEndianS24() {
 	rx_uint32 r = 0;
-	memcpy((char*)&r, (char*)&data[read_dx], 4);
+	memcpy((char*)&r, (char*)(bytes() + read_dx), 4);
 	r = CONVERT_FROM_BE_U24(r);
 	read_dx += 3;
 
@@ -411,48 +435,53 @@ rx_int64 Buffer::getBigEndianS64() {
 
 // ----------------------------------------------------------------------
 rx_uint8 Buffer::peekByte() {
-	return data[read_dx];
+	return bytes()[read_dx];
 }
 // ----------------------------------------------------------------------
 
 void Buffer::copyFrom(Buffer& other) {
-	std::copy(other.data.begin(), other.data.end(), std::back_inserter(data));
+	if(!other.size()) {
+		return;
+	}
+	putBytes(other.getPtr(), other.size());
 }
 
 void Buffer::copyTo(Buffer& other, int start, int numBytes) {
-	std::copy(data.begin()+start, data.begin()+start+numBytes, std::back_inserter(other.data));
+	other.putBytes(getPtr() + start, numBytes);
 }
 
 rx_uint32 Buffer::getNumBytesLeftToRead() {
-	return data.size() - read_dx;
+	return size() - read_dx;
 }
 
 // Debug
 void Buffer::print(int dx) {
-	printf("%02X\n", data[dx]);
+	printf("%02X\n", bytes()[dx]);
 }
 
 void Buffer::printReadIndex() {
-	printf("%02X\n", data[read_dx]);
+	printf("%02X\n", bytes()[read_dx]);
 }
 
 void Buffer::printList(int start, int end) {
+	rx_uint8* b = bytes();
 	for(int i = start; i < end; ++i) {
-		printf("%02d = %02X (%d)\n", i, data[i], data[i]);
+		printf("%02d = %02X (%d)\n", i, b[i], b[i]);
 	}
 }
 
 void Buffer::print() {
-	print(0, data.size()-1);
+	print(0, size()-1);
 }
 
 void Buffer::print(int start, int end) {
-	if(start >= data.size() || end > data.size()) {
-		printf("Out of bound, %zu\n", data.size());
+	if(start >= size() || end > size()) {
+		printf("Out of bound, %zu\n", size());
 		return;
 	}
+	rx_uint8* b = bytes();
 	for(int i = start; i < end; ++i) {
-		printf("%02X ", data[i]);
+		printf("%02X ", b[i]);
 	}
 	printf("\n");
 }
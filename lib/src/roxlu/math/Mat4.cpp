@@ -3,6 +3,10 @@
 #include <roxlu/math/Mat4.h>
 #include <roxlu/core/Utils.h>
 
+// The SSE versions use unaligned loads/stores so they work on any Mat4/Vec3/Vec4 
+// (also when they're members of other structs). The NEON versions use the same
+// kernels except for the inverse which falls back to the scalar code.
+
 // good resource: https://github.com/Kazade/kazmath/blob/master/kazmath/mat4.c
 
 namespace roxlu {
@@ -182,8 +186,16 @@ namespace roxlu {
 #define SWAP_ROWS_DOUBLE(a, b) { double *_tmp = a; (a)=(b); (b)=_tmp; }
 #define SWAP_ROWS_FLOAT(a, b) { float *_tmp = a; (a)=(b); (b)=_tmp; }
 #define MAT(m,r,c) (m)[(c)*4+(r)]
-  // thanks: http://www.opengl.org/wiki/GluProject_and_gluUnProject_code
   int mat4_inverse(const Mat4& o, Mat4& result) {
+#if defined(ROXLU_USE_SSE)
+    return mat4_inverse_sse(o, result);
+#else
+    return mat4_inverse_scalar(o, result);
+#endif
+  }
+
+  // thanks: http://www.opengl.org/wiki/GluProject_and_gluUnProject_code
+  int mat4_inverse_scalar(const Mat4& o, Mat4& result) {
     float wtmp[4][8];
     float m0, m1, m2, m3, s;
     float *r0, *r1, *r2, *r3;
@@ -436,6 +448,14 @@ namespace roxlu {
 
   // assumes a standard affine matrix.
   Mat4 affine_inverse(const Mat4& o) {
+#if defined(ROXLU_USE_SSE)
+    return affine_inverse_sse(o);
+#else
+    return affine_inverse_scalar(o);
+#endif
+  }
+
+  Mat4 affine_inverse_scalar(const Mat4& o) {
     Mat4 r;
     float cofactor0 = o.m[5] * o.m[10] - o.m[6] * o.m[9];
     float cofactor4 = o.m[2] * o.m[9]  - o.m[1] * o.m[10];
@@ -1023,79 +1043,19 @@ namespace roxlu {
 
   Mat4 Mat4::operator*(const Mat4& o) const {
     Mat4 r;
-    r.m[0]  =  m[0] * o.m[0]  +  m[4] * o.m[1]  +  m[8]  * o.m[2]  +  m[12] * o.m[3];
-    r.m[1]  =  m[1] * o.m[0]  +  m[5] * o.m[1]  +  m[9]  * o.m[2]  +  m[13] * o.m[3];
-    r.m[2]  =  m[2] * o.m[0]  +  m[6] * o.m[1]  +  m[10] * o.m[2]  +  m[14] * o.m[3];
-    r.m[3]  =  m[3] * o.m[0]  +  m[7] * o.m[1]  +  m[11] * o.m[2]  +  m[15] * o.m[3];
-	
-    r.m[4]  =  m[0] * o.m[4]  +  m[4] * o.m[5]  +  m[8]  * o.m[6]  +  m[12] * o.m[7];
-    r.m[5]  =  m[1] * o.m[4]  +  m[5] * o.m[5]  +  m[9]  * o.m[6]  +  m[13] * o.m[7];
-    r.m[6]  =  m[2] * o.m[4]  +  m[6] * o.m[5]  +  m[10] * o.m[6]  +  m[14] * o.m[7];
-    r.m[7]  =  m[3] * o.m[4]  +  m[7] * o.m[5]  +  m[11] * o.m[6]  +  m[15] * o.m[7];
-	
-    r.m[8]  =  m[0] * o.m[8]  +  m[4] * o.m[9]  +  m[8]  * o.m[10] +  m[12] * o.m[11];
-    r.m[9]  =  m[1] * o.m[8]  +  m[5] * o.m[9]  +  m[9]  * o.m[10] +  m[13] * o.m[11];
-    r.m[10] =  m[2] * o.m[8]  +  m[6] * o.m[9]  +  m[10] * o.m[10] +  m[14] * o.m[11];
-    r.m[11] =  m[3] * o.m[8]  +  m[7] * o.m[9]  +  m[11] * o.m[10] +  m[15] * o.m[11];
-	
-    r.m[12] =  m[0] * o.m[12] +  m[4] * o.m[13] +  m[8]  * o.m[14] +  m[12] * o.m[15];
-    r.m[13] =  m[1] * o.m[12] +  m[5] * o.m[13] +  m[9]  * o.m[14] +  m[13] * o.m[15];
-    r.m[14] =  m[2] * o.m[12] +  m[6] * o.m[13] +  m[10] * o.m[14] +  m[14] * o.m[15];
-    r.m[15] =  m[3] * o.m[12] +  m[7] * o.m[13] +  m[11] * o.m[14] +  m[15] * o.m[15];
+    mat4_multiply(*this, o, r);
     return r;
   }
 
   Mat4& Mat4::operator*=(const Mat4& o) {
-
-    Mat4 r;
-    r.m[0]  =  m[0] * o.m[0]  +  m[4] * o.m[1]  +  m[8]  * o.m[2]  +  m[12] * o.m[3];
-    r.m[1]  =  m[1] * o.m[0]  +  m[5] * o.m[1]  +  m[9]  * o.m[2]  +  m[13] * o.m[3];
-    r.m[2]  =  m[2] * o.m[0]  +  m[6] * o.m[1]  +  m[10] * o.m[2]  +  m[14] * o.m[3];
-    r.m[3]  =  m[3] * o.m[0]  +  m[7] * o.m[1]  +  m[11] * o.m[2]  +  m[15] * o.m[3];
-		
-    r.m[4]  =  m[0] * o.m[4]  +  m[4] * o.m[5]  +  m[8]  * o.m[6]  +  m[12] * o.m[7];
-    r.m[5]  =  m[1] * o.m[4]  +  m[5] * o.m[5]  +  m[9]  * o.m[6]  +  m[13] * o.m[7];
-    r.m[6]  =  m[2] * o.m[4]  +  m[6] * o.m[5]  +  m[10] * o.m[6]  +  m[14] * o.m[7];
-    r.m[7]  =  m[3] * o.m[4]  +  m[7] * o.m[5]  +  m[11] * o.m[6]  +  m[15] * o.m[7];
-	
-    r.m[8]  =  m[0] * o.m[8]  +  m[4] * o.m[9]  +  m[8]  * o.m[10] +  m[12] * o.m[11];
-    r.m[9]  =  m[1] * o.m[8]  +  m[5] * o.m[9]  +  m[9]  * o.m[10] +  m[13] * o.m[11];
-    r.m[10] =  m[2] * o.m[8]  +  m[6] * o.m[9]  +  m[10] * o.m[10] +  m[14] * o.m[11];
-    r.m[11] =  m[3] * o.m[8]  +  m[7] * o.m[9]  +  m[11] * o.m[10] +  m[15] * o.m[11];
-
-    r.m[12] =  m[0] * o.m[12] +  m[4] * o.m[13] +  m[8]  * o.m[14] +  m[12] * o.m[15];
-    r.m[13] =  m[1] * o.m[12] +  m[5] * o.m[13] +  m[9]  * o.m[14] +  m[13] * o.m[15];
-    r.m[14] =  m[2] * o.m[12] +  m[6] * o.m[13] +  m[10] * o.m[14] +  m[14] * o.m[15];
-    r.m[15] =  m[3] * o.m[12] +  m[7] * o.m[13] +  m[11] * o.m[14] +  m[15] * o.m[15];
-	
-    // and copy
-    m[0]  = r.m[0];
-    m[1]  = r.m[1];
-    m[2]  = r.m[2];
-    m[3]  = r.m[3];
-    m[4]  = r.m[4];
-    m[5]  = r.m[5];
-    m[6]  = r.m[6];
-    m[7]  = r.m[7];
-    m[8]  = r.m[8];
-    m[9]  = r.m[9];
-    m[10] = r.m[10];
-    m[11] = r.m[11];
-    m[12] = r.m[12];
-    m[13] = r.m[13];
-    m[14] = r.m[14];
-    m[15] = r.m[15];
-	
+    mat4_multiply(*this, o, *this);
     return *this;
   }
 
   // mat * vec
   Vec4 Mat4::operator*(const Vec4& v) const {
     Vec4 r;
-    r.x = m[0] * v.x  + m[4] * v.y  + m[8]  * v.z + m[12] * v.w;
-    r.y = m[1] * v.x  + m[5] * v.y  + m[9]  * v.z + m[13] * v.w;
-    r.z = m[2] * v.x  + m[6] * v.y  + m[10] * v.z + m[14] * v.w;
-    r.w = m[3] * v.x  + m[7] * v.y  + m[11] * v.z + m[15] * v.w;
+    transformPoints(&v, &r, 1);
     return r;
   }
 
@@ -1197,4 +1157,310 @@ namespace roxlu {
 
 
 
+  // SIMD kernels
+  //------------------------------------------------------------------------------
+
+  // out = a * b; column j of the result is the sum of the columns of `a` scaled by the elements of column j of `b`
+  void mat4_multiply(const Mat4& a, const Mat4& b, Mat4& out) {
+#if defined(ROXLU_USE_SSE)
+    __m128 c0 = _mm_loadu_ps(a.m);
+    __m128 c1 = _mm_loadu_ps(a.m + 4);
+    __m128 c2 = _mm_loadu_ps(a.m + 8);
+    __m128 c3 = _mm_loadu_ps(a.m + 12);
+
+    // when out == b we only overwrite column j after we've read it 
+    for(int j = 0; j < 16; j += 4) {
+      __m128 r = _mm_mul_ps(c0, _mm_set1_ps(b.m[j]));
+      r = _mm_add_ps(r, _mm_mul_ps(c1, _mm_set1_ps(b.m[j + 1])));
+      r = _mm_add_ps(r, _mm_mul_ps(c2, _mm_set1_ps(b.m[j + 2])));
+      r = _mm_add_ps(r, _mm_mul_ps(c3, _mm_set1_ps(b.m[j + 3])));
+      _mm_storeu_ps(out.m + j, r);
+    }
+#elif defined(ROXLU_USE_NEON)
+    float32x4_t c0 = vld1q_f32(a.m);
+    float32x4_t c1 = vld1q_f32(a.m + 4);
+    float32x4_t c2 = vld1q_f32(a.m + 8);
+    float32x4_t c3 = vld1q_f32(a.m + 12);
+
+    for(int j = 0; j < 16; j += 4) {
+      float32x4_t bc = vld1q_f32(b.m + j);
+      float32x4_t r = vmulq_lane_f32(c0, vget_low_f32(bc), 0);
+      r = vmlaq_lane_f32(r, c1, vget_low_f32(bc), 1);
+      r = vmlaq_lane_f32(r, c2, vget_high_f32(bc), 0);
+      r = vmlaq_lane_f32(r, c3, vget_high_f32(bc), 1);
+      vst1q_f32(out.m + j, r);
+    }
+#else
+    float r[16];
+    const float* m = a.m;
+    const float* o = b.m;
+    for(int j = 0; j < 16; j += 4) {
+      r[j + 0] = m[0] * o[j] + m[4] * o[j + 1] + m[8]  * o[j + 2] + m[12] * o[j + 3];
+      r[j + 1] = m[1] * o[j] + m[5] * o[j + 1] + m[9]  * o[j + 2] + m[13] * o[j + 3];
+      r[j + 2] = m[2] * o[j] + m[6] * o[j + 1] + m[10] * o[j + 2] + m[14] * o[j + 3];
+      r[j + 3] = m[3] * o[j] + m[7] * o[j + 1] + m[11] * o[j + 2] + m[15] * o[j + 3];
+    }
+    memcpy(out.m, r, sizeof(r));
+#endif
+  }
+
+  // out[i] = a * b[i]; the columns of `a` are loaded once
+  void mat4_multiply(const Mat4& a, const Mat4* b, Mat4* out, size_t n) {
+#if defined(ROXLU_USE_SSE)
+    __m128 c0 = _mm_loadu_ps(a.m);
+    __m128 c1 = _mm_loadu_ps(a.m + 4);
+    __m128 c2 = _mm_loadu_ps(a.m + 8);
+    __m128 c3 = _mm_loadu_ps(a.m + 12);
+
+    for(size_t i = 0; i < n; ++i) {
+      const float* bm = b[i].m;
+      float* om = out[i].m;
+      for(int j = 0; j < 16; j += 4) {
+        __m128 r = _mm_mul_ps(c0, _mm_set1_ps(bm[j]));
+        r = _mm_add_ps(r, _mm_mul_ps(c1, _mm_set1_ps(bm[j + 1])));
+        r = _mm_add_ps(r, _mm_mul_ps(c2, _mm_set1_ps(bm[j + 2])));
+        r = _mm_add_ps(r, _mm_mul_ps(c3, _mm_set1_ps(bm[j + 3])));
+        _mm_storeu_ps(om + j, r);
+      }
+    }
+#else
+    for(size_t i = 0; i < n; ++i) {
+      mat4_multiply(a, b[i], out[i]);
+    }
+#endif
+  }
+
+  void Mat4::transformPoints(const Vec3* in, Vec3* out, size_t n) const {
+    size_t i = 0;
+
+#if defined(ROXLU_USE_SSE)
+    __m128 m0 = _mm_set1_ps(m[0]),  m1 = _mm_set1_ps(m[1]),  m2 = _mm_set1_ps(m[2]);
+    __m128 m4 = _mm_set1_ps(m[4]),  m5 = _mm_set1_ps(m[5]),  m6 = _mm_set1_ps(m[6]);
+    __m128 m8 = _mm_set1_ps(m[8]),  m9 = _mm_set1_ps(m[9]),  m10 = _mm_set1_ps(m[10]);
+    __m128 m12 = _mm_set1_ps(m[12]), m13 = _mm_set1_ps(m[13]), m14 = _mm_set1_ps(m[14]);
+
+    // 4 points at a time: x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3 -> xxxx, yyyy, zzzz and back
+    for(; i + 4 <= n; i += 4) {
+      const float* src = &in[i].x;
+      float* dest = &out[i].x;
+
+      __m128 a = _mm_loadu_ps(src);
+      __m128 b = _mm_loadu_ps(src + 4);
+      __m128 c = _mm_loadu_ps(src + 8);
+
+      __m128 x = _mm_shuffle_ps(a, _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 3, 0));
+      __m128 y = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)), _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+      __m128 z = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)), _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+
+      __m128 rx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m0, x), _mm_mul_ps(m4, y)), _mm_add_ps(_mm_mul_ps(m8, z), m12));
+      __m128 ry = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m1, x), _mm_mul_ps(m5, y)), _mm_add_ps(_mm_mul_ps(m9, z), m13));
+      __m128 rz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m2, x), _mm_mul_ps(m6, y)), _mm_add_ps(_mm_mul_ps(m10, z), m14));
+
+      a = _mm_shuffle_ps(_mm_shuffle_ps(rx, ry, _MM_SHUFFLE(0, 0, 0, 0)), _mm_shuffle_ps(rz, rx, _MM_SHUFFLE(1, 1, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+      b = _mm_shuffle_ps(_mm_shuffle_ps(ry, rz, _MM_SHUFFLE(1, 1, 1, 1)), _mm_shuffle_ps(rx, ry, _MM_SHUFFLE(2, 2, 2, 2)), _MM_SHUFFLE(2, 0, 2, 0));
+      c = _mm_shuffle_ps(_mm_shuffle_ps(rz, rx, _MM_SHUFFLE(3, 3, 2, 2)), _mm_shuffle_ps(ry, rz, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+
+      _mm_storeu_ps(dest, a);
+      _mm_storeu_ps(dest + 4, b);
+      _mm_storeu_ps(dest + 8, c);
+    }
+#elif defined(ROXLU_USE_NEON)
+    for(; i + 4 <= n; i += 4) {
+      float32x4x3_t p = vld3q_f32(&in[i].x);
+      float32x4x3_t r;
+      r.val[0] = vmlaq_n_f32(vmlaq_n_f32(vmlaq_n_f32(vdupq_n_f32(m[12]), p.val[0], m[0]), p.val[1], m[4]), p.val[2], m[8]);
+      r.val[1] = vmlaq_n_f32(vmlaq_n_f32(vmlaq_n_f32(vdupq_n_f32(m[13]), p.val[0], m[1]), p.val[1], m[5]), p.val[2], m[9]);
+      r.val[2] = vmlaq_n_f32(vmlaq_n_f32(vmlaq_n_f32(vdupq_n_f32(m[14]), p.val[0], m[2]), p.val[1], m[6]), p.val[2], m[10]);
+      vst3q_f32(&out[i].x, r);
+    }
+#endif
+
+    for(; i < n; ++i) {
+      out[i] = transform(in[i]);
+    }
+  }
+
+  void Mat4::transformPoints(const Vec4* in, Vec4* out, size_t n) const {
+#if defined(ROXLU_USE_SSE)
+    __m128 c0 = _mm_loadu_ps(m);
+    __m128 c1 = _mm_loadu_ps(m + 4);
+    __m128 c2 = _mm_loadu_ps(m + 8);
+    __m128 c3 = _mm_loadu_ps(m + 12);
+
+    for(size_t i = 0; i < n; ++i) {
+      const float* v = &in[i].x;
+      __m128 r = _mm_mul_ps(c0, _mm_set1_ps(v[0]));
+      r = _mm_add_ps(r, _mm_mul_ps(c1, _mm_set1_ps(v[1])));
+      r = _mm_add_ps(r, _mm_mul_ps(c2, _mm_set1_ps(v[2])));
+      r = _mm_add_ps(r, _mm_mul_ps(c3, _mm_set1_ps(v[3])));
+      _mm_storeu_ps(&out[i].x, r);
+    }
+#elif defined(ROXLU_USE_NEON)
+    float32x4_t c0 = vld1q_f32(m);
+    float32x4_t c1 = vld1q_f32(m + 4);
+    float32x4_t c2 = vld1q_f32(m + 8);
+    float32x4_t c3 = vld1q_f32(m + 12);
+
+    for(size_t i = 0; i < n; ++i) {
+      float32x4_t v = vld1q_f32(&in[i].x);
+      float32x4_t r = vmulq_lane_f32(c0, vget_low_f32(v), 0);
+      r = vmlaq_lane_f32(r, c1, vget_low_f32(v), 1);
+      r = vmlaq_lane_f32(r, c2, vget_high_f32(v), 0);
+      r = vmlaq_lane_f32(r, c3, vget_high_f32(v), 1);
+      vst1q_f32(&out[i].x, r);
+    }
+#else
+    for(size_t i = 0; i < n; ++i) {
+      Vec4 v = in[i];
+      out[i].x = m[0] * v.x  + m[4] * v.y  + m[8]  * v.z + m[12] * v.w;
+      out[i].y = m[1] * v.x  + m[5] * v.y  + m[9]  * v.z + m[13] * v.w;
+      out[i].z = m[2] * v.x  + m[6] * v.y  + m[10] * v.z + m[14] * v.w;
+      out[i].w = m[3] * v.x  + m[7] * v.y  + m[11] * v.z + m[15] * v.w;
+    }
+#endif
+  }
+
+#if defined(ROXLU_USE_SSE)
+  // The inverse of the upper 3x3 has the cross products of its columns as rows, 
+  // divided by the determinant; the translation becomes -(inverse 3x3 * translation).
+  Mat4 affine_inverse_sse(const Mat4& o) {
+    Mat4 r;
+    __m128 a = _mm_loadu_ps(o.m);
+    __m128 b = _mm_loadu_ps(o.m + 4);
+    __m128 c = _mm_loadu_ps(o.m + 8);
+    __m128 t = _mm_loadu_ps(o.m + 12);
+
+    // cross(u, v) = u.yzx * v.zxy - u.zxy * v.yzx; the w lanes become 0
+    __m128 a_yzx = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+    __m128 a_zxy = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 1, 0, 2));
+    __m128 b_yzx = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+    __m128 b_zxy = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 1, 0, 2));
+    __m128 c_yzx = _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1));
+    __m128 c_zxy = _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 1, 0, 2));
+    __m128 r0 = _mm_sub_ps(_mm_mul_ps(b_yzx, c_zxy), _mm_mul_ps(b_zxy, c_yzx));
+    __m128 r1 = _mm_sub_ps(_mm_mul_ps(c_yzx, a_zxy), _mm_mul_ps(c_zxy, a_yzx));
+    __m128 r2 = _mm_sub_ps(_mm_mul_ps(a_yzx, b_zxy), _mm_mul_ps(a_zxy, b_yzx));
+    __m128 r3 = _mm_setzero_ps();
+
+    // det = dot(a, cross(b, c))
+    __m128 d = _mm_mul_ps(a, r0);
+    d = _mm_add_ps(d, _mm_movehl_ps(d, d));
+    d = _mm_add_ss(d, _mm_shuffle_ps(d, d, _MM_SHUFFLE(1, 1, 1, 1)));
+    float det = _mm_cvtss_f32(d);
+    if (IS_ZERO(det))  {
+      printf("affine inverse error!\n");
+      return r;
+    }
+
+    // rows -> columns, and the zero row gives us 0 in the w lanes
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+    __m128 inv_det = _mm_set1_ps(1.0f / det);
+    r0 = _mm_mul_ps(r0, inv_det);
+    r1 = _mm_mul_ps(r1, inv_det);
+    r2 = _mm_mul_ps(r2, inv_det);
+
+    __m128 rt = _mm_mul_ps(r0, _mm_shuffle_ps(t, t, _MM_SHUFFLE(0, 0, 0, 0)));
+    rt = _mm_add_ps(rt, _mm_mul_ps(r1, _mm_shuffle_ps(t, t, _MM_SHUFFLE(1, 1, 1, 1))));
+    rt = _mm_add_ps(rt, _mm_mul_ps(r2, _mm_shuffle_ps(t, t, _MM_SHUFFLE(2, 2, 2, 2))));
+    rt = _mm_sub_ps(_mm_setzero_ps(), rt);
+
+    _mm_storeu_ps(r.m, r0);
+    _mm_storeu_ps(r.m + 4, r1);
+    _mm_storeu_ps(r.m + 8, r2);
+    _mm_storeu_ps(r.m + 12, rt);
+    r.m[15] = 1.0f;
+    return r;
+  }
+
+  // Cramer's rule, see Intel AP-928 "Streaming SIMD Extensions - Inverse of 4x4 Matrix". 
+  // Works on the transposed matrix which gives the same result for column major storage.
+  int mat4_inverse_sse(const Mat4& o, Mat4& result) {
+    const float* src = o.m;
+    __m128 minor0, minor1, minor2, minor3;
+    __m128 row0, row1, row2, row3;
+    __m128 det, tmp1;
+
+    tmp1 = _mm_setzero_ps();
+    row1 = _mm_setzero_ps();
+    row3 = _mm_setzero_ps();
+
+    tmp1 = _mm_loadh_pi(_mm_loadl_pi(tmp1, (const __m64*)(src)), (const __m64*)(src + 4));
+    row1 = _mm_loadh_pi(_mm_loadl_pi(row1, (const __m64*)(src + 8)), (const __m64*)(src + 12));
+    row0 = _mm_shuffle_ps(tmp1, row1, 0x88);
+    row1 = _mm_shuffle_ps(row1, tmp1, 0xDD);
+    tmp1 = _mm_loadh_pi(_mm_loadl_pi(tmp1, (const __m64*)(src + 2)), (const __m64*)(src + 6));
+    row3 = _mm_loadh_pi(_mm_loadl_pi(row3, (const __m64*)(src + 10)), (const __m64*)(src + 14));
+    row2 = _mm_shuffle_ps(tmp1, row3, 0x88);
+    row3 = _mm_shuffle_ps(row3, tmp1, 0xDD);
+
+    tmp1 = _mm_mul_ps(row2, row3);
+    tmp1 = _mm_shuffle_ps(tmp1, tmp1, 0xB1);
+    minor0 = _mm_mul_ps(row1, tmp1);
+    minor1 = _mm_mul_ps(row0, tmp1);
+    tmp1 = _mm_shuffle_ps(tmp1, tmp1, 0x4E);
+    minor0 = _mm_sub_ps(_mm_mul_ps(row1, tmp1), minor0);
+    minor1 = _mm_sub_ps(_mm_mul_ps(row0, tmp1), minor1);
+    minor1 = _mm_shuffle_ps(minor1, minor1, 0x4E);
+
+    tmp1 = _mm_mul_ps(row1, row2);
+    tmp1 = _mm_shuffle_ps(tmp1, tmp1, 0xB1);
+    minor0 = _mm_add_ps(_mm_mul_ps(row3, tmp1), minor0);
+    minor3 = _mm_mul_ps(row0, tmp1);
+    tmp1 = _mm_shuffle_ps(tmp1, tmp1, 0x4E);
+    minor0 = _mm_sub_ps(minor0, _mm_mul_ps(row3, tmp1));
+    minor3 = _mm_sub_ps(_mm_mul_ps(row0, tmp1), minor3);
+    minor3 = _mm_shuffle_ps(minor3, minor3, 0x4E);
+
+    tmp1 = _mm_mul_ps(_mm_shuffle_ps(row1, row1, 0x4E), row3);
+    tmp1 = _mm_shuffle_ps(tmp1, tmp1, 0xB1);
+    row2 = _mm_shuffle_ps(row2, row2, 0x4E);
+    minor0 = _mm_add_ps(_mm_mul_ps(row2, tmp1), minor0);
+    minor2 = _mm_mul_ps(row0, tmp1);
+    tmp1 = _mm_shuffle_ps(tmp1, tmp1, 0x4E);
+    minor0 = _mm_sub_ps(minor0, _mm_mul_ps(row2, tmp1));
+    minor2 = _mm_sub_ps(_mm_mul_ps(row0, tmp1), minor2);
+    minor2 = _mm_shuffle_ps(minor2, minor2, 0x4E);
+
+    tmp1 = _mm_mul_ps(row0, row1);
+    tmp1 = _mm_shuffle_ps(tmp1, tmp1, 0xB1);
+    minor2 = _mm_add_ps(_mm_mul_ps(row3, tmp1), minor2);
+    minor3 = _mm_sub_ps(_mm_mul_ps(row2, tmp1), minor3);
+    tmp1 = _mm_shuffle_ps(tmp1, tmp1, 0x4E);
+    minor2 = _mm_sub_ps(_mm_mul_ps(row3, tmp1), minor2);
+    minor3 = _mm_sub_ps(minor3, _mm_mul_ps(row2, tmp1));
+
+    tmp1 = _mm_mul_ps(row0, row3);
+    tmp1 = _mm_shuffle_ps(tmp1, tmp1, 0xB1);
+    minor1 = _mm_sub_ps(minor1, _mm_mul_ps(row2, tmp1));
+    minor2 = _mm_add_ps(_mm_mul_ps(row1, tmp1), minor2);
+    tmp1 = _mm_shuffle_ps(tmp1, tmp1, 0x4E);
+    minor1 = _mm_add_ps(_mm_mul_ps(row2, tmp1), minor1);
+    minor2 = _mm_sub_ps(minor2, _mm_mul_ps(row1, tmp1));
+
+    tmp1 = _mm_mul_ps(row0, row2);
+    tmp1 = _mm_shuffle_ps(tmp1, tmp1, 0xB1);
+    minor1 = _mm_add_ps(_mm_mul_ps(row3, tmp1), minor1);
+    minor3 = _mm_sub_ps(minor3, _mm_mul_ps(row1, tmp1));
+    tmp1 = _mm_shuffle_ps(tmp1, tmp1, 0x4E);
+    minor1 = _mm_sub_ps(minor1, _mm_mul_ps(row3, tmp1));
+    minor3 = _mm_add_ps(_mm_mul_ps(row1, tmp1), minor3);
+
+    det = _mm_mul_ps(row0, minor0);
+    det = _mm_add_ps(_mm_shuffle_ps(det, det, 0x4E), det);
+    det = _mm_add_ss(_mm_shuffle_ps(det, det, 0xB1), det);
+
+    float d = _mm_cvtss_f32(det);
+    if(d == 0.0f) {
+      return 0;
+    }
+
+    det = _mm_set1_ps(1.0f / d);
+    _mm_storeu_ps(result.m, _mm_mul_ps(det, minor0));
+    _mm_storeu_ps(result.m + 4, _mm_mul_ps(det, minor1));
+    _mm_storeu_ps(result.m + 8, _mm_mul_ps(det, minor2));
+    _mm_storeu_ps(result.m + 12, _mm_mul_ps(det, minor3));
+    return 1;
+  }
+#endif
+
 } // roxlu
@@ -34,6 +34,14 @@
 
 
 #include	<roxlu/math/Noise.h>
+#include	<roxlu/math/SIMD.h>
+#include	<math.h>
+
+#if defined(_WIN32)
+#  include <windows.h>
+#else
+#  include <pthread.h>
+#endif
 
 #define FASTFLOOR(x) ( ((x)>0) ? ((int)x) : (((int)x)-1) )
 
@@ -220,8 +228,8 @@ float Noise::noise(float x, float y) {
   float y2 = y0 - 1.0f + 2.0f * G2;
 
   // Wrap the integer indices at 256, to avoid indexing perm[] out of bounds
-  int ii = i % 256;
-  int jj = j % 256;
+  int ii = i & 255;
+  int jj = j & 255;
 
   // Calculate the contribution from the three corners
   float t0 = 0.5f - x0*x0-y0*y0;
@@ -309,10 +317,10 @@ float Noise::noise(float x, float y, float z) {
   float y3 = y0 - 1.0f + 3.0f*G3;
   float z3 = z0 - 1.0f + 3.0f*G3;
 
-  // Wrap the integer indices at 256, to avoid indexing perm[] out of bounds
-  int ii = i % 256;
-  int jj = j % 256;
-  int kk = k % 256;
+  // Wrap the integer indices at 256, to avoid indexing perm[] out of bounds (& instead of % so negative coordinates work too)
+  int ii = i & 255;
+  int jj = j & 255;
+  int kk = k & 255;
 
   // Calculate the contribution from the four corners
   float t0 = 0.6f - x0*x0 - y0*y0 - z0*z0;
@@ -438,11 +446,11 @@ float Noise::noise(float x, float y, float z, float w) {
   float z4 = z0 - 1.0f + 4.0f*G4;
   float w4 = w0 - 1.0f + 4.0f*G4;
 
-  // Wrap the integer indices at 256, to avoid indexing perm[] out of bounds
-  int ii = i % 256;
-  int jj = j % 256;
-  int kk = k % 256;
-  int ll = l % 256;
+  // Wrap the integer indices at 256, to avoid indexing perm[] out of bounds (& instead of % so negative coordinates work too)
+  int ii = i & 255;
+  int jj = j & 255;
+  int kk = k & 255;
+  int ll = l & 255;
 
   // Calculate the contribution from the five corners
   float t0 = 0.6f - x0*x0 - y0*y0 - z0*z0 - w0*w0;
@@ -484,3 +492,481 @@ float Noise::noise(float x, float y, float z, float w) {
   return 27.0f * (n0 + n1 + n2 + n3 + n4); // TODO: The scale factor is preliminary!
 }
 //---------------------------------------------------------------------
+
+//---------------------------------------------------------------------
+// Fractal and batch functions
+
+NoiseSettings::NoiseSettings()
+  :octaves(1)
+  ,frequency(1.0f)
+  ,lacunarity(2.0f)
+  ,gain(0.5f)
+  ,turbulence(false)
+{
+}
+
+float Noise::fbm(float x, float y, const NoiseSettings& ns) {
+  float freq = ns.frequency;
+  float amp = 1.0f;
+  float total = 0.0f;
+  float sum = 0.0f;
+
+  for(int i = 0; i < ns.octaves; ++i) {
+    float n = noise(x * freq, y * freq);
+    sum += amp * ((ns.turbulence) ? fabsf(n) : n);
+    total += amp;
+    freq *= ns.lacunarity;
+    amp *= ns.gain;
+  }
+
+  return (total > 0.0f) ? sum / total : 0.0f;
+}
+
+float Noise::fbm(float x, float y, float z, const NoiseSettings& ns) {
+  float freq = ns.frequency;
+  float amp = 1.0f;
+  float total = 0.0f;
+  float sum = 0.0f;
+
+  for(int i = 0; i < ns.octaves; ++i) {
+    float n = noise(x * freq, y * freq, z * freq);
+    sum += amp * ((ns.turbulence) ? fabsf(n) : n);
+    total += amp;
+    freq *= ns.lacunarity;
+    amp *= ns.gain;
+  }
+
+  return (total > 0.0f) ? sum / total : 0.0f;
+}
+
+#if defined(ROXLU_USE_SSE)
+
+#include <emmintrin.h>
+
+// floor() for 4 floats using SSE2
+static inline __m128 noise_floor4(__m128 v) {
+  __m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(v));
+  return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, v), _mm_set1_ps(1.0f)));
+}
+
+// selects a where mask is set, else b
+static inline __m128 noise_select4(__m128 mask, __m128 a, __m128 b) {
+  return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+// flips the sign of v for the lanes where `bit` is set in h
+static inline __m128 noise_flip4(__m128i h, int bit, __m128 v) {
+  __m128i m = _mm_cmpeq_epi32(_mm_and_si128(h, _mm_set1_epi32(bit)), _mm_set1_epi32(bit));
+  return _mm_xor_ps(v, _mm_and_ps(_mm_castsi128_ps(m), _mm_set1_ps(-0.0f)));
+}
+
+static inline __m128 noise_grad4(__m128i hash, __m128 x, __m128 y) {
+  __m128i h = _mm_and_si128(hash, _mm_set1_epi32(7));
+  __m128 lt4 = _mm_castsi128_ps(_mm_cmplt_epi32(h, _mm_set1_epi32(4)));
+  __m128 u = noise_select4(lt4, x, y);
+  __m128 v = noise_select4(lt4, y, x);
+  return _mm_add_ps(noise_flip4(h, 1, u), noise_flip4(h, 2, _mm_add_ps(v, v)));
+}
+
+static inline __m128 noise_grad4(__m128i hash, __m128 x, __m128 y, __m128 z) {
+  __m128i h = _mm_and_si128(hash, _mm_set1_epi32(15));
+  __m128 lt8 = _mm_castsi128_ps(_mm_cmplt_epi32(h, _mm_set1_epi32(8)));
+  __m128 lt4 = _mm_castsi128_ps(_mm_cmplt_epi32(h, _mm_set1_epi32(4)));
+  __m128 h12_14 = _mm_castsi128_ps(_mm_or_si128(_mm_cmpeq_epi32(h, _mm_set1_epi32(12)), _mm_cmpeq_epi32(h, _mm_set1_epi32(14))));
+  __m128 u = noise_select4(lt8, x, y);
+  __m128 v = noise_select4(lt4, y, noise_select4(h12_14, x, z));
+  return _mm_add_ps(noise_flip4(h, 1, u), noise_flip4(h, 2, v));
+}
+
+// (max(t, 0))^4 * grad
+static inline __m128 noise_contrib4(__m128 t, __m128 g) {
+  t = _mm_max_ps(t, _mm_setzero_ps());
+  t = _mm_mul_ps(t, t);
+  return _mm_mul_ps(_mm_mul_ps(t, t), g);
+}
+
+// 2D simplex noise for 4 points; same math as Noise::noise(x, y), the permutation lookups are done per lane
+static __m128 noise_simplex4(const unsigned char* perm, __m128 x, __m128 y) {
+  const float f2 = 0.366025403f;
+  const float g2 = 0.211324865f;
+
+  __m128 s = _mm_mul_ps(_mm_add_ps(x, y), _mm_set1_ps(f2));
+  __m128 fi = noise_floor4(_mm_add_ps(x, s));
+  __m128 fj = noise_floor4(_mm_add_ps(y, s));
+  __m128 t = _mm_mul_ps(_mm_add_ps(fi, fj), _mm_set1_ps(g2));
+  __m128 x0 = _mm_sub_ps(x, _mm_sub_ps(fi, t));
+  __m128 y0 = _mm_sub_ps(y, _mm_sub_ps(fj, t));
+
+  __m128 one = _mm_set1_ps(1.0f);
+  __m128 i1 = _mm_and_ps(_mm_cmpgt_ps(x0, y0), one);
+  __m128 j1 = _mm_sub_ps(one, i1);
+
+  __m128 vg2 = _mm_set1_ps(g2);
+  __m128 x1 = _mm_add_ps(_mm_sub_ps(x0, i1), vg2);
+  __m128 y1 = _mm_add_ps(_mm_sub_ps(y0, j1), vg2);
+  __m128 x2 = _mm_add_ps(_mm_sub_ps(x0, one), _mm_set1_ps(2.0f * g2));
+  __m128 y2 = _mm_add_ps(_mm_sub_ps(y0, one), _mm_set1_ps(2.0f * g2));
+
+  ROXLU_ALIGN16 int ii[4], jj[4], oi[4], h0[4], h1[4], h2[4];
+  __m128i mask = _mm_set1_epi32(255);
+  _mm_store_si128((__m128i*)ii, _mm_and_si128(_mm_cvttps_epi32(fi), mask));
+  _mm_store_si128((__m128i*)jj, _mm_and_si128(_mm_cvttps_epi32(fj), mask));
+  _mm_store_si128((__m128i*)oi, _mm_cvttps_epi32(i1));
+
+  for(int l = 0; l < 4; ++l) {
+    int a = ii[l];
+    int b = jj[l];
+    int o = oi[l];
+    h0[l] = perm[a + perm[b]];
+    h1[l] = perm[a + o + perm[b + 1 - o]];
+    h2[l] = perm[a + 1 + perm[b + 1]];
+  }
+
+  __m128 half = _mm_set1_ps(0.5f);
+  __m128 n0 = noise_contrib4(_mm_sub_ps(_mm_sub_ps(half, _mm_mul_ps(x0, x0)), _mm_mul_ps(y0, y0)), noise_grad4(_mm_load_si128((__m128i*)h0), x0, y0));
+  __m128 n1 = noise_contrib4(_mm_sub_ps(_mm_sub_ps(half, _mm_mul_ps(x1, x1)), _mm_mul_ps(y1, y1)), noise_grad4(_mm_load_si128((__m128i*)h1), x1, y1));
+  __m128 n2 = noise_contrib4(_mm_sub_ps(_mm_sub_ps(half, _mm_mul_ps(x2, x2)), _mm_mul_ps(y2, y2)), noise_grad4(_mm_load_si128((__m128i*)h2), x2, y2));
+
+  return _mm_mul_ps(_mm_set1_ps(40.0f), _mm_add_ps(_mm_add_ps(n0, n1), n2));
+}
+
+// 3D simplex noise for 4 points; same math as Noise::noise(x, y, z)
+static __m128 noise_simplex4(const unsigned char* perm, __m128 x, __m128 y, __m128 z) {
+  const float f3 = 0.333333333f;
+  const float g3 = 0.166666667f;
+
+  __m128 s = _mm_mul_ps(_mm_add_ps(_mm_add_ps(x, y), z), _mm_set1_ps(f3));
+  __m128 fi = noise_floor4(_mm_add_ps(x, s));
+  __m128 fj = noise_floor4(_mm_add_ps(y, s));
+  __m128 fk = noise_floor4(_mm_add_ps(z, s));
+  __m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(fi, fj), fk), _mm_set1_ps(g3));
+  __m128 x0 = _mm_sub_ps(x, _mm_sub_ps(fi, t));
+  __m128 y0 = _mm_sub_ps(y, _mm_sub_ps(fj, t));
+  __m128 z0 = _mm_sub_ps(z, _mm_sub_ps(fk, t));
+
+  // the rank ordering of x0, y0, z0 selects the simplex; see the if/else in Noise::noise(x, y, z)
+  __m128 xy = _mm_cmpge_ps(x0, y0);
+  __m128 yz = _mm_cmpge_ps(y0, z0);
+  __m128 xz = _mm_cmpge_ps(x0, z0);
+  __m128 one = _mm_set1_ps(1.0f);
+  __m128 i1 = _mm_and_ps(_mm_and_ps(xy, xz), one);
+  __m128 j1 = _mm_and_ps(_mm_andnot_ps(xy, yz), one);
+  __m128 k1 = _mm_andnot_ps(_mm_or_ps(xz, yz), one);
+  __m128 i2 = _mm_and_ps(_mm_or_ps(xy, xz), one);
+  __m128 j2 = _mm_and_ps(_mm_or_ps(_mm_andnot_ps(xy, _mm_castsi128_ps(_mm_set1_epi32(-1))), yz), one);
+  __m128 k2 = _mm_andnot_ps(_mm_and_ps(xz, yz), one);
+
+  __m128 vg3 = _mm_set1_ps(g3);
+  __m128 vg3x2 = _mm_set1_ps(2.0f * g3);
+  __m128 vg3x3m1 = _mm_set1_ps(3.0f * g3 - 1.0f);
+  __m128 x1 = _mm_add_ps(_mm_sub_ps(x0, i1), vg3);
+  __m128 y1 = _mm_add_ps(_mm_sub_ps(y0, j1), vg3);
+  __m128 z1 = _mm_add_ps(_mm_sub_ps(z0, k1), vg3);
+  __m128 x2 = _mm_add_ps(_mm_sub_ps(x0, i2), vg3x2);
+  __m128 y2 = _mm_add_ps(_mm_sub_ps(y0, j2), vg3x2);
+  __m128 z2 = _mm_add_ps(_mm_sub_ps(z0, k2), vg3x2);
+  __m128 x3 = _mm_add_ps(x0, vg3x3m1);
+  __m128 y3 = _mm_add_ps(y0, vg3x3m1);
+  __m128 z3 = _mm_add_ps(z0, vg3x3m1);
+
+  ROXLU_ALIGN16 int ii[4], jj[4], kk[4], o1[4], o2[4], h0[4], h1[4], h2[4], h3[4];
+  __m128i mask = _mm_set1_epi32(255);
+  _mm_store_si128((__m128i*)ii, _mm_and_si128(_mm_cvttps_epi32(fi), mask));
+  _mm_store_si128((__m128i*)jj, _mm_and_si128(_mm_cvttps_epi32(fj), mask));
+  _mm_store_si128((__m128i*)kk, _mm_and_si128(_mm_cvttps_epi32(fk), mask));
+
+  // pack the corner offsets as bits: i = 1, j = 2, k = 4
+  __m128i c1 = _mm_cvttps_epi32(_mm_add_ps(_mm_add_ps(i1, _mm_add_ps(j1, j1)), _mm_mul_ps(k1, _mm_set1_ps(4.0f))));
+  __m128i c2 = _mm_cvttps_epi32(_mm_add_ps(_mm_add_ps(i2, _mm_add_ps(j2, j2)), _mm_mul_ps(k2, _mm_set1_ps(4.0f))));
+  _mm_store_si128((__m128i*)o1, c1);
+  _mm_store_si128((__m128i*)o2, c2);
+
+  for(int l = 0; l < 4; ++l) {
+    int a = ii[l];
+    int b = jj[l];
+    int c = kk[l];
+    int p1 = o1[l];
+    int p2 = o2[l];
+    h0[l] = perm[a + perm[b + perm[c]]];
+    h1[l] = perm[a + (p1 & 1) + perm[b + ((p1 >> 1) & 1) + perm[c + (p1 >> 2)]]];
+    h2[l] = perm[a + (p2 & 1) + perm[b + ((p2 >> 1) & 1) + perm[c + (p2 >> 2)]]];
+    h3[l] = perm[a + 1 + perm[b + 1 + perm[c + 1]]];
+  }
+
+  __m128 r = _mm_set1_ps(0.6f);
+  __m128 n0 = noise_contrib4(_mm_sub_ps(r, _mm_add_ps(_mm_add_ps(_mm_mul_ps(x0, x0), _mm_mul_ps(y0, y0)), _mm_mul_ps(z0, z0))), noise_grad4(_mm_load_si128((__m128i*)h0), x0, y0, z0));
+  __m128 n1 = noise_contrib4(_mm_sub_ps(r, _mm_add_ps(_mm_add_ps(_mm_mul_ps(x1, x1), _mm_mul_ps(y1, y1)), _mm_mul_ps(z1, z1))), noise_grad4(_mm_load_si128((__m128i*)h1), x1, y1, z1));
+  __m128 n2 = noise_contrib4(_mm_sub_ps(r, _mm_add_ps(_mm_add_ps(_mm_mul_ps(x2, x2), _mm_mul_ps(y2, y2)), _mm_mul_ps(z2, z2))), noise_grad4(_mm_load_si128((__m128i*)h2), x2, y2, z2));
+  __m128 n3 = noise_contrib4(_mm_sub_ps(r, _mm_add_ps(_mm_add_ps(_mm_mul_ps(x3, x3), _mm_mul_ps(y3, y3)), _mm_mul_ps(z3, z3))), noise_grad4(_mm_load_si128((__m128i*)h3), x3, y3, z3));
+
+  return _mm_mul_ps(_mm_set1_ps(32.0f), _mm_add_ps(_mm_add_ps(n0, n1), _mm_add_ps(n2, n3)));
+}
+
+#endif // ROXLU_USE_SSE
+
+void Noise::fbm4(const float* x, const float* y, float* out, const NoiseSettings& ns) {
+#if defined(ROXLU_USE_SSE)
+  __m128 px = _mm_loadu_ps(x);
+  __m128 py = _mm_loadu_ps(y);
+  __m128 sum = _mm_setzero_ps();
+  __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+  float freq = ns.frequency;
+  float amp = 1.0f;
+  float total = 0.0f;
+
+  for(int i = 0; i < ns.octaves; ++i) {
+    __m128 f = _mm_set1_ps(freq);
+    __m128 n = noise_simplex4(perm, _mm_mul_ps(px, f), _mm_mul_ps(py, f));
+    if(ns.turbulence) {
+      n = _mm_and_ps(n, abs_mask);
+    }
+    sum = _mm_add_ps(sum, _mm_mul_ps(n, _mm_set1_ps(amp)));
+    total += amp;
+    freq *= ns.lacunarity;
+    amp *= ns.gain;
+  }
+
+  _mm_storeu_ps(out, (total > 0.0f) ? _mm_div_ps(sum, _mm_set1_ps(total)) : _mm_setzero_ps());
+#else
+  for(int i = 0; i < 4; ++i) {
+    out[i] = fbm(x[i], y[i], ns);
+  }
+#endif
+}
+
+void Noise::fbm4(const float* x, const float* y, const float* z, float* out, const NoiseSettings& ns) {
+#if defined(ROXLU_USE_SSE)
+  __m128 px = _mm_loadu_ps(x);
+  __m128 py = _mm_loadu_ps(y);
+  __m128 pz = _mm_loadu_ps(z);
+  __m128 sum = _mm_setzero_ps();
+  __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+  float freq = ns.frequency;
+  float amp = 1.0f;
+  float total = 0.0f;
+
+  for(int i = 0; i < ns.octaves; ++i) {
+    __m128 f = _mm_set1_ps(freq);
+    __m128 n = noise_simplex4(perm, _mm_mul_ps(px, f), _mm_mul_ps(py, f), _mm_mul_ps(pz, f));
+    if(ns.turbulence) {
+      n = _mm_and_ps(n, abs_mask);
+    }
+    sum = _mm_add_ps(sum, _mm_mul_ps(n, _mm_set1_ps(amp)));
+    total += amp;
+    freq *= ns.lacunarity;
+    amp *= ns.gain;
+  }
+
+  _mm_storeu_ps(out, (total > 0.0f) ? _mm_div_ps(sum, _mm_set1_ps(total)) : _mm_setzero_ps());
+#else
+  for(int i = 0; i < 4; ++i) {
+    out[i] = fbm(x[i], y[i], z[i], ns);
+  }
+#endif
+}
+
+// fills the rows [row_start, row_end) of a grid; for 3D grids row r is row (r % h) of slice (r / h)
+struct NoiseFillTask {
+  float* out;
+  int w;
+  int h;
+  int row_start;
+  int row_end;
+  float x;
+  float y;
+  float z;
+  float step;
+  bool is_3d;
+  const NoiseSettings* settings;
+};
+
+static void noise_fill_rows(NoiseFillTask* task) {
+  ROXLU_ALIGN16 float xs[4];
+  ROXLU_ALIGN16 float ys[4];
+  ROXLU_ALIGN16 float zs[4];
+  ROXLU_ALIGN16 float result[4];
+  int w = task->w;
+
+  for(int r = task->row_start; r < task->row_end; ++r) {
+    float py = task->y + (r % task->h) * task->step;
+    float pz = task->z + (r / task->h) * task->step;
+    float* dest = task->out + (size_t)r * w;
+
+    for(int l = 0; l < 4; ++l) {
+      ys[l] = py;
+      zs[l] = pz;
+    }
+
+    for(int i = 0; i < w; i += 4) {
+      for(int l = 0; l < 4; ++l) {
+        xs[l] = task->x + (i + l) * task->step;
+      }
+
+      if(task->is_3d) {
+        Noise::fbm4(xs, ys, zs, result, *task->settings);
+      }
+      else {
+        Noise::fbm4(xs, ys, result, *task->settings);
+      }
+
+      int n = (w - i < 4) ? (w - i) : 4;
+      for(int l = 0; l < n; ++l) {
+        dest[i + l] = result[l];
+      }
+    }
+  }
+}
+
+#if defined(_WIN32)
+static DWORD WINAPI noise_fill_thread(LPVOID user) {
+  noise_fill_rows(static_cast<NoiseFillTask*>(user));
+  return 0;
+}
+#else
+static void* noise_fill_thread(void* user) {
+  noise_fill_rows(static_cast<NoiseFillTask*>(user));
+  return NULL;
+}
+#endif
+
+// splits the rows into `numThreads` bands; the calling thread computes the first band
+static void noise_fill(NoiseFillTask& task, int numRows, int numThreads) {
+  if(numThreads > numRows) {
+    numThreads = numRows;
+  }
+
+  if(numThreads <= 1) {
+    task.row_start = 0;
+    task.row_end = numRows;
+    noise_fill_rows(&task);
+    return;
+  }
+
+  NoiseFillTask* tasks = new NoiseFillTask[numThreads];
+#if defined(_WIN32)
+  HANDLE* threads = new HANDLE[numThreads];
+#else
+  pthread_t* threads = new pthread_t[numThreads];
+  bool* started = new bool[numThreads];
+#endif
+
+  int band = numRows / numThreads;
+  int rest = numRows % numThreads;
+  int row = 0;
+
+  for(int i = 0; i < numThreads; ++i) {
+    tasks[i] = task;
+    tasks[i].row_start = row;
+    row += band + ((i < rest) ? 1 : 0);
+    tasks[i].row_end = row;
+  }
+
+  for(int i = 1; i < numThreads; ++i) {
+#if defined(_WIN32)
+    threads[i] = CreateThread(NULL, 0, noise_fill_thread, &tasks[i], 0, NULL);
+    if(!threads[i]) {
+      noise_fill_rows(&tasks[i]);
+    }
+#else
+    started[i] = (pthread_create(&threads[i], NULL, noise_fill_thread, &tasks[i]) == 0);
+    if(!started[i]) {
+      noise_fill_rows(&tasks[i]);
+    }
+#endif
+  }
+
+  noise_fill_rows(&tasks[0]);
+
+  for(int i = 1; i < numThreads; ++i) {
+#if defined(_WIN32)
+    if(threads[i]) {
+      WaitForSingleObject(threads[i], INFINITE);
+      CloseHandle(threads[i]);
+    }
+#else
+    if(started[i]) {
+      pthread_join(threads[i], NULL);
+    }
+#endif
+  }
+
+#if !defined(_WIN32)
+  delete[] started;
+#endif
+  delete[] threads;
+  delete[] tasks;
+}
+
+void Noise::fill(float* out, int w, int h, float x, float y, float step, const NoiseSettings& ns, int numThreads) {
+  if(!out || w <= 0 || h <= 0) {
+    return;
+  }
+
+  NoiseFillTask task;
+  task.out = out;
+  task.w = w;
+  task.h = h;
+  task.x = x;
+  task.y = y;
+  task.z = 0.0f;
+  task.step = step;
+  task.is_3d = false;
+  task.settings = &ns;
+  noise_fill(task, h, numThreads);
+}
+
+void Noise::fill(float* out, int w, int h, int d, float x, float y, float z, float step, const NoiseSettings& ns, int numThreads) {
+  if(!out || w <= 0 || h <= 0 || d <= 0) {
+    return;
+  }
+
+  NoiseFillTask task;
+  task.out = out;
+  task.w = w;
+  task.h = h;
+  task.x = x;
+  task.y = y;
+  task.z = z;
+  task.step = step;
+  task.is_3d = true;
+  task.settings = &ns;
+  noise_fill(task, h * d, numThreads);
+}
+
+void Noise::noise2(const float* xy, float* out, size_t n, const NoiseSettings& ns) {
+  ROXLU_ALIGN16 float xs[4] = { 0.0f };
+  ROXLU_ALIGN16 float ys[4] = { 0.0f };
+  ROXLU_ALIGN16 float result[4];
+
+  for(size_t i = 0; i < n; i += 4) {
+    size_t count = (n - i < 4) ? (n - i) : 4;
+    for(size_t l = 0; l < count; ++l) {
+      xs[l] = xy[(i + l) * 2 + 0];
+      ys[l] = xy[(i + l) * 2 + 1];
+    }
+    fbm4(xs, ys, result, ns);
+    for(size_t l = 0; l < count; ++l) {
+      out[i + l] = result[l];
+    }
+  }
+}
+
+void Noise::noise3(const float* xyz, float* out, size_t n, const NoiseSettings& ns) {
+  ROXLU_ALIGN16 float xs[4] = { 0.0f };
+  ROXLU_ALIGN16 float ys[4] = { 0.0f };
+  ROXLU_ALIGN16 float zs[4] = { 0.0f };
+  ROXLU_ALIGN16 float result[4];
+
+  for(size_t i = 0; i < n; i += 4) {
+    size_t count = (n - i < 4) ? (n - i) : 4;
+    for(size_t l = 0; l < count; ++l) {
+      xs[l] = xyz[(i + l) * 3 + 0];
+      ys[l] = xyz[(i + l) * 3 + 1];
+      zs[l] = xyz[(i + l) * 3 + 2];
+    }
+    fbm4(xs, ys, zs, result, ns);
+    for(size_t l = 0; l < count; ++l) {
+      out[i + l] = result[l];
+    }
+  }
+}